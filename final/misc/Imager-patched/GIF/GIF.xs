@@ -34,7 +34,7 @@ i_writegif_wiol(ig, opts,...)
 	    croak("i_writegif_callback: Second argument must be a hash ref");
 	hv = (HV *)SvRV(ST(1));
 	memset(&quant, 0, sizeof(quant));
-	quant.version = 1;
+	quant.version = 2;
 	quant.mc_size = 256;
 	quant.transp = tr_threshold;
 	quant.tr_threshold = 127;
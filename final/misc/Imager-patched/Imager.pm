@@ -112,6 +112,18 @@ my %readers;
 # registered file writers
 my %writers;
 
+# registered fused thumbnail generators
+my %thumbnailers;
+
+# registered header probes
+my %probers;
+
+# registered incremental decoders
+my %decoders;
+
+# registered incremental encoders
+my %encoders;
+
 # modules we attempted to autoload
 my %attempted_to_load;
 
@@ -270,8 +282,21 @@ BEGIN {
     };
   $filters{gaussian} = {
                         callseq => [ 'image', 'stddev' ],
-                        defaults => { },
-                        callsub => sub { my %hsh = @_; i_gaussian($hsh{image}, $hsh{stddev}); },
+                        defaults => { method => "exact" },
+                        callsub =>
+                        sub {
+                          my %hsh = @_;
+                          if ($hsh{method} eq "exact") {
+                            i_gaussian($hsh{image}, $hsh{stddev});
+                          }
+                          elsif ($hsh{method} eq "iir") {
+                            i_gaussian_iir($hsh{image}, $hsh{stddev})
+                              or die Imager->_error_as_msg() . "\n";
+                          }
+                          else {
+                            die "gaussian: method must be exact or iir\n";
+                          }
+                        },
                        };
   $filters{mosaic} =
     {
@@ -1348,6 +1373,11 @@ sub _get_reader_io {
     return $input->{io}, undef;
   }
   elsif ($input->{fd}) {
+    if ($input->{mmap}) {
+      # fall back to normal reads for pipes and the like
+      my $io = io_new_mmap($input->{fd});
+      $io and return $io;
+    }
     return io_new_fd($input->{fd});
   }
   elsif ($input->{fh}) {
@@ -1364,6 +1394,10 @@ sub _get_reader_io {
       return;
     }
     binmode $file;
+    if ($input->{mmap}) {
+      my $io = io_new_mmap(fileno($file));
+      $io and return ($io, $file);
+    }
     return (io_new_fd(fileno($file)), $file);
   }
   elsif ($input->{data}) {
@@ -1594,6 +1628,376 @@ sub register_writer {
   return 1;
 }
 
+sub register_thumbnailer {
+  my ($class, %opts) = @_;
+
+  defined $opts{type}
+    or die "register_thumbnailer called with no type parameter\n";
+
+  my $type = $opts{type};
+
+  defined $opts{square}
+    or die "register_thumbnailer called with no square parameter\n";
+
+  $thumbnailers{$type} = { square => $opts{square} };
+
+  return 1;
+}
+
+sub register_prober {
+  my ($class, %opts) = @_;
+
+  defined $opts{type}
+    or die "register_prober called with no type parameter\n";
+
+  my $type = $opts{type};
+
+  defined $opts{probe}
+    or die "register_prober called with no probe parameter\n";
+
+  $probers{$type} = $opts{probe};
+
+  return 1;
+}
+
+sub register_decoder {
+  my ($class, %opts) = @_;
+
+  defined $opts{type}
+    or die "register_decoder called with no type parameter\n";
+
+  my $type = $opts{type};
+
+  defined $opts{new}
+    or die "register_decoder called with no new parameter\n";
+
+  $decoders{$type} = $opts{new};
+
+  return 1;
+}
+
+sub new_decoder {
+  my ($class, %opts) = @_;
+
+  my $type = $opts{type};
+  unless (defined $type && length $type) {
+    $class->_set_error("new_decoder: type parameter missing");
+    return;
+  }
+  for my $cb (qw(header row)) {
+    if (defined $opts{$cb} && ref $opts{$cb} ne "CODE") {
+      $class->_set_error("new_decoder: $cb must be a code ref");
+      return;
+    }
+  }
+
+  _reader_autoload($type);
+
+  unless ($decoders{$type}) {
+    $class->_set_error("new_decoder: format '$type' has no incremental decoder");
+    return;
+  }
+
+  my $handle = $decoders{$type}->($class, %opts)
+    or return;
+
+  require Imager::Decoder;
+  return Imager::Decoder->_new($handle, %opts);
+}
+
+sub register_encoder {
+  my ($class, %opts) = @_;
+
+  defined $opts{type}
+    or die "register_encoder called with no type parameter\n";
+
+  my $type = $opts{type};
+
+  defined $opts{new}
+    or die "register_encoder called with no new parameter\n";
+
+  $encoders{$type} = $opts{new};
+
+  return 1;
+}
+
+my %scale_stream_fits =
+  (
+   nonprop => 0,
+   "non-proportional" => 0,
+   min => 1,
+   max => 2,
+  );
+
+sub scale_stream {
+  my ($class, %opts) = @_;
+
+  my $in = delete $opts{in};
+  my $out = delete $opts{out};
+  unless (ref $in && ref $out) {
+    $class->_set_error("scale_stream: in and out must be hash refs");
+    return;
+  }
+  my $xpixels = delete $opts{xpixels} || 0;
+  my $ypixels = delete $opts{ypixels} || 0;
+  unless ($xpixels =~ /^[0-9]+$/ && $ypixels =~ /^[0-9]+$/) {
+    $class->_set_error("scale_stream: xpixels and ypixels must be non-negative integers");
+    return;
+  }
+  unless ($xpixels || $ypixels) {
+    $class->_set_error("scale_stream: xpixels or ypixels must be supplied");
+    return;
+  }
+  my $fit = delete $opts{type};
+  defined $fit or $fit = "max";
+  unless (defined $scale_stream_fits{$fit}) {
+    $class->_set_error("scale_stream: invalid value for type parameter");
+    return;
+  }
+
+  my ($IO, $fh) = $class->_get_reader_io($in)
+    or return;
+
+  my $type = $in->{type};
+  unless ($type) {
+    $type = i_test_format_probe($IO, -1);
+  }
+  if ($in->{file} && !$type) {
+    $type = $FORMATGUESS->($in->{file});
+  }
+  unless ($type) {
+    $class->_set_error("scale_stream: type parameter missing and it couldn't be determined from the file contents");
+    return;
+  }
+
+  my $out_type = $out->{type};
+  if (!$out_type && $out->{file}) {
+    $out_type = $FORMATGUESS->($out->{file});
+  }
+  $out_type ||= $type;
+
+  _reader_autoload($type);
+  unless ($decoders{$type}) {
+    $class->_set_error("scale_stream: format '$type' has no incremental decoder");
+    return;
+  }
+  _writer_autoload($out_type);
+  unless ($encoders{$out_type}) {
+    $class->_set_error("scale_stream: format '$out_type' has no incremental encoder");
+    return;
+  }
+
+  # let JPEG decode at a reduced scale, unless the output size
+  # depends on which side is the larger
+  my %dec_opts = %opts;
+  unless ($fit eq "max" && $xpixels && $ypixels) {
+    $dec_opts{jpeg_target_width} ||= $xpixels;
+    $dec_opts{jpeg_target_height} ||= $ypixels;
+  }
+  my $dec = $decoders{$type}->($class, %dec_opts)
+    or return;
+
+  my ($OUT, @extras) = $class->_get_writer_io($out)
+    or return;
+  my $enc = $encoders{$out_type}->($class, $OUT, %opts)
+    or return;
+
+  unless (i_scale_stream($IO, $dec, $enc, $xpixels, $ypixels,
+			 $scale_stream_fits{$fit})) {
+    $class->_set_error($class->_error_as_msg);
+    return;
+  }
+
+  if (exists $out->{data}) {
+    my $data = io_slurp($OUT);
+    unless ($data) {
+      $class->_set_error("Could not slurp from buffer");
+      return;
+    }
+    ${$out->{data}} = $data;
+  }
+
+  return 1;
+}
+
+sub probe {
+  my ($class, %opts) = @_;
+
+  my ($IO, $fh) = $class->_get_reader_io(\%opts)
+    or return;
+
+  my $type = $opts{type};
+  unless ($type) {
+    $type = i_test_format_probe($IO, -1);
+  }
+  unless ($type) {
+    $class->_set_error("probe: format not recognized");
+    return;
+  }
+
+  _reader_autoload($type);
+
+  if ($probers{$type}) {
+    return $probers{$type}->($class, $IO, %opts);
+  }
+
+  my $info = i_probe_image_info($IO);
+  unless ($info) {
+    $class->_set_error($class->_error_as_msg);
+    return;
+  }
+
+  return $info;
+}
+
+sub square_thumbnail {
+  my ($class, %opts) = @_;
+
+  my $size = $opts{size};
+  unless (defined $size && $size =~ /^[1-9][0-9]*$/) {
+    $class->_set_error("square_thumbnail: size must be a positive integer");
+    return;
+  }
+  my $in = delete $opts{in};
+  my $out = delete $opts{out};
+  unless (ref $in && ref $out) {
+    $class->_set_error("square_thumbnail: in and out must be hash refs");
+    return;
+  }
+
+  my ($IO, $fh) = $class->_get_reader_io($in)
+    or return;
+
+  my $type = $in->{type};
+  unless ($type) {
+    $type = i_test_format_probe($IO, -1);
+  }
+  if ($in->{file} && !$type) {
+    $type = $FORMATGUESS->($in->{file});
+  }
+  unless ($type) {
+    $class->_set_error("square_thumbnail: type parameter missing and it couldn't be determined from the file contents");
+    return;
+  }
+
+  my $out_type = $out->{type};
+  if (!$out_type && $out->{file}) {
+    $out_type = $FORMATGUESS->($out->{file});
+  }
+  $out_type ||= $type;
+
+  _reader_autoload($type);
+
+  if ($type eq $out_type && $thumbnailers{$type}) {
+    my ($OUT, @extras) = $class->_get_writer_io($out)
+      or return;
+
+    $thumbnailers{$type}{square}->($class, $IO, $OUT, %opts)
+      or return;
+
+    if (exists $out->{data}) {
+      my $data = io_slurp($OUT);
+      unless ($data) {
+	$class->_set_error("Could not slurp from buffer");
+	return;
+      }
+      ${$out->{data}} = $data;
+    }
+
+    return 1;
+  }
+
+  # no single pass implementation, do it the long way, letting JPEG
+  # decode at a reduced scale as square_thumbnails() does
+  my $im = Imager->new;
+  $im->read(io => $IO, type => $type,
+	    jpeg_target_width => $size, jpeg_target_height => $size)
+    or return $class->_set_error($im->errstr);
+  my $side = _min($im->getwidth, $im->getheight);
+  my $square = $im->crop(left => int(($im->getwidth - $side) / 2),
+			 top => int(($im->getheight - $side) / 2),
+			 width => $side, height => $side)
+    or return $class->_set_error($im->errstr);
+  my $thumb = $square->scale(xpixels => $size, ypixels => $size,
+			     type => "nonprop", qtype => "mixing")
+    or return $class->_set_error($square->errstr);
+  $thumb->write(%opts, %$out, type => $out_type)
+    or return $class->_set_error($thumb->errstr);
+
+  return 1;
+}
+
+sub square_thumbnails {
+  my ($class, %opts) = @_;
+
+  my $in = delete $opts{in};
+  my $out = delete $opts{out};
+  my $sizes = delete $opts{sizes};
+  unless (ref $in eq "HASH" && ref $out eq "ARRAY") {
+    $class->_set_error("square_thumbnails: in must be a hash ref and out an array ref");
+    return;
+  }
+  unless (ref $sizes eq "ARRAY" && @$sizes
+	  && !grep !defined || !/^[1-9][0-9]*$/, @$sizes) {
+    $class->_set_error("square_thumbnails: sizes must be an array ref of positive integers");
+    return;
+  }
+  unless (@$out == @$sizes && !grep ref ne "HASH", @$out) {
+    $class->_set_error("square_thumbnails: out must have a hash ref for each size");
+    return;
+  }
+
+  my ($IO, $fh) = $class->_get_reader_io($in)
+    or return;
+
+  my $type = $in->{type};
+  unless ($type) {
+    $type = i_test_format_probe($IO, -1);
+  }
+  if ($in->{file} && !$type) {
+    $type = $FORMATGUESS->($in->{file});
+  }
+  unless ($type) {
+    $class->_set_error("square_thumbnails: type parameter missing and it couldn't be determined from the file contents");
+    return;
+  }
+
+  # the image is only decoded once, at reduced scale where the format
+  # supports it
+  my $largest = _max(@$sizes);
+  my $im = Imager->new;
+  $im->read(io => $IO, type => $type,
+	    jpeg_target_width => $largest, jpeg_target_height => $largest)
+    or return $class->_set_error($im->errstr);
+  my $side = _min($im->getwidth, $im->getheight);
+  my $square = $im->crop(left => int(($im->getwidth - $side) / 2),
+			 top => int(($im->getheight - $side) / 2),
+			 width => $side, height => $side)
+    or return $class->_set_error($im->errstr);
+  undef $im;
+
+  # each thumbnail is written as it's produced
+  $square->scale_pyramid
+    (
+     sizes => [ map [ $_, $_ ], @$sizes ],
+     callback => sub {
+       my ($thumb, $index) = @_;
+       my $dest = $out->[$index];
+       my $out_type = $dest->{type};
+       if (!$out_type && $dest->{file}) {
+	 $out_type = $FORMATGUESS->($dest->{file});
+       }
+       $out_type ||= $type;
+       $thumb->write(%opts, %$dest, type => $out_type)
+	 or return $class->_set_error($thumb->errstr);
+       return 1;
+     },
+    )
+    or return $class->_set_error($square->errstr || Imager->errstr);
+
+  return 1;
+}
+
 sub read_types {
   my %types =
     (
@@ -2345,6 +2749,87 @@ sub scaleY {
   return $img;
 }
 
+# Scales to several sizes, deriving each from a halved copy of the
+# image no less than twice the size, rather than from the image itself
+
+sub scale_pyramid {
+  my ($self, %opts) = @_;
+
+  $self->_valid_image("scale_pyramid")
+    or return;
+
+  my $sizes = $opts{sizes};
+  unless (ref $sizes eq "ARRAY" && @$sizes) {
+    $self->_set_error("scale_pyramid: sizes must be a non-empty array ref");
+    return;
+  }
+  my $callback = $opts{callback};
+  if ($callback && ref $callback ne "CODE") {
+    $self->_set_error("scale_pyramid: callback must be a code ref");
+    return;
+  }
+
+  my @targets;
+  for my $index (0 .. $#$sizes) {
+    my $size = $sizes->[$index];
+    my ($width, $height);
+    if (ref $size eq "ARRAY") {
+      ($width, $height) = @$size;
+    }
+    elsif (defined $size && !ref $size && $size =~ /^[1-9][0-9]*$/) {
+      (undef, undef, $width, $height) =
+	$self->scale_calculate(xpixels => $size, ypixels => $size,
+			       type => "min")
+	  or return;
+    }
+    unless (defined $width && $width =~ /^[1-9][0-9]*$/
+	    && defined $height && $height =~ /^[1-9][0-9]*$/) {
+      $self->_set_error("scale_pyramid: invalid size at index $index");
+      return;
+    }
+    push @targets, [ $width, $height ];
+  }
+
+  my @levels = ( $self );
+  my @result;
+  for my $index (0 .. $#targets) {
+    my ($width, $height) = @{$targets[$index]};
+
+    # find or make the smallest level at least twice the target size
+    my $level = 0;
+    while ($levels[$level]->getwidth >= 2 * $width
+	   && $levels[$level]->getheight >= 2 * $height) {
+      if ($level == $#levels) {
+	my $half = Imager->new;
+	$half->{IMG} = i_scale_halve($levels[$level]{IMG});
+	unless ($half->{IMG}) {
+	  $self->_set_error("scale_pyramid: " . $self->_error_as_msg);
+	  return;
+	}
+	push @levels, $half;
+      }
+      ++$level;
+    }
+
+    my $scaled = Imager->new;
+    $scaled->{IMG} = i_scale_mixing($levels[$level]{IMG}, $width, $height);
+    unless ($scaled->{IMG}) {
+      $self->_set_error("scale_pyramid: " . $self->_error_as_msg);
+      return;
+    }
+
+    if ($callback) {
+      $callback->($scaled, $index)
+	or return;
+    }
+    else {
+      push @result, $scaled;
+    }
+  }
+
+  return $callback ? 1 : @result;
+}
+
 # Transform returns a spatial transformation of the input image
 # this moves pixels to a new location in the returned image.
 # NOTE - should make a utility function to check transforms for
@@ -3776,25 +4261,60 @@ sub difference {
 sub difference_pixels {
   my ($self, %opts) = @_;
 
-  $self->_valid_image("difference")
+  $self->_valid_image("difference_pixels")
     or return;
 
   defined $opts{mindist} or $opts{mindist} = 0;
 
   defined $opts{other}
     or return $self->_set_error("No 'other' parameter supplied");
-  unless ($opts{other}->_valid_image("difference")) {
+  unless ($opts{other}->_valid_image("difference_pixels")) {
     $self->_set_error($opts{other}->errstr . " (other image)");
     return;
   }
 
+  defined $opts{limit} or $opts{limit} = -1;
+
   my $diff_pixels = i_diff_image_pixels($self->{IMG}, $opts{other}{IMG}, 
-                                        $opts{mindist})
-      or return $self->_set_error($self->_error_as_msg());
+                                        $opts{mindist}, $opts{limit});
+  $diff_pixels >= 0
+    or return $self->_set_error($self->_error_as_msg());
 
   return $diff_pixels;
 }
 
+sub compare {
+  my ($self, %opts) = @_;
+
+  $self->_valid_image("compare")
+    or return;
+
+  defined $opts{other}
+    or return $self->_set_error("No 'other' parameter supplied");
+  unless ($opts{other}->_valid_image("compare")) {
+    $self->_set_error($opts{other}->errstr . " (other image)");
+    return;
+  }
+
+  my $tile = 0;
+  if ($opts{heatmap}) {
+    $tile = defined $opts{tile} ? $opts{tile} : 16;
+    $tile =~ /^[1-9][0-9]*$/
+      or return $self->_set_error("compare: tile must be a positive integer");
+  }
+
+  my $result = i_img_compare($self->{IMG}, $opts{other}{IMG}, $tile)
+    or return $self->_set_error($self->_error_as_msg());
+
+  if ($result->{heatmap}) {
+    my $heatmap = Imager->new;
+    $heatmap->{IMG} = $result->{heatmap};
+    $result->{heatmap} = $heatmap;
+  }
+
+  return $result;
+}
+
 # destructive border - image is shrunk by one pixel all around
 
 sub border {
@@ -4021,6 +4541,44 @@ sub get_file_limits {
   i_get_image_file_limits();
 }
 
+sub set_threads {
+  my ($class, $threads) = @_;
+
+  unless (defined $threads && $threads =~ /^[0-9]+$/) {
+    $class->_set_error("set_threads: threads must be a positive integer");
+    return;
+  }
+  unless (i_set_threads($threads)) {
+    $class->_set_error($class->_error_as_msg);
+    return;
+  }
+
+  return 1;
+}
+
+sub get_threads {
+  i_get_threads();
+}
+
+sub set_image_pool {
+  my ($class, $bytes) = @_;
+
+  unless (defined $bytes && $bytes =~ /^[0-9]+$/) {
+    $class->_set_error("set_image_pool: bytes must be a non-negative integer");
+    return;
+  }
+  unless (i_set_image_pool($bytes)) {
+    $class->_set_error($class->_error_as_msg);
+    return;
+  }
+
+  return 1;
+}
+
+sub image_pool_stats {
+  i_get_image_pool_stats();
+}
+
 my @check_args = qw(width height channels sample_size);
 
 sub check_file_limits {
@@ -4515,6 +5073,15 @@ L<Imager::Fountain> - Helper for making gradient profiles.
 
 =item *
 
+L<Imager::ThumbCache> - cache encoded thumbnails and scaled images.
+
+=item *
+
+L<Imager::Decoder> - decode images incrementally, as their data
+arrives.
+
+=item *
+
 L<Imager::IO> - Imager I/O abstraction.
 
 =item *
@@ -4626,6 +5193,9 @@ from one or more images.
 combines() - L<Imager::Draw/combines()> - return a list of the
 different combine type keywords
 
+compare() - L<Imager::Filters/compare()> - measure the PSNR, SSIM
+and other differences between two images
+
 compose() - L<Imager::Transformations/compose()> - compose one image
 over another.
 
@@ -4645,6 +5215,9 @@ deltag() -  L<Imager::ImageTypes/deltag()> - delete image tags
 difference() - L<Imager::Filters/difference()> - produce a difference
 images from two input images.
 
+difference_pixels() - L<Imager::Filters/difference_pixels()> - count
+the pixels that differ between images
+
 errstr() - L</errstr()> - the error from the last failed operation.
 
 filter() - L<Imager::Filters/filter()> - image filtering
@@ -4687,9 +5260,15 @@ row or partial row of pixels.
 getscanline() - L<Imager::Draw/getscanline()> - retrieve colors for a
 row or partial row of pixels.
 
+get_threads() - L<Imager::Threads/get_threads()> - the number of
+threads filters may use.
+
 getwidth() - L<Imager::ImageTypes/getwidth()> - width of the image in
 pixels.
 
+image_pool_stats() - L<Imager::ImageTypes/image_pool_stats()> -
+statistics for the image memory pool.
+
 img_set() - L<Imager::ImageTypes/img_set()> - re-use an Imager object
 for a new image.
 
@@ -4727,6 +5306,9 @@ NCF() - L<Imager::Handy/NCF()>
 
 new() - L<Imager::ImageTypes/new()>
 
+new_decoder() - L<Imager::Files/new_decoder()> - decode an image as
+its data arrives
+
 newcolor() - L<Imager::Handy/newcolor()>
 
 newcolour() - L<Imager::Handy/newcolour()>
@@ -4753,6 +5335,9 @@ polyline() - L<Imager::Draw/polyline()>
 
 preload() - L<Imager::Files/preload()>
 
+probe() - L<Imager::Files/probe()> - read the size and format of an
+image file without reading the image data
+
 read() - L<Imager::Files/read()> - read a single image from an image file
 
 read_multi() - L<Imager::Files/read_multi()> - read multiple images from an image
@@ -4761,10 +5346,18 @@ file
 read_types() - L<Imager::Files/read_types()> - list image types Imager
 can read.
 
+register_decoder() - L<Imager::Files/register_decoder()>
+
+register_encoder() - L<Imager::Files/register_encoder()>
+
 register_filter() - L<Imager::Filters/register_filter()>
 
+register_prober() - L<Imager::Files/register_prober()>
+
 register_reader() - L<Imager::Files/register_reader()>
 
+register_thumbnailer() - L<Imager::Files/register_thumbnailer()>
+
 register_writer() - L<Imager::Files/register_writer()>
 
 rotate() - L<Imager::Transformations/rotate()>
@@ -4776,6 +5369,12 @@ scale() - L<Imager::Transformations/scale()>
 
 scale_calculate() - L<Imager::Transformations/scale_calculate()>
 
+scale_pyramid() - L<Imager::Transformations/scale_pyramid()> - scale
+an image to several sizes at once.
+
+scale_stream() - L<Imager::Files/scale_stream()> - scale an image file
+a row at a time.
+
 scaleX() - L<Imager::Transformations/scaleX()>
 
 scaleY() - L<Imager::Transformations/scaleY()>
@@ -4785,6 +5384,12 @@ in a paletted image
 
 set_file_limits() - L<Imager::Files/set_file_limits()>
 
+set_image_pool() - L<Imager::ImageTypes/set_image_pool()> - keep the
+memory of destroyed images for reuse.
+
+set_threads() - L<Imager::Threads/set_threads()> - set the number of
+threads filters may use.
+
 setmask() - L<Imager::ImageTypes/setmask()>
 
 setpixel() - L<Imager::Draw/setpixel()>
@@ -4795,6 +5400,12 @@ setscanline() - L<Imager::Draw/setscanline()>
 
 settag() - L<Imager::ImageTypes/settag()>
 
+square_thumbnail() - L<Imager::Files/square_thumbnail()> - scale the
+centered square of an image file to a thumbnail.
+
+square_thumbnails() - L<Imager::Files/square_thumbnails()> - scale the
+centered square of an image file to several thumbnail sizes.
+
 string() - L<Imager::Draw/string()> - draw text on an image
 
 tags() -  L<Imager::ImageTypes/tags()> - fetch image tags
@@ -22,6 +22,7 @@ extern "C" {
 #include "imextdef.h"
 #include "imextpltypes.h"
 #include "imperlio.h"
+#include "imsimd.h"
 #include <float.h>
 
 #if i_int_hlines_testing()
@@ -526,6 +527,7 @@ static struct value_name make_color_names[] =
   { "gray", mc_gray, },
   { "gray4", mc_gray4, },
   { "gray16", mc_gray16, },
+  { "wu", mc_wu, },
 };
 
 static struct value_name translate_names[] =
@@ -687,9 +689,18 @@ ip_handle_quant_opts(pTHX_ i_quantize *quant, HV *hv)
       }
     }
   }
+  sv = hv_fetch(hv, "errdiff_serpentine", 18, 0);
+  if (sv && *sv && SvTRUE(*sv))
+    quant->errdiff |= ed_bidir;
   sv = hv_fetch(hv, "perturb", 7, 0);
   if (sv && *sv)
     quant->perturb = SvIV(*sv);
+
+  if (quant->version >= 2) {
+    sv = hv_fetch(hv, "make_colors_step", 16, 0);
+    if (sv && *sv)
+      quant->mc_step = SvIV(*sv);
+  }
 }
 
 static void
@@ -726,6 +737,186 @@ ip_copy_colors_back(pTHX_ HV *hv, i_quantize *quant) {
   }
 }
 
+/* returns a reference to a hash describing a probed image file */
+static SV *
+ip_image_info_sv(pTHX_ const i_image_info *info) {
+  HV *hv = newHV();
+
+  hv_stores(hv, "type", newSVpv(info->format, 0));
+  hv_stores(hv, "width", newSViv(info->width));
+  hv_stores(hv, "height", newSViv(info->height));
+  hv_stores(hv, "channels", newSViv(info->channels));
+  hv_stores(hv, "bits", newSViv(info->bits));
+  hv_stores(hv, "paletted", newSViv(info->paletted));
+  hv_stores(hv, "orientation", newSViv(info->orientation));
+  hv_stores(hv, "progressive", newSViv(info->progressive));
+  hv_stores(hv, "interlaced", newSViv(info->interlaced));
+
+  return newRV_noinc((SV *)hv);
+}
+
+/* returns a reference to an array of the first count values */
+static SV *
+double_array_sv(pTHX_ const double *values, int count) {
+  AV *av = newAV();
+  int i;
+
+  for (i = 0; i < count; ++i)
+    av_push(av, newSVnv(values[i]));
+
+  return newRV_noinc((SV *)av);
+}
+
+/* returns a reference to a hash of the results of i_img_compare(),
+   the heatmap, if any, is owned by the hash */
+static SV *
+compare_result_sv(pTHX_ const i_img_compare_result *result) {
+  HV *hv = newHV();
+  AV *hists = newAV();
+  int ch, i;
+
+  hv_stores(hv, "width", newSViv(result->width));
+  hv_stores(hv, "height", newSViv(result->height));
+  hv_stores(hv, "channels", newSViv(result->channels));
+  hv_stores(hv, "mse", newSVnv(result->mse));
+  hv_stores(hv, "psnr", newSVnv(result->psnr));
+  hv_stores(hv, "mean_error", newSVnv(result->mean_error));
+  hv_stores(hv, "max_error", newSVnv(result->max_error));
+  hv_stores(hv, "ssim", newSVnv(result->ssim));
+  hv_stores(hv, "channel_mse",
+	    double_array_sv(aTHX_ result->channel_mse, result->channels));
+  hv_stores(hv, "channel_psnr",
+	    double_array_sv(aTHX_ result->channel_psnr, result->channels));
+  hv_stores(hv, "channel_mean_error",
+	    double_array_sv(aTHX_ result->channel_mean_error, result->channels));
+  hv_stores(hv, "channel_max_error",
+	    double_array_sv(aTHX_ result->channel_max_error, result->channels));
+  hv_stores(hv, "channel_ssim",
+	    double_array_sv(aTHX_ result->channel_ssim, result->channels));
+  for (ch = 0; ch < result->channels; ++ch) {
+    AV *hist = newAV();
+    av_extend(hist, 255);
+    for (i = 0; i < 256; ++i)
+      av_push(hist, newSViv(result->histogram[ch][i]));
+    av_push(hists, newRV_noinc((SV *)hist));
+  }
+  hv_stores(hv, "histograms", newRV_noinc((SV *)hists));
+  if (result->heatmap) {
+    SV *heatmap = newSV(0);
+    sv_setref_pv(heatmap, "Imager::ImgRaw", (void *)result->heatmap);
+    hv_stores(hv, "heatmap", heatmap);
+  }
+
+  return newRV_noinc((SV *)hv);
+}
+
+/* Perl callbacks for an incremental decoder, installed as the
+   decoder's callback data by Imager::DecoderHandle::set_callbacks */
+typedef struct {
+  SV *header;
+  SV *row;
+
+  /* the image being built when there's no row callback */
+  i_img *im;
+  i_img_dim width;
+  int channels;
+} ip_decoder_glue;
+
+/* call a decoder callback, pushing the exception as an error if it
+   dies.  Takes ownership of the arguments. */
+static int
+ip_decoder_call(pTHX_ SV *cb, SV *arg1, SV *arg2) {
+  int result = 1;
+  dSP;
+
+  ENTER;
+  SAVETMPS;
+  EXTEND(SP, 2);
+  PUSHMARK(SP);
+  PUSHs(sv_2mortal(arg1));
+  if (arg2)
+    PUSHs(sv_2mortal(arg2));
+  PUTBACK;
+
+  call_sv(cb, G_VOID | G_DISCARD | G_EVAL);
+
+  if (SvTRUE(ERRSV)) {
+    STRLEN len;
+    const char *msg = SvPV(ERRSV, len);
+
+    /* die "message\n" is common */
+    if (len && msg[len-1] == '\n')
+      --len;
+    i_push_errorf(0, "%.*s", (int)len, msg);
+    result = 0;
+  }
+
+  FREETMPS;
+  LEAVE;
+
+  return result;
+}
+
+static int
+ip_decoder_header(void *p, const i_image_info *info) {
+  dTHX;
+  ip_decoder_glue *glue = p;
+
+  glue->width = info->width;
+  glue->channels = info->channels;
+  if (!glue->row) {
+    glue->im = i_img_8_new(info->width, info->height, info->channels);
+    if (!glue->im)
+      return 0;
+  }
+
+  if (glue->header)
+    return ip_decoder_call(aTHX_ glue->header, ip_image_info_sv(aTHX_ info),
+			   NULL);
+
+  return 1;
+}
+
+static int
+ip_decoder_row(void *p, i_img_dim y, const i_color *row) {
+  dTHX;
+  ip_decoder_glue *glue = p;
+
+  if (glue->im)
+    i_plin(glue->im, 0, glue->width, y, row);
+
+  if (glue->row) {
+    STRLEN size = glue->width * glue->channels;
+    SV *samples = newSV(size + 1);
+    unsigned char *out = (unsigned char *)SvPVX(samples);
+    i_img_dim x;
+    int ch;
+
+    for (x = 0; x < glue->width; ++x) {
+      for (ch = 0; ch < glue->channels; ++ch)
+	*out++ = row[x].channel[ch];
+    }
+    *out = '\0';
+    SvCUR_set(samples, size);
+    SvPOK_only(samples);
+
+    return ip_decoder_call(aTHX_ glue->row, newSViv(y), samples);
+  }
+
+  return 1;
+}
+
+static void
+ip_decoder_glue_free(pTHX_ ip_decoder_glue *glue) {
+  if (glue->header)
+    SvREFCNT_dec(glue->header);
+  if (glue->row)
+    SvREFCNT_dec(glue->row);
+  if (glue->im)
+    i_img_destroy(glue->im);
+  myfree(glue);
+}
+
 /* loads the segments of a fountain fill into an array */
 static i_fountain_seg *
 load_fount_segs(pTHX_ AV *asegs, int *count) {
@@ -925,7 +1116,8 @@ static im_pl_ext_funcs im_perl_funcs =
   IMAGER_PL_API_LEVEL,
   ip_handle_quant_opts,
   ip_cleanup_quant_opts,
-  ip_copy_colors_back
+  ip_copy_colors_back,
+  ip_image_info_sv
 };
 
 #define PERL_PL_SET_GLOBAL_CALLBACKS \
@@ -1098,6 +1290,10 @@ Imager::IO
 io_new_fd(fd)
                          int     fd
 
+Imager::IO
+io_new_mmap(fd)
+                         int     fd
+
 Imager::IO
 io_new_bufchain()
 
@@ -1155,6 +1351,39 @@ i_get_image_file_limits()
           PUSHs(sv_2mortal(newSVuv(bytes)));
         }
 
+undef_int
+i_set_threads(threads)
+	int threads
+
+int
+i_get_threads()
+
+undef_int
+i_set_image_pool(max_bytes)
+	size_t max_bytes
+
+void
+i_get_image_pool_stats()
+      PREINIT:
+	i_img_pool_stats stats;
+      PPCODE:
+	i_get_image_pool_stats(&stats);
+	EXTEND(SP, 14);
+	PUSHs(sv_2mortal(newSVpv("max_bytes", 0)));
+	PUSHs(sv_2mortal(newSVuv(stats.max_bytes)));
+	PUSHs(sv_2mortal(newSVpv("bytes", 0)));
+	PUSHs(sv_2mortal(newSVuv(stats.bytes)));
+	PUSHs(sv_2mortal(newSVpv("buffers", 0)));
+	PUSHs(sv_2mortal(newSVuv(stats.buffers)));
+	PUSHs(sv_2mortal(newSVpv("hits", 0)));
+	PUSHs(sv_2mortal(newSVuv(stats.hits)));
+	PUSHs(sv_2mortal(newSVpv("misses", 0)));
+	PUSHs(sv_2mortal(newSVuv(stats.misses)));
+	PUSHs(sv_2mortal(newSVpv("image_hits", 0)));
+	PUSHs(sv_2mortal(newSVuv(stats.image_hits)));
+	PUSHs(sv_2mortal(newSVpv("image_misses", 0)));
+	PUSHs(sv_2mortal(newSVuv(stats.image_misses)));
+
 bool
 i_int_check_image_file_limits(width, height, channels, sample_size)
 	i_img_dim width
@@ -1163,6 +1392,13 @@ i_int_check_image_file_limits(width, height, channels, sample_size)
 	size_t sample_size
   PROTOTYPE: DISABLE
 
+unsigned
+i_simd_features()
+
+unsigned
+i_simd_set_mask(mask)
+	unsigned mask
+
 MODULE = Imager		PACKAGE = Imager::IO	PREFIX = io_
 
 Imager::IO
@@ -1173,6 +1409,14 @@ io_new_fd(class, fd)
     OUTPUT:
 	RETVAL
 
+Imager::IO
+io_new_mmap(class, fd)
+	int fd
+    CODE:
+	RETVAL = io_new_mmap(fd);
+    OUTPUT:
+	RETVAL
+
 Imager::IO
 io_new_buffer(class, data_sv)
 	SV *data_sv
@@ -1471,6 +1715,11 @@ i_io_set_buffered(ig, flag = 1)
 	Imager::IO ig
 	int flag
 
+bool
+i_io_set_buffer_size(ig, size)
+	Imager::IO ig
+	size_t size
+
 bool
 i_io_is_buffered(ig)
 	Imager::IO ig
@@ -2009,6 +2258,11 @@ i_gaussian(im,stdev)
     Imager::ImgRaw     im
 	    double     stdev
 
+undef_int
+i_gaussian_iir(im,stdev)
+    Imager::ImgRaw     im
+	    double     stdev
+
 void
 i_unsharp_mask(im,stdev,scale)
     Imager::ImgRaw     im
@@ -2362,6 +2616,38 @@ i_test_format_probe(ig, length)
         Imager::IO     ig
 	       int     length
 
+undef_int
+i_scale_stream(in, dec, enc, out_width, out_height, fit)
+        Imager::IO     in
+        Imager::DecoderHandle dec
+        Imager::EncoderHandle enc
+        i_img_dim      out_width
+        i_img_dim      out_height
+        int            fit
+      PREINIT:
+        ip_decoder_glue *glue = NULL;
+      CODE:
+        /* the stream replaces any Perl callbacks */
+        if (dec->header_cb == ip_decoder_header)
+          glue = dec->cb_data;
+        RETVAL = i_scale_stream(in, dec, enc, out_width, out_height,
+                                (i_scale_fit_t)fit);
+        if (glue)
+          ip_decoder_glue_free(aTHX_ glue);
+      OUTPUT:
+        RETVAL
+
+SV *
+i_probe_image_info(ig)
+        Imager::IO     ig
+      PREINIT:
+        i_image_info info;
+      CODE:
+        RETVAL = i_probe_image_info(ig, &info)
+	  ? ip_image_info_sv(aTHX_ &info) : &PL_sv_undef;
+      OUTPUT:
+        RETVAL
+
 Imager::ImgRaw
 i_readpnm_wiol(ig, allow_incomplete)
         Imager::IO     ig
@@ -2464,6 +2750,10 @@ i_scale_mixing(im, width, height)
 	       i_img_dim     width
 	       i_img_dim     height
 
+Imager::ImgRaw
+i_scale_halve(im)
+    Imager::ImgRaw     im
+
 Imager::ImgRaw
 i_haar(im)
     Imager::ImgRaw     im
@@ -2718,11 +3008,26 @@ i_diff_image(im, im2, mindist=0)
     Imager::ImgRaw     im2
             double     mindist
 
-int
-i_diff_image_pixels(im, im2, mindist=0)
+i_img_dim
+i_diff_image_pixels(im, im2, mindist=0, limit=-1)
     Imager::ImgRaw     im
     Imager::ImgRaw     im2
             double     mindist
+         i_img_dim     limit
+
+SV *
+i_img_compare(im, im2, tile=0)
+    Imager::ImgRaw     im
+    Imager::ImgRaw     im2
+         i_img_dim     tile
+      PREINIT:
+	i_img_compare_result result;
+      CODE:
+	if (!i_img_compare(im, im2, tile, &result))
+	  XSRETURN_EMPTY;
+	RETVAL = compare_result_sv(aTHX_ &result);
+      OUTPUT:
+	RETVAL
 
 undef_int
 i_fountain(im, xa, ya, xb, yb, type, repeat, combine, super_sample, ssample_param, segs)
@@ -2958,7 +3263,7 @@ i_img_to_pal(src, quant)
           croak("i_img_to_pal: second argument must be a hash ref");
         hv = (HV *)SvRV(ST(1));
         memset(&quant, 0, sizeof(quant));
-	quant.version = 1;
+	quant.version = 2;
         quant.mc_size = 256;
 	ip_handle_quant_opts(aTHX_ &quant, hv);
         RETVAL = i_img_to_pal(src, &quant);
@@ -2995,7 +3300,7 @@ i_img_make_palette(HV *quant_hv, ...)
           }
 	}
         memset(&quant, 0, sizeof(quant));
-	quant.version = 1;
+	quant.version = 2;
 	quant.mc_size = 256;
         ip_handle_quant_opts(aTHX_ &quant, quant_hv);
 	i_quant_makemap(&quant, imgs, count);
@@ -3887,6 +4192,118 @@ i_new_fill_image(src, matrix_sv, xoff, yoff, combine)
       OUTPUT:
         RETVAL
 
+MODULE = Imager  PACKAGE = Imager::DecoderHandle  PREFIX=i_decoder_
+
+void
+i_decoder_set_callbacks(dec, header, row)
+        Imager::DecoderHandle dec
+        SV *header
+        SV *row
+      PREINIT:
+        ip_decoder_glue *glue;
+      CODE:
+        if (dec->header_cb == ip_decoder_header) {
+          glue = dec->cb_data;
+          if (glue->header)
+            SvREFCNT_dec(glue->header);
+          if (glue->row)
+            SvREFCNT_dec(glue->row);
+        }
+        else {
+          glue = mymalloc(sizeof(ip_decoder_glue));
+          glue->im = NULL;
+          glue->width = 0;
+          glue->channels = 0;
+        }
+        SvGETMAGIC(header);
+        glue->header = SvOK(header) ? newSVsv(header) : NULL;
+        SvGETMAGIC(row);
+        glue->row = SvOK(row) ? newSVsv(row) : NULL;
+        i_decoder_set_callbacks(dec, ip_decoder_header, ip_decoder_row, glue);
+
+undef_int
+i_decoder_feed(dec, data_sv)
+        Imager::DecoderHandle dec
+        SV *data_sv
+      PREINIT:
+        const char *data;
+        STRLEN size;
+      CODE:
+        data = SvPVbyte(data_sv, size);
+        RETVAL = i_decoder_feed(dec, data, size);
+      OUTPUT:
+        RETVAL
+
+undef_int
+i_decoder_finish(dec)
+        Imager::DecoderHandle dec
+
+SV *
+i_decoder_info(dec)
+        Imager::DecoderHandle dec
+      CODE:
+        RETVAL = dec->have_header
+          ? ip_image_info_sv(aTHX_ &dec->info) : &PL_sv_undef;
+      OUTPUT:
+        RETVAL
+
+i_img_dim
+i_decoder_rows(dec)
+        Imager::DecoderHandle dec
+      CODE:
+        RETVAL = dec->rows;
+      OUTPUT:
+        RETVAL
+
+Imager::ImgRaw
+i_decoder_take_image(dec)
+        Imager::DecoderHandle dec
+      PREINIT:
+        ip_decoder_glue *glue;
+      CODE:
+        /* only once the image is complete */
+        RETVAL = NULL;
+        if (dec->header_cb == ip_decoder_header && dec->finished
+            && !dec->failed) {
+          glue = dec->cb_data;
+          RETVAL = glue->im;
+          glue->im = NULL;
+        }
+      OUTPUT:
+        RETVAL
+
+void
+i_decoder_DESTROY(dec)
+        Imager::DecoderHandle dec
+      CODE:
+        if (dec->header_cb == ip_decoder_header)
+          ip_decoder_glue_free(aTHX_ dec->cb_data);
+        i_decoder_destroy(dec);
+
+int
+i_decoder_CLONE_SKIP(...)
+    CODE:
+        (void)items; /* avoid unused warning for XS variable */
+        RETVAL = 1;
+    OUTPUT:
+        RETVAL
+
+MODULE = Imager  PACKAGE = Imager::EncoderHandle  PREFIX=i_encoder_
+
+void
+i_encoder_DESTROY(enc)
+        Imager::EncoderHandle enc
+      CODE:
+        i_encoder_destroy(enc);
+
+int
+i_encoder_CLONE_SKIP(...)
+    CODE:
+        (void)items; /* avoid unused warning for XS variable */
+        RETVAL = 1;
+    OUTPUT:
+        RETVAL
+
 MODULE = Imager  PACKAGE = Imager::Internal::Hlines  PREFIX=i_int_hlines_
 
 # this class is only exposed for testing
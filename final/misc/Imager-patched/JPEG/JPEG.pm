@@ -17,7 +17,10 @@ Imager->register_reader
    sub { 
      my ($im, $io, %hsh) = @_;
 
-     ($im->{IMG},$im->{IPTCRAW}) = i_readjpeg_wiol( $io );
+     ($im->{IMG},$im->{IPTCRAW}) =
+       i_readjpeg_wiol($io, $hsh{jpeg_target_width} || 0,
+		       $hsh{jpeg_target_height} || 0,
+		       $hsh{jpeg_auto_orient} ? 1 : 0);
 
      unless ($im->{IMG}) {
        $im->_set_error(Imager->_error_as_msg);
@@ -27,6 +30,48 @@ Imager->register_reader
    },
   );
 
+Imager->register_decoder
+  (
+   type=>'jpeg',
+   new =>
+   sub {
+     my ($class, %hsh) = @_;
+
+     my $dec = i_jpeg_decoder_new($hsh{jpeg_target_width} || 0,
+				  $hsh{jpeg_target_height} || 0);
+     unless ($dec) {
+       $class->_set_error(Imager->_error_as_msg);
+       return;
+     }
+     return $dec;
+   },
+  );
+
+Imager->register_encoder
+  (
+   type=>'jpeg',
+   new =>
+   sub {
+     my ($class, $io, %hsh) = @_;
+
+     my $quality = $hsh{jpegquality};
+     defined $quality or $quality = 75;
+     my $bg = Imager::_color(defined $hsh{i_background}
+			     ? $hsh{i_background} : "#000000");
+     unless ($bg) {
+       $class->_set_error("jpeg: invalid i_background");
+       return;
+     }
+
+     my $enc = i_jpeg_encoder_new($io, $quality, $bg);
+     unless ($enc) {
+       $class->_set_error(Imager->_error_as_msg);
+       return;
+     }
+     return $enc;
+   },
+  );
+
 Imager->register_writer
   (
    type=>'jpeg',
@@ -50,6 +95,42 @@ Imager->register_writer
    },
   );
 
+Imager->register_thumbnailer
+  (
+   type=>'jpeg',
+   square =>
+   sub {
+     my ($class, $in, $out, %hsh) = @_;
+
+     my $quality = $hsh{jpegquality};
+     defined $quality or $quality = 75;
+
+     unless (i_jpeg_thumb_square_wiol($in, $out, $hsh{size}, $quality)) {
+       $class->_set_error(Imager->_error_as_msg);
+       return;
+     }
+
+     return 1;
+   },
+  );
+
+Imager->register_prober
+  (
+   type => 'jpeg',
+   probe =>
+   sub {
+     my ($class, $io, %hsh) = @_;
+
+     my $info = i_probejpeg_wiol($io);
+     unless ($info) {
+       $class->_set_error(Imager->_error_as_msg);
+       return;
+     }
+
+     return $info;
+   },
+  );
+
 __END__
 
 =head1 NAME
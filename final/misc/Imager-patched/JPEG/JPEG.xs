@@ -7,9 +7,11 @@ extern "C" {
 #include "XSUB.h"
 #include "imext.h"
 #include "imperl.h"
+#include "imextpl.h"
 #include "imjpeg.h"
 
 DEFINE_IMAGER_CALLBACKS;
+DEFINE_IMAGER_PERL_CALLBACKS;
 
 MODULE = Imager::File::JPEG  PACKAGE = Imager::File::JPEG
 
@@ -23,9 +25,41 @@ i_writejpeg_wiol(im, ig, qfactor)
 	       int     qfactor
 
 
+SV *
+i_probejpeg_wiol(ig)
+        Imager::IO     ig
+      PREINIT:
+        i_image_info info;
+      CODE:
+        RETVAL = i_probejpeg_wiol(ig, &info)
+	  ? ip_image_info_sv(aTHX_ &info) : &PL_sv_undef;
+      OUTPUT:
+        RETVAL
+
+undef_int
+i_jpeg_thumb_square_wiol(in, out, size, qfactor)
+        Imager::IO     in
+        Imager::IO     out
+        i_img_dim      size
+        int            qfactor
+
+Imager::DecoderHandle
+i_jpeg_decoder_new(target_width = 0, target_height = 0)
+        i_img_dim      target_width
+        i_img_dim      target_height
+
+Imager::EncoderHandle
+i_jpeg_encoder_new(ig, qfactor, bg)
+        Imager::IO     ig
+        int            qfactor
+        Imager::Color  bg
+
 void
-i_readjpeg_wiol(ig)
+i_readjpeg_wiol(ig, target_width = 0, target_height = 0, auto_orient = 0)
         Imager::IO     ig
+        i_img_dim      target_width
+        i_img_dim      target_height
+        int            auto_orient
 	     PREINIT:
 	      char*    iptc_itext;
 	       int     tlength;
@@ -33,7 +67,7 @@ i_readjpeg_wiol(ig)
                 SV*    r;
 	     PPCODE:
  	      iptc_itext = NULL;
-	      rimg = i_readjpeg_wiol(ig,-1,&iptc_itext,&tlength);
+	      rimg = i_readjpeg_wiol(ig,-1,&iptc_itext,&tlength,target_width,target_height,auto_orient);
 	      if (iptc_itext == NULL) {
 		    r = sv_newmortal();
 	            EXTEND(SP,1);
@@ -50,3 +84,4 @@ i_readjpeg_wiol(ig)
 
 BOOT:
 	PERL_INITIALIZE_IMAGER_CALLBACKS;
+	PERL_INITIALIZE_IMAGER_PERL_CALLBACKS;
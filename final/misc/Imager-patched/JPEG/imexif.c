@@ -334,6 +334,59 @@ i_int_decode_exif(i_img *im, unsigned char *data, size_t length) {
   return 1;
 }
 
+/*
+=item i_int_exif_orientation
+
+i_int_exif_orientation(data_base, data_size);
+
+Returns the orientation from IFD0 of the EXIF data in data_base,
+without building any tags.
+
+Returns 0 if there's no EXIF data, it has no orientation, or the
+orientation is outside the range 1 to 8.
+
+=cut
+*/
+
+int
+i_int_exif_orientation(unsigned char *data, size_t length) {
+  imtiff tiff;
+  int orientation = 0;
+  int tag_index;
+  ifd_entry *entry;
+
+  if (length < 6 || memcmp(data, "Exif\0\0", 6) != 0) {
+    return 0;
+  }
+
+  data += 6;
+  length -= 6;
+
+  if (!tiff_init(&tiff, data, length)) {
+    mm_log((2, "Exif header found, but no valid TIFF header\n"));
+    return 0;
+  }
+  if (!tiff_load_ifd(&tiff, tiff.first_ifd_offset)) {
+    mm_log((2, "Exif header found, but could not load IFD 0\n"));
+    tiff_final(&tiff);
+    return 0;
+  }
+
+  for (tag_index = 0, entry = tiff.ifd; 
+       tag_index < tiff.ifd_size; ++tag_index, ++entry) {
+    if (entry->tag == tag_orientation) {
+      if (!tiff_get_tag_int(&tiff, tag_index, &orientation)
+	  || orientation < 1 || orientation > 8)
+	orientation = 0;
+      break;
+    }
+  }
+
+  tiff_final(&tiff);
+
+  return orientation;
+}
+
 /*
 
 =back
@@ -6,5 +6,6 @@
 #include "imdatatypes.h"
 
 extern int i_int_decode_exif(i_img *im, unsigned char *data, size_t length);
+extern int i_int_exif_orientation(unsigned char *data, size_t length);
 
 #endif /* ifndef IMAGER_IMEXIF_H */
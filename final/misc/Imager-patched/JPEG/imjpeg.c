@@ -9,7 +9,7 @@ jpeg.c - implement saving and loading JPEG images
   if (!i_writejpeg_wiol(im, ig, quality)) {
     .. error ..
   }
-  im = i_readjpeg_wiol(ig, length, iptc_text, itlength);
+  im = i_readjpeg_wiol(ig, length, iptc_text, itlength, 0, 0, 0);
 
 =head1 DESCRIPTION
 
@@ -35,6 +35,9 @@ Reads and writes JPEG images
 #include <errno.h>
 #include <stdlib.h>
 #include "imexif.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define JPEG_APP13       0xED    /* APP13 marker code */
 #define JPEG_APP1 (JPEG_APP0 + 1)
@@ -42,6 +45,11 @@ Reads and writes JPEG images
 
 #define JPEG_DIM_MAX JPEG_MAX_DIMENSION
 
+/* libjpeg-turbo 1.5 added jpeg_skip_scanlines() and jpeg_crop_scanline() */
+#if defined(LIBJPEG_TURBO_VERSION_NUMBER) && LIBJPEG_TURBO_VERSION_NUMBER >= 1005000
+#define IMJPEG_PARTIAL_DECODE
+#endif
+
 #define _STRINGIFY(x) #x
 #define STRINGIFY(x) _STRINGIFY(x)
 
@@ -52,7 +60,6 @@ static unsigned char fake_eoi[]={(JOCTET) 0xFF,(JOCTET) JPEG_EOI};
 typedef struct {
   struct jpeg_source_mgr pub;	/* public fields */
   io_glue *data;
-  JOCTET *buffer;		/* start of buffer */
   int length;			/* Do I need this? */
   boolean start_of_file;	/* have we gotten any data yet? */
 } wiol_source_mgr;
@@ -96,17 +103,21 @@ wiol_init_source (j_decompress_ptr cinfo) {
 static boolean
 wiol_fill_input_buffer(j_decompress_ptr cinfo) {
   wiol_src_ptr src = (wiol_src_ptr) cinfo->src;
+  const unsigned char *data;
   ssize_t nbytes; /* We assume that reads are "small" */
   
   mm_log((1,"wiol_fill_input_buffer(cinfo %p)\n", cinfo));
   
-  nbytes = i_io_read(src->data, src->buffer, JPGS);
+  /* decode straight from the io_glue's buffer, or from the source
+     data for memory and mmap()ed sources, the data stays valid until
+     the next fill */
+  nbytes = i_io_read_ptr(src->data, &data, JPGS);
   
   if (nbytes <= 0) { /* Insert a fake EOI marker */
     src->pub.next_input_byte = fake_eoi;
     src->pub.bytes_in_buffer = 2;
   } else {
-    src->pub.next_input_byte = src->buffer;
+    src->pub.next_input_byte = data;
     src->pub.bytes_in_buffer = nbytes;
   }
   src->start_of_file = FALSE;
@@ -138,12 +149,7 @@ wiol_skip_input_data (j_decompress_ptr cinfo, long num_bytes) {
 
 static void
 wiol_term_source (j_decompress_ptr cinfo) {
-  /* no work necessary here */ 
-  wiol_src_ptr src;
-  if (cinfo->src != NULL) {
-    src = (wiol_src_ptr) cinfo->src;
-    myfree(src->buffer);
-  }
+  /* no work necessary here, the data belongs to the io_glue */ 
 }
 
 
@@ -163,7 +169,6 @@ jpeg_wiol_src(j_decompress_ptr cinfo, io_glue *ig, int length) {
   
   src         = (wiol_src_ptr) cinfo->src;
   src->data   = ig;
-  src->buffer = mymalloc( JPGS );
   src->length = length;
 
   src->pub.init_source       = wiol_init_source;
@@ -360,12 +365,228 @@ i_libjpeg_version(void) {
 }
 
 /*
-=item i_readjpeg_wiol(data, length, iptc_itext, itlength)
+=item choose_scale(cinfo, target_width, target_height)
+
+Set the decompression scale to the smallest of 1/8, 1/4 or 1/2 that
+produces an image at least C<target_width> by C<target_height>.  A
+target of zero doesn't limit that dimension.
+
+libjpeg does most of the work of scaling in the IDCT, so this is much
+cheaper than decoding the full image and scaling afterwards.
+
+=cut
+*/
+
+static void
+choose_scale(j_decompress_ptr cinfo, i_img_dim target_width,
+	     i_img_dim target_height) {
+  int denom;
+
+  for (denom = 8; denom > 1; denom /= 2) {
+    cinfo->scale_num = 1;
+    cinfo->scale_denom = denom;
+    jpeg_calc_output_dimensions(cinfo);
+    if ((i_img_dim)cinfo->output_width >= target_width
+	&& (i_img_dim)cinfo->output_height >= target_height)
+      return;
+  }
+
+  cinfo->scale_num = 1;
+  cinfo->scale_denom = 1;
+}
+
+/*
+=item choose_transfer(cinfo, transfer_f, channels)
+
+Select the function used to convert rows returned by libjpeg to
+i_color and the number of channels in the result, based on the output
+color space.
+
+Returns false, with an error pushed, if the color space isn't
+supported.
+
+=cut
+*/
+
+static int
+choose_transfer(j_decompress_ptr cinfo, transfer_function_t *transfer_f,
+		int *channels) {
+  *channels = cinfo->output_components;
+  switch (cinfo->out_color_space) {
+  case JCS_GRAYSCALE:
+    if (cinfo->output_components != 1) {
+      mm_log((1, "i_readjpeg: grayscale image with %d channels\n", cinfo->output_components));
+      i_push_errorf(0, "grayscale image with invalid components %d", cinfo->output_components);
+      return 0;
+    }
+    *transfer_f = transfer_gray;
+    break;
+  
+  case JCS_RGB:
+    *transfer_f = transfer_rgb;
+    if (cinfo->output_components != 3) {
+      mm_log((1, "i_readjpeg: RGB image with %d channels\n", cinfo->output_components));
+      i_push_errorf(0, "RGB image with invalid components %d", cinfo->output_components);
+      return 0;
+    }
+    break;
+
+  case JCS_CMYK:
+    if (cinfo->output_components == 4) {
+      /* we treat the CMYK values as inverted, because that's what that
+	 buggy photoshop does, and everyone has to follow the gorilla.
+
+	 Is there any app that still produces correct CMYK JPEGs?
+      */
+      *transfer_f = transfer_cmyk_inverted;
+      *channels = 3;
+    }
+    else {
+      mm_log((1, "i_readjpeg: cmyk image with %d channels\n", cinfo->output_components));
+      i_push_errorf(0, "CMYK image with invalid components %d", cinfo->output_components);
+      return 0;
+    }
+    break;
+
+  default:
+    mm_log((1, "i_readjpeg: unknown color space %d\n", cinfo->out_color_space));
+    i_push_errorf(0, "Unknown color space %d", cinfo->out_color_space);
+    return 0;
+  }
+
+  return 1;
+}
+
+/* rows decoded at a time when applying an orientation, so that rows
+   becoming columns are written a run of pixels at a time */
+#define ORIENT_ROWS 32
+
+/*
+=item orient_put_rows(im, lines, y, count, orientation)
+
+Store C<count> rows, starting from row C<y> of the decoded image, where
+the EXIF C<orientation> puts them in C<im>, which has the upright
+dimensions.  For orientations 5 to 8 the rows become columns.
+
+=cut
+*/
+
+static void
+orient_put_rows(i_img *im, const i_color *lines, i_img_dim y, int count,
+		int orientation) {
+  size_t stride;
+  i_sample_t *base = i_img_8_row(im, 0, &stride);
+  int channels = im->channels;
+  /* the decoded image's dimensions */
+  int transposed = orientation >= 5;
+  i_img_dim width = transposed ? im->ysize : im->xsize;
+  i_img_dim height = transposed ? im->xsize : im->ysize;
+  /* decoded pixel (x, y) goes to origin + x * xstep + y * ystep */
+  ptrdiff_t row = stride;
+  i_sample_t *origin;
+  ptrdiff_t xstep, ystep;
+  i_img_dim x;
+  int i, ch;
+
+  switch (orientation) {
+  case 2: /* mirrored */
+    origin = base + (width - 1) * channels;
+    xstep = -channels;
+    ystep = row;
+    break;
+
+  case 3: /* rotated 180 */
+    origin = base + (height - 1) * row + (width - 1) * channels;
+    xstep = -channels;
+    ystep = -row;
+    break;
+
+  case 4: /* flipped */
+    origin = base + (height - 1) * row;
+    xstep = channels;
+    ystep = -row;
+    break;
+
+  case 5: /* transposed */
+    origin = base;
+    xstep = row;
+    ystep = channels;
+    break;
+
+  case 6: /* needs a clockwise rotation */
+    origin = base + (height - 1) * channels;
+    xstep = row;
+    ystep = -channels;
+    break;
+
+  case 7: /* transversed */
+    origin = base + (width - 1) * row + (height - 1) * channels;
+    xstep = -row;
+    ystep = -channels;
+    break;
+
+  case 8: /* needs an anti-clockwise rotation */
+    origin = base + (width - 1) * row;
+    xstep = -row;
+    ystep = channels;
+    break;
+
+  default:
+    origin = base;
+    xstep = channels;
+    ystep = row;
+    break;
+  }
+  origin += y * ystep;
+
+  if (transposed) {
+    /* each column of the rows is a run of pixels in a row of im */
+    for (x = 0; x < width; ++x) {
+      i_sample_t *p = origin + x * xstep;
+      const i_color *in = lines + x;
+      for (i = 0; i < count; ++i) {
+	for (ch = 0; ch < channels; ++ch)
+	  p[ch] = in->channel[ch];
+	p += ystep;
+	in += width;
+      }
+    }
+  }
+  else {
+    for (i = 0; i < count; ++i) {
+      i_sample_t *p = origin + i * ystep;
+      const i_color *in = lines + i * width;
+      for (x = 0; x < width; ++x) {
+	for (ch = 0; ch < channels; ++ch)
+	  p[ch] = in[x].channel[ch];
+	p += xstep;
+      }
+    }
+  }
+}
+
+/*
+=item i_readjpeg_wiol(data, length, iptc_itext, itlength, target_width, target_height, auto_orient)
+
+Read a JPEG image.
+
+If either of C<target_width> or C<target_height> is positive the image
+is decoded at the smallest scale libjpeg supports that is at least
+that size, and the C<jpeg_scale_denom> tag is set to the scale
+denominator used.
+
+If C<auto_orient> is non-zero and the EXIF data has an orientation
+other than 1, each row is stored as it's decoded where that
+orientation puts it, so the image is returned upright without another
+pass.  The C<jpeg_oriented> tag is then set to the orientation
+applied, and C<exif_orientation> to 1.
 
 =cut
 */
 i_img*
-i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength) {
+i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength,
+		i_img_dim target_width, i_img_dim target_height,
+		int auto_orient) {
   i_img * volatile im = NULL;
   int seen_exif = 0;
   i_color * volatile line_buffer = NULL;
@@ -377,8 +598,10 @@ i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength) {
   transfer_function_t transfer_f;
   int channels;
   volatile int src_set = 0;
+  volatile int orientation = 1;
+  i_img_dim width, height;
 
-  mm_log((1,"i_readjpeg_wiol(data %p, length %d,iptc_itext %p)\n", data, length, iptc_itext));
+  mm_log((1,"i_readjpeg_wiol(data %p, length %d,iptc_itext %p, target(" i_DFp "), auto_orient %d)\n", data, length, iptc_itext, i_DFcp(target_width, target_height), auto_orient));
 
   i_clear_error();
 
@@ -409,60 +632,39 @@ i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength) {
   src_set = 1;
 
   (void) jpeg_read_header(&cinfo, TRUE);
+  if (target_width > 0 || target_height > 0)
+    choose_scale(&cinfo, target_width, target_height);
   (void) jpeg_start_decompress(&cinfo);
 
-  channels = cinfo.output_components;
-  switch (cinfo.out_color_space) {
-  case JCS_GRAYSCALE:
-    if (cinfo.output_components != 1) {
-      mm_log((1, "i_readjpeg: grayscale image with %d channels\n", cinfo.output_components));
-      i_push_errorf(0, "grayscale image with invalid components %d", cinfo.output_components);
-      wiol_term_source(&cinfo);
-      jpeg_destroy_decompress(&cinfo);
-      return NULL;
-    }
-    transfer_f = transfer_gray;
-    break;
-  
-  case JCS_RGB:
-    transfer_f = transfer_rgb;
-    if (cinfo.output_components != 3) {
-      mm_log((1, "i_readjpeg: RGB image with %d channels\n", cinfo.output_components));
-      i_push_errorf(0, "RGB image with invalid components %d", cinfo.output_components);
-      wiol_term_source(&cinfo);
-      jpeg_destroy_decompress(&cinfo);
-      return NULL;
-    }
-    break;
-
-  case JCS_CMYK:
-    if (cinfo.output_components == 4) {
-      /* we treat the CMYK values as inverted, because that's what that
-	 buggy photoshop does, and everyone has to follow the gorilla.
-
-	 Is there any app that still produces correct CMYK JPEGs?
-      */
-      transfer_f = transfer_cmyk_inverted;
-      channels = 3;
-    }
-    else {
-      mm_log((1, "i_readjpeg: cmyk image with %d channels\n", cinfo.output_components));
-      i_push_errorf(0, "CMYK image with invalid components %d", cinfo.output_components);
-      wiol_term_source(&cinfo);
-      jpeg_destroy_decompress(&cinfo);
-      return NULL;
-    }
-    break;
-
-  default:
-    mm_log((1, "i_readjpeg: unknown color space %d\n", cinfo.out_color_space));
-    i_push_errorf(0, "Unknown color space %d", cinfo.out_color_space);
+  if (!choose_transfer(&cinfo, &transfer_f, &channels)) {
     wiol_term_source(&cinfo);
     jpeg_destroy_decompress(&cinfo);
     return NULL;
   }
 
-  if (!i_int_check_image_file_limits(cinfo.output_width, cinfo.output_height,
+  if (auto_orient) {
+    /* the markers before the image data have been read */
+    for (markerp = cinfo.marker_list; markerp; markerp = markerp->next) {
+      if (markerp->marker == JPEG_APP1) {
+	int found = i_int_exif_orientation(markerp->data,
+					   markerp->data_length);
+	if (found) {
+	  orientation = found;
+	  break;
+	}
+      }
+    }
+  }
+  if (orientation >= 5) {
+    width = cinfo.output_height;
+    height = cinfo.output_width;
+  }
+  else {
+    width = cinfo.output_width;
+    height = cinfo.output_height;
+  }
+
+  if (!i_int_check_image_file_limits(width, height,
 				     channels, sizeof(i_sample_t))) {
     mm_log((1, "i_readjpeg: image size exceeds limits\n"));
     wiol_term_source(&cinfo);
@@ -470,19 +672,41 @@ i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength) {
     return NULL;
   }
 
-  im = i_img_8_new(cinfo.output_width, cinfo.output_height, channels);
+  im = i_img_8_new(width, height, channels);
   if (!im) {
     wiol_term_source(&cinfo);
     jpeg_destroy_decompress(&cinfo);
     return NULL;
   }
   row_stride = cinfo.output_width * cinfo.output_components;
-  buffer = (*cinfo.mem->alloc_sarray) ((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
-  line_buffer = mymalloc(sizeof(i_color) * cinfo.output_width);
-  while (cinfo.output_scanline < cinfo.output_height) {
-    (void) jpeg_read_scanlines(&cinfo, buffer, 1);
-    transfer_f(line_buffer, buffer, cinfo.output_width);
-    i_plin(im, 0, cinfo.output_width, cinfo.output_scanline-1, line_buffer);
+  if (orientation == 1) {
+    buffer = (*cinfo.mem->alloc_sarray) ((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
+    line_buffer = mymalloc(sizeof(i_color) * cinfo.output_width);
+    while (cinfo.output_scanline < cinfo.output_height) {
+      (void) jpeg_read_scanlines(&cinfo, buffer, 1);
+      transfer_f(line_buffer, buffer, cinfo.output_width);
+      i_plin(im, 0, cinfo.output_width, cinfo.output_scanline-1, line_buffer);
+    }
+  }
+  else {
+    buffer = (*cinfo.mem->alloc_sarray)
+      ((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, ORIENT_ROWS);
+    line_buffer = mymalloc(sizeof(i_color) * cinfo.output_width * ORIENT_ROWS);
+    while (cinfo.output_scanline < cinfo.output_height) {
+      JDIMENSION start = cinfo.output_scanline;
+      JDIMENSION count = 0;
+      JDIMENSION i;
+
+      /* libjpeg may return fewer rows than asked for */
+      while (count < ORIENT_ROWS
+	     && cinfo.output_scanline < cinfo.output_height)
+	count += jpeg_read_scanlines(&cinfo, buffer + count,
+				     ORIENT_ROWS - count);
+      for (i = 0; i < count; ++i)
+	transfer_f(line_buffer + i * cinfo.output_width, buffer + i,
+		   cinfo.output_width);
+      orient_put_rows(im, line_buffer, start, count, orientation);
+    }
   }
   myfree(line_buffer);
   line_buffer = NULL;
@@ -530,10 +754,28 @@ i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength) {
       yres *= 2.54;
       break;
     }
+    if (cinfo.density_unit) {
+      /* keep the physical size of the scaled image the same */
+      xres /= cinfo.scale_denom;
+      yres /= cinfo.scale_denom;
+    }
+    if (orientation >= 5) {
+      double tmp = xres;
+      xres = yres;
+      yres = tmp;
+    }
     i_tags_set_float2(&im->tags, "i_xres", 0, xres, 6);
     i_tags_set_float2(&im->tags, "i_yres", 0, yres, 6);
   }
 
+  if (orientation != 1) {
+    i_tags_setn(&im->tags, "jpeg_oriented", orientation);
+    i_tags_setn(&im->tags, "exif_orientation", 1);
+  }
+
+  if (cinfo.scale_denom != 1)
+    i_tags_setn(&im->tags, "jpeg_scale_denom", cinfo.scale_denom);
+
   /* I originally used jpeg_has_multiple_scans() here, but that can
    * return true for non-progressive files too.  The progressive_mode
    * member is available at least as far back as 6b and does the right
@@ -551,15 +793,229 @@ i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength) {
   return im;
 }
 
+/*
+=item i_probejpeg_wiol(ig, info)
+
+Read the JPEG headers into C<info> without decoding the image.
+
+The orientation is taken from the EXIF data, if any.
+
+=cut
+*/
+int
+i_probejpeg_wiol(io_glue *ig, i_image_info *info) {
+  struct jpeg_decompress_struct cinfo;
+  struct my_error_mgr jerr;
+  jpeg_saved_marker_ptr markerp;
+  volatile int src_set = 0;
+
+  mm_log((1,"i_probejpeg_wiol(ig %p, info %p)\n", ig, info));
+
+  i_clear_error();
+
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit     = my_error_exit;
+  jerr.pub.output_message = my_output_message;
+
+  if (setjmp(jerr.setjmp_buffer)) {
+    if (src_set)
+      wiol_term_source(&cinfo);
+    jpeg_destroy_decompress(&cinfo); 
+    return 0;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_save_markers(&cinfo, JPEG_APP1, 0xFFFF);
+  jpeg_wiol_src(&cinfo, ig, -1);
+  src_set = 1;
+
+  (void) jpeg_read_header(&cinfo, TRUE);
+
+  memset(info, 0, sizeof(*info));
+  info->format = "jpeg";
+  info->width = cinfo.image_width;
+  info->height = cinfo.image_height;
+  /* CMYK is converted to RGB on read */
+  info->channels = cinfo.out_color_space == JCS_GRAYSCALE ? 1 : 3;
+  info->bits = cinfo.data_precision;
+  info->progressive = cinfo.progressive_mode ? 1 : 0;
+
+  for (markerp = cinfo.marker_list; markerp; markerp = markerp->next) {
+    if (markerp->marker == JPEG_APP1
+	&& (info->orientation = 
+	    i_int_exif_orientation(markerp->data, markerp->data_length)))
+      break;
+  }
+
+  wiol_term_source(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+
+  return 1;
+}
+
+/* rows passed to jpeg_write_scanlines() at a time */
+#define WRITE_BATCH 16
+
+/* composite 8-bit samples with alpha over bg into samples without,
+   the same results as i_gsamp_bg() */
+
+static void
+composite_grey_row(JSAMPLE *out, const i_sample_t *in, i_img_dim width,
+		   int grey_bg) {
+  i_img_dim x = 0;
+
+#ifdef __SSE2__
+  {
+    const __m128i lo_mask = _mm_set1_epi16(0xFF);
+    const __m128i max = _mm_set1_epi16(255);
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i bg = _mm_set1_epi16(grey_bg);
+
+    for (; x + 8 <= width; x += 8) {
+      __m128i px = _mm_loadu_si128((const __m128i *)(in + x * 2));
+      __m128i grey = _mm_and_si128(px, lo_mask);
+      __m128i alpha = _mm_srli_epi16(px, 8);
+      /* at most 255 * 255, fits in 16 bits unsigned */
+      __m128i sum = _mm_add_epi16
+	(_mm_mullo_epi16(grey, alpha),
+	 _mm_mullo_epi16(bg, _mm_sub_epi16(max, alpha)));
+      /* exact sum / 255 for sums up to 255 * 255 */
+      __m128i q = _mm_srli_epi16
+	(_mm_add_epi16(_mm_add_epi16(sum, one), _mm_srli_epi16(sum, 8)), 8);
+      _mm_storel_epi64((__m128i *)(out + x),
+		       _mm_packus_epi16(q, _mm_setzero_si128()));
+    }
+  }
+#endif
+
+  for (; x < width; ++x) {
+    int alpha = in[x * 2 + 1];
+    out[x] = (in[x * 2] * alpha + grey_bg * (255 - alpha)) / 255;
+  }
+}
+
+/* out needs room for one extra sample */
+static void
+composite_rgb_row(JSAMPLE *out, const i_sample_t *in, i_img_dim width,
+		  const i_color *bg) {
+  i_img_dim x = 0;
+  int ch;
+
+#ifdef __SSE2__
+  {
+    const __m128i max = _mm_set1_epi16(255);
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bgv = _mm_setr_epi16
+      (bg->rgb.r, bg->rgb.g, bg->rgb.b, 0, bg->rgb.r, bg->rgb.g, bg->rgb.b, 0);
+
+    for (; x + 4 <= width; x += 4) {
+      __m128i px = _mm_loadu_si128((const __m128i *)(in + x * 4));
+      __m128i halves[2];
+      __m128i result;
+      int i;
+
+      halves[0] = _mm_unpacklo_epi8(px, zero);
+      halves[1] = _mm_unpackhi_epi8(px, zero);
+      for (i = 0; i < 2; ++i) {
+	__m128i s = halves[i];
+	/* each pixel's alpha in all four of its lanes */
+	__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xFF), 0xFF);
+	__m128i sum = _mm_add_epi16
+	  (_mm_mullo_epi16(s, alpha),
+	   _mm_mullo_epi16(bgv, _mm_sub_epi16(max, alpha)));
+	halves[i] = _mm_srli_epi16
+	  (_mm_add_epi16(_mm_add_epi16(sum, one), _mm_srli_epi16(sum, 8)), 8);
+      }
+      result = _mm_packus_epi16(halves[0], halves[1]);
+
+      /* store RGBx for each pixel, each overwriting the x of the
+	 previous */
+      for (i = 0; i < 4; ++i) {
+	int v = _mm_cvtsi128_si32(result);
+	memcpy(out + (x + i) * 3, &v, 4);
+	result = _mm_srli_si128(result, 4);
+      }
+    }
+  }
+#endif
+
+  for (; x < width; ++x) {
+    const i_sample_t *inp = in + x * 4;
+    int alpha = inp[3];
+    for (ch = 0; ch < 3; ++ch)
+      out[x * 3 + ch] = (inp[ch] * alpha + bg->channel[ch] * (255 - alpha)) / 255;
+  }
+}
+
+/* apply the jpeg_optimize, jpeg_dct, jpeg_sample and jpeg_restart
+   tags */
+static int
+set_compress_options(i_img *im, j_compress_ptr cinfo) {
+  int optimize, restart;
+  char buf[20];
+
+  if (i_tags_get_int(&im->tags, "jpeg_optimize", 0, &optimize))
+    cinfo->optimize_coding = optimize ? TRUE : FALSE;
+
+  if (i_tags_get_string(&im->tags, "jpeg_dct", 0, buf, sizeof(buf))) {
+    if (strcmp(buf, "islow") == 0)
+      cinfo->dct_method = JDCT_ISLOW;
+    else if (strcmp(buf, "ifast") == 0)
+      cinfo->dct_method = JDCT_IFAST;
+    else if (strcmp(buf, "float") == 0)
+      cinfo->dct_method = JDCT_FLOAT;
+    else {
+      i_push_error(0, "jpeg_dct must be islow, ifast or float");
+      return 0;
+    }
+  }
+
+  if (i_tags_get_string(&im->tags, "jpeg_sample", 0, buf, sizeof(buf))) {
+    int h, v;
+    char extra;
+
+    if (sscanf(buf, "%dx%d%c", &h, &v, &extra) != 2
+	|| h < 1 || h > 4 || v < 1 || v > 4) {
+      i_push_error(0, "jpeg_sample must be HxV with H and V from 1 to 4");
+      return 0;
+    }
+    /* only the luma component is sampled at a higher rate, the
+       chroma components stay 1x1 */
+    if (cinfo->num_components == 3) {
+      cinfo->comp_info[0].h_samp_factor = h;
+      cinfo->comp_info[0].v_samp_factor = v;
+    }
+  }
+
+  if (i_tags_get_int(&im->tags, "jpeg_restart", 0, &restart)) {
+    if (restart < 0 || restart > 65535) {
+      i_push_error(0, "jpeg_restart must be from 0 to 65535");
+      return 0;
+    }
+    cinfo->restart_in_rows = restart;
+  }
+
+  return 1;
+}
+
 /*
 =item i_writejpeg_wiol(im, ig, qfactor)
 
+Write C<im> to C<ig> as a JPEG image.
+
+Rows are passed to libjpeg several at a time.  8-bit direct images are
+passed without copying, or with the alpha channel composited against
+the background in a single pass.
+
+The C<jpeg_optimize>, C<jpeg_dct>, C<jpeg_sample> and C<jpeg_restart>
+tags control the encoder.
+
 =cut
 */
 
 undef_int
 i_writejpeg_wiol(i_img *im, io_glue *ig, int qfactor) {
-  JSAMPLE *image_buffer;
   int quality;
   int got_xres, got_yres, aspect_only, resunit;
   double xres, yres;
@@ -570,10 +1026,11 @@ i_writejpeg_wiol(i_img *im, io_glue *ig, int qfactor) {
   struct jpeg_compress_struct cinfo;
   struct my_error_mgr jerr;
 
-  JSAMPROW row_pointer[1];	/* pointer to JSAMPLE row[s] */
-  int row_stride;		/* physical row width in image buffer */
-  unsigned char * data = NULL;
+  JSAMPROW row_pointer[WRITE_BATCH];
+  unsigned char * volatile data = NULL;
   i_color *line_buf = NULL;
+  i_color bg;
+  size_t row_size;
 
   mm_log((1,"i_writejpeg(im %p, ig %p, qfactor %d)\n", im, ig, qfactor));
   
@@ -622,6 +1079,11 @@ i_writejpeg_wiol(i_img *im, io_glue *ig, int qfactor) {
   jpeg_set_defaults(&cinfo);
   jpeg_set_quality(&cinfo, quality, TRUE);  /* limit to baseline-JPEG values */
 
+  if (!set_compress_options(im, &cinfo)) {
+    jpeg_destroy_compress(&cinfo);
+    return 0;
+  }
+
   if (!i_tags_get_int(&im->tags, "jpeg_progressive", 0, &progressive))
     progressive = 0;
   if (progressive) {
@@ -661,46 +1123,49 @@ i_writejpeg_wiol(i_img *im, io_glue *ig, int qfactor) {
 		      im->tags.tags[comment_entry].size);
   }
 
-  row_stride = im->xsize * im->channels;	/* JSAMPLEs per row in image_buffer */
+  i_get_file_background(im, &bg);
 
-  if (!im->virtual && im->type == i_direct_type && im->bits == i_8_bits
-      && im->channels == want_channels) {
-    image_buffer=im->idata;
+  /* room for the samples i_gsamp_bg() reads before removing alpha,
+     plus the extra sample composite_rgb_row() may write */
+  row_size = im->xsize * im->channels + 1;
 
-    while (cinfo.next_scanline < cinfo.image_height) {
-      /* jpeg_write_scanlines expects an array of pointers to scanlines.
-       * Here the array is only one element long, but you could pass
-       * more than one scanline at a time if that's more convenient.
-       */
-      row_pointer[0] = & image_buffer[cinfo.next_scanline * row_stride];
-      (void) jpeg_write_scanlines(&cinfo, row_pointer, 1);
-    }
-  }
-  else {
-    i_color bg;
-
-    i_get_file_background(im, &bg);
-    data = mymalloc(im->xsize * im->channels);
-    if (data) {
-      while (cinfo.next_scanline < cinfo.image_height) {
-        /* jpeg_write_scanlines expects an array of pointers to scanlines.
-         * Here the array is only one element long, but you could pass
-         * more than one scanline at a time if that's more convenient.
-         */
-        i_gsamp_bg(im, 0, im->xsize, cinfo.next_scanline, data, 
-		   want_channels, &bg);
-        row_pointer[0] = data;
-        (void) jpeg_write_scanlines(&cinfo, row_pointer, 1);
+  while (cinfo.next_scanline < cinfo.image_height) {
+    JDIMENSION y = cinfo.next_scanline;
+    JDIMENSION count = cinfo.image_height - y;
+    JDIMENSION i;
+
+    if (count > WRITE_BATCH)
+      count = WRITE_BATCH;
+
+    for (i = 0; i < count; ++i) {
+      i_sample_t *row = i_img_8_row(im, y + i, NULL);
+
+      if (row && im->channels == want_channels) {
+	row_pointer[i] = row;
+	continue;
+      }
+
+      if (!data)
+	data = mymalloc(row_size * WRITE_BATCH);
+      row_pointer[i] = data + row_size * i;
+      if (row && want_channels == 1) {
+	composite_grey_row(row_pointer[i], row, im->xsize,
+			   (int)(bg.rgb.r * 0.222 + bg.rgb.g * 0.707
+				 + bg.rgb.b * 0.071 + 0.5));
+      }
+      else if (row && want_channels == 3 && im->channels == 4) {
+	composite_rgb_row(row_pointer[i], row, im->xsize, &bg);
+      }
+      else {
+	i_gsamp_bg(im, 0, im->xsize, y + i, row_pointer[i], want_channels, &bg);
       }
-      myfree(data);
-    }
-    else {
-      jpeg_destroy_compress(&cinfo);
-      i_push_error(0, "out of memory");
-      return 0; /* out of memory? */
     }
+    (void) jpeg_write_scanlines(&cinfo, row_pointer, count);
   }
 
+  if (data)
+    myfree(data);
+
   /* Step 6: Finish compression */
 
   jpeg_finish_compress(&cinfo);
@@ -713,6 +1178,611 @@ i_writejpeg_wiol(i_img *im, io_glue *ig, int qfactor) {
   return(1);
 }
 
+typedef struct {
+  j_compress_ptr cinfo;
+  JSAMPROW row;
+  int channels;
+} thumb_writer;
+
+static int
+thumb_put_row(void *p, i_img_dim y, const i_color *row) {
+  thumb_writer *writer = p;
+  JSAMPROW outp = writer->row;
+  JDIMENSION x;
+  int ch;
+
+  for (x = 0; x < writer->cinfo->image_width; ++x) {
+    for (ch = 0; ch < writer->channels; ++ch)
+      *outp++ = row[x].channel[ch];
+  }
+  (void) jpeg_write_scanlines(writer->cinfo, &writer->row, 1);
+
+  return 1;
+}
+
+/*
+=item i_jpeg_thumb_square_wiol(in, out, size, qfactor)
+
+Read a JPEG image from C<in> and write a C<size> by C<size> thumbnail
+of its centered square to C<out> as a JPEG with the given quality.
+
+The source is decoded at the smallest scale that still covers
+C<size>, rows and columns outside the square are skipped where
+libjpeg supports it, and decoded rows are scaled as with
+i_scale_mixing() and compressed as they're produced, so only a few
+rows of image data are held in memory.
+
+Returns non-zero on success.
+
+=cut
+*/
+
+undef_int
+i_jpeg_thumb_square_wiol(io_glue *in, io_glue *out, i_img_dim size,
+			 int qfactor) {
+  struct jpeg_decompress_struct dinfo;
+  struct jpeg_compress_struct cinfo;
+  struct my_error_mgr jerr;
+  i_scale_rows * volatile rows = NULL;
+  i_color * volatile line_buffer = NULL;
+  JSAMPLE * volatile out_row = NULL;
+  volatile int src_set = 0;
+  volatile int compress_created = 0;
+  thumb_writer writer;
+  JSAMPARRAY buffer;
+  transfer_function_t transfer_f;
+  int channels;
+  JDIMENSION side, crop_x, crop_y, left;
+#ifdef IMJPEG_PARTIAL_DECODE
+  JDIMENSION width;
+#endif
+
+  mm_log((1, "i_jpeg_thumb_square_wiol(in %p, out %p, size %" i_DF ", qfactor %d)\n",
+	  in, out, i_DFc(size), qfactor));
+
+  i_clear_error();
+
+  if (size <= 0 || size > JPEG_DIM_MAX) {
+    i_push_errorf(0, "thumbnail size %" i_DF " invalid", i_DFc(size));
+    return 0;
+  }
+
+  dinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit     = my_error_exit;
+  jerr.pub.output_message = my_output_message;
+  cinfo.err = &jerr.pub;
+
+  if (setjmp(jerr.setjmp_buffer)) {
+    if (rows)
+      i_scale_rows_destroy(rows);
+    if (src_set)
+      wiol_term_source(&dinfo);
+    jpeg_destroy_decompress(&dinfo);
+    if (compress_created)
+      jpeg_destroy_compress(&cinfo);
+    if (line_buffer)
+      myfree(line_buffer);
+    if (out_row)
+      myfree(out_row);
+    return 0;
+  }
+
+  jpeg_create_decompress(&dinfo);
+  jpeg_wiol_src(&dinfo, in, -1);
+  src_set = 1;
+
+  (void) jpeg_read_header(&dinfo, TRUE);
+  choose_scale(&dinfo, size, size);
+  (void) jpeg_start_decompress(&dinfo);
+
+  if (!choose_transfer(&dinfo, &transfer_f, &channels)) {
+    wiol_term_source(&dinfo);
+    jpeg_destroy_decompress(&dinfo);
+    return 0;
+  }
+
+  side = dinfo.output_width < dinfo.output_height
+    ? dinfo.output_width : dinfo.output_height;
+  crop_x = (dinfo.output_width - side) / 2;
+  crop_y = (dinfo.output_height - side) / 2;
+
+  left = 0;
+#ifdef IMJPEG_PARTIAL_DECODE
+  if (side != dinfo.output_width) {
+    /* this may widen the decoded columns to an iMCU boundary */
+    left = crop_x;
+    width = side;
+    jpeg_crop_scanline(&dinfo, &left, &width);
+  }
+#endif
+
+  buffer = (*dinfo.mem->alloc_sarray)
+    ((j_common_ptr) &dinfo, JPOOL_IMAGE,
+     dinfo.output_width * dinfo.output_components, 1);
+  line_buffer = mymalloc(sizeof(i_color) * dinfo.output_width);
+
+  rows = i_scale_rows_new(side, side, size, size, channels,
+			  thumb_put_row, &writer);
+  if (!rows) {
+    /* clean up as for a libjpeg error */
+    longjmp(jerr.setjmp_buffer, 1);
+  }
+
+  jpeg_create_compress(&cinfo);
+  compress_created = 1;
+  jpeg_wiol_dest(&cinfo, out);
+
+  cinfo.image_width = size;
+  cinfo.image_height = size;
+  cinfo.input_components = channels;
+  cinfo.in_color_space = channels == 3 ? JCS_RGB : JCS_GRAYSCALE;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, qfactor, TRUE);  /* limit to baseline-JPEG values */
+  jpeg_start_compress(&cinfo, TRUE);
+
+  out_row = mymalloc(size * channels);
+  writer.cinfo = &cinfo;
+  writer.row = out_row;
+  writer.channels = channels;
+
+#ifdef IMJPEG_PARTIAL_DECODE
+  if (crop_y)
+    (void) jpeg_skip_scanlines(&dinfo, crop_y);
+#endif
+  while (dinfo.output_scanline < crop_y)
+    (void) jpeg_read_scanlines(&dinfo, buffer, 1);
+
+  /* rows below the square are never decoded */
+  while (!i_scale_rows_done(rows)
+	 && dinfo.output_scanline < dinfo.output_height) {
+    (void) jpeg_read_scanlines(&dinfo, buffer, 1);
+    transfer_f(line_buffer, buffer, dinfo.output_width);
+    if (!i_scale_rows_feed(rows, line_buffer + (crop_x - left))) {
+      /* the error has been pushed, clean up as for a libjpeg error */
+      longjmp(jerr.setjmp_buffer, 1);
+    }
+  }
+
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+
+  i_scale_rows_destroy(rows);
+  wiol_term_source(&dinfo);
+  jpeg_destroy_decompress(&dinfo);
+  myfree(line_buffer);
+  myfree(out_row);
+
+  if (i_io_close(out))
+    return 0;
+
+  return 1;
+}
+
+/* where the incremental decoder is up to */
+enum {
+  JDEC_HEADER,
+  JDEC_START,
+  JDEC_SCAN,
+  JDEC_FINISH,
+  JDEC_DONE
+};
+
+typedef struct {
+  i_decoder base;
+  struct jpeg_decompress_struct cinfo;
+  struct my_error_mgr jerr;
+  struct jpeg_source_mgr src;
+
+  /* data fed but not yet consumed by libjpeg starts at
+     src.next_input_byte */
+  JOCTET *buffer;
+  size_t buffer_size;
+
+  /* bytes libjpeg asked to skip beyond the data we have */
+  size_t skip;
+  int eof;
+
+  int state;
+  i_img_dim target_width, target_height;
+  transfer_function_t transfer_f;
+  int channels;
+  JSAMPARRAY scanline;
+  i_color *row;
+} jpeg_decoder;
+
+static void
+dec_init_source(j_decompress_ptr cinfo) {
+}
+
+/* suspend until more data is fed, or at the end of the data, insert
+   a fake EOI marker, as the reader does */
+static boolean
+dec_fill_input_buffer(j_decompress_ptr cinfo) {
+  jpeg_decoder *dec = cinfo->client_data;
+
+  if (!dec->eof)
+    return FALSE;
+
+  dec->src.next_input_byte = fake_eoi;
+  dec->src.bytes_in_buffer = 2;
+
+  return TRUE;
+}
+
+static void
+dec_skip_input_data(j_decompress_ptr cinfo, long num_bytes) {
+  jpeg_decoder *dec = cinfo->client_data;
+
+  if (num_bytes <= 0)
+    return;
+
+  if ((size_t)num_bytes <= dec->src.bytes_in_buffer) {
+    dec->src.next_input_byte += num_bytes;
+    dec->src.bytes_in_buffer -= num_bytes;
+  }
+  else {
+    dec->skip += num_bytes - dec->src.bytes_in_buffer;
+    dec->src.next_input_byte += dec->src.bytes_in_buffer;
+    dec->src.bytes_in_buffer = 0;
+  }
+}
+
+static void
+dec_term_source(j_decompress_ptr cinfo) {
+}
+
+/* decode as much as the data so far allows, returning zero on
+   failure */
+static int
+jpeg_dec_run(jpeg_decoder *dec) {
+  j_decompress_ptr cinfo = &dec->cinfo;
+
+  if (setjmp(dec->jerr.setjmp_buffer)) {
+    mm_log((1, "jpeg decoder: error.\n"));
+    return 0;
+  }
+
+  if (dec->state == JDEC_HEADER) {
+    i_image_info info;
+    jpeg_saved_marker_ptr markerp;
+
+    if (jpeg_read_header(cinfo, TRUE) == JPEG_SUSPENDED)
+      return 1;
+
+    if (dec->target_width > 0 || dec->target_height > 0)
+      choose_scale(cinfo, dec->target_width, dec->target_height);
+    else
+      jpeg_calc_output_dimensions(cinfo);
+
+    if (!choose_transfer(cinfo, &dec->transfer_f, &dec->channels))
+      return 0;
+
+    /* multiple scans are buffered by libjpeg */
+    if (!i_decoder_check_limits(&dec->base, cinfo->output_width,
+				cinfo->output_height, dec->channels,
+				jpeg_has_multiple_scans(cinfo))) {
+      mm_log((1, "jpeg decoder: image size exceeds limits\n"));
+      return 0;
+    }
+
+    memset(&info, 0, sizeof(info));
+    info.format = "jpeg";
+    info.width = cinfo->output_width;
+    info.height = cinfo->output_height;
+    info.channels = dec->channels;
+    info.bits = cinfo->data_precision;
+    info.progressive = cinfo->progressive_mode ? 1 : 0;
+    for (markerp = cinfo->marker_list; markerp; markerp = markerp->next) {
+      if (markerp->marker == JPEG_APP1
+	  && (info.orientation =
+	      i_int_exif_orientation(markerp->data, markerp->data_length)))
+	break;
+    }
+
+    dec->row = mymalloc(sizeof(i_color) * cinfo->output_width);
+    dec->state = JDEC_START;
+
+    if (!i_decoder_header(&dec->base, &info))
+      return 0;
+  }
+
+  if (dec->state == JDEC_START) {
+    /* for progressive files this consumes all of the scans */
+    if (!jpeg_start_decompress(cinfo))
+      return 1;
+
+    dec->scanline = (*cinfo->mem->alloc_sarray)
+      ((j_common_ptr)cinfo, JPOOL_IMAGE,
+       cinfo->output_width * cinfo->output_components, 1);
+    dec->state = JDEC_SCAN;
+  }
+
+  if (dec->state == JDEC_SCAN) {
+    while (cinfo->output_scanline < cinfo->output_height) {
+      if (jpeg_read_scanlines(cinfo, dec->scanline, 1) == 0)
+	return 1;
+      dec->transfer_f(dec->row, dec->scanline, cinfo->output_width);
+      if (!i_decoder_row(&dec->base, cinfo->output_scanline - 1, dec->row))
+	return 0;
+    }
+    dec->state = JDEC_FINISH;
+  }
+
+  if (dec->state == JDEC_FINISH) {
+    if (!jpeg_finish_decompress(cinfo))
+      return 1;
+    dec->state = JDEC_DONE;
+  }
+
+  return 1;
+}
+
+static int
+jpeg_dec_feed(i_decoder *base, const unsigned char *data, size_t size) {
+  jpeg_decoder *dec = (jpeg_decoder *)base;
+  size_t keep = dec->src.bytes_in_buffer;
+
+  if (dec->skip) {
+    size_t skip = dec->skip < size ? dec->skip : size;
+    data += skip;
+    size -= skip;
+    dec->skip -= skip;
+    if (!size)
+      return 1;
+  }
+
+  /* keep the data libjpeg hasn't consumed, followed by the new data */
+  if (keep && dec->src.next_input_byte != dec->buffer)
+    memmove(dec->buffer, dec->src.next_input_byte, keep);
+  if (keep + size > dec->buffer_size) {
+    dec->buffer_size = keep + size > JPGS ? keep + size : JPGS;
+    dec->buffer = myrealloc(dec->buffer, dec->buffer_size);
+  }
+  memcpy(dec->buffer + keep, data, size);
+  dec->src.next_input_byte = dec->buffer;
+  dec->src.bytes_in_buffer = keep + size;
+
+  return jpeg_dec_run(dec);
+}
+
+static int
+jpeg_dec_finish(i_decoder *base) {
+  jpeg_decoder *dec = (jpeg_decoder *)base;
+
+  dec->eof = 1;
+
+  return jpeg_dec_run(dec);
+}
+
+static void
+jpeg_dec_destroy(i_decoder *base) {
+  jpeg_decoder *dec = (jpeg_decoder *)base;
+
+  jpeg_destroy_decompress(&dec->cinfo);
+  if (dec->buffer)
+    myfree(dec->buffer);
+  if (dec->row)
+    myfree(dec->row);
+  myfree(dec);
+}
+
+/*
+=item i_jpeg_decoder_new(target_width, target_height)
+
+Create an incremental JPEG decoder, see decoder.c.
+
+Rows are passed on as soon as the data for them is fed, except for
+progressive files, where every scan touches every row, so the rows
+are only passed on once all of the data has been fed.
+
+C<target_width> and C<target_height> are as for i_readjpeg_wiol().
+
+=cut
+*/
+
+i_decoder *
+i_jpeg_decoder_new(i_img_dim target_width, i_img_dim target_height) {
+  jpeg_decoder *dec;
+
+  mm_log((1, "i_jpeg_decoder_new(target(" i_DFp "))\n",
+	  i_DFcp(target_width, target_height)));
+
+  i_clear_error();
+
+  dec = mymalloc(sizeof(jpeg_decoder));
+  memset(dec, 0, sizeof(*dec));
+  dec->base.f_feed = jpeg_dec_feed;
+  dec->base.f_finish = jpeg_dec_finish;
+  dec->base.f_destroy = jpeg_dec_destroy;
+  dec->target_width = target_width;
+  dec->target_height = target_height;
+  dec->state = JDEC_HEADER;
+
+  dec->cinfo.err = jpeg_std_error(&dec->jerr.pub);
+  dec->jerr.pub.error_exit = my_error_exit;
+  dec->jerr.pub.output_message = my_output_message;
+
+  if (setjmp(dec->jerr.setjmp_buffer)) {
+    jpeg_destroy_decompress(&dec->cinfo);
+    myfree(dec);
+    return NULL;
+  }
+
+  jpeg_create_decompress(&dec->cinfo);
+  jpeg_save_markers(&dec->cinfo, JPEG_APP1, 0xFFFF);
+  dec->cinfo.client_data = dec;
+
+  dec->src.init_source = dec_init_source;
+  dec->src.fill_input_buffer = dec_fill_input_buffer;
+  dec->src.skip_input_data = dec_skip_input_data;
+  dec->src.resync_to_restart = jpeg_resync_to_restart;
+  dec->src.term_source = dec_term_source;
+  dec->src.bytes_in_buffer = 0;
+  dec->src.next_input_byte = NULL;
+  dec->cinfo.src = &dec->src;
+
+  return &dec->base;
+}
+
+typedef struct {
+  i_encoder base;
+  struct jpeg_compress_struct cinfo;
+  struct my_error_mgr jerr;
+  io_glue *ig;
+  int quality;
+  i_color bg;
+  /* the grey of bg, for rows with 2 channels */
+  int grey_bg;
+
+  /* channels written, without any alpha channel */
+  int out_channels;
+
+  /* packed samples, for compositing rows with alpha */
+  i_sample_t *samples;
+  JSAMPROW row;
+} jpeg_encoder;
+
+static int
+jpeg_enc_start(i_encoder *base, i_img_dim width, i_img_dim height,
+	       int channels) {
+  jpeg_encoder *enc = (jpeg_encoder *)base;
+  j_compress_ptr cinfo = &enc->cinfo;
+
+  if (width > JPEG_DIM_MAX || height > JPEG_DIM_MAX) {
+    i_push_error(0, "image too large for JPEG");
+    return 0;
+  }
+
+  if (setjmp(enc->jerr.setjmp_buffer))
+    return 0;
+
+  enc->out_channels = channels == 2 || channels == 4 ? channels - 1 : channels;
+  enc->row = mymalloc(width * enc->out_channels + 1);
+  if (enc->out_channels != channels)
+    enc->samples = mymalloc(width * channels);
+
+  jpeg_wiol_dest(cinfo, enc->ig);
+  cinfo->image_width = width;
+  cinfo->image_height = height;
+  cinfo->input_components = enc->out_channels;
+  cinfo->in_color_space = enc->out_channels == 3 ? JCS_RGB : JCS_GRAYSCALE;
+  jpeg_set_defaults(cinfo);
+  jpeg_set_quality(cinfo, enc->quality, TRUE);
+  jpeg_start_compress(cinfo, TRUE);
+
+  return 1;
+}
+
+static int
+jpeg_enc_row(i_encoder *base, const i_color *row) {
+  jpeg_encoder *enc = (jpeg_encoder *)base;
+  i_img_dim width = base->width;
+  int channels = base->channels;
+  i_img_dim x;
+  int ch;
+
+  if (setjmp(enc->jerr.setjmp_buffer))
+    return 0;
+
+  if (enc->samples) {
+    i_sample_t *outp = enc->samples;
+    for (x = 0; x < width; ++x) {
+      for (ch = 0; ch < channels; ++ch)
+	*outp++ = row[x].channel[ch];
+    }
+    if (channels == 2)
+      composite_grey_row(enc->row, enc->samples, width, enc->grey_bg);
+    else
+      composite_rgb_row(enc->row, enc->samples, width, &enc->bg);
+  }
+  else {
+    JSAMPROW outp = enc->row;
+    for (x = 0; x < width; ++x) {
+      for (ch = 0; ch < channels; ++ch)
+	*outp++ = row[x].channel[ch];
+    }
+  }
+  (void) jpeg_write_scanlines(&enc->cinfo, &enc->row, 1);
+
+  return 1;
+}
+
+static int
+jpeg_enc_finish(i_encoder *base) {
+  jpeg_encoder *enc = (jpeg_encoder *)base;
+
+  if (setjmp(enc->jerr.setjmp_buffer))
+    return 0;
+
+  jpeg_finish_compress(&enc->cinfo);
+
+  if (i_io_close(enc->ig))
+    return 0;
+
+  return 1;
+}
+
+static void
+jpeg_enc_destroy(i_encoder *base) {
+  jpeg_encoder *enc = (jpeg_encoder *)base;
+
+  jpeg_destroy_compress(&enc->cinfo);
+  if (enc->samples)
+    myfree(enc->samples);
+  if (enc->row)
+    myfree(enc->row);
+  myfree(enc);
+}
+
+/*
+=item i_jpeg_encoder_new(ig, qfactor, bg)
+
+Create an incremental JPEG encoder writing to C<ig> with the given
+quality, see encoder.c.
+
+Rows with an alpha channel are composited over C<bg>, or black if
+C<bg> is NULL, as i_writejpeg_wiol() does.
+
+=cut
+*/
+
+i_encoder *
+i_jpeg_encoder_new(io_glue *ig, int qfactor, const i_color *bg) {
+  jpeg_encoder *enc;
+
+  mm_log((1, "i_jpeg_encoder_new(ig %p, qfactor %d, bg %p)\n",
+	  ig, qfactor, bg));
+
+  i_clear_error();
+
+  enc = mymalloc(sizeof(jpeg_encoder));
+  memset(enc, 0, sizeof(*enc));
+  enc->base.f_start = jpeg_enc_start;
+  enc->base.f_row = jpeg_enc_row;
+  enc->base.f_finish = jpeg_enc_finish;
+  enc->base.f_destroy = jpeg_enc_destroy;
+  enc->ig = ig;
+  enc->quality = qfactor;
+  if (bg)
+    enc->bg = *bg;
+  enc->grey_bg = (int)(enc->bg.rgb.r * 0.222 + enc->bg.rgb.g * 0.707
+		       + enc->bg.rgb.b * 0.071 + 0.5);
+
+  enc->cinfo.err = jpeg_std_error(&enc->jerr.pub);
+  enc->jerr.pub.error_exit = my_error_exit;
+  enc->jerr.pub.output_message = my_output_message;
+
+  if (setjmp(enc->jerr.setjmp_buffer)) {
+    jpeg_destroy_compress(&enc->cinfo);
+    myfree(enc);
+    return NULL;
+  }
+
+  jpeg_create_compress(&enc->cinfo);
+
+  return &enc->base;
+}
+
 /*
 =back
 
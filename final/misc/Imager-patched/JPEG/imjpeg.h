@@ -4,11 +4,26 @@
 #include "imdatatypes.h"
 
 i_img*
-i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength);
+i_readjpeg_wiol(io_glue *data, int length, char** iptc_itext, int *itlength,
+		i_img_dim target_width, i_img_dim target_height,
+		int auto_orient);
+
+int
+i_probejpeg_wiol(io_glue *ig, i_image_info *info);
 
 undef_int
 i_writejpeg_wiol(i_img *im, io_glue *ig, int qfactor);
 
+undef_int
+i_jpeg_thumb_square_wiol(io_glue *in, io_glue *out, i_img_dim size,
+			 int qfactor);
+
+i_decoder *
+i_jpeg_decoder_new(i_img_dim target_width, i_img_dim target_height);
+
+i_encoder *
+i_jpeg_encoder_new(io_glue *ig, int qfactor, const i_color *bg);
+
 extern const char *
 i_libjpeg_version(void);
 
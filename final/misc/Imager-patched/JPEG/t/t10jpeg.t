@@ -2,7 +2,8 @@
 use strict;
 use Imager qw(:all);
 use Test::More;
-use Imager::Test qw(is_color_close3 test_image_raw test_image is_image);
+use Imager::Test qw(is_color_close3 test_image_raw test_image is_image
+  is_image_similar);
 
 -d "testout" or mkdir "testout";
 
@@ -11,7 +12,7 @@ init_log("testout/t101jpeg.log",1);
 $Imager::formats{"jpeg"}
   or plan skip_all => "no jpeg support";
 
-plan tests => 103;
+plan tests => 274;
 
 print STDERR "libjpeg version: ", Imager::File::JPEG::i_libjpeg_version(), "\n";
 
@@ -438,6 +439,179 @@ SKIP:
   is_image($rdprog, $norm, "prog vs norm should be the same image");
 }
 
+{ # scaled decode
+  my $im = test_image()->scale(scalefactor => 4); # 600x600
+  my $data;
+  ok($im->write(data => \$data, type => "jpeg", jpegquality => 100),
+     "write image for scaled decode");
+  my $full = Imager->new(data => $data)
+    or print "# ", Imager->errstr, "\n";
+  ok($full, "read at full size");
+  is($full->getwidth, 600, "full width");
+  is_deeply([ $full->tags(name => "jpeg_scale_denom") ], [],
+	    "no jpeg_scale_denom for a full size read");
+
+  my $quarter = Imager->new(data => $data, jpeg_target_width => 128,
+			    jpeg_target_height => 100)
+    or print "# ", Imager->errstr, "\n";
+  ok($quarter, "read with target size");
+  is($quarter->getwidth, 150, "1/4 width");
+  is($quarter->getheight, 150, "1/4 height");
+  is($quarter->tags(name => "jpeg_scale_denom"), 4, "check scale tag");
+  my $expect = $full->scale(scalefactor => 0.25, qtype => "mixing");
+  is_image_similar($quarter, $expect, 150 * 150 * 3 * 4,
+		   "scaled decode similar to full decode then scale");
+
+  my $tall = Imager->new(data => $data, jpeg_target_height => 400);
+  is($tall->getheight, 600, "target over half keeps full size");
+  is_deeply([ $tall->tags(name => "jpeg_scale_denom") ], [],
+	    "no scale tag when not scaled");
+  my $eighth = Imager->new(data => $data, jpeg_target_width => 10);
+  is($eighth->getwidth, 75, "width only target, 1/8 scale");
+  is($eighth->tags(name => "jpeg_scale_denom"), 8, "check scale tag");
+}
+
+{ # single pass square thumbnails
+  my $im = test_image()->scale(xpixels => 450, ypixels => 300,
+			       type => "nonprop");
+  for my $src ([ "wide", $im ], [ "tall", $im->rotate(right => 90) ],
+	       [ "gray", $im->convert(preset => "gray") ]) {
+    my ($name, $srcim) = @$src;
+    my $data;
+    ok($srcim->write(data => \$data, type => "jpeg"),
+       "$name: write source");
+    for my $size (40, 120, 400) {
+      my $thumb;
+      ok(Imager->square_thumbnail(in => { data => $data },
+				  out => { data => \$thumb },
+				  size => $size, jpegquality => 90),
+	 "$name $size: make thumbnail")
+	or print "# ", Imager->errstr, "\n";
+
+      # the same steps, one at a time
+      my $full = Imager->new(data => $data, jpeg_target_width => $size,
+			     jpeg_target_height => $size);
+      my $side = $full->getwidth < $full->getheight
+	? $full->getwidth : $full->getheight;
+      my $expect = $full->crop(left => int(($full->getwidth - $side) / 2),
+                               top => int(($full->getheight - $side) / 2),
+                               width => $side, height => $side)
+	->scale(xpixels => $size, ypixels => $size, qtype => "mixing");
+      my $expect_data;
+      $expect->write(data => \$expect_data, type => "jpeg",
+		     jpegquality => 90);
+      ok($thumb eq $expect_data, "$name $size: same as the long way");
+    }
+  }
+
+  { # a different output type takes the long way, still with a
+    # scaled decode
+    my $data;
+    ok($im->write(data => \$data, type => "jpeg"), "write source for pnm");
+    my $thumb;
+    ok(Imager->square_thumbnail(in => { data => $data },
+				out => { data => \$thumb, type => "pnm" },
+				size => 40),
+       "jpeg to pnm thumbnail")
+      or print "# ", Imager->errstr, "\n";
+    my $full = Imager->new(data => $data, jpeg_target_width => 40,
+			   jpeg_target_height => 40);
+    is($full->tags(name => "jpeg_scale_denom"), 4, "decoded at 1/4 scale");
+    my $expect_data;
+    $full->crop(left => int(($full->getwidth - $full->getheight) / 2),
+		width => $full->getheight)
+      ->scale(xpixels => 40, ypixels => 40, qtype => "mixing")
+      ->write(data => \$expect_data, type => "pnm");
+    ok($thumb eq $expect_data, "jpeg to pnm: same as a scaled decode");
+  }
+
+  my $thumb;
+  ok(!Imager->square_thumbnail(in => { data => "\xFF\xD8\xFF\xE0 junk" },
+			       out => { data => \$thumb }, size => 10,
+			       type => "jpeg"),
+     "fail on a bad file");
+}
+
+{ # decoding straight from the source data
+  my $im = Imager->new(file => "testout/t101.jpg");
+  ok($im, "read normally for comparison");
+  my $mapped = Imager->new(file => "testout/t101.jpg", mmap => 1);
+  ok($mapped, "read from a memory mapping");
+  is_image($mapped, $im, "same as a normal read");
+  open my $fh, "<", "testout/t101.jpg" or die;
+  binmode $fh;
+  my $io = Imager::io_new_fd(fileno($fh));
+  $io->set_buffered(0);
+  my $im2 = Imager->new;
+  ok($im2->read(io => $io), "read unbuffered");
+  is_image($im2, $im, "same as a normal read");
+}
+
+{ # probe the header only
+  my $info = Imager->probe(file => "testimg/209_yonge.jpg");
+  ok($info, "probe a jpeg")
+    or diag(Imager->errstr);
+  is($info->{type}, "jpeg", "check type");
+  is($info->{width}, 480, "check width");
+  is($info->{height}, 640, "check height");
+  is($info->{channels}, 3, "check channels");
+  is($info->{bits}, 8, "check bits");
+  is($info->{orientation}, 8, "orientation from the EXIF data");
+  is($info->{progressive}, 0, "not progressive");
+
+  my $im = test_image();
+  my $data;
+  ok($im->convert(preset => "gray")
+     ->write(data => \$data, type => "jpeg", jpeg_progressive => 1),
+     "write a progressive gray image");
+  $info = Imager->probe(data => $data);
+  ok($info, "probe it");
+  is($info->{channels}, 1, "check channels");
+  is($info->{progressive}, 1, "check progressive");
+  is($info->{orientation}, 0, "no orientation");
+
+  ok(!Imager->probe(data => "\xFF\xD8\xFF\xE0 junk"), "fail on a bad file");
+  like(Imager->errstr, qr/./, "with a message");
+}
+
+{ # apply the EXIF orientation while reading
+  open my $fh, "<", "testimg/209_yonge.jpg"
+    or die "Cannot open testimg/209_yonge.jpg: $!";
+  binmode $fh;
+  my $data = do { local $/; <$fh> };
+  close $fh;
+
+  # the orientation entry in IFD0
+  my $entry = index($data, "\x12\x01\x03\x00\x01\x00\x00\x00");
+  my $plain = Imager->new(data => $data);
+  is($plain->getwidth, 480, "orientation not applied by default");
+
+  my %expect =
+    (
+     1 => sub { $_[0] },
+     2 => sub { $_[0]->copy->flip(dir => "h") },
+     3 => sub { $_[0]->rotate(right => 180) },
+     4 => sub { $_[0]->copy->flip(dir => "v") },
+     5 => sub { $_[0]->rotate(right => 90)->flip(dir => "h") },
+     6 => sub { $_[0]->rotate(right => 90) },
+     7 => sub { $_[0]->rotate(right => 270)->flip(dir => "h") },
+     8 => sub { $_[0]->rotate(right => 270) },
+    );
+  for my $orientation (1 .. 8) {
+    my $oriented = $data;
+    substr($oriented, $entry + 8, 1, chr($orientation));
+    my $im = Imager->new(data => $oriented, jpeg_auto_orient => 1);
+    is_image($im, $expect{$orientation}->($plain),
+	     "orientation $orientation applied");
+    is($im->tags(name => "exif_orientation"), 1,
+       "orientation $orientation: exif_orientation now 1");
+  }
+  my $half = Imager->new(data => $data, jpeg_auto_orient => 1,
+			 jpeg_target_width => 200);
+  is($half->getwidth, 320, "orientation with a reduced scale");
+  is($half->tags(name => "jpeg_oriented"), 8, "check jpeg_oriented");
+}
+
 { # check close failures are handled correctly
   my $im = test_image();
   my $fail_close = sub {
@@ -450,3 +624,252 @@ SKIP:
     like($im->errstr, qr/synthetic close failure/,
 	 "check error message");
 }
+
+{ # alpha channels composited in place match the general path
+  for my $width (1, 5, 17) {
+    my $rgba = test_image()->scale(xpixels => $width, ypixels => 20,
+				   type => "nonprop")
+      ->convert(preset => "addalpha");
+    for my $y (0 .. 19) {
+      my @samples = unpack "C*", $rgba->getsamples(y => $y, type => "8bit");
+      for (my $i = 3; $i < @samples; $i += 4) {
+	$samples[$i] = ($i * 7 + $y * 13) % 256;
+      }
+      $rgba->setsamples(y => $y, data => pack "C*", @samples);
+    }
+    my $grey_alpha = $rgba->convert(matrix => [ [ 0.3, 0.6, 0.1, 0 ],
+						[ 0, 0, 0, 1 ] ]);
+    for my $im ($rgba, $grey_alpha) {
+      my $channels = $im->getchannels;
+      my ($fast, $slow);
+      ok($im->write(data => \$fast, type => "jpeg",
+		    i_background => "#3080C0"),
+	 "write $channels channel $width wide image");
+      ok($im->to_rgb16->write(data => \$slow, type => "jpeg",
+			      i_background => "#3080C0"),
+	 "write 16-bit version");
+      ok($fast eq $slow, "same result for $channels channels, $width wide");
+    }
+  }
+}
+
+{ # encoder controls, the options are set as tags on the image, so
+  # write a fresh copy each time
+  my $test = test_image();
+  my $plain;
+  ok($test->copy->write(data => \$plain, type => "jpeg"), "write defaults");
+  my $optimized;
+  ok($test->copy->write(data => \$optimized, type => "jpeg", jpeg_optimize => 1),
+     "write with optimized coding");
+  cmp_ok(length $optimized, '<', length $plain, "optimized is smaller");
+  my $im_plain = Imager->new(data => $plain);
+  my $im_opt = Imager->new(data => $optimized);
+  is_image($im_opt, $im_plain, "same image");
+
+  my $fast;
+  ok($test->copy->write(data => \$fast, type => "jpeg", jpeg_dct => "ifast"),
+     "write with fast DCT");
+  is_image_similar(Imager->new(data => $fast), $im_plain, 200_000,
+		   "similar image");
+  my $im = $test->copy;
+  ok(!$im->write(data => \my $bad, type => "jpeg", jpeg_dct => "slow"),
+     "fail on a bad DCT method");
+  is($im->errstr, "jpeg_dct must be islow, ifast or float", "check message");
+
+  # sampling factors from the first component of the SOF0 marker
+  my $sampling = sub {
+    my ($data) = @_;
+    my $pos = index($data, "\xFF\xC0");
+    return $pos < 0 ? undef : ord substr($data, $pos + 11, 1);
+  };
+  is($sampling->($plain), 0x22, "default 2x2 sampling");
+  for my $sample ([ "1x1", 0x11 ], [ "2x1", 0x21 ]) {
+    my ($name, $factors) = @$sample;
+    my $data;
+    ok($test->copy->write(data => \$data, type => "jpeg",
+			  jpeg_sample => $name),
+       "write $name sampling");
+    is($sampling->($data), $factors, "check $name sampling");
+  }
+  $im = $test->copy;
+  ok(!$im->write(data => \my $bad2, type => "jpeg", jpeg_sample => "5x1"),
+     "fail on bad sampling");
+  is($im->errstr, "jpeg_sample must be HxV with H and V from 1 to 4",
+     "check message");
+
+  my $restart;
+  ok($test->copy->write(data => \$restart, type => "jpeg", jpeg_restart => 1),
+     "write with restart markers");
+  ok(index($restart, "\xFF\xDD") >= 0, "has a restart interval");
+  ok(index($plain, "\xFF\xDD") < 0, "default doesn't");
+  is_image(Imager->new(data => $restart), $im_plain, "same image");
+  $im = $test->copy;
+  ok(!$im->write(data => \my $bad3, type => "jpeg", jpeg_restart => -1),
+     "fail on bad restart interval");
+  is($im->errstr, "jpeg_restart must be from 0 to 65535", "check message");
+}
+
+{ # incremental decoding
+  my $src = Imager->new(file => "testimg/209_yonge.jpg");
+  ok($src, "read source for decoder tests");
+  my $data;
+  ok($src->write(data => \$data, type => "jpeg"), "write it");
+
+  my $info;
+  my $dec = Imager->new_decoder(type => "jpeg",
+				header => sub { $info = shift });
+  ok($dec, "make a decoder")
+    or diag(Imager->errstr);
+  is($dec->info, undef, "no info before the header");
+  ok($dec->feed(substr($data, 0, 10)), "feed the start");
+  is($info, undef, "header callback not called yet");
+  my $pos = 10;
+  my $fed = 1;
+  while ($pos < length $data) {
+    unless ($dec->feed(substr($data, $pos, 97))) {
+      $fed = 0;
+      last;
+    }
+    $pos += 97;
+  }
+  ok($fed, "fed the rest in small pieces")
+    or diag($dec->errstr);
+  ok($dec->finish, "finish")
+    or diag($dec->errstr);
+  is($info->{width}, 480, "header width");
+  is($info->{height}, 640, "header height");
+  is($info->{channels}, 3, "header channels");
+  is($dec->rows, 640, "all rows decoded");
+  my $im = $dec->image;
+  ok($im, "got an image");
+  is_image($im, Imager->new(data => $data), "same as reading it");
+  ok(!$dec->feed("x"), "can't feed after finish");
+  is($dec->errstr, "decoder is finished", "check message");
+
+  # rows as they arrive
+  my @rows;
+  my $first_row_at;
+  $dec = Imager->new_decoder
+    (
+     type => "jpeg",
+     row => sub {
+       my ($y, $samples) = @_;
+       defined $first_row_at or $first_row_at = $pos;
+       $rows[$y] = $samples;
+     },
+    );
+  $pos = 0;
+  while ($pos < length $data) {
+    $dec->feed(substr($data, $pos, 1000));
+    $pos += 1000;
+  }
+  ok($dec->finish, "finish with row callback");
+  is(scalar(@rows), 640, "got all rows");
+  cmp_ok($first_row_at, '<', length($data) / 4, "first row arrived early");
+  my $ref = Imager->new(data => $data);
+  is($rows[100], $ref->getsamples(y => 100, type => "8bit"), "check a row");
+  ok(!$dec->image, "no image with a row callback");
+
+  # stop from a callback
+  $dec = Imager->new_decoder(type => "jpeg",
+			     row => sub { die "enough\n" if $_[0] == 10 });
+  ok(!$dec->feed($data), "die from row callback");
+  is($dec->errstr, "enough", "check message");
+  is($dec->rows, 11, "stopped at row 10");
+
+  # scaled decoding
+  $dec = Imager->new_decoder(type => "jpeg", jpeg_target_width => 100);
+  ok($dec->feed($data) && $dec->finish, "decode scaled");
+  is($dec->info->{width}, 120, "1/4 scale");
+  is_image($dec->image,
+	   Imager->new(data => $data, jpeg_target_width => 100),
+	   "same as a scaled read");
+
+  # progressive, rows only arrive at the end
+  my $prog;
+  ok($src->write(data => \$prog, type => "jpeg", jpeg_progressive => 1),
+     "write progressive");
+  my $got_info;
+  $dec = Imager->new_decoder(type => "jpeg",
+			     header => sub { $got_info = shift });
+  ok($dec->feed(substr($prog, 0, -100)), "feed most of progressive file");
+  ok($got_info && $got_info->{progressive}, "header says progressive");
+  ok($dec->feed(substr($prog, -100)), "feed the rest");
+  ok($dec->finish, "finish progressive");
+  is_image($dec->image, Imager->new(data => $prog), "progressive matches");
+
+  # bad data
+  $dec = Imager->new_decoder(type => "jpeg");
+  ok(!$dec->feed("not a jpeg file at all"), "bad data");
+  like($dec->errstr, qr/Not a JPEG file/, "check message");
+  ok(!$dec->finish, "can't finish after failure");
+  is($dec->errstr, "decoder has already failed", "check message");
+
+  # truncated header
+  $dec = Imager->new_decoder(type => "jpeg");
+  ok($dec->feed(substr($data, 0, 20)), "feed part of the header");
+  ok(!$dec->finish, "finish fails");
+}
+
+{ # streaming scaling
+  my $data;
+  ok(Imager->new(file => "testimg/209_yonge.jpg")
+     ->write(data => \$data, type => "jpeg"), "make source");
+  my $out;
+  ok(Imager->scale_stream(in => { data => $data }, out => { data => \$out },
+			  xpixels => 100, jpegquality => 90),
+     "stream scale jpeg to jpeg")
+    or print "# ", Imager->errstr, "\n";
+  my $exp;
+  ok(Imager->new(data => $data, jpeg_target_width => 100)
+     ->scale(xpixels => 100, qtype => "mixing")
+     ->write(data => \$exp, type => "jpeg", jpegquality => 90),
+     "make expected");
+  ok($out eq $exp, "same as read, scale, write");
+
+  # max fit can't use a scaled decode
+  ok(Imager->scale_stream(in => { data => $data }, out => { data => \$out },
+			  xpixels => 100, ypixels => 100, jpegquality => 90),
+     "stream scale to fill a box");
+  ok(Imager->new(data => $data)
+     ->scale(xpixels => 100, ypixels => 100, qtype => "mixing")
+     ->write(data => \$exp, type => "jpeg", jpegquality => 90),
+     "make expected");
+  ok($out eq $exp, "same as read, scale, write");
+
+  # only a row at a time is buffered, so height limits don't apply
+  Imager->set_file_limits(height => 10);
+  ok(!Imager->new(data => $data), "normal read fails with limit");
+  ok(Imager->scale_stream(in => { data => $data },
+			  out => { file => "testout/t10stream.jpg" },
+			  xpixels => 50, type => "min"),
+     "stream scale with limit");
+  Imager->set_file_limits(reset => 1);
+  my $im = Imager->new(file => "testout/t10stream.jpg");
+  ok($im, "read stream scaled file");
+  is($im->getwidth, 50, "check width");
+
+  ok(!Imager->scale_stream(in => { data => substr($data, 0, 20) },
+			   out => { data => \$out }, xpixels => 50),
+     "truncated header");
+
+ SKIP:
+  { # grey with alpha is composited over the grey of i_background,
+    # like write() does
+    $Imager::formats{png}
+      or skip "no PNG support for a source with alpha", 3;
+    my $src = Imager->new(xsize => 40, ysize => 30, channels => 2);
+    $src->box(filled => 1, color => [ 200, 128 ], xmax => 19);
+    my $png;
+    ok($src->write(data => \$png, type => "png"), "make grey alpha source");
+    ok(Imager->scale_stream(in => { data => $png },
+			    out => { data => \$out, type => "jpeg" },
+			    xpixels => 20, i_background => "#3080C0"),
+       "stream scale with a colored background")
+      or print "# ", Imager->errstr, "\n";
+    my $exp;
+    $src->scale(xpixels => 20, qtype => "mixing")
+      ->write(data => \$exp, type => "jpeg", i_background => "#3080C0");
+    ok($out eq $exp, "same as read, scale, write");
+  }
+}
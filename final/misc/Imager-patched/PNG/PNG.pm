@@ -47,6 +47,72 @@ Imager->register_writer
    },
   );
 
+Imager->register_decoder
+  (
+   type=>'png',
+   new =>
+   sub {
+     my ($class, %hsh) = @_;
+     my $flags = 0;
+     $hsh{png_ignore_benign_errors}
+       and $flags |= IMPNG_READ_IGNORE_BENIGN_ERRORS;
+     my $dec = i_png_decoder_new($flags);
+     unless ($dec) {
+       $class->_set_error(Imager->_error_as_msg);
+       return;
+     }
+     return $dec;
+   },
+  );
+
+Imager->register_encoder
+  (
+   type=>'png',
+   new =>
+   sub {
+     my ($class, $io, %hsh) = @_;
+     my $enc = i_png_encoder_new($io);
+     unless ($enc) {
+       $class->_set_error(Imager->_error_as_msg);
+       return;
+     }
+     return $enc;
+   },
+  );
+
+Imager->register_thumbnailer
+  (
+   type=>'png',
+   square =>
+   sub {
+     my ($class, $in, $out, %hsh) = @_;
+
+     unless (i_png_thumb_square_wiol($in, $out, $hsh{size})) {
+       $class->_set_error(Imager->_error_as_msg);
+       return;
+     }
+
+     return 1;
+   },
+  );
+
+Imager->register_prober
+  (
+   type => 'png',
+   probe =>
+   sub {
+     my ($class, $io, %hsh) = @_;
+
+     my $info = i_probepng_wiol($io);
+     unless ($info) {
+       $class->_set_error(Imager->_error_as_msg);
+       return;
+     }
+
+     return $info;
+   },
+  );
+
 __END__
 
 =head1 NAME
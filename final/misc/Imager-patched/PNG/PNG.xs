@@ -7,9 +7,11 @@ extern "C" {
 #include "XSUB.h"
 #include "imext.h"
 #include "imperl.h"
+#include "imextpl.h"
 #include "impng.h"
 
 DEFINE_IMAGER_CALLBACKS;
+DEFINE_IMAGER_PERL_CALLBACKS;
 
 MODULE = Imager::File::PNG  PACKAGE = Imager::File::PNG
 
@@ -23,9 +25,34 @@ i_writepng_wiol(im, ig)
     Imager::ImgRaw     im
         Imager::IO     ig
 
+SV *
+i_probepng_wiol(ig)
+        Imager::IO     ig
+      PREINIT:
+        i_image_info info;
+      CODE:
+        RETVAL = i_probepng_wiol(ig, &info)
+	  ? ip_image_info_sv(aTHX_ &info) : &PL_sv_undef;
+      OUTPUT:
+        RETVAL
+
+undef_int
+i_png_thumb_square_wiol(in, out, size)
+        Imager::IO     in
+        Imager::IO     out
+        i_img_dim      size
+
 unsigned
 i_png_lib_version()
 
+Imager::DecoderHandle
+i_png_decoder_new(flags=0)
+        int            flags
+
+Imager::EncoderHandle
+i_png_encoder_new(ig)
+        Imager::IO     ig
+
 MODULE = Imager::File::PNG  PACKAGE = Imager::File::PNG PREFIX=i_png_
 
 void
@@ -49,3 +76,4 @@ IMPNG_READ_IGNORE_BENIGN_ERRORS()
 
 BOOT:
 	PERL_INITIALIZE_IMAGER_CALLBACKS;
+	PERL_INITIALIZE_IMAGER_PERL_CALLBACKS;
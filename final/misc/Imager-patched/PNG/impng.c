@@ -2,6 +2,7 @@
 #include "png.h"
 #include <stdlib.h>
 #include <string.h>
+#include <zlib.h>
 
 /* this is a way to get number of channels from color space 
  * Color code to channel number */
@@ -40,6 +41,9 @@ get_png_tags(i_img *im, png_structp png_ptr, png_infop info_ptr, int bit_depth,
 static int
 set_png_tags(i_img *im, png_structp png_ptr, png_infop info_ptr);
 
+static int
+set_png_compression(i_img *im, png_structp png_ptr);
+
 static const char *
 get_string2(i_img_tags *tags, const char *name, char *buf, size_t *size);
 
@@ -249,7 +253,8 @@ i_writepng_wiol(i_img *im, io_glue *ig) {
   png_set_IHDR(png_ptr, info_ptr, width, height, bits, cspace,
 	       PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 
-  if (!set_png_tags(im, png_ptr, info_ptr)) {
+  if (!set_png_tags(im, png_ptr, info_ptr)
+      || !set_png_compression(im, png_ptr)) {
     png_destroy_write_struct(&png_ptr, &info_ptr);
     return 0;
   }
@@ -412,6 +417,676 @@ i_readpng_wiol(io_glue *ig, int flags) {
   return im;
 }
 
+/*
+=item i_probepng_wiol(ig, info)
+
+Read the PNG header, up to the first image data, into C<info> without
+decoding the image.
+
+=cut
+*/
+
+int
+i_probepng_wiol(io_glue *ig, i_image_info *info) {
+  png_structp png_ptr;
+  png_infop info_ptr;
+  png_uint_32 width, height;
+  int bit_depth, color_type, interlace_type;
+  i_png_read_state rs;
+
+  rs.warnings = NULL;
+
+  mm_log((1,"i_probepng_wiol(ig %p, info %p)\n", ig, info));
+  i_clear_error();
+
+  png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, &rs, 
+				   error_handler, read_warn_handler);
+  if (!png_ptr) {
+    i_push_error(0, "Cannot create PNG read structure");
+    return 0;
+  }
+  png_set_read_fn(png_ptr, (png_voidp) (ig), wiol_read_data);
+
+  info_ptr = png_create_info_struct(png_ptr);
+  if (info_ptr == NULL) {
+    png_destroy_read_struct(&png_ptr, (png_infopp)NULL, (png_infopp)NULL);
+    i_push_error(0, "Cannot create PNG info structure");
+    return 0;
+  }
+  
+  if (setjmp(png_jmpbuf(png_ptr))) {
+    mm_log((1,"i_probepng_wiol: error.\n"));
+    png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+    cleanup_read_state(&rs);
+    return 0;
+  }
+
+  png_set_user_limits(png_ptr, PNG_DIM_MAX, PNG_DIM_MAX);
+  png_read_info(png_ptr, info_ptr);
+  png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type,
+	       &interlace_type, NULL, NULL);
+
+  memset(info, 0, sizeof(*info));
+  info->format = "png";
+  info->width = width;
+  info->height = height;
+  info->bits = bit_depth;
+  info->interlaced = interlace_type != PNG_INTERLACE_NONE;
+
+  /* match the image i_readpng_wiol() would create */
+  CC2C[PNG_COLOR_TYPE_GRAY]=1;
+  CC2C[PNG_COLOR_TYPE_PALETTE]=3;
+  CC2C[PNG_COLOR_TYPE_RGB]=3;
+  CC2C[PNG_COLOR_TYPE_RGB_ALPHA]=4;
+  CC2C[PNG_COLOR_TYPE_GRAY_ALPHA]=2;
+  info->channels = CC2C[color_type];
+  if (color_type == PNG_COLOR_TYPE_PALETTE) {
+    info->paletted = 1;
+  }
+  else if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth == 1
+	   && !png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS)) {
+    info->paletted = 1;
+  }
+  if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS))
+    ++info->channels;
+
+  png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+  cleanup_read_state(&rs);
+
+  return 1;
+}
+
+typedef struct {
+  png_structp png_ptr;
+  png_bytep row;
+  int channels;
+  i_img_dim width;
+} thumb_writer;
+
+static int
+thumb_put_row(void *p, i_img_dim y, const i_color *row) {
+  thumb_writer *writer = p;
+  png_bytep outp = writer->row;
+  i_img_dim x;
+  int ch;
+
+  for (x = 0; x < writer->width; ++x) {
+    for (ch = 0; ch < writer->channels; ++ch)
+      *outp++ = row[x].channel[ch];
+  }
+  png_write_row(writer->png_ptr, writer->row);
+
+  return 1;
+}
+
+/* resources released on both success and failure */
+typedef struct {
+  png_structp png_ptr;
+  png_infop info_ptr;
+  png_structp wpng_ptr;
+  png_infop winfo_ptr;
+  i_png_read_statep rs;
+  i_scale_rows * volatile rows;
+  png_bytep volatile image;
+  png_bytep * volatile row_pointers;
+  png_bytep volatile line;
+  i_color * volatile in_row;
+  png_bytep volatile out_row;
+} thumb_state;
+
+static void
+thumb_cleanup(thumb_state *st) {
+  png_destroy_read_struct(&st->png_ptr, &st->info_ptr, (png_infopp)NULL);
+  png_destroy_write_struct(&st->wpng_ptr, &st->winfo_ptr);
+  cleanup_read_state(st->rs);
+  if (st->rows)
+    i_scale_rows_destroy(st->rows);
+  if (st->image)
+    myfree(st->image);
+  if (st->row_pointers)
+    myfree(st->row_pointers);
+  if (st->line)
+    myfree(st->line);
+  if (st->in_row)
+    myfree(st->in_row);
+  if (st->out_row)
+    myfree(st->out_row);
+}
+
+/*
+=item i_png_thumb_square_wiol(in, out, size)
+
+Read a PNG image from C<in> and write a C<size> by C<size> thumbnail
+of its centered square to C<out> as a PNG.
+
+Rows are scaled as with i_scale_mixing() and written as they're
+produced, and decoding stops at the bottom of the square, so for
+non-interlaced images only a few rows of image data are held in
+memory.  Interlaced images are decoded in full first.
+
+The thumbnail is always written with 8 bits per sample, with palette
+images expanded to RGB.
+
+Returns non-zero on success.
+
+=cut
+*/
+
+undef_int
+i_png_thumb_square_wiol(io_glue *in, io_glue *out, i_img_dim size) {
+  png_structp png_ptr;
+  png_infop info_ptr;
+  png_uint_32 width, height;
+  int bit_depth, color_type, interlace_type;
+  int channels, number_passes, cspace;
+  i_img_dim side, crop_x, crop_y, y, x;
+  size_t row_bytes;
+  thumb_state st;
+  thumb_writer writer;
+  i_png_read_state rs;
+
+  mm_log((1, "i_png_thumb_square_wiol(in %p, out %p, size %" i_DF ")\n",
+	  in, out, i_DFc(size)));
+
+  i_clear_error();
+
+  if (size <= 0 || size > PNG_DIM_MAX) {
+    i_push_errorf(0, "thumbnail size %" i_DF " invalid", i_DFc(size));
+    return 0;
+  }
+
+  rs.warnings = NULL;
+  st.rs = &rs;
+  st.info_ptr = st.winfo_ptr = NULL;
+  st.wpng_ptr = NULL;
+  st.rows = NULL;
+  st.image = st.line = st.out_row = NULL;
+  st.row_pointers = NULL;
+  st.in_row = NULL;
+
+  png_ptr = st.png_ptr = png_create_read_struct
+    (PNG_LIBPNG_VER_STRING, &rs, error_handler, read_warn_handler);
+  if (!png_ptr) {
+    i_push_error(0, "Cannot create PNG read structure");
+    return 0;
+  }
+  info_ptr = st.info_ptr = png_create_info_struct(png_ptr);
+  st.wpng_ptr = png_create_write_struct
+    (PNG_LIBPNG_VER_STRING, NULL, error_handler, write_warn_handler);
+  if (st.wpng_ptr)
+    st.winfo_ptr = png_create_info_struct(st.wpng_ptr);
+  if (!info_ptr || !st.wpng_ptr || !st.winfo_ptr) {
+    thumb_cleanup(&st);
+    i_push_error(0, "Cannot create PNG structures");
+    return 0;
+  }
+
+  if (setjmp(png_jmpbuf(png_ptr))) {
+    mm_log((1, "i_png_thumb_square_wiol: read error.\n"));
+    thumb_cleanup(&st);
+    return 0;
+  }
+  if (setjmp(png_jmpbuf(st.wpng_ptr))) {
+    mm_log((1, "i_png_thumb_square_wiol: write error.\n"));
+    thumb_cleanup(&st);
+    return 0;
+  }
+
+  png_set_read_fn(png_ptr, (png_voidp) (in), wiol_read_data);
+  png_set_user_limits(png_ptr, PNG_DIM_MAX, PNG_DIM_MAX);
+  png_read_info(png_ptr, info_ptr);
+  png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type,
+	       &interlace_type, NULL, NULL);
+
+  /* always work with 8-bit gray, gray-alpha, RGB or RGBA */
+  png_set_expand(png_ptr);
+  png_set_strip_16(png_ptr);
+  number_passes = png_set_interlace_handling(png_ptr);
+  png_read_update_info(png_ptr, info_ptr);
+  channels = png_get_channels(png_ptr, info_ptr);
+  row_bytes = png_get_rowbytes(png_ptr, info_ptr);
+
+  mm_log((1, "i_png_thumb_square_wiol: %u x %u, channels %d, passes %d\n",
+	  (unsigned)width, (unsigned)height, channels, number_passes));
+
+  side = width < height ? width : height;
+  crop_x = (width - side) / 2;
+  crop_y = (height - side) / 2;
+
+  switch (channels) {
+  case 1:
+    cspace = PNG_COLOR_TYPE_GRAY;
+    break;
+  case 2:
+    cspace = PNG_COLOR_TYPE_GRAY_ALPHA;
+    break;
+  case 3:
+    cspace = PNG_COLOR_TYPE_RGB;
+    break;
+  default:
+    cspace = PNG_COLOR_TYPE_RGB_ALPHA;
+    break;
+  }
+
+  st.rows = i_scale_rows_new(side, side, size, size, channels,
+			     thumb_put_row, &writer);
+  if (!st.rows) {
+    /* clean up as for a libpng error */
+    longjmp(png_jmpbuf(png_ptr), 1);
+  }
+  st.in_row = mymalloc(sizeof(i_color) * side);
+  st.out_row = mymalloc(size * channels);
+  writer.png_ptr = st.wpng_ptr;
+  writer.row = st.out_row;
+  writer.channels = channels;
+  writer.width = size;
+
+  png_set_write_fn(st.wpng_ptr, (png_voidp) (out), wiol_write_data,
+		   wiol_flush_data);
+  png_set_IHDR(st.wpng_ptr, st.winfo_ptr, size, size, 8, cspace,
+	       PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
+	       PNG_FILTER_TYPE_BASE);
+  png_write_info(st.wpng_ptr, st.winfo_ptr);
+
+  if (number_passes > 1) {
+    /* every pass touches every row, so we need the whole image */
+    if (!i_int_check_image_file_limits(width, height, channels,
+				       sizeof(i_sample_t))) {
+      mm_log((1, "i_png_thumb_square_wiol: image size exceeds limits\n"));
+      longjmp(png_jmpbuf(png_ptr), 1);
+    }
+
+    st.image = mymalloc(row_bytes * height);
+    st.row_pointers = mymalloc(sizeof(png_bytep) * height);
+    for (y = 0; y < height; ++y)
+      st.row_pointers[y] = st.image + row_bytes * y;
+    png_read_image(png_ptr, st.row_pointers);
+    myfree(st.row_pointers);
+    st.row_pointers = NULL;
+  }
+  else {
+    st.line = mymalloc(row_bytes);
+  }
+
+  for (y = 0; y < crop_y + side && !i_scale_rows_done(st.rows); ++y) {
+    png_bytep inp;
+    if (st.image) {
+      inp = st.image + row_bytes * y;
+    }
+    else {
+      png_read_row(png_ptr, st.line, NULL);
+      inp = st.line;
+    }
+    if (y < crop_y)
+      continue;
+
+    inp += crop_x * channels;
+    for (x = 0; x < side; ++x) {
+      int ch;
+      for (ch = 0; ch < channels; ++ch)
+	st.in_row[x].channel[ch] = *inp++;
+    }
+    if (!i_scale_rows_feed(st.rows, st.in_row)) {
+      /* the error has been pushed, clean up as for a libpng error */
+      longjmp(png_jmpbuf(png_ptr), 1);
+    }
+  }
+
+  png_write_end(st.wpng_ptr, st.winfo_ptr);
+
+  thumb_cleanup(&st);
+
+  if (i_io_close(out))
+    return 0;
+
+  return 1;
+}
+
+typedef struct {
+  i_decoder base;
+  png_structp png_ptr;
+  png_infop info_ptr;
+  i_png_read_state rs;
+  i_img_dim width, height;
+  int channels;
+  size_t row_bytes;
+
+  /* interlaced images are assembled here, then passed on at the end */
+  png_bytep image;
+  i_color *row;
+
+  /* set once the end of the image is seen */
+  int done;
+} png_decoder;
+
+/* pass a decoded row to the decoder callback */
+static void
+dec_put_row(png_decoder *dec, png_bytep inp, i_img_dim y) {
+  i_img_dim x;
+  int ch;
+
+  for (x = 0; x < dec->width; ++x) {
+    for (ch = 0; ch < dec->channels; ++ch)
+      dec->row[x].channel[ch] = *inp++;
+  }
+  if (!i_decoder_row(&dec->base, y, dec->row))
+    longjmp(png_jmpbuf(dec->png_ptr), 1);
+}
+
+static void
+dec_info(png_structp png_ptr, png_infop info_ptr) {
+  png_decoder *dec = png_get_progressive_ptr(png_ptr);
+  png_uint_32 width, height;
+  int bit_depth, color_type, interlace_type;
+  int number_passes;
+  i_image_info info;
+
+  png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type,
+	       &interlace_type, NULL, NULL);
+
+  /* always 8-bit gray, gray-alpha, RGB or RGBA */
+  png_set_expand(png_ptr);
+  png_set_strip_16(png_ptr);
+  number_passes = png_set_interlace_handling(png_ptr);
+  png_read_update_info(png_ptr, info_ptr);
+  dec->width = width;
+  dec->height = height;
+  dec->channels = png_get_channels(png_ptr, info_ptr);
+  dec->row_bytes = png_get_rowbytes(png_ptr, info_ptr);
+
+  mm_log((1, "png decoder: %u x %u, channels %d, passes %d\n",
+	  (unsigned)width, (unsigned)height, dec->channels, number_passes));
+
+  if (!i_decoder_check_limits(&dec->base, width, height, dec->channels,
+			      number_passes > 1)) {
+    longjmp(png_jmpbuf(png_ptr), 1);
+  }
+
+  dec->row = mymalloc(sizeof(i_color) * width);
+  if (number_passes > 1) {
+    /* each pass only fills in some pixels of some rows */
+    dec->image = mymalloc(dec->row_bytes * height);
+    memset(dec->image, 0, dec->row_bytes * height);
+  }
+
+  memset(&info, 0, sizeof(info));
+  info.format = "png";
+  info.width = width;
+  info.height = height;
+  info.channels = dec->channels;
+  info.bits = bit_depth;
+  info.paletted = color_type == PNG_COLOR_TYPE_PALETTE;
+  info.interlaced = interlace_type != PNG_INTERLACE_NONE;
+
+  if (!i_decoder_header(&dec->base, &info))
+    longjmp(png_jmpbuf(png_ptr), 1);
+}
+
+static void
+dec_row(png_structp png_ptr, png_bytep new_row, png_uint_32 row_num,
+	int pass) {
+  png_decoder *dec = png_get_progressive_ptr(png_ptr);
+
+  (void)pass;
+
+  if (dec->image) {
+    png_progressive_combine_row(png_ptr, dec->image + dec->row_bytes * row_num,
+				new_row);
+  }
+  else if (new_row) {
+    dec_put_row(dec, new_row, row_num);
+  }
+}
+
+static void
+dec_end(png_structp png_ptr, png_infop info_ptr) {
+  png_decoder *dec = png_get_progressive_ptr(png_ptr);
+  i_img_dim y;
+
+  (void)info_ptr;
+
+  dec->done = 1;
+  if (dec->image) {
+    for (y = 0; y < dec->height; ++y)
+      dec_put_row(dec, dec->image + dec->row_bytes * y, y);
+  }
+}
+
+static int
+png_dec_feed(i_decoder *base, const unsigned char *data, size_t size) {
+  png_decoder *dec = (png_decoder *)base;
+
+  if (setjmp(png_jmpbuf(dec->png_ptr))) {
+    mm_log((1, "png decoder: error.\n"));
+    return 0;
+  }
+
+  png_process_data(dec->png_ptr, dec->info_ptr, (png_bytep)data, size);
+
+  return 1;
+}
+
+static int
+png_dec_finish(i_decoder *base) {
+  png_decoder *dec = (png_decoder *)base;
+
+  if (!dec->done) {
+    i_push_error(0, "incomplete PNG data");
+    return 0;
+  }
+
+  return 1;
+}
+
+static void
+png_dec_destroy(i_decoder *base) {
+  png_decoder *dec = (png_decoder *)base;
+
+  png_destroy_read_struct(&dec->png_ptr, &dec->info_ptr, (png_infopp)NULL);
+  cleanup_read_state(&dec->rs);
+  if (dec->image)
+    myfree(dec->image);
+  if (dec->row)
+    myfree(dec->row);
+  myfree(dec);
+}
+
+/*
+=item i_png_decoder_new(flags)
+
+Create an incremental PNG decoder, see decoder.c.
+
+Rows are passed on as they're decoded from the data fed so far, except
+for interlaced images, where every pass touches every row, so the
+image is assembled and the rows passed on once the end of the image
+data is seen.
+
+C<flags> is as for i_readpng_wiol().
+
+=cut
+*/
+
+i_decoder *
+i_png_decoder_new(int flags) {
+  png_decoder *dec;
+
+  mm_log((1, "i_png_decoder_new(flags %d)\n", flags));
+  i_clear_error();
+
+  dec = mymalloc(sizeof(png_decoder));
+  memset(dec, 0, sizeof(*dec));
+  dec->base.f_feed = png_dec_feed;
+  dec->base.f_finish = png_dec_finish;
+  dec->base.f_destroy = png_dec_destroy;
+  dec->rs.warnings = NULL;
+
+  dec->png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, &dec->rs,
+					error_handler, read_warn_handler);
+  if (!dec->png_ptr) {
+    i_push_error(0, "Cannot create PNG read structure");
+    myfree(dec);
+    return NULL;
+  }
+  dec->info_ptr = png_create_info_struct(dec->png_ptr);
+  if (!dec->info_ptr) {
+    i_push_error(0, "Cannot create PNG info structure");
+    png_dec_destroy(&dec->base);
+    return NULL;
+  }
+
+#if defined(PNG_BENIGN_ERRORS_SUPPORTED)
+  png_set_benign_errors(dec->png_ptr,
+			(flags & IMPNG_READ_IGNORE_BENIGN_ERRORS) ? 1 : 0);
+#else
+  if (flags & IMPNG_READ_IGNORE_BENIGN_ERRORS) {
+    i_push_error(0, "libpng not configured to ignore benign errors");
+    png_dec_destroy(&dec->base);
+    return NULL;
+  }
+#endif
+
+  /* we do our own limit checks */
+  png_set_user_limits(dec->png_ptr, PNG_DIM_MAX, PNG_DIM_MAX);
+  png_set_progressive_read_fn(dec->png_ptr, dec, dec_info, dec_row, dec_end);
+
+  return &dec->base;
+}
+
+typedef struct {
+  i_encoder base;
+  png_structp png_ptr;
+  png_infop info_ptr;
+  io_glue *ig;
+  png_bytep row;
+} png_encoder;
+
+static int
+png_enc_start(i_encoder *base, i_img_dim width, i_img_dim height,
+	      int channels) {
+  png_encoder *enc = (png_encoder *)base;
+  int cspace;
+
+  if (width > PNG_DIM_MAX || height > PNG_DIM_MAX) {
+    i_push_error(0, "image too large for PNG");
+    return 0;
+  }
+
+  switch (channels) {
+  case 1:
+    cspace = PNG_COLOR_TYPE_GRAY;
+    break;
+  case 2:
+    cspace = PNG_COLOR_TYPE_GRAY_ALPHA;
+    break;
+  case 3:
+    cspace = PNG_COLOR_TYPE_RGB;
+    break;
+  default:
+    cspace = PNG_COLOR_TYPE_RGB_ALPHA;
+    break;
+  }
+
+  if (setjmp(png_jmpbuf(enc->png_ptr)))
+    return 0;
+
+  enc->row = mymalloc(width * channels);
+  png_set_write_fn(enc->png_ptr, (png_voidp) (enc->ig), wiol_write_data,
+		   wiol_flush_data);
+  png_set_user_limits(enc->png_ptr, width, height);
+  png_set_IHDR(enc->png_ptr, enc->info_ptr, width, height, 8, cspace,
+	       PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
+	       PNG_FILTER_TYPE_BASE);
+  png_write_info(enc->png_ptr, enc->info_ptr);
+
+  return 1;
+}
+
+static int
+png_enc_row(i_encoder *base, const i_color *row) {
+  png_encoder *enc = (png_encoder *)base;
+  png_bytep outp = enc->row;
+  i_img_dim x;
+  int ch;
+
+  for (x = 0; x < base->width; ++x) {
+    for (ch = 0; ch < base->channels; ++ch)
+      *outp++ = row[x].channel[ch];
+  }
+
+  if (setjmp(png_jmpbuf(enc->png_ptr)))
+    return 0;
+
+  png_write_row(enc->png_ptr, enc->row);
+
+  return 1;
+}
+
+static int
+png_enc_finish(i_encoder *base) {
+  png_encoder *enc = (png_encoder *)base;
+
+  if (setjmp(png_jmpbuf(enc->png_ptr)))
+    return 0;
+
+  png_write_end(enc->png_ptr, enc->info_ptr);
+
+  if (i_io_close(enc->ig))
+    return 0;
+
+  return 1;
+}
+
+static void
+png_enc_destroy(i_encoder *base) {
+  png_encoder *enc = (png_encoder *)base;
+
+  png_destroy_write_struct(&enc->png_ptr, &enc->info_ptr);
+  if (enc->row)
+    myfree(enc->row);
+  myfree(enc);
+}
+
+/*
+=item i_png_encoder_new(ig)
+
+Create an incremental PNG encoder writing 8-bit gray, gray-alpha, RGB
+or RGBA to C<ig>, see encoder.c.
+
+=cut
+*/
+
+i_encoder *
+i_png_encoder_new(io_glue *ig) {
+  png_encoder *enc;
+
+  mm_log((1, "i_png_encoder_new(ig %p)\n", ig));
+  i_clear_error();
+
+  enc = mymalloc(sizeof(png_encoder));
+  memset(enc, 0, sizeof(*enc));
+  enc->base.f_start = png_enc_start;
+  enc->base.f_row = png_enc_row;
+  enc->base.f_finish = png_enc_finish;
+  enc->base.f_destroy = png_enc_destroy;
+  enc->ig = ig;
+
+  enc->png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL,
+					 error_handler, write_warn_handler);
+  if (!enc->png_ptr) {
+    i_push_error(0, "Cannot create PNG write structure");
+    myfree(enc);
+    return NULL;
+  }
+  enc->info_ptr = png_create_info_struct(enc->png_ptr);
+  if (!enc->info_ptr) {
+    i_push_error(0, "Cannot create PNG info structure");
+    png_enc_destroy(&enc->base);
+    return NULL;
+  }
+
+  return &enc->base;
+}
+
 static i_img *
 read_direct8(png_structp png_ptr, png_infop info_ptr, int channels,
 	     i_img_dim width, i_img_dim height) {
@@ -1167,9 +1842,99 @@ get_string2(i_img_tags *tags, const char *name, char *buf, size_t *size) {
   return NULL;
 }
 
+static const struct {
+  const char *name;
+  int strategy;
+} strategies[] =
+  {
+    { "default", Z_DEFAULT_STRATEGY },
+    { "filtered", Z_FILTERED },
+    { "huffman", Z_HUFFMAN_ONLY },
+#ifdef Z_RLE
+    { "rle", Z_RLE },
+#endif
+#ifdef Z_FIXED
+    { "fixed", Z_FIXED },
+#endif
+  };
+
+static const struct {
+  const char *name;
+  int mask;
+} filters[] =
+  {
+    { "none", PNG_FILTER_NONE },
+    { "sub", PNG_FILTER_SUB },
+    { "up", PNG_FILTER_UP },
+    { "avg", PNG_FILTER_AVG },
+    { "paeth", PNG_FILTER_PAETH },
+    { "all", PNG_ALL_FILTERS },
+  };
+
+/* apply the png_compression_level, png_compression_strategy and
+   png_filter tags, leaving libpng's defaults otherwise */
+static int
+set_png_compression(i_img *im, png_structp png_ptr) {
+  int level;
+  char buf[80];
+  size_t i;
+
+  if (i_tags_get_int(&im->tags, "png_compression_level", 0, &level)) {
+    if (level < 0 || level > 9) {
+      i_push_error(0, "tag png_compression_level must be from 0 to 9");
+      return 0;
+    }
+    png_set_compression_level(png_ptr, level);
+  }
+
+  if (i_tags_get_string(&im->tags, "png_compression_strategy", 0,
+			buf, sizeof(buf))) {
+    for (i = 0; i < sizeof(strategies) / sizeof(*strategies); ++i) {
+      if (strcmp(buf, strategies[i].name) == 0)
+	break;
+    }
+    if (i == sizeof(strategies) / sizeof(*strategies)) {
+      i_push_errorf(0, "unknown png_compression_strategy '%s'", buf);
+      return 0;
+    }
+    png_set_compression_strategy(png_ptr, strategies[i].strategy);
+  }
+
+  if (i_tags_get_string(&im->tags, "png_filter", 0, buf, sizeof(buf))) {
+    int mask = 0;
+    char *name = buf + strspn(buf, ", ");
+
+    /* split in place rather than with strtok(), which isn't
+       reentrant */
+    while (*name) {
+      char *end = name + strcspn(name, ", ");
+
+      if (*end)
+	*end++ = '\0';
+      for (i = 0; i < sizeof(filters) / sizeof(*filters); ++i) {
+	if (strcmp(name, filters[i].name) == 0)
+	  break;
+      }
+      if (i == sizeof(filters) / sizeof(*filters)) {
+	i_push_errorf(0, "unknown png_filter '%s'", name);
+	return 0;
+      }
+      mask |= filters[i].mask;
+      name = end + strspn(end, ", ");
+    }
+    if (!mask) {
+      i_push_error(0, "tag png_filter must name at least one filter");
+      return 0;
+    }
+    png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, mask);
+  }
+
+  return 1;
+}
+
 static int
 write_direct8(png_structp png_ptr, png_infop info_ptr, i_img *im) {
-  unsigned char *data, *volatile vdata = NULL;
+  unsigned char *volatile vdata = NULL;
   i_img_dim y;
 
   if (setjmp(png_jmpbuf(png_ptr))) {
@@ -1181,12 +1946,21 @@ write_direct8(png_structp png_ptr, png_infop info_ptr, i_img *im) {
 
   png_write_info(png_ptr, info_ptr);
 
-  vdata = data = mymalloc(im->xsize * im->channels);
   for (y = 0; y < im->ysize; y++) {
-    i_gsamp(im, 0, im->xsize, y, data, NULL, im->channels);
-    png_write_row(png_ptr, (png_bytep)data);
+    /* libpng copies the row before filtering it, so plain 8-bit
+       images can supply their rows directly */
+    unsigned char *row = i_img_8_row(im, y, NULL);
+
+    if (!row) {
+      if (!vdata)
+	vdata = mymalloc(im->xsize * im->channels);
+      row = vdata;
+      i_gsamp(im, 0, im->xsize, y, row, NULL, im->channels);
+    }
+    png_write_row(png_ptr, (png_bytep)row);
   }
-  myfree(data);
+  if (vdata)
+    myfree(vdata);
 
   return 1;
 }
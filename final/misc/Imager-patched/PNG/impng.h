@@ -4,11 +4,15 @@
 #include "imext.h"
 
 i_img    *i_readpng_wiol(io_glue *ig, int flags);
+int i_probepng_wiol(io_glue *ig, i_image_info *info);
 
 #define IMPNG_READ_IGNORE_BENIGN_ERRORS 1
 
 undef_int i_writepng_wiol(i_img *im, io_glue *ig);
+undef_int i_png_thumb_square_wiol(io_glue *in, io_glue *out, i_img_dim size);
 unsigned i_png_lib_version(void);
+i_decoder *i_png_decoder_new(int flags);
+i_encoder *i_png_encoder_new(io_glue *ig);
 
 extern const char * const *
 i_png_features(void);
@@ -10,7 +10,7 @@ my $debug_writes = 1;
 
 init_log("testout/t102png.log",1);
 
-plan tests => 249;
+plan tests => 413;
 
 # this loads Imager::File::PNG too
 ok($Imager::formats{"png"}, "must have png format");
@@ -768,6 +768,22 @@ SKIP:
       [ png_time => "2012-13-01T00:00:00" ],
       "invalid date/time for png_time"
      ],
+     [
+      [ png_compression_level => 10 ],
+      "tag png_compression_level must be from 0 to 9"
+     ],
+     [
+      [ png_compression_strategy => "fastest" ],
+      "unknown png_compression_strategy 'fastest'"
+     ],
+     [
+      [ png_filter => "none,median" ],
+      "unknown png_filter 'median'"
+     ],
+     [
+      [ png_filter => "," ],
+      "tag png_filter must name at least one filter"
+     ],
     ); 
   my $im = Imager->new(xsize => 1, ysize => 1);
   for my $test (@tests) {
@@ -780,6 +796,219 @@ SKIP:
   }
 }
 
+{ # compression controls
+  my $im = test_image();
+  my @settings =
+    (
+     [ png_compression_level => 0 ],
+     [ png_compression_level => 9 ],
+     [ png_filter => "none" ],
+     [ png_filter => "sub, paeth" ],
+     [ png_compression_strategy => "huffman" ],
+     [ png_compression_strategy => "rle", png_filter => "up" ],
+    );
+  my %sizes;
+  for my $setting (@settings) {
+    my $data;
+    ok($im->copy->write(data => \$data, type => "png", @$setting),
+       "write with @$setting");
+    is_image(Imager->new(data => $data), $im, "same image with @$setting");
+    $sizes{"@$setting"} = length $data;
+  }
+  cmp_ok($sizes{"png_compression_level 9"}, '<',
+	 $sizes{"png_compression_level 0"}, "level 9 is smaller than level 0");
+}
+
+{ # single pass square thumbnails
+  my $im = test_image()->scale(xpixels => 150, ypixels => 100,
+			       type => "nonprop");
+  my @sources =
+    (
+     [ "rgb", $im ],
+     [ "tall", $im->rotate(right => 90) ],
+     [ "gray", $im->convert(preset => "gray") ],
+     [ "rgba", $im->convert(preset => "addalpha") ],
+     [ "paletted", $im->to_paletted ],
+     map [ $_, "testimg/$_.png" ], qw(rgb8i paltrans bilevel graya),
+    );
+  for my $src (@sources) {
+    my ($name, $source) = @$src;
+    my $data;
+    if (ref $source) {
+      ok($source->write(data => \$data, type => "png"),
+	 "$name: write source");
+    }
+    else {
+      ok(open(my $fh, "<", $source), "$name: open source");
+      binmode $fh;
+      $data = do { local $/; <$fh> };
+    }
+    my $thumb;
+    ok(Imager->square_thumbnail(in => { data => $data },
+				out => { data => \$thumb }, size => 32),
+       "$name: make thumbnail")
+      or print "# ", Imager->errstr, "\n";
+    my $tim = Imager->new(data => $thumb);
+    ok($tim, "$name: read thumbnail");
+
+    # the same steps, one at a time
+    my $full = Imager->new(data => $data);
+    my $side = $full->getwidth < $full->getheight
+      ? $full->getwidth : $full->getheight;
+    my $expect = $full->crop(left => int(($full->getwidth - $side) / 2),
+                             top => int(($full->getheight - $side) / 2),
+                             width => $side, height => $side)
+      ->scale(xpixels => 32, ypixels => 32, qtype => "mixing");
+    is_image($tim, $expect, "$name: same as the long way");
+  }
+}
+
+{ # interlaced thumbnail sources are decoded in full, so are limited
+  Imager->set_file_limits(reset => 1, height => 10);
+  my $thumb;
+  ok(!Imager->square_thumbnail(in => { file => "testimg/rgb8i.png" },
+			       out => { data => \$thumb }, size => 8),
+     "interlaced thumbnail fails with limit");
+  like(Imager->errstr, qr/exceeds limit/, "check message");
+  Imager->set_file_limits(reset => 1);
+  ok(Imager->square_thumbnail(in => { file => "testimg/rgb8i.png" },
+			      out => { data => \$thumb }, size => 8),
+     "works without the limit");
+}
+
+{ # probe the header only
+  for my $file (qw(rgb8.png rgb8i.png cover16.png coverpal.png bilevel.png
+		   graya.png paltrans.png)) {
+    my $info = Imager->probe(file => "testimg/$file");
+    ok($info, "$file: probe")
+      or diag(Imager->errstr);
+    my $im = Imager->new(file => "testimg/$file");
+    is($info->{type}, "png", "$file: type");
+    is($info->{width}, $im->getwidth, "$file: width");
+    is($info->{height}, $im->getheight, "$file: height");
+    is($info->{channels}, $im->getchannels, "$file: channels");
+    is($info->{paletted}, $im->type eq "paletted" ? 1 : 0, "$file: paletted");
+    is($info->{interlaced}, $file =~ /i\.png$/ ? 1 : 0, "$file: interlaced");
+  }
+  is(Imager->probe(file => "testimg/cover16.png")->{bits}, 16,
+     "check 16-bit");
+  is(Imager->probe(file => "testimg/coverpal.png")->{bits}, 4,
+     "check 4-bit paletted");
+
+  ok(!Imager->probe(file => "testimg/badcrc.png"), "fail on a bad header");
+  like(Imager->errstr, qr/CRC error/, "check message");
+}
+
+{ # incremental decoding
+  for my $file (qw(rgb8.png rgb8i.png gray.png graya.png pal.png
+		   paltrans.png coverpali.png bilevel.png)) {
+    my $data = do {
+      open my $fh, "<", "testimg/$file" or die "testimg/$file: $!";
+      binmode $fh;
+      local $/;
+      <$fh>;
+    };
+    my $ref = Imager->new(data => $data)->to_rgb8;
+    my $info;
+    my $dec = Imager->new_decoder(type => "png",
+				  header => sub { $info = shift });
+    my $pos = 0;
+    my $fed = 1;
+    while ($pos < length $data) {
+      unless ($dec->feed(substr($data, $pos, 50))) {
+	$fed = 0;
+	last;
+      }
+      $pos += 50;
+    }
+    ok($fed && $dec->finish, "$file: decode in pieces")
+      or diag($dec->errstr);
+    is($info->{interlaced}, $file =~ /i\.png$/ ? 1 : 0,
+       "$file: check interlaced");
+    is_image($dec->image, $ref, "$file: same as read");
+  }
+
+  my $data;
+  ok(test_image()->write(data => \$data, type => "png"), "write a test png");
+  my @rows;
+  my $dec = Imager->new_decoder
+    (
+     type => "png",
+     row => sub {
+       my ($y, $samples) = @_;
+       $rows[$y] = $samples;
+     },
+    );
+  ok($dec->feed(substr($data, 0, length($data) / 2)), "feed half");
+  ok(@rows > 0 && @rows < 150, "some rows decoded");
+  ok($dec->feed(substr($data, length($data) / 2)), "feed the rest");
+  ok($dec->finish, "finish");
+  is($dec->rows, 150, "all rows");
+  is($rows[75], test_image()->getsamples(y => 75, type => "8bit"),
+     "check a row");
+
+  $dec = Imager->new_decoder(type => "png", header => sub { die "no thanks\n" });
+  ok(!$dec->feed($data), "die from header callback");
+  is($dec->errstr, "no thanks", "check message");
+
+  $dec = Imager->new_decoder(type => "png");
+  ok($dec->feed(substr($data, 0, 100)), "feed a partial file");
+  ok(!$dec->finish, "finish fails");
+  is($dec->errstr, "incomplete PNG data", "check message");
+
+  $dec = Imager->new_decoder(type => "png");
+  my $bad = $data;
+  substr($bad, 20, 1) = "x";
+  ok(!$dec->feed($bad), "bad header data");
+  like($dec->errstr, qr/CRC error/, "check message");
+}
+
+{ # streaming scaling
+  my $src = test_image()->convert(preset => "addalpha");
+  $src->box(filled => 1, color => [ 0, 0, 255, 128 ], xmax => 40);
+  my $data;
+  ok($src->write(data => \$data, type => "png"), "write source");
+  my $out;
+  ok(Imager->scale_stream(in => { data => $data }, out => { data => \$out },
+			  xpixels => 60, ypixels => 40, type => "nonprop"),
+     "stream scale png to png")
+    or print "# ", Imager->errstr, "\n";
+  my $im = Imager->new(data => $out);
+  ok($im, "read result");
+  is_image($im, $src->scale(xpixels => 60, ypixels => 40,
+			    type => "nonprop", qtype => "mixing"),
+	   "same as scale()");
+
+  # interlaced sources are buffered by libpng, but still work
+  my $inter = "testimg/rgb8i.png";
+  ok(Imager->scale_stream(in => { file => $inter }, out => { data => \$out },
+			  ypixels => 25),
+     "stream scale interlaced");
+  is_image(Imager->new(data => $out),
+	   Imager->new(file => $inter)->scale(ypixels => 25, qtype => "mixing"),
+	   "same as scale()");
+
+  # only a row at a time is buffered, so height limits don't apply
+  Imager->set_file_limits(height => 10);
+  ok(!Imager->new(data => $data), "normal read fails with limit");
+  ok(Imager->scale_stream(in => { data => $data },
+			  out => { file => "testout/stream.png" },
+			  xpixels => 50),
+     "stream scale with limit");
+  ok(!Imager->scale_stream(in => { file => $inter },
+			   out => { data => \$out }, xpixels => 50),
+     "but interlaced images are limited");
+  Imager->set_file_limits(reset => 1);
+  $im = Imager->new(file => "testout/stream.png");
+  ok($im, "read stream scaled file");
+  is($im->getwidth, 50, "check width");
+
+  ok(!Imager->scale_stream(in => { data => substr($data, 0, 300) },
+			   out => { data => \$out }, xpixels => 50),
+     "truncated source");
+  is(Imager->errstr, "incomplete PNG data", "check message");
+}
+
 sub limited_write {
   my ($limit) = @_;
 
@@ -0,0 +1,46 @@
+#!perl -w
+# benchmark comparing images, run from the build directory:
+#   perl -Mblib bench/compare.pl
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+
+my $min_time = 3;
+
+my $im1 = Imager->new(xsize => 2000, ysize => 1500);
+$im1->filter(type => "gradgen", xo => [ 0, 1999, 1000 ], yo => [ 0, 0, 1499 ],
+	     colors => [ qw(red green blue) ]);
+my $im2 = $im1->copy;
+$im2->filter(type => "noise", amount => 10);
+my $thumb1 = $im1->scale(xpixels => 150, ypixels => 150, type => "nonprop");
+my $thumb2 = $im2->scale(xpixels => 150, ypixels => 150, type => "nonprop");
+
+my @tests =
+  (
+   [ "2000x1500" => sub { $im1->compare(other => $im2) } ],
+   [ "heatmap" => sub { $im1->compare(other => $im2, heatmap => 1) } ],
+   [ "4 threads" => sub {
+       Imager->set_threads(4);
+       my $result = $im1->compare(other => $im2);
+       Imager->set_threads(1);
+       $result;
+     } ],
+   [ "double" => sub {
+       $im1->to_rgb_double->compare(other => $im2->to_rgb_double)
+     } ],
+   [ "150x150" => sub { $thumb1->compare(other => $thumb2) } ],
+  );
+
+for my $test (@tests) {
+  my ($name, $code) = @$test;
+  my $count = 0;
+  my $start = time;
+  my $elapsed;
+  do {
+    $code->()
+      or die $im1->errstr;
+    ++$count;
+    $elapsed = time - $start;
+  } while ($elapsed < $min_time);
+  printf "%-10s %9.3f ms/op\n", $name, $elapsed * 1000 / $count;
+}
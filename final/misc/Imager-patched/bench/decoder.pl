@@ -0,0 +1,80 @@
+#!perl -w
+# benchmark decoding an upload as it arrives with an incremental
+# decoder vs reading it once complete, measuring the total time and
+# how much of the data has arrived when the first row is available
+# run from the build directory:
+#   perl -Mblib -IJPEG/blib/lib -IJPEG/blib/arch \
+#     -IPNG/blib/lib -IPNG/blib/arch bench/decoder.pl
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+use FindBin;
+use lib "$FindBin::Bin/lib";
+use BenchImage qw(source_image);
+
+my $chunk = 16384;
+my $min_time = 2;
+
+my $src = source_image(2592, 1944);
+for my $type (qw(jpeg png)) {
+  my $data;
+  $src->write(data => \$data, type => $type)
+    or die $src->errstr;
+
+  my $first_row_at;
+  my @tests =
+    (
+     [
+      read => sub {
+	my $im = Imager->new(data => $data)
+	  or die Imager->errstr;
+      },
+     ],
+     [
+      decoder => sub {
+	my $dec = Imager->new_decoder(type => $type)
+	  or die Imager->errstr;
+	for (my $pos = 0; $pos < length $data; $pos += $chunk) {
+	  $dec->feed(substr($data, $pos, $chunk))
+	    or die $dec->errstr;
+	}
+	$dec->finish
+	  or die $dec->errstr;
+	my $im = $dec->image;
+      },
+     ],
+     [
+      rows => sub {
+	my $pos = 0;
+	undef $first_row_at;
+	my $dec = Imager->new_decoder
+	  (
+	   type => $type,
+	   row => sub {
+	     defined $first_row_at or $first_row_at = $pos + $chunk;
+	   },
+	  ) or die Imager->errstr;
+	for ($pos = 0; $pos < length $data; $pos += $chunk) {
+	  $dec->feed(substr($data, $pos, $chunk))
+	    or die $dec->errstr;
+	}
+	$dec->finish
+	  or die $dec->errstr;
+      },
+     ],
+    );
+  for my $test (@tests) {
+    my ($mode, $code) = @$test;
+    my $count = 0;
+    my $start = time;
+    my $elapsed;
+    do {
+      $code->();
+      ++$count;
+      $elapsed = time - $start;
+    } while ($elapsed < $min_time);
+    printf "%-4s %-8s %8.2f ms/op\n", $type, $mode, $elapsed * 1000 / $count;
+  }
+  printf "%-4s first row after %d of %d bytes\n", $type, $first_row_at,
+    length $data;
+}
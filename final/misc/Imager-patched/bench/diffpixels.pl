@@ -0,0 +1,41 @@
+#!perl -w
+# benchmark counting differing pixels, run from the build directory:
+#   perl -Mblib bench/diffpixels.pl
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+
+my $min_time = 3;
+
+my $im1 = Imager->new(xsize => 2000, ysize => 1500);
+$im1->filter(type => "gradgen", xo => [ 0, 1999, 1000 ], yo => [ 0, 0, 1499 ],
+	     colors => [ qw(red green blue) ]);
+my $im2 = $im1->copy;
+$im2->filter(type => "noise", amount => 3);
+
+my @tests =
+  (
+   [ "count" => sub { $im1->difference_pixels(other => $im2) } ],
+   [ "mindist 2" => sub { $im1->difference_pixels(other => $im2, mindist => 2) } ],
+   [ "limit 100" => sub { $im1->difference_pixels(other => $im2, limit => 100) } ],
+   [ "no SIMD" => sub {
+       my $old = Imager::i_simd_set_mask(0);
+       my $count = $im1->difference_pixels(other => $im2);
+       Imager::i_simd_set_mask($old);
+       $count;
+     } ],
+  );
+
+for my $test (@tests) {
+  my ($name, $code) = @$test;
+  my $count = 0;
+  my $start = time;
+  my $elapsed;
+  do {
+    defined $code->()
+      or die $im1->errstr;
+    ++$count;
+    $elapsed = time - $start;
+  } while ($elapsed < $min_time);
+  printf "%-10s %9.3f ms/op\n", $name, $elapsed * 1000 / $count;
+}
@@ -0,0 +1,43 @@
+#!perl -w
+# benchmark the operations that work directly on the rows of 8-bit
+# images, run from the build directory:
+#   perl -Mblib bench/direct8.pl
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+
+my $min_time = 3;
+
+my $src = Imager->new(xsize => 2000, ysize => 1500);
+$src->filter(type => "gradgen", xo => [ 0, 1999, 1000 ], yo => [ 0, 0, 1499 ],
+	     colors => [ qw(red green blue) ]);
+$src->filter(type => "noise", amount => 20);
+my $tile = $src->crop(width => 97, height => 89);
+
+my @tests =
+  (
+   [ contrast => sub { $_[0]->filter(type => "contrast", intensity => 1.2) } ],
+   [ hardinvert => sub { $_[0]->filter(type => "hardinvert") } ],
+   [ noise => sub { $_[0]->filter(type => "noise", amount => 10) } ],
+   [ postlevels => sub { $_[0]->filter(type => "postlevels", levels => 6) } ],
+   [ autolevels => sub { $_[0]->filter(type => "autolevels") } ],
+   [ "box filled" => sub { $_[0]->box(filled => 1, color => "#804020") } ],
+   [ "flood fill" => sub { $_[0]->flood_fill(x => 0, y => 0, color => "#FF0000") } ],
+   [ "tile fill" => sub { $_[0]->box(fill => { image => $tile, xoff => 11 }) } ],
+  );
+
+for my $test (@tests) {
+  my ($name, $code) = @$test;
+  my $im = $name eq "flood fill"
+    ? Imager->new(xsize => 2000, ysize => 1500) : $src->copy;
+  my $count = 0;
+  my $start = time;
+  my $elapsed;
+  do {
+    $code->($im)
+      or die $im->errstr;
+    ++$count;
+    $elapsed = time - $start;
+  } while ($elapsed < $min_time);
+  printf "%-12s %9.2f ms/op\n", $name, $elapsed * 1000 / $count;
+}
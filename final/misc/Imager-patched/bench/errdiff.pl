@@ -0,0 +1,41 @@
+#!perl -w
+# benchmark error diffusion to a fixed palette with each of the
+# built-in maps, run from the build directory:
+#   perl -Mblib bench/errdiff.pl
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+
+my $min_time = 3;
+
+my $rgb = Imager->new(xsize => 2000, ysize => 1500);
+$rgb->filter(type => "gradgen", xo => [ 0, 1999, 1000 ], yo => [ 0, 0, 1499 ],
+	     colors => [ qw(red green blue) ]);
+$rgb->filter(type => "noise", amount => 30);
+
+my @palettes =
+  (
+   [ "256 colors" => Imager->make_palette({ make_colors => "mediancut" }, $rgb) ],
+   [ mono => Imager->make_palette({ make_colors => "mono" }, $rgb) ],
+  );
+
+for my $palette (@palettes) {
+  my ($pal_name, @colors) = @$palette;
+  for my $map (qw(floyd jarvis stucki)) {
+    for my $serpentine (0, 1) {
+      my $count = 0;
+      my $start = time;
+      my $elapsed;
+      do {
+	$rgb->to_paletted(colors => \@colors, make_colors => "none",
+			  translate => "errdiff", errdiff => $map,
+			  errdiff_serpentine => $serpentine)
+	  or die $rgb->errstr;
+	++$count;
+	$elapsed = time - $start;
+      } while ($elapsed < $min_time);
+      printf "%-10s %-6s %-10s %9.2f ms/op\n", $pal_name, $map,
+	$serpentine ? "serpentine" : "", $elapsed * 1000 / $count;
+    }
+  }
+}
@@ -0,0 +1,32 @@
+#!perl -w
+# benchmark the gaussian filter methods over a range of stddev
+# run from the build directory:
+#   perl -Mblib bench/gaussian.pl [method ...]
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+use FindBin;
+use lib "$FindBin::Bin/lib";
+use BenchImage qw(source_image);
+
+my @methods = @ARGV ? @ARGV : qw(exact iir);
+my @stddevs = ( 1, 2, 5, 10, 20, 50 );
+my $min_time = 2;
+
+my $im = source_image(1024, 768);
+for my $method (@methods) {
+  for my $stddev (@stddevs) {
+    my $count = 0;
+    my $start = time;
+    my $elapsed;
+    do {
+      my $work = $im->copy;
+      $work->filter(type => "gaussian", stddev => $stddev, method => $method)
+	or die $work->errstr;
+      ++$count;
+      $elapsed = time - $start;
+    } while ($elapsed < $min_time);
+    printf "%dx%d stddev %2d %-5s %9.2f ms/op\n", $im->getwidth,
+      $im->getheight, $stddev, $method, $elapsed * 1000 / $count;
+  }
+}
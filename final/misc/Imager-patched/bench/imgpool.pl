@@ -0,0 +1,47 @@
+#!perl -w
+# benchmark creating and discarding images with and without the
+# image pool, run from the build directory:
+#   perl -Mblib bench/imgpool.pl
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+
+my $min_time = 3;
+
+# malloc() typically hands very large blocks straight to the OS, so
+# the large images show the difference most
+my @sets =
+  (
+   [ medium => [ 1024, 768 ], [ 1000, 750 ], [ 1024, 700 ], [ 980, 768 ] ],
+   [ large => [ 4000, 3000 ], [ 3900, 3000 ], [ 4000, 2900 ] ],
+  );
+
+my @tests =
+  (
+   [ malloc => 0 ],
+   [ pool => 200_000_000 ],
+  );
+
+for my $set (@sets) {
+  my ($set_name, @sizes) = @$set;
+  for my $test (@tests) {
+    my ($name, $limit) = @$test;
+    Imager->set_image_pool($limit);
+    my $count = 0;
+    my $start = time;
+    my $elapsed;
+    do {
+      for my $size (@sizes) {
+	my $im = Imager->new(xsize => $size->[0], ysize => $size->[1])
+	  or die Imager->errstr;
+      }
+      ++$count;
+      $elapsed = time - $start;
+    } while ($elapsed < $min_time);
+    printf "%-6s %-6s %9.3f ms/op\n", $set_name, $name,
+      $elapsed * 1000 / $count;
+  }
+}
+
+my %stats = Imager->image_pool_stats;
+print join(" ", map "$_=$stats{$_}", sort keys %stats), "\n";
@@ -0,0 +1,51 @@
+#!perl -w
+# benchmark reading a file normally, memory mapped and from a scalar,
+# run from the build directory:
+#   perl -Mblib bench/ioread.pl [file]
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+
+my $min_time = 3;
+
+my $file = shift;
+unless ($file) {
+  $Imager::formats{jpeg}
+    or die "No JPEG support, supply a file to read\n";
+  -d "testout" or mkdir "testout";
+  $file = "testout/ioread.jpg";
+  my $im = Imager->new(xsize => 3000, ysize => 2000);
+  $im->filter(type => "gradgen", xo => [ 0, 2999, 1500 ], yo => [ 0, 0, 1999 ],
+	      colors => [ qw(red green blue) ]);
+  $im->filter(type => "noise", amount => 30);
+  $im->write(file => $file, jpegquality => 90)
+    or die $im->errstr;
+}
+
+my $data = do {
+  open my $fh, "<", $file or die "Cannot open $file: $!";
+  binmode $fh;
+  local $/;
+  <$fh>;
+};
+
+my @tests =
+  (
+   [ file => sub { Imager->new(file => $file) } ],
+   [ mmap => sub { Imager->new(file => $file, mmap => 1) } ],
+   [ data => sub { Imager->new(data => $data) } ],
+  );
+
+for my $test (@tests) {
+  my ($name, $code) = @$test;
+  my $count = 0;
+  my $start = time;
+  my $elapsed;
+  do {
+    $code->()
+      or die Imager->errstr;
+    ++$count;
+    $elapsed = time - $start;
+  } while ($elapsed < $min_time);
+  printf "%-5s %9.2f ms/op\n", $name, $elapsed * 1000 / $count;
+}
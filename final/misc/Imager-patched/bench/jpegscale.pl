@@ -0,0 +1,40 @@
+#!perl -w
+# benchmark making JPEG thumbnails, decoding at full size then scaling
+# vs letting libjpeg decode at a reduced scale first
+# run from the build directory:
+#   perl -Mblib bench/jpegscale.pl
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+use FindBin;
+use lib "$FindBin::Bin/lib";
+use BenchImage qw(source_data);
+
+my @sources = ( [ 1600, 1200 ], [ 2592, 1944 ] );
+my @sizes = ( 32, 64, 128, 256 );
+my $min_time = 2;
+
+for my $source (@sources) {
+  my $data = source_data("jpeg", @$source);
+  for my $size (@sizes) {
+    for my $mode (qw(full target)) {
+      my %read_opts = $mode eq "target"
+	? ( jpeg_target_width => $size, jpeg_target_height => $size )
+	: ();
+      my $count = 0;
+      my $start = time;
+      my $elapsed;
+      do {
+	my $im = Imager->new(data => $data, %read_opts)
+	  or die Imager->errstr;
+	$im->scale(xpixels => $size, ypixels => $size, type => "min",
+		   qtype => "mixing")
+	  or die $im->errstr;
+	++$count;
+	$elapsed = time - $start;
+      } while ($elapsed < $min_time);
+      printf "%dx%d -> %3d %-6s %8.2f ms/op\n", @$source, $size, $mode,
+	$elapsed * 1000 / $count;
+    }
+  }
+}
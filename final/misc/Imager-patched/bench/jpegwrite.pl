@@ -0,0 +1,48 @@
+#!perl -w
+# benchmark writing JPEG images, run from the build directory:
+#   perl -Mblib -IJPEG/blib/lib -IJPEG/blib/arch bench/jpegwrite.pl
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+
+my $min_time = 3;
+
+$Imager::formats{jpeg}
+  or die "No JPEG support\n";
+
+my $rgb = Imager->new(xsize => 2000, ysize => 1500);
+$rgb->filter(type => "gradgen", xo => [ 0, 1999, 1000 ], yo => [ 0, 0, 1499 ],
+	     colors => [ qw(red green blue) ]);
+$rgb->filter(type => "noise", amount => 30);
+my $grey = $rgb->convert(preset => "grey");
+my $rgba = $rgb->convert(preset => "addalpha");
+my $grey_alpha = $grey->convert(preset => "addalpha");
+
+my @tests =
+  (
+   [ rgb => $rgb ],
+   [ grey => $grey ],
+   [ rgba => $rgba ],
+   [ "grey+alpha" => $grey_alpha ],
+   [ "rgb ifast" => $rgb, jpeg_dct => "ifast" ],
+   [ "rgb optimize" => $rgb, jpeg_optimize => 1 ],
+   [ "rgb 1x1" => $rgb, jpeg_sample => "1x1" ],
+  );
+
+for my $test (@tests) {
+  my ($name, $im, @opts) = @$test;
+  my $count = 0;
+  my $size;
+  my $start = time;
+  my $elapsed;
+  do {
+    my $data;
+    $im->write(data => \$data, type => "jpeg", @opts)
+      or die $im->errstr;
+    $size = length $data;
+    ++$count;
+    $elapsed = time - $start;
+  } while ($elapsed < $min_time);
+  printf "%-12s %9.2f ms/op %8d bytes\n", $name, $elapsed * 1000 / $count,
+    $size;
+}
@@ -0,0 +1,42 @@
+package BenchImage;
+use strict;
+use Imager;
+require Exporter;
+use vars qw(@ISA @EXPORT_OK);
+
+@ISA = qw(Exporter);
+@EXPORT_OK = qw(source_image source_data);
+
+# source images shared by the benchmarks, load with:
+#   use FindBin;
+#   use lib "$FindBin::Bin/lib";
+#   use BenchImage qw(source_image);
+
+# a photo-like RGB image, a three color gradient with noise
+sub source_image {
+  my ($width, $height) = @_;
+
+  my $im = Imager->new(xsize => $width, ysize => $height);
+  $im->filter(type => "gradgen", xo => [ 0, $width-1, $width/3 ],
+	      yo => [ 0, $height-1, $height/2 ],
+	      colors => [ map Imager::Color->new($_), qw(red blue green) ])
+    or die $im->errstr;
+  $im->filter(type => "noise", amount => 40, subtype => 0)
+    or die $im->errstr;
+
+  return $im;
+}
+
+# the same image written to a file of the given type
+sub source_data {
+  my ($type, $width, $height) = @_;
+
+  my $im = source_image($width, $height);
+  my $data;
+  $im->write(data => \$data, type => $type, jpegquality => 90)
+    or die $im->errstr;
+
+  return $data;
+}
+
+1;
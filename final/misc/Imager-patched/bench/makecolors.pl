@@ -0,0 +1,43 @@
+#!perl -w
+# benchmark building a 256 color palette for a 6 megapixel image,
+# with the error of the image translated to that palette, run from
+# the build directory:
+#   perl -Mblib bench/makecolors.pl
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+
+my $min_time = 3;
+
+my $im = Imager->new(xsize => 3000, ysize => 2000);
+$im->filter(type => "gradgen", xo => [ 0, 2999, 1500 ], yo => [ 0, 0, 1999 ],
+	    colors => [ qw(red green blue) ]);
+$im->filter(type => "noise", amount => 30);
+
+my @tests =
+  (
+   [ mediancut => make_colors => "mediancut" ],
+   [ wu => make_colors => "wu" ],
+   [ "wu step 2" => make_colors => "wu", make_colors_step => 2 ],
+   [ "wu step 4" => make_colors => "wu", make_colors_step => 4 ],
+  );
+
+for my $test (@tests) {
+  my ($name, %opts) = @$test;
+  my @colors;
+  my $count = 0;
+  my $start = time;
+  my $elapsed;
+  do {
+    @colors = Imager->make_palette(\%opts, $im)
+      or die Imager->errstr;
+    ++$count;
+    $elapsed = time - $start;
+  } while ($elapsed < $min_time);
+  my $pal = $im->to_paletted(colors => \@colors, make_colors => "none")
+    or die $im->errstr;
+  my $rms = sqrt(Imager::i_img_diff($pal->to_rgb8->{IMG}, $im->{IMG})
+		 / ($im->getwidth * $im->getheight * 3));
+  printf "%-10s %9.2f ms/op %3d colors rms error %.2f\n", $name,
+    $elapsed * 1000 / $count, scalar(@colors), $rms;
+}
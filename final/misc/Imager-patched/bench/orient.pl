@@ -0,0 +1,55 @@
+#!perl -w
+# benchmark reading a JPEG with an EXIF orientation upright, by
+# rotating after the read vs jpeg_auto_orient, run from the build
+# directory:
+#   perl -Mblib -IJPEG/blib/lib -IJPEG/blib/arch bench/orient.pl
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+
+my $min_time = 3;
+
+# take the EXIF block, with orientation 8, from a test image
+open my $fh, "<", "JPEG/testimg/209_yonge.jpg"
+  or die "Cannot open JPEG/testimg/209_yonge.jpg: $!\n";
+binmode $fh;
+my $exif_src = do { local $/; <$fh> };
+close $fh;
+my $exif_start = index($exif_src, "\xFF\xE1");
+my $exif_len = unpack("n", substr($exif_src, $exif_start + 2, 2)) + 2;
+my $exif = substr($exif_src, $exif_start, $exif_len);
+
+my $im = Imager->new(xsize => 4000, ysize => 3000);
+$im->filter(type => "gradgen", xo => [ 0, 3999, 2000 ], yo => [ 0, 0, 2999 ],
+	    colors => [ qw(red green blue) ]);
+$im->filter(type => "noise", amount => 30);
+my $data;
+$im->write(data => \$data, type => "jpeg")
+  or die $im->errstr;
+# insert it after SOI
+substr($data, 2, 0, $exif);
+
+my @tests =
+  (
+   [ "read only" => sub { Imager->new(data => $data) } ],
+   [ "read, rotate" => sub {
+       Imager->new(data => $data)->rotate(right => 270)
+     } ],
+   [ "jpeg_auto_orient" => sub {
+       Imager->new(data => $data, jpeg_auto_orient => 1)
+     } ],
+  );
+
+for my $test (@tests) {
+  my ($name, $code) = @$test;
+
+  my $count = 0;
+  my $start = time;
+  my $elapsed;
+  do {
+    $code->() or die Imager->errstr;
+    ++$count;
+    $elapsed = time - $start;
+  } while ($elapsed < $min_time);
+  printf "%-16s %9.2f ms/op\n", $name, $elapsed * 1000 / $count;
+}
@@ -0,0 +1,52 @@
+#!perl -w
+# benchmark writing PNG images with various compression settings, run
+# from the build directory:
+#   perl -Mblib -IPNG/blib/lib -IPNG/blib/arch bench/pngwrite.pl
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+
+my $min_time = 3;
+
+$Imager::formats{png}
+  or die "No PNG support\n";
+
+my $photo = Imager->new(xsize => 1024, ysize => 768);
+$photo->filter(type => "gradgen", xo => [ 0, 1023, 512 ], yo => [ 0, 0, 767 ],
+	       colors => [ qw(red green blue) ]);
+$photo->filter(type => "noise", amount => 20);
+my $icon = $photo->scale(xpixels => 64, ypixels => 64, type => "nonprop")
+  ->convert(preset => "addalpha");
+
+my @settings =
+  (
+   [ default => ],
+   [ "level 1" => png_compression_level => 1 ],
+   [ "level 9" => png_compression_level => 9 ],
+   [ "no filter" => png_filter => "none" ],
+   [ "fast" => png_compression_level => 1, png_filter => "none" ],
+   [ "rle" => png_compression_strategy => "rle", png_filter => "sub" ],
+  );
+
+for my $image ([ icon => $icon ], [ photo => $photo ]) {
+  my ($image_name, $im) = @$image;
+  for my $setting (@settings) {
+    my ($name, @opts) = @$setting;
+    # the options are stored as tags, so work on a copy
+    my $work = $im->copy;
+    my $count = 0;
+    my $size;
+    my $start = time;
+    my $elapsed;
+    do {
+      my $data;
+      $work->write(data => \$data, type => "png", @opts)
+	or die $work->errstr;
+      $size = length $data;
+      ++$count;
+      $elapsed = time - $start;
+    } while ($elapsed < $min_time);
+    printf "%-5s %-9s %9.3f ms/op %8d bytes\n", $image_name, $name,
+      $elapsed * 1000 / $count, $size;
+  }
+}
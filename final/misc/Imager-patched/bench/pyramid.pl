@@ -0,0 +1,58 @@
+#!perl -w
+# benchmark producing a set of thumbnail sizes from one image, scaling
+# the full image for each size vs scale_pyramid()
+# run from the build directory:
+#   perl -Mblib bench/pyramid.pl
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+use FindBin;
+use lib "$FindBin::Bin/lib";
+use BenchImage qw(source_image);
+
+my @sources = ( [ 1024, 768 ], [ 2592, 1944 ] );
+my @sets =
+  (
+   [ icons => 32, 64, 128 ],
+   [ entries => 128, 256 ],
+   [ largest => 256 ],
+  );
+my $min_time = 2;
+
+for my $source (@sources) {
+  my $im = source_image(@$source);
+  for my $set (@sets) {
+    my ($name, @sizes) = @$set;
+    my @tests =
+      (
+       [
+	separate => sub {
+	  for my $size (@sizes) {
+	    $im->scale(xpixels => $size, ypixels => $size, type => "min",
+		       qtype => "mixing")
+	      or die $im->errstr;
+	  }
+	},
+       ],
+       [
+	pyramid => sub {
+	  my @thumbs = $im->scale_pyramid(sizes => \@sizes)
+	    or die $im->errstr;
+	},
+       ],
+      );
+    for my $test (@tests) {
+      my ($mode, $code) = @$test;
+      my $count = 0;
+      my $start = time;
+      my $elapsed;
+      do {
+	$code->();
+	++$count;
+	$elapsed = time - $start;
+      } while ($elapsed < $min_time);
+      printf "%dx%d %-8s %-9s %8.2f ms/op\n", @$source, $name, $mode,
+	$elapsed * 1000 / $count;
+    }
+  }
+}
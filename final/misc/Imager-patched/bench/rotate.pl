@@ -0,0 +1,41 @@
+#!perl -w
+# benchmark rotating and affine transforming 8-bit images, run from
+# the build directory:
+#   perl -Mblib bench/rotate.pl
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+
+my $min_time = 3;
+
+my $rgb = Imager->new(xsize => 2000, ysize => 1500);
+$rgb->filter(type => "gradgen", xo => [ 0, 1999, 1000 ], yo => [ 0, 0, 1499 ],
+	     colors => [ qw(red green blue) ]);
+$rgb->filter(type => "noise", amount => 30);
+my $rgba = $rgb->convert(preset => "addalpha");
+my $gray = $rgb->convert(preset => "gray");
+
+my @tests =
+  (
+   [ "rotate 10 rgb" => sub { $rgb->rotate(degrees => 10) } ],
+   [ "rotate 10 gray" => sub { $gray->rotate(degrees => 10) } ],
+   [ "rotate 10 rgba" => sub { $rgba->rotate(degrees => 10) } ],
+   [ "rotate 90 rgb" => sub { $rgb->rotate(degrees => 90) } ],
+   [ "shear rgb" => sub {
+       $rgb->matrix_transform(matrix => [ 1, 0.3, 0, 0, 1, 0, 0, 0, 1 ])
+     } ],
+  );
+
+for my $test (@tests) {
+  my ($name, $code) = @$test;
+
+  my $count = 0;
+  my $start = time;
+  my $elapsed;
+  do {
+    $code->() or die Imager->errstr;
+    ++$count;
+    $elapsed = time - $start;
+  } while ($elapsed < $min_time);
+  printf "%-16s %9.2f ms/op\n", $name, $elapsed * 1000 / $count;
+}
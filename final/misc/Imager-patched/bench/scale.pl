@@ -0,0 +1,41 @@
+#!perl -w
+# benchmark scaling of upload sized images down to icon sizes
+# run from the build directory:
+#   perl -Mblib bench/scale.pl [--simd=mask] [qtype ...]
+# --simd=0 disables the vectorized code paths
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+use FindBin;
+use lib "$FindBin::Bin/lib";
+use BenchImage qw(source_image);
+
+if (@ARGV && $ARGV[0] =~ /^--simd=(\d+)$/) {
+  Imager::i_simd_set_mask($1);
+  shift @ARGV;
+}
+
+my @qtypes = @ARGV ? @ARGV : qw(normal mixing);
+my @sources = ( [ 1600, 1200 ], [ 2592, 1944 ] );
+my @sizes = ( 32, 64, 128, 256 );
+my $min_time = 2;
+
+for my $source (@sources) {
+  my $im = source_image(@$source);
+  for my $qtype (@qtypes) {
+    for my $size (@sizes) {
+      my $count = 0;
+      my $start = time;
+      my $elapsed;
+      do {
+	$im->scale(xpixels => $size, ypixels => $size, type => "min",
+		   qtype => $qtype)
+	  or die $im->errstr;
+	++$count;
+	$elapsed = time - $start;
+      } while ($elapsed < $min_time);
+      printf "%dx%d -> %3d %-7s %8.2f ms/op\n", @$source, $size, $qtype,
+	$elapsed * 1000 / $count;
+    }
+  }
+}
@@ -0,0 +1,75 @@
+#!perl -w
+# benchmark scaling an image file a row at a time with scale_stream()
+# vs read, scale and write, measuring the time and the peak memory
+# used, each case is run in a child process so the peaks are separate
+# run from the build directory on a system with /proc:
+#   perl -Mblib -IJPEG/blib/lib -IJPEG/blib/arch \
+#     -IPNG/blib/lib -IPNG/blib/arch bench/scalestream.pl
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+use FindBin;
+use lib "$FindBin::Bin/lib";
+use BenchImage qw(source_image);
+
+my $size = 1024;
+
+my $src = source_image(6000, 4000);
+for my $type (qw(jpeg png)) {
+  my $file = "testout/scalestream.$type";
+  $src->write(file => $file)
+    or die $src->errstr;
+
+  my @tests =
+    (
+     [
+      read => sub {
+	my $im = Imager->new(file => $file)
+	  or die Imager->errstr;
+	my $out;
+	$im->scale(xpixels => $size, ypixels => $size, type => "min",
+		   qtype => "mixing")
+	  ->write(data => \$out, type => $type)
+	    or die Imager->errstr;
+      },
+     ],
+     [
+      stream => sub {
+	my $out;
+	Imager->scale_stream(in => { file => $file },
+			     out => { data => \$out },
+			     xpixels => $size, ypixels => $size,
+			     type => "min")
+	  or die Imager->errstr;
+      },
+     ],
+    );
+  for my $test (@tests) {
+    my ($mode, $code) = @$test;
+    my $pid = fork;
+    defined $pid
+      or die "Cannot fork: $!\n";
+    if ($pid) {
+      waitpid($pid, 0);
+      next;
+    }
+    my $base = _peak_kb();
+    my $start = time;
+    $code->();
+    my $elapsed = time - $start;
+    printf "%-4s %-6s %8.2f ms %8d KB peak\n", $type, $mode,
+      $elapsed * 1000, _peak_kb() - $base;
+    exit 0;
+  }
+  unlink $file;
+}
+
+sub _peak_kb {
+  open my $fh, "<", "/proc/self/status"
+    or die "Cannot open /proc/self/status: $!\n";
+  while (<$fh>) {
+    /^VmHWM:\s+(\d+)/
+      and return $1;
+  }
+  die "No VmHWM in /proc/self/status\n";
+}
@@ -0,0 +1,45 @@
+#!perl -w
+# benchmark the operations that use worker threads, for each number
+# of threads given, run from the build directory:
+#   perl -Mblib bench/threads.pl 1 2 4
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+use FindBin;
+use lib "$FindBin::Bin/lib";
+use BenchImage qw(source_image);
+
+my $min_time = 5;
+
+my @thread_counts = @ARGV ? @ARGV : ( 1, 2, 4 );
+
+my @tests =
+  (
+   [ "gaussian stddev 3" => sub { $_[0]->filter(type => "gaussian", stddev => 3) } ],
+   [ "conv 7 taps" => sub { $_[0]->filter(type => "conv", coef => [ 1, 2, 3, 4, 3, 2, 1 ]) } ],
+   [ "unsharpmask" => sub { $_[0]->filter(type => "unsharpmask", stddev => 2) } ],
+   [ "scale mixing 0.3" => sub { $_[0]->scale(scalefactor => 0.3, qtype => "mixing") } ],
+   [ "rotate 17" => sub { $_[0]->rotate(degrees => 17) } ],
+   [ "convert gray" => sub { $_[0]->convert(matrix => [ [ 0.3, 0.5, 0.2 ] ]) } ],
+  );
+
+my $im = source_image(4000, 3000);
+for my $threads (@thread_counts) {
+  Imager->set_threads($threads)
+    or die Imager->errstr;
+  for my $test (@tests) {
+    my ($name, $code) = @$test;
+    my $count = 0;
+    my $start = time;
+    my $elapsed;
+    do {
+      my $work = $im->copy;
+      $code->($work)
+	or die $work->errstr;
+      ++$count;
+      $elapsed = time - $start;
+    } while ($elapsed < $min_time);
+    printf "%dx%d %2d threads %-18s %9.2f ms/op\n", $im->getwidth,
+      $im->getheight, $threads, $name, $elapsed * 1000 / $count;
+  }
+}
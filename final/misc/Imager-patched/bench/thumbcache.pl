@@ -0,0 +1,71 @@
+#!perl -w
+# benchmark serving the same thumbnails repeatedly with and without
+# Imager::ThumbCache, run from the build directory:
+#   perl -Mblib bench/thumbcache.pl
+use strict;
+use Imager;
+use Imager::ThumbCache;
+use Imager::Test qw(test_image);
+use Time::HiRes qw(time);
+
+my $min_time = 3;
+
+my $src = test_image()->scale(xpixels => 1024, ypixels => 768,
+			      type => "nonprop");
+my $src_data;
+$src->write(data => \$src_data, type => "pnm")
+  or die $src->errstr;
+
+# a handful of sizes requested over and over, as a web page would
+my @sizes = ( 32, 64, 128, 256 );
+
+my $cache = Imager::ThumbCache->new;
+
+my @tests =
+  (
+   [
+    uncached => sub {
+      for my $size (@sizes) {
+	my $data;
+	Imager->square_thumbnail(in => { data => $src_data },
+				 out => { data => \$data, type => "png" },
+				 size => $size)
+	  or die Imager->errstr;
+      }
+    },
+   ],
+   [
+    cached => sub {
+      for my $size (@sizes) {
+	$cache->square_thumbnail(in => { data => $src_data },
+				 size => $size, type => "png")
+	  or die $cache->errstr;
+      }
+    },
+   ],
+   [
+    cached_id => sub {
+      for my $size (@sizes) {
+	$cache->square_thumbnail(id => "src", in => { data => $src_data },
+				 size => $size, type => "png")
+	  or die $cache->errstr;
+      }
+    },
+   ],
+  );
+
+for my $test (@tests) {
+  my ($name, $code) = @$test;
+  my $count = 0;
+  my $start = time;
+  my $elapsed;
+  do {
+    $code->();
+    ++$count;
+    $elapsed = time - $start;
+  } while ($elapsed < $min_time);
+  printf "%-10s %9.3f ms/op\n", $name, $elapsed * 1000 / $count;
+}
+
+my %stats = $cache->stats;
+print join(" ", map "$_=$stats{$_}", sort keys %stats), "\n";
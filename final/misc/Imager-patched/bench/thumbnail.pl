@@ -0,0 +1,69 @@
+#!perl -w
+# benchmark making square thumbnails, the read/crop/scale/write steps
+# one at a time vs Imager->square_thumbnail()
+# run from the build directory:
+#   perl -Mblib bench/thumbnail.pl
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+use FindBin;
+use lib "$FindBin::Bin/lib";
+use BenchImage qw(source_data);
+
+my @sources = ( [ jpeg => 2592, 1944 ], [ png => 1600, 1200 ] );
+my @sizes = ( 64, 128, 256 );
+my $min_time = 2;
+
+my %modes =
+  (
+   steps => \&steps,
+   fused => \&fused,
+  );
+
+for my $source (@sources) {
+  my ($type, $width, $height) = @$source;
+  my $data = source_data(@$source);
+  for my $size (@sizes) {
+    for my $mode (qw(steps fused)) {
+      my $code = $modes{$mode};
+      my $count = 0;
+      my $start = time;
+      my $elapsed;
+      do {
+	$code->($data, $size);
+	++$count;
+	$elapsed = time - $start;
+      } while ($elapsed < $min_time);
+      printf "%-4s %dx%d -> %3d %-5s %8.2f ms/op\n", $type, $width, $height,
+	$size, $mode, $elapsed * 1000 / $count;
+    }
+  }
+}
+
+sub steps {
+  my ($data, $size) = @_;
+
+  my $im = Imager->new(data => $data)
+    or die Imager->errstr;
+  my $side = $im->getwidth < $im->getheight ? $im->getwidth : $im->getheight;
+  my $thumb = $im->crop(left => int(($im->getwidth - $side) / 2),
+			top => int(($im->getheight - $side) / 2),
+			width => $side, height => $side)
+    ->scale(xpixels => $size, ypixels => $size, qtype => "mixing");
+  my $out;
+  $thumb->write(data => \$out, type => $im->tags(name => "i_format"))
+    or die $thumb->errstr;
+
+  return $out;
+}
+
+sub fused {
+  my ($data, $size) = @_;
+
+  my $out;
+  Imager->square_thumbnail(in => { data => $data }, out => { data => \$out },
+			   size => $size)
+    or die Imager->errstr;
+
+  return $out;
+}
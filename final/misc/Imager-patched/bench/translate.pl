@@ -0,0 +1,60 @@
+#!perl -w
+# benchmark translating images to a 256 color palette, with an MD5 of
+# the palette indices produced to check the results don't change,
+# run from the build directory:
+#   perl -Mblib bench/translate.pl
+use strict;
+use Imager;
+use Digest::MD5 qw(md5_hex);
+use Time::HiRes qw(time);
+
+my $min_time = 3;
+
+my $rgb = Imager->new(xsize => 2000, ysize => 1500);
+$rgb->filter(type => "gradgen", xo => [ 0, 1999, 1000 ], yo => [ 0, 0, 1499 ],
+	     colors => [ qw(red green blue) ]);
+$rgb->filter(type => "noise", amount => 30);
+my $rgb16 = $rgb->to_rgb16;
+my $grey = $rgb->convert(preset => "grey");
+
+my @tests =
+  (
+   [ "closest addi" => $rgb, make_colors => "addi", translate => "closest" ],
+   [ "closest webmap" => $rgb, make_colors => "webmap",
+     translate => "closest" ],
+   [ "closest mediancut" => $rgb, make_colors => "mediancut",
+     translate => "closest" ],
+   [ "closest 16-bit" => $rgb16, make_colors => "mediancut",
+     translate => "closest" ],
+   [ "closest grey" => $grey, make_colors => "mediancut",
+     translate => "closest" ],
+   [ "errdiff" => $rgb, make_colors => "mediancut", translate => "errdiff" ],
+  );
+
+for my $test (@tests) {
+  my ($name, $im, @opts) = @$test;
+
+  my %opts = @opts;
+
+  # the palette is made once so only the translation is timed
+  my @colors = Imager->make_palette({ make_colors => $opts{make_colors} },
+				    $im)
+    or die Imager->errstr;
+  my $pal;
+  my $count = 0;
+  my $start = time;
+  my $elapsed;
+  do {
+    $pal = $im->to_paletted(colors => \@colors, make_colors => "none",
+			    translate => $opts{translate})
+      or die $im->errstr;
+    ++$count;
+    $elapsed = time - $start;
+  } while ($elapsed < $min_time);
+  my $md5 = Digest::MD5->new;
+  for my $y (0 .. $pal->getheight - 1) {
+    $md5->add(pack("C*", $pal->getscanline(y => $y, type => "index")));
+  }
+  printf "%-18s %9.2f ms/op %s\n", $name, $elapsed * 1000 / $count,
+    $md5->hexdigest;
+}
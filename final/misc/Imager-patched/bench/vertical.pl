@@ -0,0 +1,39 @@
+#!perl -w
+# benchmark the filters with a separate vertical pass on a large image
+# run from the build directory:
+#   perl -Mblib bench/vertical.pl
+use strict;
+use Imager;
+use Time::HiRes qw(time);
+use FindBin;
+use lib "$FindBin::Bin/lib";
+use BenchImage qw(source_image);
+
+my $min_time = 5;
+
+my @tests =
+  (
+   [ "gaussian stddev 1" => sub { $_[0]->filter(type => "gaussian", stddev => 1) } ],
+   [ "gaussian stddev 3" => sub { $_[0]->filter(type => "gaussian", stddev => 3) } ],
+   [ "conv 3 taps" => sub { $_[0]->filter(type => "conv", coef => [ 0.3, 1, 0.3 ]) } ],
+   [ "conv 7 taps" => sub { $_[0]->filter(type => "conv", coef => [ 1, 2, 3, 4, 3, 2, 1 ]) } ],
+   [ "scaleY 0.5" => sub { $_[0]->scaleY(scalefactor => 0.5) } ],
+   [ "scaleY 2" => sub { $_[0]->scaleY(scalefactor => 2) } ],
+  );
+
+my $im = source_image(4000, 3000);
+for my $test (@tests) {
+  my ($name, $code) = @$test;
+  my $count = 0;
+  my $start = time;
+  my $elapsed;
+  do {
+    my $work = $im->copy;
+    $code->($work)
+      or die $work->errstr;
+    ++$count;
+    $elapsed = time - $start;
+  } while ($elapsed < $min_time);
+  printf "%dx%d %-18s %9.2f ms/op\n", $im->getwidth, $im->getheight,
+    $name, $elapsed * 1000 / $count;
+}
@@ -199,6 +199,76 @@ i_readbmp_wiol(io_glue *ig, int allow_incomplete) {
   return im;
 }
 
+/*
+=item i_probebmp_wiol(ig, info)
+
+Reads the header of a Windows BMP file into C<info> without reading
+the image data.  Returns non-zero on success.
+
+=cut
+*/
+
+int
+i_probebmp_wiol(io_glue *ig, i_image_info *info) {
+  i_packed_t b_magic, m_magic, filesize, res1, res2, infohead_size;
+  i_packed_t xsize, ysize, planes, bit_count, compression, size_image, xres, yres;
+  i_packed_t clr_used, clr_important, offbits;
+  dIMCTXio(ig);
+
+  im_log((aIMCTX, 1, "i_probebmp_wiol(ig %p, info %p)\n", ig, info));
+  
+  i_clear_error();
+
+  if (!read_packed(ig, "CCVvvVVV!V!vvVVVVVV", &b_magic, &m_magic, &filesize, 
+		   &res1, &res2, &offbits, &infohead_size, 
+                   &xsize, &ysize, &planes,
+		   &bit_count, &compression, &size_image, &xres, &yres, 
+		   &clr_used, &clr_important)) {
+    i_push_error(0, "file too short to be a BMP file");
+    return 0;
+  }
+  if (b_magic != 'B' || m_magic != 'M' || infohead_size != INFOHEAD_SIZE
+      || planes != 1) {
+    i_push_error(0, "not a BMP file");
+    return 0;
+  }
+  /* a negative height is a top-down image, and -2**31 can't be
+     negated in 32 bits */
+  if (xsize <= 0 || ysize == 0 || ysize < -0x7FFFFFFFL) {
+    i_push_error(0, "invalid image size in BMP header");
+    return 0;
+  }
+
+  memset(info, 0, sizeof(*info));
+  info->format = "bmp";
+  info->width = xsize;
+  info->height = ysize < 0 ? -ysize : ysize;
+  info->channels = 3;
+  switch (bit_count) {
+  case 1:
+  case 4:
+  case 8:
+    info->bits = bit_count;
+    info->paletted = 1;
+    break;
+
+  case 16:
+    info->bits = 5;
+    break;
+
+  case 24:
+  case 32:
+    info->bits = 8;
+    break;
+
+  default:
+    im_push_errorf(aIMCTX, 0, "unknown bit count for BMP file (%d)", (int)bit_count);
+    return 0;
+  }
+
+  return 1;
+}
+
 /*
 =back
 
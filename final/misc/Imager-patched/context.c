@@ -45,6 +45,11 @@ im_context_new(void) {
     return NULL;
   }
 
+  ctx->threads = 1;
+  ctx->pool = NULL;
+
+  ctx->img_pool = NULL;
+
   ctx->refcount = 1;
 
 #ifdef IMAGER_TRACE_CONTEXT
@@ -115,6 +120,12 @@ im_context_refdec(im_context_t ctx, const char *where) {
 
   free(ctx->slots);
 
+  if (ctx->pool)
+    i_int_pool_destroy(ctx->pool);
+
+  if (ctx->img_pool)
+    i_int_img_pool_destroy(ctx->img_pool);
+
   for (i = 0; i < IM_ERROR_COUNT; ++i) {
     if (ctx->error_stack[i].msg)
       myfree(ctx->error_stack[i].msg);
@@ -140,6 +151,7 @@ The error stack is not copied from the original context.
 im_context_t
 im_context_clone(im_context_t ctx, const char *where) {
   im_context_t nctx = malloc(sizeof(im_context_struct));
+  i_img_pool_stats pool_stats;
   int i;
 
   if (!nctx)
@@ -181,6 +193,15 @@ im_context_clone(im_context_t ctx, const char *where) {
   nctx->max_height = ctx->max_height;
   nctx->max_bytes = ctx->max_bytes;
 
+  nctx->threads = ctx->threads;
+  nctx->pool = NULL;
+
+  /* the new context gets its own pool with the same limit */
+  nctx->img_pool = NULL;
+  im_get_image_pool_stats(ctx, &pool_stats);
+  if (pool_stats.max_bytes)
+    im_set_image_pool(nctx, pool_stats.max_bytes);
+
   nctx->refcount = 1;
 
 #ifdef IMAGER_TRACE_CONTEXT
@@ -287,3 +308,161 @@ im_context_slot_get(im_context_t ctx, im_slot_t slot) {
 
   return ctx->slots[slot];
 }
+
+/*
+=item im_set_threads(ctx, threads)
+X<im_set_threads API>X<i_set_threads API>
+=section Context objects
+=synopsis im_set_threads(aIMCTX, 4);
+=synopsis i_set_threads(4);
+
+Set the number of threads, including the calling thread, that
+filters that support it may use to process an image.
+
+The default is 1, which processes images entirely in the calling
+thread.  Results are the same for any number of threads.
+
+Worker threads are only supported with POSIX threads, elsewhere
+this is accepted but ignored.
+
+Returns non-zero on success.
+
+Also callable as C<i_set_threads(threads)>.
+
+=cut
+*/
+
+int
+im_set_threads(im_context_t ctx, int threads) {
+  im_clear_error(ctx);
+
+  if (threads < 1 || threads > IM_MAX_THREADS) {
+    im_push_errorf(ctx, 0, "threads must be from 1 to %d", IM_MAX_THREADS);
+    return 0;
+  }
+
+  if (threads != ctx->threads && ctx->pool) {
+    i_int_pool_destroy(ctx->pool);
+    ctx->pool = NULL;
+  }
+  ctx->threads = threads;
+
+  return 1;
+}
+
+/*
+=item im_get_threads(ctx)
+X<im_get_threads API>X<i_get_threads API>
+=section Context objects
+=synopsis int threads = im_get_threads(aIMCTX);
+=synopsis int threads = i_get_threads();
+
+Retrieve the number of threads set by im_set_threads().
+
+Also callable as C<i_get_threads()>.
+
+=cut
+*/
+
+int
+im_get_threads(im_context_t ctx) {
+  return ctx->threads;
+}
+
+/*
+=item i_int_run_bands(src, dest, count, min_band, f, p)
+
+Split C<count> rows into bands of at least C<min_band> rows and call:
+
+  f(p, start, end)
+
+for each band, where C<start> is the first row of the band and C<end>
+is one past the last.
+
+If more than one thread is configured for the context of C<dest>, and
+both C<src> and C<dest> can be accessed from several threads at once,
+the bands are processed in parallel.  C<f> must only write to the
+rows of the band it was called for, must produce the same result
+however the rows are split, and must not use the context for errors
+or logging.  Use i_int_band_malloc() and i_int_band_free() instead
+of mymalloc() and myfree() in C<f>.  C<src> may be NULL if only
+C<dest> is accessed.
+
+Bands can't be nested, C<f> must not call i_int_run_bands().
+
+=cut
+*/
+
+/* direct images store their own samples, so different rows can be
+   accessed from different threads, palette images may be converted
+   to direct images when written to */
+#define img_threadsafe(im) ((im)->type == i_direct_type && !(im)->virtual)
+
+void
+i_int_run_bands(i_img *src, i_img *dest, i_img_dim count, i_img_dim min_band,
+		i_int_band_f f, void *p) {
+  im_context_t ctx = dest->context;
+  i_img_dim band_size;
+
+  if (count <= 0)
+    return;
+
+#ifdef IMAGER_DEBUG_MALLOC
+  /* the debug malloc isn't thread safe */
+  f(p, 0, count);
+  return;
+#endif
+
+  if (ctx->threads < 2 || count < min_band * 2
+      || (src && !img_threadsafe(src)) || !img_threadsafe(dest)) {
+    f(p, 0, count);
+    return;
+  }
+
+  if (!ctx->pool) {
+    ctx->pool = i_int_pool_new(ctx->threads);
+    if (!ctx->pool) {
+      f(p, 0, count);
+      return;
+    }
+  }
+
+  /* a few bands per thread so a slow band doesn't hold up the rest */
+  band_size = (count + ctx->threads * 4 - 1) / (ctx->threads * 4);
+  if (band_size < min_band)
+    band_size = min_band;
+
+  i_int_pool_run(ctx->pool, count, band_size, f, p);
+}
+
+/*
+=item i_int_band_malloc(size)
+
+=item i_int_band_free(p)
+
+Allocate and release memory in band functions called by
+i_int_run_bands().  Unlike mymalloc() these don't log, so are safe
+to call from worker threads.
+
+Like mymalloc(), i_int_band_malloc() aborts the process if the memory
+isn't available.
+
+=cut
+*/
+
+void *
+i_int_band_malloc(size_t size) {
+  void *p = malloc(size);
+
+  if (!p) {
+    fprintf(stderr, "Unable to malloc %ld.\n", (long)size);
+    exit(3);
+  }
+
+  return p;
+}
+
+void
+i_int_band_free(void *p) {
+  free(p);
+}
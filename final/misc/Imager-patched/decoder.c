@@ -0,0 +1,258 @@
+#include "imageri.h"
+
+/*
+=head1 NAME
+
+decoder.c - incremental image decoders
+
+=head1 SYNOPSIS
+
+  static int
+  got_header(void *p, const i_image_info *info) {
+    ... info->width, info->height, info->channels ...
+    return 1;
+  }
+
+  static int
+  got_row(void *p, i_img_dim y, const i_color *row) {
+    ... process the row ...
+    return 1;
+  }
+
+  i_decoder *dec = ... a file format module's constructor ...;
+  i_decoder_set_callbacks(dec, got_header, got_row, p);
+  while (... more data ...) {
+    if (!i_decoder_feed(dec, data, size))
+      ... error ...
+  }
+  if (!i_decoder_finish(dec))
+    ... error ...
+  i_decoder_destroy(dec);
+
+=head1 DESCRIPTION
+
+The readers in the file format modules pull data from an io_glue and
+return the image once it's complete.  An incremental decoder instead
+accepts the file data as it arrives, such as from a network upload,
+and passes each row to a callback as soon as it's decoded, so
+processing can start before the data is complete and the full image
+need never be held in memory.
+
+Rows are always passed as 8-bit samples.
+
+The decoders themselves are implemented by the file format modules,
+this is the common interface.
+
+=over
+
+=cut
+*/
+
+/*
+=item i_decoder_set_callbacks(dec, header, row, p)
+=category Incremental decoding
+=synopsis i_decoder_set_callbacks(dec, got_header, got_row, p);
+
+Set the functions called when the image header is decoded and for
+each row of the image.  C<p> is passed as the first parameter of each.
+
+Either callback can return zero to stop decoding, pushing an error
+message first.
+
+=cut
+*/
+
+void
+i_decoder_set_callbacks(i_decoder *dec, i_decode_header_f header,
+			i_decode_row_f row, void *p) {
+  dec->header_cb = header;
+  dec->row_cb = row;
+  dec->cb_data = p;
+}
+
+/*
+=item i_decoder_feed(dec, data, size)
+=category Incremental decoding
+=synopsis if (!i_decoder_feed(dec, data, size)) { ... error ... }
+
+Supply the next C<size> bytes of the image file to the decoder.  The
+callbacks are called for whatever can be decoded from the data so
+far.
+
+Returns non-zero on success.  Once this fails the decoder can't be
+used further.
+
+=cut
+*/
+
+int
+i_decoder_feed(i_decoder *dec, const void *data, size_t size) {
+  i_clear_error();
+
+  if (dec->failed) {
+    i_push_error(0, "decoder has already failed");
+    return 0;
+  }
+  if (dec->finished) {
+    i_push_error(0, "decoder is finished");
+    return 0;
+  }
+  if (!size)
+    return 1;
+
+  if (!dec->f_feed(dec, data, size)) {
+    dec->failed = 1;
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+=item i_decoder_finish(dec)
+=category Incremental decoding
+=synopsis if (!i_decoder_finish(dec)) { ... error ... }
+
+Tell the decoder there's no more data.
+
+Returns non-zero if a complete image was decoded.
+
+=cut
+*/
+
+int
+i_decoder_finish(i_decoder *dec) {
+  i_clear_error();
+
+  if (dec->failed) {
+    i_push_error(0, "decoder has already failed");
+    return 0;
+  }
+  if (dec->finished) {
+    i_push_error(0, "decoder is finished");
+    return 0;
+  }
+  dec->finished = 1;
+
+  if (!dec->f_finish(dec)) {
+    dec->failed = 1;
+    return 0;
+  }
+  if (!dec->have_header || dec->rows < dec->info.height) {
+    i_push_error(0, "image data incomplete");
+    dec->failed = 1;
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+=item i_decoder_destroy(dec)
+=category Incremental decoding
+=synopsis i_decoder_destroy(dec);
+
+Release the decoder.
+
+=cut
+*/
+
+void
+i_decoder_destroy(i_decoder *dec) {
+  dec->f_destroy(dec);
+}
+
+/*
+=item i_decoder_check_limits(dec, width, height, channels, whole)
+=category Incremental decoding
+=synopsis if (!i_decoder_check_limits(dec, width, height, channels, 0)) { ... error ... }
+
+Called by a file format module's decoder before allocating its
+buffers, to check the image against the limits set by
+i_set_image_file_limits().
+
+If the consumer only keeps a row at a time, such as i_scale_stream(),
+the image height doesn't use memory, so only a single row is checked,
+unless C<whole> is non-zero because the decoder itself holds the
+whole image, as for an interlaced PNG.
+
+Returns non-zero if the image is within the limits.
+
+=cut
+*/
+
+int
+i_decoder_check_limits(i_decoder *dec, i_img_dim width, i_img_dim height,
+		       int channels, int whole) {
+  if (dec->rows_only && !whole)
+    height = 1;
+
+  return i_int_check_image_file_limits(width, height, channels,
+				       sizeof(i_sample_t));
+}
+
+/*
+=item i_decoder_header(dec, info)
+=category Incremental decoding
+=synopsis if (!i_decoder_header(dec, &info)) { ... stop ... }
+
+Called by a file format module's decoder once the image size is
+known.  C<info> describes the rows that will be passed to
+i_decoder_row(), so C<channels> is the number of channels in each
+row.
+
+Returns zero if the header callback asked for decoding to stop.
+
+=cut
+*/
+
+int
+i_decoder_header(i_decoder *dec, const i_image_info *info) {
+  dec->info = *info;
+  dec->have_header = 1;
+
+  if (dec->header_cb && !dec->header_cb(dec->cb_data, info)) {
+    if (!i_errors()[0].msg)
+      i_push_error(0, "decoding stopped by the header callback");
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+=item i_decoder_row(dec, y, row)
+=category Incremental decoding
+=synopsis if (!i_decoder_row(dec, y, row)) { ... stop ... }
+
+Called by a file format module's decoder for each decoded row, from
+top to bottom.  C<row> has C<width> pixels with C<channels> channels
+as supplied to i_decoder_header().
+
+Returns zero if the row callback asked for decoding to stop.
+
+=cut
+*/
+
+int
+i_decoder_row(i_decoder *dec, i_img_dim y, const i_color *row) {
+  ++dec->rows;
+
+  if (dec->row_cb && !dec->row_cb(dec->cb_data, y, row)) {
+    if (!i_errors()[0].msg)
+      i_push_error(0, "decoding stopped by the row callback");
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+=back
+
+=head1 SEE ALSO
+
+Imager::Decoder, imjpeg.c, impng.c
+
+=cut
+*/
@@ -0,0 +1,127 @@
+#include "imageri.h"
+#include "imsimd.h"
+
+/*
+=head1 NAME
+
+diffsimd.c - vectorized pixel difference counting for 8-bit images
+
+=head1 SYNOPSIS
+
+  i_int_diff_count_row_f count_row = i_int_diff_simd_count_row();
+  if (count_row)
+    diffs += count_row(row1, row2, width, channels, mindist);
+
+=head1 DESCRIPTION
+
+Counts the pixels in a row of 8-bit samples where any sample differs
+from the corresponding sample in the other row by more than mindist,
+for i_diff_image_pixels().
+
+16 pixels are compared at a time, the per-byte results are collected
+into a bit mask of up to 64 bits, the bits for the channels of each
+pixel are folded onto the bit for its first channel and those bits
+counted.
+
+=over
+
+=cut
+*/
+
+#ifdef IM_SIMD_HAVE_SSE2
+
+#include <emmintrin.h>
+
+/* the bit for the first sample of each of 16 pixels, by channel count */
+static const unsigned long long pixel_starts[MAXCHANNELS + 1] =
+  {
+    0,
+    0xFFFFULL,
+    0x55555555ULL,
+    0x249249249249ULL,
+    0x1111111111111111ULL
+  };
+
+static i_img_dim
+diff_count_row_sse2(const i_sample_t *a, const i_sample_t *b,
+		    i_img_dim width, int channels, int mindist) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i dist = _mm_set1_epi8((char)mindist);
+  unsigned long long starts = pixel_starts[channels];
+  i_img_dim count = 0;
+  i_img_dim x = 0;
+  int ch;
+
+  for (; x + 16 <= width; x += 16) {
+    unsigned long long mask = 0;
+    unsigned long long pixels;
+
+    for (ch = 0; ch < channels; ++ch) {
+      __m128i va = _mm_loadu_si128((const __m128i *)a + ch);
+      __m128i vb = _mm_loadu_si128((const __m128i *)b + ch);
+      /* |a - b| - mindist with unsigned saturation is non-zero
+	 exactly when the samples differ by more than mindist */
+      __m128i over = _mm_subs_epu8
+	(_mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va)), dist);
+      unsigned same = _mm_movemask_epi8(_mm_cmpeq_epi8(over, zero));
+      mask |= (unsigned long long)(~same & 0xFFFF) << (16 * ch);
+    }
+    if (mask) {
+      pixels = mask;
+      for (ch = 1; ch < channels; ++ch)
+	pixels |= mask >> ch;
+      count += __builtin_popcountll(pixels & starts);
+    }
+    a += 16 * channels;
+    b += 16 * channels;
+  }
+
+  for (; x < width; ++x) {
+    for (ch = 0; ch < channels; ++ch) {
+      if (abs(a[ch] - b[ch]) > mindist) {
+	++count;
+	break;
+      }
+    }
+    a += channels;
+    b += channels;
+  }
+
+  return count;
+}
+
+/*
+=item i_int_diff_simd_count_row()
+
+Returns the vectorized row difference counter for the best
+instruction set the CPU supports, or NULL if there is none.
+
+=cut
+*/
+
+i_int_diff_count_row_f
+i_int_diff_simd_count_row(void) {
+  if (!(i_simd_features() & IM_SIMD_SSE2))
+    return NULL;
+
+  return diff_count_row_sse2;
+}
+
+#else
+
+i_int_diff_count_row_f
+i_int_diff_simd_count_row(void) {
+  return NULL;
+}
+
+#endif
+
+/*
+=back
+
+=head1 SEE ALSO
+
+filters.im, simd.c
+
+=cut
+*/
@@ -79,6 +79,9 @@ i_ppix_norm(i_img *im, i_img_dim x, i_img_dim y, i_color const *col) {
 static void
 cfill_from_btm(i_img *im, i_fill_t *fill, struct i_bitmap *btm, 
 	       i_img_dim bxmin, i_img_dim bxmax, i_img_dim bymin, i_img_dim bymax);
+static void
+fill_from_btm(i_img *im, const i_color *col, struct i_bitmap *btm,
+	      i_img_dim bxmin, i_img_dim bxmax, i_img_dim bymin, i_img_dim bymax);
 
 void
 i_mmarray_cr(i_mmarray *ar,i_img_dim l) {
@@ -1148,6 +1151,24 @@ i_box_filled(i_img *im,i_img_dim x1,i_img_dim y1,i_img_dim x2,i_img_dim y2, cons
 
     myfree(line);
   }
+  else if (i_img_8_row(im, y1, NULL)) {
+    /* fill the top row of the box, then copy it to the others */
+    size_t stride;
+    i_sample_t *first = i_img_8_row(im, y1, &stride) + x1 * im->channels;
+    i_sample_t *p = first;
+    size_t row_bytes = width * im->channels;
+    int ch;
+
+    for (x = 0; x < width; ++x) {
+      for (ch = 0; ch < im->channels; ++ch)
+	*p++ = val->channel[ch];
+    }
+    p = first;
+    for (y = y1 + 1; y <= y2; ++y) {
+      p += stride;
+      memcpy(p, first, row_bytes);
+    }
+  }
   else {
     i_color *line = mymalloc(sizeof(i_color) * width);
 
@@ -1658,12 +1679,28 @@ i_ccomp_border(i_color const *val1, i_color const *val2, int ch) {
   return 0;
 }
 
+/* fetch a pixel for the comparisons, row is from i_img_8_row() */
+static void
+ff_gpix(i_img *im, const i_sample_t *row, i_img_dim x, i_img_dim y,
+	i_color *val) {
+  if (row) {
+    int ch;
+    row += x * im->channels;
+    for (ch = 0; ch < im->channels; ++ch)
+      val->channel[ch] = row[ch];
+  }
+  else {
+    i_gpix(im, x, y, val);
+  }
+}
+
 static int
 i_lspan(i_img *im, i_img_dim seedx, i_img_dim seedy, i_color const *val, ff_cmpfunc cmpfunc) {
   i_color cval;
+  const i_sample_t *row = i_img_8_row(im, seedy, NULL);
   while(1) {
     if (seedx-1 < 0) break;
-    i_gpix(im,seedx-1,seedy,&cval);
+    ff_gpix(im,row,seedx-1,seedy,&cval);
     if (!cmpfunc(val,&cval,im->channels)) 
       break;
     seedx--;
@@ -1674,9 +1711,10 @@ i_lspan(i_img *im, i_img_dim seedx, i_img_dim seedy, i_color const *val, ff_cmpf
 static int
 i_rspan(i_img *im, i_img_dim seedx, i_img_dim seedy, i_color const *val, ff_cmpfunc cmpfunc) {
   i_color cval;
+  const i_sample_t *row = i_img_8_row(im, seedy, NULL);
   while(1) {
     if (seedx+1 > im->xsize-1) break;
-    i_gpix(im,seedx+1,seedy,&cval);
+    ff_gpix(im,row,seedx+1,seedy,&cval);
     if (!cmpfunc(val,&cval,im->channels)) break;
     seedx++;
   }
@@ -1717,7 +1755,7 @@ i_rspan(i_img *im, i_img_dim seedx, i_img_dim seedy, i_color const *val, ff_cmpf
 #define SET(x,y) btm_set(btm,x,y)
 
 /* INSIDE returns true if pixel is correct color and we haven't set it before. */
-#define INSIDE(x,y, seed) ((!btm_test(btm,x,y) && ( i_gpix(im,x,y,&cval),cmpfunc(seed,&cval,channels)  ) ))
+#define INSIDE(x,y, seed) ((!btm_test(btm,x,y) && ( ff_gpix(im,row,x,y,&cval),cmpfunc(seed,&cval,channels)  ) ))
 
 
 
@@ -1768,11 +1806,13 @@ i_flood_fill_low(i_img *im,i_img_dim seedx,i_img_dim seedy,
 
     i_img_dim x;
     int wasIn=0;
+    const i_sample_t *row;
 
     ST_POP(); /* sets lx, rx, dadLx, dadRx, y, direction */
 
 
     if (y<0 || y>ysize-1) continue;
+    row = i_img_8_row(im, y, NULL);
     if (bymin > y) bymin=y; /* in the worst case an extra line */
     if (bymax < y) bymax=y; 
 
@@ -1852,7 +1892,6 @@ undef_int
 i_flood_fill(i_img *im, i_img_dim seedx, i_img_dim seedy, const i_color *dcol) {
   i_img_dim bxmin, bxmax, bymin, bymax;
   struct i_bitmap *btm;
-  i_img_dim x, y;
   i_color val;
   dIMCTXim(im);
 
@@ -1872,10 +1911,7 @@ i_flood_fill(i_img *im, i_img_dim seedx, i_img_dim seedy, const i_color *dcol) {
   btm = i_flood_fill_low(im, seedx, seedy, &bxmin, &bxmax, &bymin, &bymax,
 			 &val, i_ccomp_normal);
 
-  for(y=bymin;y<=bymax;y++)
-    for(x=bxmin;x<=bxmax;x++)
-      if (btm_test(btm,x,y)) 
-	i_ppix(im,x,y,dcol);
+  fill_from_btm(im, dcol, btm, bxmin, bxmax, bymin, bymax);
   btm_destroy(btm);
   return 1;
 }
@@ -1944,7 +1980,6 @@ i_flood_fill_border(i_img *im, i_img_dim seedx, i_img_dim seedy, const i_color *
 		    const i_color *border) {
   i_img_dim bxmin, bxmax, bymin, bymax;
   struct i_bitmap *btm;
-  i_img_dim x, y;
   dIMCTXim(im);
 
   im_log((aIMCTX, 1, "i_flood_cfill(im %p, seed(" i_DFp "), dcol %p, border %p)",
@@ -1960,10 +1995,7 @@ i_flood_fill_border(i_img *im, i_img_dim seedx, i_img_dim seedy, const i_color *
   btm = i_flood_fill_low(im, seedx, seedy, &bxmin, &bxmax, &bymin, &bymax,
 			 border, i_ccomp_border);
 
-  for(y=bymin;y<=bymax;y++)
-    for(x=bxmin;x<=bxmax;x++)
-      if (btm_test(btm,x,y)) 
-	i_ppix(im,x,y,dcol);
+  fill_from_btm(im, dcol, btm, bxmin, bxmax, bymin, bymax);
   btm_destroy(btm);
   return 1;
 }
@@ -2039,6 +2071,38 @@ cfill_from_btm(i_img *im, i_fill_t *fill, struct i_bitmap *btm,
   i_render_done(&r);
 }
 
+static void
+fill_from_btm(i_img *im, const i_color *col, struct i_bitmap *btm,
+	      i_img_dim bxmin, i_img_dim bxmax, i_img_dim bymin, i_img_dim bymax) {
+  i_img_dim x, y;
+  int ch;
+
+  /* the span search can leave the bounds one past the image */
+  if (bxmin < 0)
+    bxmin = 0;
+  if (bxmax > im->xsize - 1)
+    bxmax = im->xsize - 1;
+
+  for(y=bymin;y<=bymax;y++) {
+    i_sample_t *row = i_img_8_row(im, y, NULL);
+    if (row) {
+      i_sample_t *p = row + bxmin * im->channels;
+      for(x=bxmin;x<=bxmax;x++) {
+	if (btm_test(btm,x,y)) {
+	  for (ch = 0; ch < im->channels; ++ch)
+	    p[ch] = col->channel[ch];
+	}
+	p += im->channels;
+      }
+    }
+    else {
+      for(x=bxmin;x<=bxmax;x++)
+	if (btm_test(btm,x,y)) 
+	  i_ppix(im,x,y,col);
+    }
+  }
+}
+
 /*
 =back
 
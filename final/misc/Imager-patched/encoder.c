@@ -0,0 +1,184 @@
+#include "imageri.h"
+
+/*
+=head1 NAME
+
+encoder.c - incremental image encoders
+
+=head1 SYNOPSIS
+
+  i_encoder *enc = ... a file format module's constructor ...;
+  if (!i_encoder_start(enc, width, height, channels))
+    ... error ...
+  for (y = 0; y < height; ++y) {
+    ... fill row ...
+    if (!i_encoder_row(enc, row))
+      ... error ...
+  }
+  if (!i_encoder_finish(enc))
+    ... error ...
+  i_encoder_destroy(enc);
+
+=head1 DESCRIPTION
+
+The writers in the file format modules take a complete image.  An
+incremental encoder instead accepts the rows one at a time and writes
+the file as it goes, so the image need never be held in memory.
+
+Rows are always supplied as 8-bit samples.
+
+The encoders themselves are implemented by the file format modules,
+this is the common interface.
+
+=over
+
+=cut
+*/
+
+/*
+=item i_encoder_start(enc, width, height, channels)
+=category Incremental encoding
+=synopsis if (!i_encoder_start(enc, width, height, channels)) { ... error ... }
+
+Start writing an image of the given size, with C<channels> channels
+in each row.
+
+Returns non-zero on success.
+
+=cut
+*/
+
+int
+i_encoder_start(i_encoder *enc, i_img_dim width, i_img_dim height,
+		int channels) {
+  if (enc->failed) {
+    i_push_error(0, "encoder has already failed");
+    return 0;
+  }
+  if (enc->started) {
+    i_push_error(0, "encoder already started");
+    return 0;
+  }
+  if (width <= 0 || height <= 0) {
+    i_push_error(0, "image size must be positive");
+    enc->failed = 1;
+    return 0;
+  }
+  if (channels < 1 || channels > MAXCHANNELS) {
+    i_push_errorf(0, "channels must be between 1 and %d", MAXCHANNELS);
+    enc->failed = 1;
+    return 0;
+  }
+
+  enc->width = width;
+  enc->height = height;
+  enc->channels = channels;
+  enc->started = 1;
+
+  if (!enc->f_start(enc, width, height, channels)) {
+    enc->failed = 1;
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+=item i_encoder_row(enc, row)
+=category Incremental encoding
+=synopsis if (!i_encoder_row(enc, row)) { ... error ... }
+
+Write the next row of the image, C<width> pixels with C<channels>
+channels, as supplied to i_encoder_start().
+
+Returns non-zero on success.
+
+=cut
+*/
+
+int
+i_encoder_row(i_encoder *enc, const i_color *row) {
+  if (enc->failed) {
+    i_push_error(0, "encoder has already failed");
+    return 0;
+  }
+  if (!enc->started || enc->finished) {
+    i_push_error(0, "encoder isn't started");
+    return 0;
+  }
+  if (enc->rows >= enc->height) {
+    i_push_error(0, "too many rows written");
+    enc->failed = 1;
+    return 0;
+  }
+
+  if (!enc->f_row(enc, row)) {
+    enc->failed = 1;
+    return 0;
+  }
+  ++enc->rows;
+
+  return 1;
+}
+
+/*
+=item i_encoder_finish(enc)
+=category Incremental encoding
+=synopsis if (!i_encoder_finish(enc)) { ... error ... }
+
+Complete the file once every row has been written.
+
+Returns non-zero on success.
+
+=cut
+*/
+
+int
+i_encoder_finish(i_encoder *enc) {
+  if (enc->failed) {
+    i_push_error(0, "encoder has already failed");
+    return 0;
+  }
+  if (!enc->started || enc->finished) {
+    i_push_error(0, "encoder isn't started");
+    return 0;
+  }
+  if (enc->rows < enc->height) {
+    i_push_error(0, "not all rows were written");
+    enc->failed = 1;
+    return 0;
+  }
+
+  enc->finished = 1;
+  if (!enc->f_finish(enc)) {
+    enc->failed = 1;
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+=item i_encoder_destroy(enc)
+=category Incremental encoding
+=synopsis i_encoder_destroy(enc);
+
+Release the encoder.
+
+=cut
+*/
+
+void
+i_encoder_destroy(i_encoder *enc) {
+  enc->f_destroy(enc);
+}
+
+/*
+=back
+
+=head1 SEE ALSO
+
+decoder.c, scalerows.c, imjpeg.c, impng.c
+
+=cut
+*/
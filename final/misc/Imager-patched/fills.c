@@ -843,13 +843,14 @@ fill_image(i_fill_t *fill, i_img_dim x, i_img_dim y, i_img_dim width,
     }
   }
   else {
-    /* the easy way */
-    /* this should be possible to optimize to use i_glin() */
+    /* the easy way, copy runs up to the right edge of each tile */
     while (i < width) {
       i_img_dim rx = x+i;
       i_img_dim ry = y;
       i_img_dim ix = rx / f->src->xsize;
       i_img_dim iy = ry / f->src->ysize;
+      i_img_dim run;
+      const i_sample_t *row;
 
       if (f->xoff) {
         rx += iy * f->xoff;
@@ -861,9 +862,28 @@ fill_image(i_fill_t *fill, i_img_dim x, i_img_dim y, i_img_dim width,
       }
       rx -= ix * f->src->xsize;
       ry -= iy * f->src->ysize;
-      i_gpix(f->src, rx, ry, out);
-      ++out;
-      ++i;
+
+      run = f->src->xsize - rx;
+      if (run > width - i)
+        run = width - i;
+      if (rx < 0 || ry < 0)
+        run = 1; /* leave it to i_glin() to reject */
+
+      row = i_img_8_row(f->src, ry, NULL);
+      if (row && rx >= 0) {
+        i_img_dim j;
+        int ch;
+        row += rx * f->src->channels;
+        for (j = 0; j < run; ++j) {
+          for (ch = 0; ch < f->src->channels; ++ch)
+            out[j].channel[ch] = *row++;
+        }
+      }
+      else {
+        i_glin(f->src, rx, rx + run, ry, out);
+      }
+      out += run;
+      i += run;
     }
   }
   if (f->src->channels != want_channels)
@@ -78,7 +78,7 @@ object.
 
 i_img *
 im_img_alloc(pIMCTX) {
-  return mymalloc(sizeof(i_img));
+  return i_int_img_struct_alloc(aIMCTX);
 }
 
 /*
@@ -264,7 +264,7 @@ i_img_exorcise(i_img *im) {
   i_tags_destroy(&im->tags);
   if (im->i_f_destroy)
     (im->i_f_destroy)(im);
-  if (im->idata != NULL) { myfree(im->idata); }
+  if (im->idata != NULL) { i_int_img_data_free(aIMCTX, im->idata); }
   im->idata    = NULL;
   im->xsize    = 0;
   im->ysize    = 0;
@@ -289,7 +289,7 @@ i_img_destroy(i_img *im) {
   dIMCTXim(im);
   im_log((aIMCTX, 1,"i_img_destroy(im %p)\n",im));
   i_img_exorcise(im);
-  if (im) { myfree(im); }
+  if (im) { i_int_img_struct_free(aIMCTX, im); }
   im_context_refdec(aIMCTX, "img_destroy");
 }
 
@@ -538,23 +538,146 @@ Lanczos(float x) {
 Returns a new image object which is I<im> scaled by I<value> along
 wither the x-axis (I<axis> == 0) or the y-axis (I<axis> == 1).
 
+The Lanczos weights for each output position are calculated once up
+front, and source pixels are fetched a row at a time with i_glin().
+For the y-axis a window of the most recently read source rows is kept
+so each source row is only fetched once.
+
 =cut
 */
 
+/* Lanczos taps for a single output position along the scaled axis */
+typedef struct {
+  /* first lMax weights are l1[], the second lMax are l0[] reversed,
+     so weights[l] and weights[lMax+l] pair with the taps at
+     Mx[l] and mx[l] */
+  float *weights;
+  i_img_dim *Mx;
+  i_img_dim *mx;
+} i_lanczos_taps;
+
+static void
+scaleaxis_taps(i_lanczos_taps *taps, i_img_dim jEnd, i_img_dim lMax,
+	       i_img_dim LanczosWidthFactor, double Value, i_img_dim limit) {
+  i_img_dim j, l;
+  float *l0 = mymalloc(lMax * sizeof(float));
+  float *l1 = mymalloc(lMax * sizeof(float));
+
+  taps->weights = mymalloc(jEnd * lMax * 2 * sizeof(float));
+  taps->Mx = mymalloc(jEnd * lMax * sizeof(i_img_dim));
+  taps->mx = mymalloc(jEnd * lMax * sizeof(i_img_dim));
+
+  for (j=0; j<jEnd; j++) {
+    double OldLocation = ((double) j) / Value;
+    i_img_dim T = (i_img_dim) (OldLocation);
+    float F = OldLocation - T;
+    double t;
+    float *w = taps->weights + j * lMax * 2;
+    i_img_dim *Mx = taps->Mx + j * lMax;
+    i_img_dim *mx = taps->mx + j * lMax;
+    
+    for (l = 0; l<lMax; l++) {
+      l0[lMax-l-1] = Lanczos(((float) (lMax-l-1) + F) / (float) LanczosWidthFactor);
+      l1[l]        = Lanczos(((float) (l+1)      - F) / (float) LanczosWidthFactor);
+    }
+    
+    /* Make sure filter is normalized */
+    t = 0.0;
+    for(l=0; l<lMax; l++) {
+      t+=l0[l];
+      t+=l1[l];
+    }
+    t /= (double)LanczosWidthFactor;
+    
+    for(l=0; l<lMax; l++) {
+      l0[l] /= t;
+      l1[l] /= t;
+    }
+
+    for (l = 0; l < lMax; ++l) {
+      i_img_dim lo = T-lMax+l+1;
+      i_img_dim hi = T+l+1;
+      w[l] = l1[l];
+      w[lMax+l] = l0[lMax-l-1];
+      mx[l] = (lo < 0) ? 0 : lo;
+      Mx[l] = (hi >= limit) ? limit-1 : hi;
+    }
+  }
+
+  myfree(l0);
+  myfree(l1);
+}
+
+static void
+scaleaxis_taps_free(i_lanczos_taps *taps) {
+  myfree(taps->weights);
+  myfree(taps->Mx);
+  myfree(taps->mx);
+}
+
+/* add a single tap pair to the accumulator for one pixel */
+#define SCALEAXIS_ACCUM(pv, w1, w0, val1, val2)	\
+  do {									\
+    if (has_alpha) {							\
+      i_sample_t alpha1 = (val1)->channel[color_chans];			\
+      i_sample_t alpha2 = (val2)->channel[color_chans];			\
+      for (k=0; k < color_chans; k++) {					\
+	(pv)[k] += (w1) * (val1)->channel[k] * alpha1 / 255;		\
+	(pv)[k] += (w0) * (val2)->channel[k] * alpha2 / 255;		\
+      }									\
+      (pv)[color_chans] += (w1) * (val1)->channel[color_chans];		\
+      (pv)[color_chans] += (w0) * (val2)->channel[color_chans];		\
+    }									\
+    else {								\
+      for (k=0; k<channels; k++) {					\
+	(pv)[k] += (w1) * (val1)->channel[k];				\
+	(pv)[k] += (w0) * (val2)->channel[k];				\
+      }									\
+    }									\
+  } while (0)
+
+static void
+scaleaxis_store(i_color *val, const float *PictureValue, int channels,
+		int has_alpha, i_img_dim LanczosWidthFactor) {
+  int color_chans = has_alpha ? channels - 1 : channels;
+  short psave;
+  int k;
+
+  if (has_alpha) {
+    float fa = PictureValue[color_chans] / LanczosWidthFactor;
+    int alpha = minmax(0, 255, fa+0.5);
+    if (alpha) {
+      for (k = 0; k < color_chans; ++k) {
+	psave = (short)(0.5+(PictureValue[k] / LanczosWidthFactor * 255 / fa));
+	val->channel[k]=minmax(0,255,psave);
+      }
+      val->channel[color_chans] = alpha;
+    }
+    else {
+      /* zero alpha, so the pixel has no color */
+      for (k = 0; k < channels; ++k)
+	val->channel[k] = 0;
+    }
+  }
+  else {
+    for(k=0;k<channels;k++) {
+      psave = (short)(0.5+(PictureValue[k] / LanczosWidthFactor));
+      val->channel[k]=minmax(0,255,psave);
+    }
+  }
+}
+
 i_img*
 i_scaleaxis(i_img *im, double Value, int Axis) {
-  i_img_dim hsize, vsize, i, j, k, l, lMax, iEnd, jEnd;
+  i_img_dim hsize, vsize, i, j, l, lMax, iEnd, jEnd;
   i_img_dim LanczosWidthFactor;
-  float *l0, *l1;
-  double OldLocation;
-  i_img_dim T; 
-  double t;
-  float F, PictureValue[MAXCHANNELS];
-  short psave;
-  i_color val,val1,val2;
+  i_lanczos_taps taps;
   i_img *new_img;
+  i_color *out_row;
   int has_alpha = i_img_has_alpha(im);
   int color_chans = i_img_color_channels(im);
+  int channels = im->channels;
+  int k;
   dIMCTXim(im);
 
   i_clear_error();
@@ -592,146 +715,101 @@ i_scaleaxis(i_img *im, double Value, int Axis) {
   /* 1.4 is a magic number, setting it to 2 will cause rather blurred images */
   LanczosWidthFactor = (Value >= 1) ? 1 : (i_img_dim) (1.4/Value); 
   lMax = LanczosWidthFactor << 1;
-  
-  l0 = mymalloc(lMax * sizeof(float));
-  l1 = mymalloc(lMax * sizeof(float));
-  
-  for (j=0; j<jEnd; j++) {
-    OldLocation = ((double) j) / Value;
-    T = (i_img_dim) (OldLocation);
-    F = OldLocation - T;
-    
-    for (l = 0; l<lMax; l++) {
-      l0[lMax-l-1] = Lanczos(((float) (lMax-l-1) + F) / (float) LanczosWidthFactor);
-      l1[l]        = Lanczos(((float) (l+1)      - F) / (float) LanczosWidthFactor);
-    }
-    
-    /* Make sure filter is normalized */
-    t = 0.0;
-    for(l=0; l<lMax; l++) {
-      t+=l0[l];
-      t+=l1[l];
-    }
-    t /= (double)LanczosWidthFactor;
-    
-    for(l=0; l<lMax; l++) {
-      l0[l] /= t;
-      l1[l] /= t;
-    }
 
-    if (Axis == XAXIS) {
-      
-      for (i=0; i<iEnd; i++) {
-	for (k=0; k<im->channels; k++) PictureValue[k] = 0.0;
+  scaleaxis_taps(&taps, jEnd, lMax, LanczosWidthFactor, Value,
+		 Axis == XAXIS ? im->xsize : im->ysize);
+
+  out_row = mymalloc(hsize * sizeof(i_color));
+
+  if (Axis == XAXIS) {
+    i_color *in_row = mymalloc(im->xsize * sizeof(i_color));
+
+    for (i=0; i<iEnd; i++) {
+      i_glin(im, 0, im->xsize, i, in_row);
+      for (j=0; j<jEnd; j++) {
+	const float *w = taps.weights + j * lMax * 2;
+	const i_img_dim *Mx = taps.Mx + j * lMax;
+	const i_img_dim *mx = taps.mx + j * lMax;
+	float PictureValue[MAXCHANNELS];
+
+	for (k=0; k<channels; k++) PictureValue[k] = 0.0;
 	for (l=0; l<lMax; l++) {
-	  i_img_dim mx = T-lMax+l+1;
-	  i_img_dim Mx = T+l+1;
-	  mx = (mx < 0) ? 0 : mx;
-	  Mx = (Mx >= im->xsize) ? im->xsize-1 : Mx;
-	  
-	  i_gpix(im, Mx, i, &val1);
-	  i_gpix(im, mx, i, &val2);
-
-	  if (has_alpha) {
-	    i_sample_t alpha1 = val1.channel[color_chans];
-	    i_sample_t alpha2 = val2.channel[color_chans];
-	    for (k=0; k < color_chans; k++) {
-	      PictureValue[k] += l1[l]        * val1.channel[k] * alpha1 / 255;
-	      PictureValue[k] += l0[lMax-l-1] * val2.channel[k] * alpha2 / 255;
-	    }
-	    PictureValue[color_chans] += l1[l] * val1.channel[color_chans];
-	    PictureValue[color_chans] += l0[lMax-l-1] * val2.channel[color_chans];
-	  }
-	  else {
-	    for (k=0; k<im->channels; k++) {
-	      PictureValue[k] += l1[l]        * val1.channel[k];
-	      PictureValue[k] += l0[lMax-l-1] * val2.channel[k];
-	    }
-	  }
+	  SCALEAXIS_ACCUM(PictureValue, w[l], w[lMax+l],
+			  in_row + Mx[l], in_row + mx[l]);
 	}
+	scaleaxis_store(out_row + j, PictureValue, channels, has_alpha,
+			LanczosWidthFactor);
+      }
+      i_plin(new_img, 0, hsize, i, out_row);
+    }
 
-	if (has_alpha) {
-	  float fa = PictureValue[color_chans] / LanczosWidthFactor;
-	  int alpha = minmax(0, 255, fa+0.5);
-	  if (alpha) {
-	    for (k = 0; k < color_chans; ++k) {
-	      psave = (short)(0.5+(PictureValue[k] / LanczosWidthFactor * 255 / fa));
-	      val.channel[k]=minmax(0,255,psave);
-	    }
-	    val.channel[color_chans] = alpha;
-	  }
-	  else {
-	    /* zero alpha, so the pixel has no color */
-	    for (k = 0; k < im->channels; ++k)
-	      val.channel[k] = 0;
-	  }
+    myfree(in_row);
+  }
+  else {
+    /* each output row needs a contiguous span of at most lMax*2
+       source rows, and that span only moves forward, so keep a
+       window of rows indexed by source row modulo the window size */
+    i_img_dim win_size = lMax * 2 < im->ysize ? lMax * 2 : im->ysize;
+    i_color *window = mymalloc(win_size * iEnd * sizeof(i_color));
+    i_img_dim *win_rows = mymalloc(win_size * sizeof(i_img_dim));
+    const i_color **rows1 = mymalloc(lMax * sizeof(i_color *));
+    const i_color **rows0 = mymalloc(lMax * sizeof(i_color *));
+    float *accum = mymalloc(iEnd * MAXCHANNELS * sizeof(float));
+
+    for (l = 0; l < win_size; ++l)
+      win_rows[l] = -1;
+
+    for (j=0; j<jEnd; j++) {
+      const float *w = taps.weights + j * lMax * 2;
+      const i_img_dim *Mx = taps.Mx + j * lMax;
+      const i_img_dim *mx = taps.mx + j * lMax;
+
+      for (l = 0; l < lMax; ++l) {
+	i_img_dim slot1 = Mx[l] % win_size;
+	i_img_dim slot0 = mx[l] % win_size;
+	if (win_rows[slot1] != Mx[l]) {
+	  i_glin(im, 0, iEnd, Mx[l], window + slot1 * iEnd);
+	  win_rows[slot1] = Mx[l];
 	}
-	else {
-	  for(k=0;k<im->channels;k++) {
-	    psave = (short)(0.5+(PictureValue[k] / LanczosWidthFactor));
-	    val.channel[k]=minmax(0,255,psave);
-	  }
+	if (win_rows[slot0] != mx[l]) {
+	  i_glin(im, 0, iEnd, mx[l], window + slot0 * iEnd);
+	  win_rows[slot0] = mx[l];
 	}
-	i_ppix(new_img, j, i, &val);
+	rows1[l] = window + slot1 * iEnd;
+	rows0[l] = window + slot0 * iEnd;
       }
-      
-    } else {
-      
-      for (i=0; i<iEnd; i++) {
-	for (k=0; k<im->channels; k++) PictureValue[k] = 0.0;
-	for (l=0; l < lMax; l++) {
-	  i_img_dim mx = T-lMax+l+1;
-	  i_img_dim Mx = T+l+1;
-	  mx = (mx < 0) ? 0 : mx;
-	  Mx = (Mx >= im->ysize) ? im->ysize-1 : Mx;
-
-	  i_gpix(im, i, Mx, &val1);
-	  i_gpix(im, i, mx, &val2);
-	  if (has_alpha) {
-	    i_sample_t alpha1 = val1.channel[color_chans];
-	    i_sample_t alpha2 = val2.channel[color_chans];
-	    for (k=0; k < color_chans; k++) {
-	      PictureValue[k] += l1[l]        * val1.channel[k] * alpha1 / 255;
-	      PictureValue[k] += l0[lMax-l-1] * val2.channel[k] * alpha2 / 255;
-	    }
-	    PictureValue[color_chans] += l1[l] * val1.channel[color_chans];
-	    PictureValue[color_chans] += l0[lMax-l-1] * val2.channel[color_chans];
-	  }
-	  else {
-	    for (k=0; k<im->channels; k++) {
-	      PictureValue[k] += l1[l]        * val1.channel[k];
-	      PictureValue[k] += l0[lMax-l-1] * val2.channel[k];
-	    }
-	  }
-	}
-	if (has_alpha) {
-	  float fa = PictureValue[color_chans] / LanczosWidthFactor;
-	  int alpha = minmax(0, 255, fa+0.5);
-	  if (alpha) {
-	    for (k = 0; k < color_chans; ++k) {
-	      psave = (short)(0.5+(PictureValue[k] / LanczosWidthFactor * 255 / fa));
-	      val.channel[k]=minmax(0,255,psave);
-	    }
-	    val.channel[color_chans] = alpha;
-	  }
-	  else {
-	    for (k = 0; k < im->channels; ++k)
-	      val.channel[k] = 0;
-	  }
-	}
-	else {
-	  for(k=0;k<im->channels;k++) {
-	    psave = (short)(0.5+(PictureValue[k] / LanczosWidthFactor));
-	    val.channel[k]=minmax(0,255,psave);
-	  }
+
+      for (i = 0; i < iEnd * MAXCHANNELS; ++i)
+	accum[i] = 0.0;
+
+      /* the taps are summed in the same order per pixel as for the
+	 x-axis, but walking along the rows */
+      for (l = 0; l < lMax; ++l) {
+	const i_color *row1 = rows1[l];
+	const i_color *row0 = rows0[l];
+	float w1 = w[l];
+	float w0 = w[lMax+l];
+	for (i = 0; i < iEnd; ++i) {
+	  SCALEAXIS_ACCUM(accum + i * MAXCHANNELS, w1, w0, row1 + i, row0 + i);
 	}
-	i_ppix(new_img, i, j, &val);
       }
-      
+
+      for (i = 0; i < iEnd; ++i) {
+	scaleaxis_store(out_row + i, accum + i * MAXCHANNELS, channels,
+			has_alpha, LanczosWidthFactor);
+      }
+      i_plin(new_img, 0, hsize, j, out_row);
     }
+
+    myfree(window);
+    myfree(win_rows);
+    myfree(rows1);
+    myfree(rows0);
+    myfree(accum);
   }
-  myfree(l0);
-  myfree(l1);
+
+  myfree(out_row);
+  scaleaxis_taps_free(&taps);
 
   im_log((aIMCTX, 1,"(%p) <- i_scaleaxis\n", new_img));
 
@@ -915,6 +993,129 @@ i_transform(i_img *im, int *opx,int opxl,int *opy,int opyl,double parm[],int par
   return new_img;
 }
 
+/* rows per band when comparing images on several threads */
+#define DIFF_BAND 16
+
+/* comparisons only look at the channels common to both images */
+static const int diff_chans[MAXCHANNELS] = { 0, 1, 2, 3 };
+
+typedef struct {
+  i_img *im1, *im2;
+  i_img_dim width;
+  int channels;
+  /* sum of the squared differences for each row */
+  double *row_sums;
+} diff_state;
+
+/* the first channels samples of each pixel of row y */
+static const i_sample_t *
+diff_row_8(i_img *im, i_img_dim y, i_img_dim width, int channels,
+	   i_sample_t *buf) {
+  if (channels == im->channels) {
+    const i_sample_t *row = i_img_8_row(im, y, NULL);
+    if (row)
+      return row;
+  }
+
+  i_gsamp(im, 0, width, y, buf, channels == im->channels ? NULL : diff_chans,
+	  channels);
+
+  return buf;
+}
+
+/* the first channels samples of each pixel of row y as floating point */
+static void
+diff_row_double(i_img *im, i_img_dim y, i_img_dim width, int channels,
+		i_fsample_t *buf) {
+  i_gsampf(im, 0, width, y, buf, channels == im->channels ? NULL : diff_chans,
+	   channels);
+}
+
+static void
+diff_rows_8(void *p, i_img_dim start, i_img_dim end) {
+  diff_state *state = p;
+  size_t count = (size_t)state->width * state->channels;
+  i_sample_t *buf1 = i_int_band_malloc(count);
+  i_sample_t *buf2 = i_int_band_malloc(count);
+  i_img_dim y;
+  size_t i;
+
+  for (y = start; y < end; ++y) {
+    const i_sample_t *row1 = diff_row_8(state->im1, y, state->width,
+					state->channels, buf1);
+    const i_sample_t *row2 = diff_row_8(state->im2, y, state->width,
+					state->channels, buf2);
+    i_img_dim sum = 0;
+    for (i = 0; i < count; ++i) {
+      int sdiff = row1[i] - row2[i];
+      sum += sdiff * sdiff;
+    }
+    state->row_sums[y] = sum;
+  }
+
+  i_int_band_free(buf1);
+  i_int_band_free(buf2);
+}
+
+static void
+diff_rows_double(void *p, i_img_dim start, i_img_dim end) {
+  diff_state *state = p;
+  size_t count = (size_t)state->width * state->channels;
+  i_fsample_t *row1 = i_int_band_malloc(sizeof(i_fsample_t) * count);
+  i_fsample_t *row2 = i_int_band_malloc(sizeof(i_fsample_t) * count);
+  i_img_dim y;
+  size_t i;
+
+  for (y = start; y < end; ++y) {
+    /* separate sums so the additions don't wait on each other */
+    double sums[4] = { 0, 0, 0, 0 };
+    diff_row_double(state->im1, y, state->width, state->channels, row1);
+    diff_row_double(state->im2, y, state->width, state->channels, row2);
+    for (i = 0; i + 4 <= count; i += 4) {
+      double d0 = row1[i] - row2[i];
+      double d1 = row1[i+1] - row2[i+1];
+      double d2 = row1[i+2] - row2[i+2];
+      double d3 = row1[i+3] - row2[i+3];
+      sums[0] += d0 * d0;
+      sums[1] += d1 * d1;
+      sums[2] += d2 * d2;
+      sums[3] += d3 * d3;
+    }
+    for (; i < count; ++i) {
+      double sdiff = row1[i] - row2[i];
+      sums[0] += sdiff * sdiff;
+    }
+    state->row_sums[y] = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+  }
+
+  i_int_band_free(row1);
+  i_int_band_free(row2);
+}
+
+/* sum the squared differences a row at a time, the rows are summed in
+   order so the result doesn't depend on the number of threads */
+static double
+diff_sum(i_img *im1, i_img *im2, i_int_band_f f) {
+  diff_state state;
+  i_img_dim height = i_min(im1->ysize, im2->ysize);
+  double total = 0;
+  i_img_dim y;
+
+  state.im1 = im1;
+  state.im2 = im2;
+  state.width = i_min(im1->xsize, im2->xsize);
+  state.channels = i_min(im1->channels, im2->channels);
+  state.row_sums = mymalloc(sizeof(double) * height);
+
+  i_int_run_bands(im1, im2, height, DIFF_BAND, f, &state);
+
+  for (y = 0; y < height; ++y)
+    total += state.row_sums[y];
+  myfree(state.row_sums);
+
+  return total;
+}
+
 /*
 =item i_img_diff(im1, im2)
 
@@ -925,33 +1126,21 @@ If the images are not the same size then only the common area is
 compared, hence even if images are different sizes this function 
 can return zero.
 
+The images are compared a row at a time, in parallel if threads have
+been set with im_set_threads().
+
 =cut
 */
 
 float
 i_img_diff(i_img *im1,i_img *im2) {
-  i_img_dim x, y, xb, yb;
-  int ch, chb;
-  float tdiff;
-  i_color val1,val2;
+  double tdiff;
   dIMCTXim(im1);
 
   im_log((aIMCTX, 1,"i_img_diff(im1 %p,im2 %p)\n",im1,im2));
 
-  xb=(im1->xsize<im2->xsize)?im1->xsize:im2->xsize;
-  yb=(im1->ysize<im2->ysize)?im1->ysize:im2->ysize;
-  chb=(im1->channels<im2->channels)?im1->channels:im2->channels;
+  tdiff = diff_sum(im1, im2, diff_rows_8);
 
-  im_log((aIMCTX, 1,"i_img_diff: b=(" i_DFp ") chb=%d\n",
-	  i_DFcp(xb,yb), chb));
-
-  tdiff=0;
-  for(y=0;y<yb;y++) for(x=0;x<xb;x++) {
-    i_gpix(im1,x,y,&val1);
-    i_gpix(im2,x,y,&val2);
-
-    for(ch=0;ch<chb;ch++) tdiff+=(val1.channel[ch]-val2.channel[ch])*(val1.channel[ch]-val2.channel[ch]);
-  }
   im_log((aIMCTX, 1,"i_img_diff <- (%.2f)\n",tdiff));
   return tdiff;
 }
@@ -968,46 +1157,152 @@ can return zero.
 
 This is like i_img_diff() but looks at floating point samples instead.
 
+For two 8-bit images the squared differences are summed as integers
+and scaled, which avoids the rounding of summing them as floating
+point.
+
 =cut
 */
 
 double
 i_img_diffd(i_img *im1,i_img *im2) {
-  i_img_dim x, y, xb, yb;
-  int ch, chb;
   double tdiff;
-  i_fcolor val1,val2;
   dIMCTXim(im1);
 
   im_log((aIMCTX, 1,"i_img_diffd(im1 %p,im2 %p)\n",im1,im2));
 
-  xb=(im1->xsize<im2->xsize)?im1->xsize:im2->xsize;
-  yb=(im1->ysize<im2->ysize)?im1->ysize:im2->ysize;
-  chb=(im1->channels<im2->channels)?im1->channels:im2->channels;
+  if (im1->bits == i_8_bits && im2->bits == i_8_bits) {
+    /* exact integer sums, scaled */
+    tdiff = diff_sum(im1, im2, diff_rows_8) / (255.0 * 255.0);
+  }
+  else {
+    tdiff = diff_sum(im1, im2, diff_rows_double);
+  }
 
-  im_log((aIMCTX, 1,"i_img_diffd: b(" i_DFp ") chb=%d\n",
-	  i_DFcp(xb, yb), chb));
+  im_log((aIMCTX, 1,"i_img_diffd <- (%.2f)\n",tdiff));
 
-  tdiff=0;
-  for(y=0;y<yb;y++) for(x=0;x<xb;x++) {
-    i_gpixf(im1,x,y,&val1);
-    i_gpixf(im2,x,y,&val2);
+  return tdiff;
+}
+
+typedef struct {
+  i_img *im1, *im2;
+  i_img_dim width;
+  int channels;
+  double epsilon;
+  /* set once a difference is found, so other bands can stop early */
+  volatile int differ;
+  i_mutex_t mutex;
+  /* the first difference found */
+  i_img_dim x, y;
+  double diff;
+} samef_state;
+
+/* record a difference at (x, y), keeping the first by row */
+static void
+samef_found(samef_state *state, i_img_dim x, i_img_dim y, double diff) {
+  i_mutex_lock(state->mutex);
+  if (!state->differ || y < state->y) {
+    state->x = x;
+    state->y = y;
+    state->diff = diff;
+  }
+  state->differ = 1;
+  i_mutex_unlock(state->mutex);
+}
 
-    for(ch=0;ch<chb;ch++) {
-      double sdiff = val1.channel[ch]-val2.channel[ch];
-      tdiff += sdiff * sdiff;
+/* look for a difference in row y of 8-bit samples, returns the index
+   of the first differing sample or -1 */
+static i_img_dim
+samef_row_8(const i_sample_t *row1, const i_sample_t *row2, size_t count,
+	    double epsilon) {
+  int max_diff = 0;
+  size_t i;
+
+  /* find the largest difference first, this vectorizes */
+  for (i = 0; i < count; ++i) {
+    int sdiff = row1[i] > row2[i] ? row1[i] - row2[i] : row2[i] - row1[i];
+    if (sdiff > max_diff)
+      max_diff = sdiff;
+  }
+  /* identical or clearly within epsilon, allowing for rounding */
+  if (max_diff == 0 || max_diff <= epsilon * 255.0 - 1)
+    return -1;
+
+  for (i = 0; i < count; ++i) {
+    if (fabs(Sample8ToF(row1[i]) - Sample8ToF(row2[i])) > epsilon)
+      return i;
+  }
+
+  return -1;
+}
+
+static void
+samef_rows_8(void *p, i_img_dim start, i_img_dim end) {
+  samef_state *state = p;
+  size_t count = (size_t)state->width * state->channels;
+  i_sample_t *buf1 = i_int_band_malloc(count);
+  i_sample_t *buf2 = i_int_band_malloc(count);
+  i_img_dim y;
+
+  for (y = start; y < end && !state->differ; ++y) {
+    const i_sample_t *row1 = diff_row_8(state->im1, y, state->width,
+					state->channels, buf1);
+    const i_sample_t *row2 = diff_row_8(state->im2, y, state->width,
+					state->channels, buf2);
+    i_img_dim i = samef_row_8(row1, row2, count, state->epsilon);
+    if (i >= 0) {
+      samef_found(state, i / state->channels, y,
+		  Sample8ToF(row1[i]) - Sample8ToF(row2[i]));
+      break;
     }
   }
-  im_log((aIMCTX, 1,"i_img_diffd <- (%.2f)\n",tdiff));
 
-  return tdiff;
+  i_int_band_free(buf1);
+  i_int_band_free(buf2);
+}
+
+static void
+samef_rows_double(void *p, i_img_dim start, i_img_dim end) {
+  samef_state *state = p;
+  size_t count = (size_t)state->width * state->channels;
+  i_fsample_t *row1 = i_int_band_malloc(sizeof(i_fsample_t) * count);
+  i_fsample_t *row2 = i_int_band_malloc(sizeof(i_fsample_t) * count);
+  i_img_dim y;
+  size_t i;
+
+  for (y = start; y < end && !state->differ; ++y) {
+    diff_row_double(state->im1, y, state->width, state->channels, row1);
+    diff_row_double(state->im2, y, state->width, state->channels, row2);
+    for (i = 0; i < count; ++i) {
+      double sdiff = row1[i] - row2[i];
+      if (fabs(sdiff) > state->epsilon) {
+	samef_found(state, i / state->channels, y, sdiff);
+	break;
+      }
+    }
+  }
+
+  i_int_band_free(row1);
+  i_int_band_free(row2);
 }
 
+/*
+=item i_img_samef(im1, im2, epsilon, what)
+
+Returns true if no sample in the common area of the two images differs
+by more than C<epsilon>, treating samples as ranging from 0 to 1.
+C<what> is only used for logging.
+
+Stops at the first difference found.  The images are compared a row
+at a time, in parallel if threads have been set with im_set_threads().
+
+=cut
+*/
+
 int
 i_img_samef(i_img *im1,i_img *im2, double epsilon, char const *what) {
-  i_img_dim x,y,xb,yb;
-  int ch, chb;
-  i_fcolor val1,val2;
+  samef_state state;
+  i_img_dim height;
   dIMCTXim(im1);
 
   if (what == NULL)
@@ -1015,27 +1310,27 @@ i_img_samef(i_img *im1,i_img *im2, double epsilon, char const *what) {
 
   im_log((aIMCTX,1,"i_img_samef(im1 %p,im2 %p, epsilon %g, what '%s')\n", im1, im2, epsilon, what));
 
-  xb=(im1->xsize<im2->xsize)?im1->xsize:im2->xsize;
-  yb=(im1->ysize<im2->ysize)?im1->ysize:im2->ysize;
-  chb=(im1->channels<im2->channels)?im1->channels:im2->channels;
+  state.im1 = im1;
+  state.im2 = im2;
+  state.width = i_min(im1->xsize, im2->xsize);
+  state.channels = i_min(im1->channels, im2->channels);
+  state.epsilon = epsilon;
+  state.differ = 0;
+  state.mutex = i_mutex_new();
+  height = i_min(im1->ysize, im2->ysize);
 
   im_log((aIMCTX, 1,"i_img_samef: b(" i_DFp ") chb=%d\n",
-	  i_DFcp(xb, yb), chb));
+	  i_DFcp(state.width, height), state.channels));
 
-  for(y = 0; y < yb; y++) {
-    for(x = 0; x < xb; x++) {
-      i_gpixf(im1, x, y, &val1);
-      i_gpixf(im2, x, y, &val2);
-      
-      for(ch = 0; ch < chb; ch++) {
-	double sdiff = val1.channel[ch] - val2.channel[ch];
-	if (fabs(sdiff) > epsilon) {
-	  im_log((aIMCTX, 1,"i_img_samef <- different %g @(" i_DFp ")\n",
-		  sdiff, i_DFcp(x, y)));
-	  return 0;
-	}
-      }
-    }
+  i_int_run_bands(im1, im2, height, DIFF_BAND,
+		  im1->bits == i_8_bits && im2->bits == i_8_bits
+		  ? samef_rows_8 : samef_rows_double, &state);
+  i_mutex_destroy(state.mutex);
+
+  if (state.differ) {
+    im_log((aIMCTX, 1,"i_img_samef <- different %g @(" i_DFp ")\n",
+	    state.diff, i_DFcp(state.x, state.y)));
+    return 0;
   }
   im_log((aIMCTX, 1,"i_img_samef <- same\n"));
 
@@ -1682,6 +1977,53 @@ i_test_format_probe(io_glue *data, int length) {
   return NULL;
 }
 
+/*
+=item i_probe_image_info(ig, info)
+
+=category Files
+
+=synopsis i_image_info info;
+=synopsis if (i_probe_image_info(ig, &info))
+=synopsis   printf("%s " i_DFp "\n", info.format, i_DFcp(info.width, info.height));
+
+Fill in C<info> with the format, size and other details of the image
+in C<ig>, reading only the file header.
+
+This handles the formats Imager reads itself, PNM, BMP and TGA.  The
+file format modules provide their own probe functions, eg.
+i_probejpeg_wiol().
+
+Returns non-zero on success.
+
+=cut
+*/
+
+int
+i_probe_image_info(io_glue *ig, i_image_info *info) {
+  const char *format;
+  dIMCTXio(ig);
+
+  im_log((aIMCTX, 1, "i_probe_image_info(ig %p, info %p)\n", ig, info));
+
+  im_clear_error(aIMCTX);
+
+  format = i_test_format_probe(ig, -1);
+  if (!format) {
+    im_push_error(aIMCTX, 0, "format not recognized");
+    return 0;
+  }
+
+  if (strcmp(format, "pnm") == 0)
+    return i_probepnm_wiol(ig, info);
+  else if (strcmp(format, "bmp") == 0)
+    return i_probebmp_wiol(ig, info);
+  else if (strcmp(format, "tga") == 0)
+    return i_probetga_wiol(ig, info);
+
+  im_push_errorf(aIMCTX, 0, "cannot probe %s files", format);
+  return 0;
+}
+
 /*
 =item i_img_is_monochrome(img, &zero_is_white)
 
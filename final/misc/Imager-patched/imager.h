@@ -48,6 +48,7 @@ extern void i_rgb_to_hsv(i_color *color);
 extern void i_hsv_to_rgb(i_color *color);
 
 i_img *im_img_8_new(pIMCTX, i_img_dim x,i_img_dim y,int ch);
+i_sample_t *i_img_8_row(i_img *im, i_img_dim y, size_t *stride);
 #define i_img_empty(im, x, y) i_img_empty_ch((im), (x), (y), 3)
 i_img *im_img_empty_ch(pIMCTX, i_img *im,i_img_dim x,i_img_dim y,int ch);
 #define i_img_empty_ch(im, x, y, ch) im_img_empty_ch(aIMCTX, (im), (x), (y), (ch))
@@ -171,6 +172,7 @@ undef_int i_flood_cfill_border(i_img *im, i_img_dim seedx, i_img_dim seedy, i_fi
 /* image processing functions */
 
 int i_gaussian    (i_img *im, double stdev);
+int i_gaussian_iir(i_img *im, double stdev);
 int i_conv        (i_img *im,const double *coeff,int len);
 void i_unsharp_mask(i_img *im, double stddev, double scale);
 
@@ -222,6 +224,7 @@ extern int i_get_file_background(i_img *im, i_color *bg);
 extern int i_get_file_backgroundf(i_img *im, i_fcolor *bg);
 
 const char * i_test_format_probe(io_glue *data, int length);
+int i_probe_image_info(io_glue *ig, i_image_info *info);
 
 
 i_img   * i_readraw_wiol(io_glue *ig, i_img_dim x, i_img_dim y, int datachannels, int storechannels, int intrl);
@@ -229,14 +232,17 @@ undef_int i_writeraw_wiol(i_img* im, io_glue *ig);
 
 i_img   * i_readpnm_wiol(io_glue *ig, int allow_incomplete);
 i_img   ** i_readpnm_multi_wiol(io_glue *ig, int *count, int allow_incomplete);
+int i_probepnm_wiol(io_glue *ig, i_image_info *info);
 undef_int i_writeppm_wiol(i_img *im, io_glue *ig);
 
 extern int    i_writebmp_wiol(i_img *im, io_glue *ig);
 extern i_img *i_readbmp_wiol(io_glue *ig, int allow_incomplete);
+extern int i_probebmp_wiol(io_glue *ig, i_image_info *info);
 
 int tga_header_verify(unsigned char headbuf[18]);
 
 i_img   * i_readtga_wiol(io_glue *ig, int length);
+int i_probetga_wiol(io_glue *ig, i_image_info *info);
 undef_int i_writetga_wiol(i_img *img, io_glue *ig, int wierdpack, int compress, char *idstring, size_t idlen);
 
 i_img   * i_readrgb_wiol(io_glue *ig, int length);
@@ -245,6 +251,37 @@ undef_int i_writergb_wiol(i_img *img, io_glue *ig, int wierdpack, int compress,
 i_img * i_scaleaxis(i_img *im, double Value, int Axis);
 i_img * i_scale_nn(i_img *im, double scx, double scy);
 i_img * i_scale_mixing(i_img *src, i_img_dim width, i_img_dim height);
+i_img * i_scale_halve(i_img *src);
+
+/* scalerows.c */
+i_scale_rows *i_scale_rows_new(i_img_dim in_width, i_img_dim in_height,
+			       i_img_dim out_width, i_img_dim out_height,
+			       int channels, i_scale_rows_put_f put,
+			       void *put_data);
+int i_scale_rows_feed(i_scale_rows *rows, const i_color *row);
+int i_scale_rows_done(i_scale_rows *rows);
+void i_scale_rows_destroy(i_scale_rows *rows);
+int i_scale_stream(io_glue *in, i_decoder *dec, i_encoder *enc,
+		   i_img_dim out_width, i_img_dim out_height,
+		   i_scale_fit_t fit);
+
+/* decoder.c */
+void i_decoder_set_callbacks(i_decoder *dec, i_decode_header_f header,
+			     i_decode_row_f row, void *p);
+int i_decoder_feed(i_decoder *dec, const void *data, size_t size);
+int i_decoder_finish(i_decoder *dec);
+void i_decoder_destroy(i_decoder *dec);
+int i_decoder_check_limits(i_decoder *dec, i_img_dim width, i_img_dim height,
+			   int channels, int whole);
+int i_decoder_header(i_decoder *dec, const i_image_info *info);
+int i_decoder_row(i_decoder *dec, i_img_dim y, const i_color *row);
+
+/* encoder.c */
+int i_encoder_start(i_encoder *enc, i_img_dim width, i_img_dim height,
+		    int channels);
+int i_encoder_row(i_encoder *enc, const i_color *row);
+int i_encoder_finish(i_encoder *enc);
+void i_encoder_destroy(i_encoder *enc);
 i_img * i_haar(i_img *im);
 int     i_count_colors(i_img *im,int maxc);
 int i_get_anonymous_color_histo(i_img *im, unsigned int **col_usage, int maxc);
@@ -276,7 +313,10 @@ void i_turbnoise(i_img *im,double xo,double yo,double scale);
 void i_gradgen(i_img *im, int num, i_img_dim *xo, i_img_dim *yo, i_color *ival, int dmeasure);
 int i_nearest_color(i_img *im, int num, i_img_dim *xo, i_img_dim *yo, i_color *ival, int dmeasure);
 i_img *i_diff_image(i_img *im, i_img *im2, double mindist);
-int i_diff_image_pixels(i_img *im, i_img *im2, double mindist);
+i_img_dim i_diff_image_pixels(i_img *im, i_img *im2, double mindist,
+			      i_img_dim limit);
+int i_img_compare(i_img *im1, i_img *im2, i_img_dim tile,
+		  i_img_compare_result *result);
 int
 i_fountain(i_img *im, double xa, double ya, double xb, double yb, 
            i_fountain_type type, i_fountain_repeat repeat, 
@@ -335,6 +375,13 @@ im_get_image_file_limits(im_context_t ctx, i_img_dim *width, i_img_dim *height,
 extern int
 im_int_check_image_file_limits(im_context_t ctx, i_img_dim width, i_img_dim height, int channels, size_t sample_size);
 
+/* worker threads */
+extern int im_set_threads(im_context_t ctx, int threads);
+extern int im_get_threads(im_context_t ctx);
+
+extern int im_set_image_pool(im_context_t ctx, size_t max_bytes);
+extern void im_get_image_pool_stats(im_context_t ctx, i_img_pool_stats *stats);
+
 /* memory allocation */
 void* mymalloc(size_t size);
 void  myfree(void *p);
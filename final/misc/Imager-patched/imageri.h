@@ -47,6 +47,47 @@ extern i_img_dim i_gsamp_bits_fb(i_img *im, i_img_dim x, i_img_dim r, i_img_dim
 
 extern void i_get_combine(int combine, i_fill_combine_f *, i_fill_combinef_f *);
 
+/* vectorized i_scale_mixing() for 8-bit images, false if unavailable */
+extern int i_int_scale_mixing_simd(i_img *src, i_img *result);
+
+/* vectorized kernels for the above, see scalesimd.c */
+typedef void (*i_int_mix_accum_row_f)(float *accum, const i_color *in,
+				      i_img_dim width, int channels,
+				      float fraction);
+extern i_int_mix_accum_row_f i_int_mix_simd_accum_row(void);
+extern void i_int_mix_simd_hscale(i_color *out, i_img_dim out_width,
+				  const float *in, i_img_dim in_width,
+				  int channels);
+
+/* vectorized row comparison for i_diff_image_pixels(), see diffsimd.c */
+typedef i_img_dim (*i_int_diff_count_row_f)(const i_sample_t *a,
+					    const i_sample_t *b,
+					    i_img_dim width, int channels,
+					    int mindist);
+extern i_int_diff_count_row_f i_int_diff_simd_count_row(void);
+
+/* bilinear interpolation for affine i_matrix_transform_bg(), weights
+   are fractions scaled by I_BILINEAR_ONE, see rotatesimd.c */
+#define I_BILINEAR_BITS 14
+#define I_BILINEAR_ONE (1 << I_BILINEAR_BITS)
+/* fraction bits kept from the horizontal pass */
+#define I_BILINEAR_ROW_BITS 7
+
+typedef void (*i_int_bilinear_row_f)(i_color *out, const i_color *taps,
+				     const int *weights, i_img_dim count);
+extern i_int_bilinear_row_f i_int_bilinear_simd_row(void);
+
+/* copy strips of columns to and from rows of a buffer, see
+   transpose.im */
+extern void i_int_get_cols_8(i_img *src, i_img_dim x, i_img_dim count,
+			     i_color *cols);
+extern void i_int_get_cols_double(i_img *src, i_img_dim x, i_img_dim count,
+				  i_fcolor *cols);
+extern void i_int_put_cols_8(i_img *dest, i_img_dim x, i_img_dim count,
+			     const i_color *cols);
+extern void i_int_put_cols_double(i_img *dest, i_img_dim x, i_img_dim count,
+				  const i_fcolor *cols);
+
 #define im_min(a, b) ((a) < (b) ? (a) : (b))
 #define im_max(a, b) ((a) > (b) ? (a) : (b))
 
@@ -112,6 +153,37 @@ i_img_dim i_abs(i_img_dim x);
 
 #define color_to_grey(col) ((col)->rgb.r * 0.222  + (col)->rgb.g * 0.707 + (col)->rgb.b * 0.071)
 
+/* worker thread pool, implemented with the mutexes */
+typedef void (*i_int_band_f)(void *p, i_img_dim start, i_img_dim end);
+typedef struct i_int_pool_tag *i_int_pool_t;
+
+extern i_int_pool_t i_int_pool_new(int threads);
+extern void i_int_pool_destroy(i_int_pool_t pool);
+extern void i_int_pool_run(i_int_pool_t pool, i_img_dim count,
+			   i_img_dim band_size, i_int_band_f f, void *p);
+
+/* split count rows into bands and call f for each band, possibly from
+   other threads, see context.c */
+extern void i_int_run_bands(i_img *src, i_img *dest, i_img_dim count,
+			    i_img_dim min_band, i_int_band_f f, void *p);
+
+/* memory allocation for band functions, mymalloc() logs through the
+   context */
+extern void *i_int_band_malloc(size_t size);
+extern void i_int_band_free(void *p);
+
+/* image sample buffer and structure pool, see imgpool.c */
+typedef struct i_int_img_pool_tag *i_int_img_pool_t;
+
+extern void *i_int_img_data_alloc(im_context_t ctx, size_t bytes);
+extern void i_int_img_data_free(im_context_t ctx, void *data);
+extern i_img *i_int_img_struct_alloc(im_context_t ctx);
+extern void i_int_img_struct_free(im_context_t ctx, i_img *im);
+extern void i_int_img_pool_destroy(i_int_img_pool_t pool);
+
+/* limit for im_set_threads() */
+#define IM_MAX_THREADS 256
+
 #define IM_ERROR_COUNT 20
 typedef struct im_context_tag {
   int error_sp;
@@ -138,6 +210,15 @@ typedef struct im_context_tag {
   size_t slot_alloc;
   void **slots;
 
+  /* worker threads used by i_int_run_bands(), the pool is created
+     when first needed */
+  int threads;
+  i_int_pool_t pool;
+
+  /* released image buffers and structures kept for reuse, created
+     by im_set_image_pool() */
+  i_int_img_pool_t img_pool;
+
   ptrdiff_t refcount;
 } im_context_struct;
 
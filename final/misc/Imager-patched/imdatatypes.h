@@ -619,6 +619,7 @@ typedef enum i_make_colors_tag {
   mc_gray, /* 256 gray map */
   mc_gray4, /* four step gray map */
   mc_gray16, /* sixteen step gray map */
+  mc_wu, /* Wu's variance minimizing quantizer */
   mc_mask = 0xFF /* (mask for generator) */
 } i_make_colors;
 
@@ -698,6 +699,10 @@ typedef struct i_quantize_tag {
   /* the amount of perturbation to use for translate is mc_perturb */
   int perturb;
   /* version 2 members after here */
+
+  /* only every mc_step-th pixel of every mc_step-th row is examined
+     by mc_wu, 0 or 1 for every pixel */
+  int mc_step;
 } i_quantize;
 
 /* distance measures used by some filters */
@@ -719,6 +724,303 @@ typedef struct {
 
 typedef struct i_render_tag i_render;
 
+typedef struct i_scale_rows_tag i_scale_rows;
+typedef int (*i_scale_rows_put_f)(void *p, i_img_dim y, const i_color *row);
+
+/* how i_scale_stream() fits the image to the requested size, as for
+   the type parameter of Imager's scale() method */
+typedef enum {
+  i_scale_fit_nonprop,
+  i_scale_fit_min,
+  i_scale_fit_max
+} i_scale_fit_t;
+
+/*
+=item i_image_info
+=category Data Types
+=synopsis i_image_info info;
+
+Describes an image file without reading the image data, as filled in
+by i_probe_image_info() or a file format module's probe function.
+
+=over
+
+=item *
+
+C<format> - the file format, as returned by i_test_format_probe().
+
+=item *
+
+C<width>, C<height> - the size of the image in pixels.
+
+=item *
+
+C<channels> - the number of channels Imager creates when reading the
+image.
+
+=item *
+
+C<bits> - the bits per sample stored in the file, or the bits per
+index for a paletted image.
+
+=item *
+
+C<paletted> - non-zero if the image is read as a paletted image.
+
+=item *
+
+C<orientation> - the EXIF/TIFF orientation, 1 to 8, or 0 if the file
+doesn't say.
+
+=item *
+
+C<progressive> - non-zero for a progressive JPEG.
+
+=item *
+
+C<interlaced> - non-zero for an interlaced PNG or GIF.
+
+=back
+
+=cut
+*/
+typedef struct {
+  const char *format;
+  i_img_dim width, height;
+  int channels;
+  int bits;
+  int paletted;
+  int orientation;
+  int progressive;
+  int interlaced;
+} i_image_info;
+
+/*
+=item i_img_compare_result
+=category Data Types
+=synopsis i_img_compare_result result;
+
+The result of comparing two images with i_img_compare().  Errors are
+on the scale of 8-bit samples, 0 to 255, whatever the sample size of
+the images.
+
+=over
+
+=item *
+
+C<width>, C<height>, C<channels> - the area and the number of
+channels compared.
+
+=item *
+
+C<mse>, C<psnr>, C<mean_error>, C<max_error>, C<ssim> - the mean
+squared error, the peak signal to noise ratio in dB, the mean and
+maximum absolute error and the mean structural similarity over all
+channels.  C<psnr> is C<HUGE_VAL> for identical images.
+
+=item *
+
+C<channel_mse>, C<channel_psnr>, C<channel_mean_error>,
+C<channel_max_error>, C<channel_ssim> - the same for each channel.
+
+=item *
+
+C<histogram> - for each channel, the number of samples with each
+absolute error, rounded to 0 to 255.
+
+=item *
+
+C<heatmap> - if requested, a one channel double image with a pixel for
+each tile of the compared area, the mean absolute error of the tile
+scaled to 0 to 1.  The caller owns this image.
+
+=back
+
+=cut
+*/
+typedef struct {
+  i_img_dim width, height;
+  int channels;
+  double mse;
+  double psnr;
+  double mean_error;
+  double max_error;
+  double ssim;
+  double channel_mse[MAXCHANNELS];
+  double channel_psnr[MAXCHANNELS];
+  double channel_mean_error[MAXCHANNELS];
+  double channel_max_error[MAXCHANNELS];
+  double channel_ssim[MAXCHANNELS];
+  i_img_dim histogram[MAXCHANNELS][256];
+  i_img *heatmap;
+} i_img_compare_result;
+
+/*
+=item i_img_pool_stats
+=category Data Types
+=synopsis i_img_pool_stats stats;
+
+Statistics for the image pool, filled in by
+im_get_image_pool_stats().
+
+=over
+
+=item *
+
+C<max_bytes> - the limit set by im_set_image_pool(), 0 if the pool is
+disabled.
+
+=item *
+
+C<bytes>, C<buffers> - the bytes and number of sample buffers held for
+reuse.
+
+=item *
+
+C<hits>, C<misses> - sample buffer allocations satisfied from the
+pool, and those that weren't.
+
+=item *
+
+C<image_hits>, C<image_misses> - image structure allocations
+satisfied from the pool, and those that weren't.
+
+=back
+
+=cut
+*/
+
+typedef struct {
+  size_t max_bytes;
+  size_t bytes;
+  size_t buffers;
+  size_t hits;
+  size_t misses;
+  size_t image_hits;
+  size_t image_misses;
+} i_img_pool_stats;
+
+/*
+=item i_decoder
+=category Data Types
+
+An incremental decoder, created by a file format module, which is
+supplied the image file data a piece at a time with i_decoder_feed()
+and passes each row to a callback as soon as it's decoded.
+
+File format modules allocate the decoder, zero filled, with the
+i_decoder structure as the first member of their own state, and
+fill in:
+
+=over
+
+=item *
+
+C<f_feed> - called by i_decoder_feed() with the next piece of file
+data.  Returns zero on failure.
+
+=item *
+
+C<f_finish> - called by i_decoder_finish() at the end of the data.
+Returns zero on failure.
+
+=item *
+
+C<f_destroy> - release the decoder's resources, including the decoder
+itself.
+
+=back
+
+and call i_decoder_check_limits() and i_decoder_header() once the
+image size is known, and i_decoder_row() for each row.
+
+=cut
+*/
+typedef struct i_decoder_tag i_decoder;
+
+typedef int (*i_decode_header_f)(void *p, const i_image_info *info);
+typedef int (*i_decode_row_f)(void *p, i_img_dim y, const i_color *row);
+
+struct i_decoder_tag {
+  int (*f_feed)(i_decoder *dec, const unsigned char *data, size_t size);
+  int (*f_finish)(i_decoder *dec);
+  void (*f_destroy)(i_decoder *dec);
+
+  /* set by i_decoder_set_callbacks() */
+  i_decode_header_f header_cb;
+  i_decode_row_f row_cb;
+  void *cb_data;
+
+  /* maintained by i_decoder_header() and i_decoder_row() */
+  i_image_info info;
+  int have_header;
+  i_img_dim rows;
+
+  /* set once the decoder fails, or i_decoder_finish() is called */
+  int failed;
+  int finished;
+
+  /* set when the consumer only keeps a row at a time, see
+     i_decoder_check_limits() */
+  int rows_only;
+};
+
+/*
+=item i_encoder
+=category Data Types
+
+An incremental encoder, created by a file format module, which is
+supplied the image a row at a time, writing the file as it goes.
+
+File format modules allocate the encoder, zero filled, with the
+i_encoder structure as the first member of their own state, and
+fill in:
+
+=over
+
+=item *
+
+C<f_start> - called by i_encoder_start() with the size of the image
+and the number of channels in each row.  Returns zero on failure.
+
+=item *
+
+C<f_row> - called by i_encoder_row() with each row from top to
+bottom.  Returns zero on failure.
+
+=item *
+
+C<f_finish> - called by i_encoder_finish() once every row has been
+supplied.  Returns zero on failure.
+
+=item *
+
+C<f_destroy> - release the encoder's resources, including the encoder
+itself.
+
+=back
+
+=cut
+*/
+typedef struct i_encoder_tag i_encoder;
+
+struct i_encoder_tag {
+  int (*f_start)(i_encoder *enc, i_img_dim width, i_img_dim height,
+		 int channels);
+  int (*f_row)(i_encoder *enc, const i_color *row);
+  int (*f_finish)(i_encoder *enc);
+  void (*f_destroy)(i_encoder *enc);
+
+  /* maintained by i_encoder_start() and i_encoder_row() */
+  i_img_dim width, height;
+  int channels;
+  i_img_dim rows;
+
+  int started;
+  int failed;
+  int finished;
+};
+
 #ifdef IMAGER_FORMAT_ATTR
 #define I_FORMAT_ATTR(format_index, va_index) \
   __attribute ((format (printf, format_index, va_index)))
@@ -204,7 +204,33 @@ im_ext_funcs imager_function_table =
     i_mutex_unlock,
     im_context_slot_new,
     im_context_slot_set,
-    im_context_slot_get
+    im_context_slot_get,
+
+    /* level 9 */
+    i_scale_rows_new,
+    i_scale_rows_feed,
+    i_scale_rows_done,
+    i_scale_rows_destroy,
+    im_set_threads,
+    im_get_threads,
+    im_io_new_mmap,
+    i_io_read_ptr,
+    i_io_set_buffer_size,
+    i_img_8_row,
+    i_probe_image_info,
+    im_set_image_pool,
+    im_get_image_pool_stats,
+    i_decoder_set_callbacks,
+    i_decoder_feed,
+    i_decoder_finish,
+    i_decoder_destroy,
+    i_decoder_header,
+    i_decoder_row,
+    i_decoder_check_limits,
+    i_encoder_start,
+    i_encoder_row,
+    i_encoder_finish,
+    i_encoder_destroy
   };
 
 /* in general these functions aren't called by Imager internally, but
@@ -238,6 +238,41 @@ extern im_ext_funcs *imager_function_ext_table;
 
 #define im_push_errorf (im_extt->f_im_push_errorf)
 
+#define i_scale_rows_new(in_width, in_height, out_width, out_height, channels, put, put_data) \
+  ((im_extt->f_i_scale_rows_new)((in_width), (in_height), (out_width), (out_height), (channels), (put), (put_data)))
+#define i_scale_rows_feed(rows, row) ((im_extt->f_i_scale_rows_feed)((rows), (row)))
+#define i_scale_rows_done(rows) ((im_extt->f_i_scale_rows_done)(rows))
+#define i_scale_rows_destroy(rows) ((im_extt->f_i_scale_rows_destroy)(rows))
+
+#define im_set_threads(ctx, threads) ((im_extt->f_im_set_threads)((ctx), (threads)))
+#define im_get_threads(ctx) ((im_extt->f_im_get_threads)(ctx))
+
+#define im_io_new_mmap(ctx, fd) ((im_extt->f_im_io_new_mmap)((ctx), (fd)))
+#define i_io_read_ptr (im_extt->f_i_io_read_ptr)
+#define i_io_set_buffer_size (im_extt->f_i_io_set_buffer_size)
+
+#define i_img_8_row(im, y, stride) ((im_extt->f_i_img_8_row)((im), (y), (stride)))
+#define i_probe_image_info(ig, info) ((im_extt->f_i_probe_image_info)((ig), (info)))
+
+#define im_set_image_pool(ctx, max_bytes) ((im_extt->f_im_set_image_pool)((ctx), (max_bytes)))
+#define im_get_image_pool_stats(ctx, stats) ((im_extt->f_im_get_image_pool_stats)((ctx), (stats)))
+
+#define i_decoder_set_callbacks(dec, header, row, p) \
+  ((im_extt->f_i_decoder_set_callbacks)((dec), (header), (row), (p)))
+#define i_decoder_feed(dec, data, size) ((im_extt->f_i_decoder_feed)((dec), (data), (size)))
+#define i_decoder_finish(dec) ((im_extt->f_i_decoder_finish)(dec))
+#define i_decoder_destroy(dec) ((im_extt->f_i_decoder_destroy)(dec))
+#define i_decoder_header(dec, info) ((im_extt->f_i_decoder_header)((dec), (info)))
+#define i_decoder_row(dec, y, row) ((im_extt->f_i_decoder_row)((dec), (y), (row)))
+#define i_decoder_check_limits(dec, width, height, channels, whole) \
+  ((im_extt->f_i_decoder_check_limits)((dec), (width), (height), (channels), (whole)))
+
+#define i_encoder_start(enc, width, height, channels) \
+  ((im_extt->f_i_encoder_start)((enc), (width), (height), (channels)))
+#define i_encoder_row(enc, row) ((im_extt->f_i_encoder_row)((enc), (row)))
+#define i_encoder_finish(enc) ((im_extt->f_i_encoder_finish)(enc))
+#define i_encoder_destroy(enc) ((im_extt->f_i_encoder_destroy)(enc))
+
 #ifdef IMAGER_LOG
 #ifndef IMAGER_NO_CONTEXT
 #define mm_log(x) { i_lhead(__FILE__,__LINE__); i_loog x; } 
@@ -29,5 +29,6 @@ extern im_pl_ext_funcs *imager_perl_function_ext_table;
 #define ip_handle_quant_opts  (im_exttpl->f_ip_handle_quant_opts)
 #define ip_cleanup_quant_opts  (im_exttpl->f_ip_cleanup_quant_opts)
 #define ip_copy_colors_back (im_exttpl->f_ip_copy_colors_back)
+#define ip_image_info_sv (im_exttpl->f_ip_image_info_sv)
 
 #endif
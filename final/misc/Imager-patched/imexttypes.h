@@ -34,7 +34,7 @@
  will result in an increment of IMAGER_API_LEVEL.
 */
 
-#define IMAGER_API_LEVEL 8
+#define IMAGER_API_LEVEL 9
 
 typedef struct {
   int version;
@@ -254,6 +254,32 @@ typedef struct {
   im_slot_t (*f_im_context_slot_new)(im_slot_destroy_t);
   int (*f_im_context_slot_set)(im_context_t, im_slot_t, void *);
   void *(*f_im_context_slot_get)(im_context_t, im_slot_t);
+
+  /* IMAGER_API_LEVEL 9 functions will be added here */
+  i_scale_rows *(*f_i_scale_rows_new)(i_img_dim in_width, i_img_dim in_height, i_img_dim out_width, i_img_dim out_height, int channels, i_scale_rows_put_f put, void *put_data);
+  int (*f_i_scale_rows_feed)(i_scale_rows *rows, const i_color *row);
+  int (*f_i_scale_rows_done)(i_scale_rows *rows);
+  void (*f_i_scale_rows_destroy)(i_scale_rows *rows);
+  int (*f_im_set_threads)(im_context_t ctx, int threads);
+  int (*f_im_get_threads)(im_context_t ctx);
+  i_io_glue_t *(*f_im_io_new_mmap)(im_context_t ctx, int fd);
+  ssize_t (*f_i_io_read_ptr)(io_glue *ig, const unsigned char **pdata, size_t size);
+  int (*f_i_io_set_buffer_size)(io_glue *ig, size_t size);
+  i_sample_t *(*f_i_img_8_row)(i_img *im, i_img_dim y, size_t *stride);
+  int (*f_i_probe_image_info)(io_glue *ig, i_image_info *info);
+  int (*f_im_set_image_pool)(im_context_t ctx, size_t max_bytes);
+  void (*f_im_get_image_pool_stats)(im_context_t ctx, i_img_pool_stats *stats);
+  void (*f_i_decoder_set_callbacks)(i_decoder *dec, i_decode_header_f header, i_decode_row_f row, void *p);
+  int (*f_i_decoder_feed)(i_decoder *dec, const void *data, size_t size);
+  int (*f_i_decoder_finish)(i_decoder *dec);
+  void (*f_i_decoder_destroy)(i_decoder *dec);
+  int (*f_i_decoder_header)(i_decoder *dec, const i_image_info *info);
+  int (*f_i_decoder_row)(i_decoder *dec, i_img_dim y, const i_color *row);
+  int (*f_i_decoder_check_limits)(i_decoder *dec, i_img_dim width, i_img_dim height, int channels, int whole);
+  int (*f_i_encoder_start)(i_encoder *enc, i_img_dim width, i_img_dim height, int channels);
+  int (*f_i_encoder_row)(i_encoder *enc, const i_color *row);
+  int (*f_i_encoder_finish)(i_encoder *enc);
+  void (*f_i_encoder_destroy)(i_encoder *enc);
 } im_ext_funcs;
 
 #define PERL_FUNCTION_TABLE_NAME "Imager::__ext_func_table"
@@ -175,7 +175,7 @@ im_img_empty_ch(pIMCTX, i_img *im,i_img_dim x,i_img_dim y,int ch) {
   im->channels = ch;
   im->ch_mask  = MAXINT;
   im->bytes=bytes;
-  if ( (im->idata=mymalloc(im->bytes)) == NULL) 
+  if ( (im->idata=i_int_img_data_alloc(aIMCTX, im->bytes)) == NULL) 
     im_fatal(aIMCTX, 2,"malloc() error\n"); 
   memset(im->idata,0,(size_t)im->bytes);
   
@@ -187,6 +187,46 @@ im_img_empty_ch(pIMCTX, i_img *im,i_img_dim x,i_img_dim y,int ch) {
   return im;
 }
 
+/*
+=item i_img_8_row(im, y, &stride)
+=category Image
+=synopsis size_t stride;
+=synopsis i_sample_t *row = i_img_8_row(im, y, &stride);
+
+Returns a pointer to the samples of row C<y> of C<im>, stored as
+C<< im->channels >> interleaved samples for each pixel, if C<im> is a
+plain 8-bit direct color image as created by i_img_8_new().  If
+C<stride> is non-NULL it is set to the number of samples from the
+start of one row to the start of the next.
+
+Returns NULL for any other image, such as masked, paletted, 16-bit or
+double images, if C<y> is outside the image, or if the channel mask
+of C<im> excludes any channel, since writes through the pointer can't
+honour it.  Callers should then fall back to i_glin()/i_plin() or
+i_gsamp()/i_psamp().
+
+The pointer is only valid until the image is next modified other than
+through the pointer, since writing a paletted color to a paletted
+image can convert it to a direct color image.
+
+=cut
+*/
+
+i_sample_t *
+i_img_8_row(i_img *im, i_img_dim y, size_t *stride) {
+  unsigned all_mask = (1U << im->channels) - 1;
+
+  if (im->i_f_glin != i_glin_d || im->virtual || !im->idata
+      || y < 0 || y >= im->ysize
+      || (im->ch_mask & all_mask) != all_mask)
+    return NULL;
+
+  if (stride)
+    *stride = (size_t)im->xsize * im->channels;
+
+  return im->idata + (size_t)im->xsize * im->channels * y;
+}
+
 /*
 =head2 8-bit per sample image internal functions
 
@@ -526,12 +566,6 @@ i_gsampf_d(i_img *im, i_img_dim l, i_img_dim r, i_img_dim y, i_fsample_t *samps,
   int ch;
   i_img_dim count, i, w;
   unsigned char *data;
-  for (ch = 0; ch < chan_count; ++ch) {
-    if (chans[ch] < 0 || chans[ch] >= im->channels) {
-      dIMCTXim(im);
-      im_push_errorf(aIMCTX, 0, "No channel %d in this image", chans[ch]);
-    }
-  }
   if (y >=0 && y < im->ysize && l < im->xsize && l >= 0) {
     if (r > im->xsize)
       r = im->xsize;
@@ -134,7 +134,7 @@ im_img_double_new(pIMCTX, i_img_dim x, i_img_dim y, int ch) {
   im->channels = ch;
   im->bytes = bytes;
   im->ext_data = NULL;
-  im->idata = mymalloc(im->bytes);
+  im->idata = i_int_img_data_alloc(aIMCTX, im->bytes);
   memset(im->idata, 0, im->bytes);
   im_img_init(aIMCTX, im);
   
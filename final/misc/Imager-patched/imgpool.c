@@ -0,0 +1,441 @@
+#include "imageri.h"
+#include <string.h>
+
+/*
+=head1 NAME
+
+imgpool.c - reuse image sample buffers and image structures
+
+=head1 SYNOPSIS
+
+  im_set_image_pool(aIMCTX, 64 * 1024 * 1024);
+
+  im->idata = i_int_img_data_alloc(aIMCTX, im->bytes);
+  ...
+  i_int_img_data_free(aIMCTX, im->idata);
+
+  i_img_pool_stats stats;
+  im_get_image_pool_stats(aIMCTX, &stats);
+
+=head1 DESCRIPTION
+
+A program that creates and destroys images of similar sizes over and
+over, such as a thumbnailing service, passes the same large blocks
+through malloc() and free() for every image.
+
+Once enabled with im_set_image_pool() a context keeps the sample
+buffers and image structures released by destroyed images, up to the
+configured number of bytes, and hands them out again to new images.
+
+Buffer sizes are rounded up to a size class, 4, 5, 6 or 7 times a
+power of two, so a buffer can be reused for an image of a slightly
+different size while wasting at most a quarter of it.  Buffers
+smaller than 16k are left to malloc().
+
+The buffers handed out are tracked, so a buffer that some other code
+allocated and stored in an image is released with myfree() as
+before.
+
+Like the rest of the context, the pool belongs to a single thread,
+so it isn't locked.
+
+=over
+
+=cut
+*/
+
+/* smaller buffers aren't worth the bookkeeping */
+#define POOL_MIN_BYTES 16384
+
+/* image structures kept for reuse */
+#define POOL_MAX_IMAGES 32
+
+/* four size classes for each power of two */
+#define POOL_CLASSES (sizeof(size_t) * 8 * 4)
+
+typedef struct pool_free_tag {
+  struct pool_free_tag *next;
+} pool_free;
+
+/* a buffer handed out by the pool */
+typedef struct {
+  void *p;
+  size_t size;
+} pool_live;
+
+struct i_int_img_pool_tag {
+  size_t max_bytes;
+
+  /* bytes and count of buffers held in the free lists */
+  size_t bytes;
+  size_t buffers;
+  pool_free *free[POOL_CLASSES];
+
+  /* buffers handed out, open addressed on the pointer */
+  pool_live *live;
+  size_t live_alloc;
+  size_t live_count;
+
+  i_img *images[POOL_MAX_IMAGES];
+  int image_count;
+
+  size_t hits, misses;
+  size_t image_hits, image_misses;
+};
+
+/* round bytes up to the size class m << k, m from 4 to 7, returning
+   the index of the class */
+static int
+size_class(size_t bytes, size_t *class_bytes) {
+  size_t m = bytes - 1;
+  int k = 0;
+
+  while (m >= 8) {
+    m >>= 1;
+    ++k;
+  }
+  if (k == 0) {
+    *class_bytes = 8;
+    return 0;
+  }
+  ++m;
+  if (m == 8) {
+    m = 4;
+    ++k;
+  }
+  *class_bytes = m << k;
+
+  return k * 4 + (int)(m - 4);
+}
+
+static size_t
+live_hash(const void *p, size_t mask) {
+  return (size_t)(((size_t)p >> 4) * (size_t)2654435761u) & mask;
+}
+
+/* the pool's own structures are allocated with malloc() since it
+   may be set up while a context is created, when mymalloc() can't
+   log */
+static void
+live_add(i_int_img_pool_t pool, void *p, size_t size) {
+  size_t mask, i;
+
+  if ((pool->live_count + 1) * 2 > pool->live_alloc) {
+    size_t old_alloc = pool->live_alloc;
+    size_t new_alloc = old_alloc ? old_alloc * 2 : 32;
+    pool_live *old = pool->live;
+    size_t j;
+
+    pool->live = calloc(new_alloc, sizeof(pool_live));
+    if (!pool->live) {
+      /* the buffer just isn't returned to the pool */
+      pool->live = old;
+      return;
+    }
+    pool->live_alloc = new_alloc;
+    mask = pool->live_alloc - 1;
+    for (j = 0; j < old_alloc; ++j) {
+      if (old[j].p) {
+	i = live_hash(old[j].p, mask);
+	while (pool->live[i].p)
+	  i = (i + 1) & mask;
+	pool->live[i] = old[j];
+      }
+    }
+    free(old);
+  }
+
+  mask = pool->live_alloc - 1;
+  i = live_hash(p, mask);
+  while (pool->live[i].p)
+    i = (i + 1) & mask;
+  pool->live[i].p = p;
+  pool->live[i].size = size;
+  ++pool->live_count;
+}
+
+/* remove p from the live table, returning its class size, or 0 if
+   the pool didn't hand it out */
+static size_t
+live_remove(i_int_img_pool_t pool, const void *p) {
+  size_t mask, i, j, size;
+
+  if (!pool->live_count)
+    return 0;
+
+  mask = pool->live_alloc - 1;
+  i = live_hash(p, mask);
+  while (pool->live[i].p != p) {
+    if (!pool->live[i].p)
+      return 0;
+    i = (i + 1) & mask;
+  }
+  size = pool->live[i].size;
+
+  /* shift later entries of the probe sequence back into the hole */
+  j = i;
+  for (;;) {
+    size_t home;
+
+    j = (j + 1) & mask;
+    if (!pool->live[j].p)
+      break;
+    home = live_hash(pool->live[j].p, mask);
+    if (i < j ? (i < home && home <= j) : (i < home || home <= j))
+      continue;
+    pool->live[i] = pool->live[j];
+    i = j;
+  }
+  pool->live[i].p = NULL;
+  --pool->live_count;
+
+  return size;
+}
+
+/* release held buffers until no more than max_bytes are held,
+   largest first */
+static void
+pool_trim(i_int_img_pool_t pool, size_t max_bytes) {
+  int cls = POOL_CLASSES;
+
+  while (pool->bytes > max_bytes && cls-- > 0) {
+    while (pool->free[cls] && pool->bytes > max_bytes) {
+      pool_free *f = pool->free[cls];
+      size_t size;
+
+      pool->free[cls] = f->next;
+      size = ((size_t)(4 + cls % 4)) << (cls / 4);
+      pool->bytes -= size;
+      --pool->buffers;
+      myfree(f);
+    }
+  }
+}
+
+/*
+=item i_int_img_data_alloc(ctx, bytes)
+
+Allocate a sample buffer of at least C<bytes> bytes for a new image,
+reusing a buffer from the context's pool if possible.
+
+The buffer isn't cleared.
+
+=cut
+*/
+
+void *
+i_int_img_data_alloc(im_context_t ctx, size_t bytes) {
+  i_int_img_pool_t pool = ctx->img_pool;
+  size_t size;
+  int cls;
+  void *p;
+
+  if (!pool || !pool->max_bytes || bytes < POOL_MIN_BYTES)
+    return mymalloc(bytes);
+
+  cls = size_class(bytes, &size);
+  if (pool->free[cls]) {
+    pool_free *f = pool->free[cls];
+    pool->free[cls] = f->next;
+    pool->bytes -= size;
+    --pool->buffers;
+    ++pool->hits;
+    p = f;
+  }
+  else {
+    p = mymalloc(size);
+    ++pool->misses;
+  }
+  live_add(pool, p, size);
+
+  return p;
+}
+
+/*
+=item i_int_img_data_free(ctx, data)
+
+Release a sample buffer, keeping it in the context's pool if it came
+from the pool and the pool has room for it.
+
+=cut
+*/
+
+void
+i_int_img_data_free(im_context_t ctx, void *data) {
+  i_int_img_pool_t pool = ctx->img_pool;
+  size_t size;
+  pool_free *f;
+  int cls;
+
+  if (!pool || (size = live_remove(pool, data)) == 0) {
+    myfree(data);
+    return;
+  }
+
+  if (pool->bytes + size > pool->max_bytes) {
+    myfree(data);
+    return;
+  }
+
+  cls = size_class(size, &size);
+  f = data;
+  f->next = pool->free[cls];
+  pool->free[cls] = f;
+  pool->bytes += size;
+  ++pool->buffers;
+}
+
+/*
+=item i_int_img_struct_alloc(ctx)
+
+Allocate an image structure, reusing one from the context's pool if
+possible.
+
+=cut
+*/
+
+i_img *
+i_int_img_struct_alloc(im_context_t ctx) {
+  i_int_img_pool_t pool = ctx->img_pool;
+
+  if (pool && pool->max_bytes) {
+    if (pool->image_count) {
+      ++pool->image_hits;
+      return pool->images[--pool->image_count];
+    }
+    ++pool->image_misses;
+  }
+
+  return mymalloc(sizeof(i_img));
+}
+
+/*
+=item i_int_img_struct_free(ctx, im)
+
+Release an image structure, keeping it in the context's pool if there
+is room.
+
+=cut
+*/
+
+void
+i_int_img_struct_free(im_context_t ctx, i_img *im) {
+  i_int_img_pool_t pool = ctx->img_pool;
+
+  if (pool && pool->max_bytes && pool->image_count < POOL_MAX_IMAGES)
+    pool->images[pool->image_count++] = im;
+  else
+    myfree(im);
+}
+
+/*
+=item i_int_img_pool_destroy(pool)
+
+Release the pool and everything it holds, called when the context is
+destroyed.
+
+=cut
+*/
+
+void
+i_int_img_pool_destroy(i_int_img_pool_t pool) {
+  pool_trim(pool, 0);
+  while (pool->image_count)
+    myfree(pool->images[--pool->image_count]);
+  free(pool->live);
+  free(pool);
+}
+
+/*
+=item im_set_image_pool(ctx, max_bytes)
+X<im_set_image_pool API>X<i_set_image_pool API>
+=section Context objects
+=synopsis im_set_image_pool(aIMCTX, 64 * 1024 * 1024);
+=synopsis i_set_image_pool(64 * 1024 * 1024);
+
+Keep the sample buffers and image structures of destroyed images,
+holding up to C<max_bytes> bytes of buffers, to reuse them for new
+images created in this context.
+
+A C<max_bytes> of 0, the default, disables the pool and releases
+anything it holds.  Lowering the limit releases buffers until the
+pool is within the new limit.
+
+Returns non-zero on success.
+
+Also callable as C<i_set_image_pool(max_bytes)>.
+
+=cut
+*/
+
+int
+im_set_image_pool(im_context_t ctx, size_t max_bytes) {
+  i_int_img_pool_t pool = ctx->img_pool;
+
+  im_clear_error(ctx);
+
+  if (!pool) {
+    if (!max_bytes)
+      return 1;
+    pool = calloc(1, sizeof(struct i_int_img_pool_tag));
+    if (!pool) {
+      im_push_error(ctx, 0, "set_image_pool: out of memory");
+      return 0;
+    }
+    ctx->img_pool = pool;
+  }
+
+  pool->max_bytes = max_bytes;
+  pool_trim(pool, max_bytes);
+  if (!max_bytes) {
+    while (pool->image_count)
+      myfree(pool->images[--pool->image_count]);
+  }
+
+  return 1;
+}
+
+/*
+=item im_get_image_pool_stats(ctx, stats)
+X<im_get_image_pool_stats API>X<i_get_image_pool_stats API>
+=section Context objects
+=synopsis i_img_pool_stats stats;
+=synopsis im_get_image_pool_stats(aIMCTX, &stats);
+=synopsis i_get_image_pool_stats(&stats);
+
+Fill in C<stats> with the limit set by im_set_image_pool(), the bytes
+and number of buffers currently held, and the number of buffer and
+image structure allocations satisfied from the pool (hits) or not
+(misses).
+
+Also callable as C<i_get_image_pool_stats(stats)>.
+
+=cut
+*/
+
+void
+im_get_image_pool_stats(im_context_t ctx, i_img_pool_stats *stats) {
+  i_int_img_pool_t pool = ctx->img_pool;
+
+  memset(stats, 0, sizeof(*stats));
+  if (!pool)
+    return;
+
+  stats->max_bytes = pool->max_bytes;
+  stats->bytes = pool->bytes;
+  stats->buffers = pool->buffers;
+  stats->hits = pool->hits;
+  stats->misses = pool->misses;
+  stats->image_hits = pool->image_hits;
+  stats->image_misses = pool->image_misses;
+}
+
+/*
+=back
+
+=head1 SEE ALSO
+
+context.c, image.c
+
+=cut
+*/
@@ -152,6 +152,12 @@ returns -1 and pushes an error.
 #define i_get_image_file_limits(width, height, bytes) im_get_image_file_limits(aIMCTX, width, height, bytes)
 #define i_int_check_image_file_limits(width, height, channels, sample_size) im_int_check_image_file_limits(aIMCTX, width, height, channels, sample_size)
 
+#define i_set_threads(threads) im_set_threads(aIMCTX, (threads))
+#define i_get_threads() im_get_threads(aIMCTX)
+
+#define i_set_image_pool(max_bytes) im_set_image_pool(aIMCTX, (max_bytes))
+#define i_get_image_pool_stats(stats) im_get_image_pool_stats(aIMCTX, (stats))
+
 #define i_clear_error() im_clear_error(aIMCTX)
 #define i_push_errorvf(code, fmt, args) im_push_errorvf(aIMCTX, code, fmt, args)
 #define i_push_error(code, msg) im_push_error(aIMCTX, code, msg)
@@ -162,5 +168,6 @@ returns -1 and pushes an error.
 #define io_new_buffer(data, len, closecb, closectx) im_io_new_buffer(aIMCTX, (data), (len), (closecb), (closectx))
 #define io_new_cb(p, readcb, writecb, seekcb, closecb, destroycb) \
   im_io_new_cb(aIMCTX, (p), (readcb), (writecb), (seekcb), (closecb), (destroycb))
+#define io_new_mmap(fd) im_io_new_mmap(aIMCTX, (fd))
 
 #endif
@@ -28,4 +28,9 @@ typedef i_fill_t* Imager__FillHandle;
 
 typedef io_glue *Imager__IO;
 
+/* incremental decoders and encoders, the handle owns the decoder or
+   encoder */
+typedef i_decoder *Imager__DecoderHandle;
+typedef i_encoder *Imager__EncoderHandle;
+
 #endif
@@ -0,0 +1,28 @@
+/* Declares the runtime CPU feature checks used to select vectorized
+   implementations of some inner loops.
+
+   Not part of the extension API.
+*/
+#ifndef IMAGER_IMSIMD_H_
+#define IMAGER_IMSIMD_H_
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define IM_SIMD_X86 1
+#  if defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+/* can compile AVX2 code in functions marked with IM_TARGET_AVX2 */
+#    define IM_SIMD_HAVE_AVX2 1
+#    define IM_TARGET_AVX2 __attribute__((target("avx2")))
+#  endif
+#endif
+
+#if defined(__SSE2__)
+#  define IM_SIMD_HAVE_SSE2 1
+#endif
+
+#define IM_SIMD_SSE2 0x01
+#define IM_SIMD_AVX2 0x02
+
+extern unsigned i_simd_features(void);
+extern unsigned i_simd_set_mask(unsigned mask);
+
+#endif
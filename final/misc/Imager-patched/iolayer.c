@@ -11,13 +11,19 @@
 #include <string.h>
 #include <errno.h>
 #include "imageri.h"
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#define IO_HAVE_MMAP
+#endif
 
 #define IOL_DEB(x)
 #define IOL_DEBs stderr
 
 #define IO_BUF_SIZE 8192
 
-char *io_type_names[] = { "FDSEEK", "FDNOSEEK", "BUFFER", "CBSEEK", "CBNOSEEK", "BUFCHAIN" };
+char *io_type_names[] = { "FDSEEK", "FDNOSEEK", "BUFFER", "CBSEEK", "CBNOSEEK", "BUFCHAIN", "MEMMAP" };
 
 typedef struct io_blink {
   char buf[BBSIZ];
@@ -128,6 +134,8 @@ static void
 i_io_start_write(io_glue *ig);
 static int
 i_io_read_fill(io_glue *ig, ssize_t needed);
+static int
+buffer_read_fill(io_glue *ig);
 static void
 dump_data(unsigned char *start, unsigned char *end, int bias);
 static ssize_t realseek_read(io_glue *igo, void *buf, size_t count);
@@ -278,6 +286,117 @@ im_io_new_fd(pIMCTX, int fd) {
   return (io_glue *)ig;
 }
 
+#ifdef IO_HAVE_MMAP
+
+struct io_mmap_region {
+  void *addr;
+  size_t len;
+};
+
+static void
+io_mmap_unmap(void *p) {
+  struct io_mmap_region *region = p;
+
+  munmap(region->addr, region->len);
+  myfree(region);
+}
+
+#endif
+
+/*
+=item im_io_new_mmap(ctx, file)
+X<io_new_mmap API>X<im_io_new_mmap API>
+=order 10
+=category I/O Layers
+
+Returns a new io_glue object that reads from a read-only memory
+mapping of the regular file open on file descriptor C<file>, or NULL
+if the file can't be mapped.
+
+Reading starts from the current position of C<file>, but reading
+from the io_glue object doesn't move that position.  C<file> can be
+closed once the io_glue object is created.
+
+The file must not be truncated while the io_glue object exists.
+
+Buffered reads from the io_glue object return data directly from the
+mapping rather than through an intermediate buffer, see
+i_io_read_ptr().
+
+This always fails on Win32.
+
+  ctx - an Imager context object
+  file - file descriptor to read from
+
+Also callable as C<io_new_mmap(file)>.
+
+=cut
+*/
+
+io_glue *
+im_io_new_mmap(pIMCTX, int fd) {
+#ifdef IO_HAVE_MMAP
+  struct stat st;
+  struct io_mmap_region *region = NULL;
+  const char *data = NULL;
+  size_t len;
+  off_t pos;
+  io_glue *ig;
+
+  im_log((aIMCTX, 1, "io_new_mmap(fd %d)\n", fd));
+  im_clear_error(aIMCTX);
+
+  if (fstat(fd, &st) < 0) {
+    im_push_errorf(aIMCTX, errno, "cannot stat file: %s", my_strerror(errno));
+    return NULL;
+  }
+  if (!S_ISREG(st.st_mode)) {
+    im_push_error(aIMCTX, 0, "only regular files can be mapped");
+    return NULL;
+  }
+  len = st.st_size;
+  if ((off_t)len != st.st_size) {
+    im_push_error(aIMCTX, 0, "file too large to map");
+    return NULL;
+  }
+
+  if (len) {
+    void *addr = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      im_push_errorf(aIMCTX, errno, "cannot map file: %s", my_strerror(errno));
+      return NULL;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(addr, len, MADV_SEQUENTIAL);
+#endif
+    region = mymalloc(sizeof(struct io_mmap_region));
+    region->addr = addr;
+    region->len = len;
+    data = addr;
+  }
+
+  pos = lseek(fd, 0, SEEK_CUR);
+  if (pos < 0)
+    pos = 0;
+  else if (pos > st.st_size)
+    pos = st.st_size;
+
+  ig = im_io_new_buffer(aIMCTX, data, len, region ? io_mmap_unmap : NULL,
+			region);
+  ig->type = MEMMAP;
+  ((io_buffer *)ig)->cpos = pos;
+
+  im_log((aIMCTX, 1, "(%p) <- io_new_mmap\n", ig));
+
+  return ig;
+#else
+  im_log((aIMCTX, 1, "io_new_mmap(fd %d)\n", fd));
+  im_push_error(aIMCTX, 0, "memory mapped files aren't supported on this platform");
+
+  return NULL;
+#endif
+}
+
 /*
 =item im_io_new_cb(ctx, p, read_cb, write_cb, seek_cb, close_cb, destroy_cb)
 X<im_io_new_cb API>X<io_new_cb API>
@@ -569,6 +688,11 @@ i_io_peekn(io_glue *ig, void *buf, size_t size) {
   if (!ig->buffer)
     i_io_setup_buffer(ig);
 
+  /* memory sources could return more, but keep to the documented
+     limit */
+  if (size > ig->buf_size)
+    size = ig->buf_size;
+
   if ((!ig->read_ptr || size > ig->read_end - ig->read_ptr)
       && !(ig->buf_eof || ig->error)) {
     i_io_read_fill(ig, size);
@@ -741,6 +865,86 @@ i_io_read(io_glue *ig, void *buf, size_t size) {
   return read_total;
 }
 
+/*
+=item i_io_read_ptr(io, &data, size)
+=category I/O Layers
+=synopsis const unsigned char *data;
+=synopsis ssize_t count = i_io_read_ptr(io, &data, size);
+
+Read up to C<size> bytes from the stream C<io> without copying them,
+setting C<data> to point at the bytes read.
+
+For a stream from io_new_buffer() or io_new_mmap() C<data> points
+into the caller's buffer or the mapped file, and everything left in
+the stream is available from the first call.  Other streams return
+at most the size of their buffer, see i_io_set_buffer_size().
+
+The data is only valid until the next operation on the stream.
+
+Returns the number of bytes read.  Returns 0 on end of file.  Returns
+-1 on error.
+
+=cut
+*/
+
+ssize_t
+i_io_read_ptr(io_glue *ig, const unsigned char **pdata, size_t size) {
+  size_t avail;
+
+  IOL_DEB(fprintf(IOL_DEBs, "i_io_read_ptr(%p, %p, %u)\n", ig, pdata, (unsigned)size));
+
+  if (size == 0) {
+    dIMCTXio(ig);
+    i_push_error(0, "read_ptr size must be positive");
+    return -1;
+  }
+
+  if (ig->write_ptr) {
+    IOL_DEB(fprintf(IOL_DEBs, "i_io_read_ptr() => -1 (write_ptr set)\n"));
+    return -1;
+  }
+
+  if (!ig->buffer)
+    i_io_setup_buffer(ig);
+
+  if (!ig->read_ptr || ig->read_ptr == ig->read_end) {
+    if (ig->error)
+      return -1;
+    if (ig->buf_eof)
+      return 0;
+
+    if (!ig->buffered && ig->type != BUFFER && ig->type != MEMMAP) {
+      /* don't read more than we were asked for */
+      ssize_t rc = i_io_raw_read(ig, ig->buffer,
+				 size < ig->buf_size ? size : ig->buf_size);
+      if (rc < 0) {
+	ig->error = 1;
+	return -1;
+      }
+      else if (rc == 0) {
+	ig->buf_eof = 1;
+	return 0;
+      }
+      ig->read_ptr = ig->buffer;
+      ig->read_end = ig->buffer + rc;
+    }
+    else if (!i_io_read_fill(ig, 1)) {
+      IOL_DEB(fprintf(IOL_DEBs, "i_io_read_ptr() => %d (fill failure)\n", ig->error ? -1 : 0));
+      return ig->error ? -1 : 0;
+    }
+  }
+
+  avail = ig->read_end - ig->read_ptr;
+  if (avail > size)
+    avail = size;
+  *pdata = ig->read_ptr;
+  ig->read_ptr += avail;
+
+  IOL_DEB(fprintf(IOL_DEBs, "i_io_read_ptr() => %d\n", (int)avail));
+
+  return avail;
+}
+
 /*
 =item i_io_write(io, buffer, size)
 =category I/O Layers
@@ -1066,6 +1270,48 @@ i_io_set_buffered(io_glue *ig, int buffered) {
   return 1;
 }
 
+/*
+=item i_io_set_buffer_size(io, size)
+=category I/O Layers
+
+Set the size of the buffer used for buffered reads and writes on the
+stream.  The default is 8192 bytes.
+
+This also limits how much i_io_peekn() can return.  Buffered reads
+from io_new_buffer() and io_new_mmap() streams return the source data
+directly and don't use the buffer.
+
+Returns true on success.  Fails if C<size> is zero or if there is
+buffered input or output.
+
+=cut
+*/
+
+int
+i_io_set_buffer_size(io_glue *ig, size_t size) {
+  if (size == 0) {
+    dIMCTXio(ig);
+    i_push_error(0, "buffer size must be positive");
+    return 0;
+  }
+  if ((ig->write_ptr && ig->write_ptr != ig->buffer)
+      || (ig->read_ptr && ig->read_ptr != ig->read_end)) {
+    dIMCTXio(ig);
+    i_push_error(0, "cannot change the buffer size with data buffered");
+    return 0;
+  }
+
+  if (ig->buffer) {
+    myfree(ig->buffer);
+    ig->buffer = NULL;
+  }
+  ig->read_ptr = ig->read_end = NULL;
+  ig->write_ptr = ig->write_end = NULL;
+  ig->buf_size = size;
+
+  return 1;
+}
+
 /*
 =item i_io_dump(ig)
 
@@ -1162,6 +1408,12 @@ i_io_read_fill(io_glue *ig, ssize_t needed) {
   if (ig->error || ig->buf_eof)
     return 0;
 
+  if (ig->type == BUFFER || ig->type == MEMMAP) {
+    rc = buffer_read_fill(ig);
+    if (rc >= 0)
+      return rc;
+  }
+
   if (needed > ig->buf_size)
     needed = ig->buf_size;
 
@@ -1523,6 +1775,48 @@ buffer_seek(io_glue *igo, off_t offset, int whence) {
   /* FIXME: How about implementing this offset handling stuff? */
 }
 
+/*
+=item buffer_read_fill(ig)
+
+Buffered reads from a buffer or memory mapped source read directly
+from the source data, so rather than copying to the io_glue buffer
+this makes everything left in the source available at once.
+
+Returns -1 if there are bytes left in the io_glue buffer from reads
+made while unbuffered, which are followed by more of the source, so
+the caller needs to fill the buffer the normal way.
+
+=cut
+*/
+
+static int
+buffer_read_fill(io_glue *igo) {
+  io_buffer *ig = (io_buffer *)igo;
+
+  if (igo->read_ptr && igo->read_ptr < igo->read_end) {
+    if (ig->cpos < ig->len)
+      return -1;
+
+    /* everything left is already available */
+    igo->buf_eof = 1;
+    return 1;
+  }
+  if (ig->cpos >= ig->len) {
+    igo->buf_eof = 1;
+    return 0;
+  }
+
+  /* the io_glue never writes through read_ptr */
+  igo->read_ptr = (unsigned char *)ig->data + ig->cpos;
+  igo->read_end = (unsigned char *)ig->data + ig->len;
+  ig->cpos = ig->len;
+
+  IOL_DEB(fprintf(IOL_DEBs, "buffer_read_fill => 1, %u available\n",
+		  (unsigned)(igo->read_end - igo->read_ptr)));
+
+  return 1;
+}
+
 static
 void
 buffer_destroy(io_glue *igo) {
@@ -26,6 +26,7 @@ io_glue *im_io_new_fd(pIMCTX, int fd);
 io_glue *im_io_new_bufchain(pIMCTX);
 io_glue *im_io_new_buffer(pIMCTX, const char *data, size_t len, i_io_closebufp_t closecb, void *closedata);
 io_glue *im_io_new_cb(pIMCTX, void *p, i_io_readl_t readcb, i_io_writel_t writecb, i_io_seekl_t seekcb, i_io_closel_t closecb, i_io_destroyl_t destroycb);
+io_glue *im_io_new_mmap(pIMCTX, int fd);
 size_t   io_slurp(io_glue *ig, unsigned char **c);
 void     io_glue_destroy(io_glue *ig);
 
@@ -37,11 +38,13 @@ extern int i_io_peekc_imp(io_glue *ig);
 extern ssize_t i_io_peekn(io_glue *ig, void *buf, size_t size);
 extern int i_io_putc_imp(io_glue *ig, int c);
 extern ssize_t i_io_read(io_glue *ig, void *buf, size_t size);
+extern ssize_t i_io_read_ptr(io_glue *ig, const unsigned char **pdata, size_t size);
 extern ssize_t i_io_write(io_glue *ig, const void *buf, size_t size);
 extern off_t i_io_seek(io_glue *ig, off_t offset, int whence);
 extern int i_io_flush(io_glue *ig);
 extern int i_io_close(io_glue *ig);
 extern int i_io_set_buffered(io_glue *ig, int buffered);
+extern int i_io_set_buffer_size(io_glue *ig, size_t size);
 extern ssize_t i_io_gets(io_glue *ig, char *, size_t, int);
 
 #endif /* _IOLAYER_H_ */
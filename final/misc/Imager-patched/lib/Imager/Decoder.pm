@@ -0,0 +1,230 @@
+package Imager::Decoder;
+use strict;
+use Imager;
+use vars qw($VERSION);
+
+$VERSION = "1.000";
+
+=head1 NAME
+
+Imager::Decoder - decode an image as its data arrives
+
+=head1 SYNOPSIS
+
+  use Imager;
+
+  # build the image from data as it arrives
+  my $dec = Imager->new_decoder(type => "jpeg")
+    or die Imager->errstr;
+  while (my $chunk = next_chunk()) {
+    $dec->feed($chunk)
+      or die $dec->errstr;
+  }
+  $dec->finish
+    or die $dec->errstr;
+  my $im = $dec->image;
+
+  # or process each row as it's decoded
+  my $dec = Imager->new_decoder
+    (
+     type => "png",
+     header => sub {
+       my ($info) = @_;
+       die "too big\n" if $info->{width} > 10_000;
+     },
+     row => sub {
+       my ($y, $samples) = @_;
+       ...
+     },
+    ) or die Imager->errstr;
+
+=head1 DESCRIPTION
+
+Imager's file readers need the complete file before they return the
+image.  A decoder instead accepts the file data a piece at a time,
+such as while it's being received over the network, and decodes as
+much as it can from each piece, so the image size is known as soon as
+the header arrives, and rows can be processed, or the decode
+abandoned, before the rest of the data is available.
+
+Decoders are created with L<Imager/new_decoder()>, and are currently
+available for the C<jpeg> and C<png> formats.
+
+Rows are always decoded to 8-bit samples.  Palette and grayscale
+images with transparency are expanded to the channels needed to
+represent them.
+
+=head1 METHODS
+
+=over
+
+=item feed()
+
+  $dec->feed($data)
+    or die $dec->errstr;
+
+Supply the next piece of the file.  Any header and row callbacks are
+called before this returns for whatever can be decoded so far.
+
+Returns true on success.  Once a decoder fails, whether from bad data
+or from a callback dying, it can't be used further.
+
+=cut
+
+sub feed {
+  my ($self, $data) = @_;
+
+  $self->{handle}->feed($data)
+    or return $self->_set_error(Imager->_error_as_msg);
+
+  return 1;
+}
+
+=item finish()
+
+  $dec->finish
+    or die $dec->errstr;
+
+Tell the decoder the data is complete.  Fails if the file was
+incomplete.
+
+=cut
+
+sub finish {
+  my ($self) = @_;
+
+  $self->{handle}->finish
+    or return $self->_set_error(Imager->_error_as_msg);
+
+  return 1;
+}
+
+=item image()
+
+  my $im = $dec->image;
+
+Returns the decoded image as an Imager object, once finish() has
+succeeded.
+
+The image is only built when no C<row> callback was supplied to
+new_decoder(), otherwise this returns nothing.
+
+=cut
+
+sub image {
+  my ($self) = @_;
+
+  unless ($self->{image}) {
+    my $raw = $self->{handle}->take_image
+      or return $self->_set_error("image: no image available");
+    $self->{image} = Imager->new;
+    $self->{image}{IMG} = $raw;
+  }
+
+  return $self->{image};
+}
+
+=item info()
+
+  my $info = $dec->info;
+
+Returns a hash reference describing the image, as returned by
+L<Imager::Files/probe()>, once the header has been decoded, or
+nothing before then.
+
+C<channels> is the number of channels in the decoded rows.
+
+=cut
+
+sub info {
+  my ($self) = @_;
+
+  return $self->{handle}->info;
+}
+
+=item rows()
+
+  my $count = $dec->rows;
+
+The number of rows decoded so far.
+
+=cut
+
+sub rows {
+  my ($self) = @_;
+
+  return $self->{handle}->rows;
+}
+
+=item errstr()
+
+  my $message = $dec->errstr;
+
+Returns the error message from the last failed operation.
+
+=cut
+
+sub errstr {
+  my ($self) = @_;
+
+  return $self->{errstr};
+}
+
+sub _set_error {
+  my ($self, $msg) = @_;
+
+  $self->{errstr} = $msg;
+
+  return;
+}
+
+sub _new {
+  my ($class, $handle, %opts) = @_;
+
+  $handle->set_callbacks($opts{header}, $opts{row});
+
+  return bless { handle => $handle, errstr => undef }, $class;
+}
+
+1;
+
+__END__
+
+=back
+
+=head1 CALLBACKS
+
+=over
+
+=item *
+
+C<header> - called once the image header has been decoded, with a
+hash reference describing the image, as returned by info().
+
+=item *
+
+C<row> - called for each row from top to bottom, with the row number
+and a string of packed 8-bit samples, C<width * channels> bytes long.
+Unpack it with C<unpack("C*", $samples)> or write it to an image with
+C<< $im->setsamples(y => $y, data => $samples) >>.
+
+=back
+
+To stop decoding, die from either callback.  The feed() call that
+called it fails with the exception as the error message.
+
+=head1 NOTES
+
+For progressive JPEG and interlaced PNG files the rows are only known
+once all of the data has arrived, so the row callbacks are only
+called by the final feed() or finish().
+
+=head1 AUTHOR
+
+Tony Cook <tonyc@cpan.org>
+
+=head1 SEE ALSO
+
+L<Imager>, L<Imager::Files/new_decoder()>
+
+=cut
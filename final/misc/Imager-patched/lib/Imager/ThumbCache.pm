@@ -0,0 +1,655 @@
+package Imager::ThumbCache;
+use strict;
+use Imager;
+use File::Spec;
+use vars qw($VERSION);
+
+$VERSION = "1.000";
+
+=head1 NAME
+
+Imager::ThumbCache - cache encoded thumbnails and scaled images
+
+=head1 SYNOPSIS
+
+  use Imager::ThumbCache;
+  my $cache = Imager::ThumbCache->new(max_bytes => 32_000_000,
+                                      dir => "/var/cache/thumbs");
+
+  # square thumbnail of a file, keyed on the file's contents
+  my $png = $cache->square_thumbnail(in => { file => "photo.jpg" },
+                                     size => 64,
+                                     type => "png")
+    or die $cache->errstr;
+
+  # keyed on an identifier instead of the source bytes
+  my $jpeg = $cache->scale(id => "image/1234",
+                           in => { file => $path },
+                           xpixels => 400, ypixels => 400,
+                           type => "jpeg", jpegquality => 85)
+    or die $cache->errstr;
+
+  # any other pipeline
+  my $data = $cache->fetch([ "grey", $id, 200 ], sub {
+    my $im = Imager->new(file => $path) or return;
+    my $data;
+    $im->scale(xpixels => 200)->convert(preset => "grey")
+      ->write(data => \$data, type => "png")
+      or return;
+    return $data;
+  });
+
+  my %stats = $cache->stats;
+
+=head1 DESCRIPTION
+
+Web applications that serve thumbnails and scaled images tend to
+produce the same few outputs from the same sources over and over.
+Imager::ThumbCache keeps the encoded results in memory, keyed on a
+digest of the source, either its bytes or an identifier you supply,
+and of the operation and its parameters, so a repeated request is
+served without decoding, scaling or encoding anything.
+
+The cache is a least recently used list bounded by the total size of
+the data held.  If a directory is supplied, entries evicted from
+memory are written there and read back, and copied back into memory,
+when next requested.
+
+A cache object isn't shared between processes or threads, though
+several processes can share a spill directory.
+
+=head1 METHODS
+
+=over
+
+=item new()
+
+  my $cache = Imager::ThumbCache->new(%opts);
+
+Create a new cache.  Options:
+
+=over
+
+=item *
+
+C<max_bytes> - the maximum total size of the encoded data held in
+memory.  Default: 16,000,000.
+
+=item *
+
+C<max_entries> - the maximum number of entries held in memory.
+Default: no limit.
+
+=item *
+
+C<dir> - a directory to spill entries evicted from memory to.  This
+must already exist.  Files are named by a digest of the key, so any
+key is safe to use.  Default: entries are discarded when evicted.
+Imager::ThumbCache doesn't limit the size of this directory, remove
+old files from it as needed.
+
+=back
+
+=cut
+
+sub new {
+  my ($class, %opts) = @_;
+
+  my $max_bytes = defined $opts{max_bytes} ? $opts{max_bytes} : 16_000_000;
+  unless ($max_bytes =~ /^[0-9]+$/) {
+    Imager->_set_error("Imager::ThumbCache: max_bytes must be a non-negative integer");
+    return;
+  }
+  my $max_entries = $opts{max_entries};
+  if (defined $max_entries && $max_entries !~ /^[0-9]+$/) {
+    Imager->_set_error("Imager::ThumbCache: max_entries must be a non-negative integer");
+    return;
+  }
+  if (defined $opts{dir} && !-d $opts{dir}) {
+    Imager->_set_error("Imager::ThumbCache: dir $opts{dir} isn't a directory");
+    return;
+  }
+
+  # the LRU list is circular, through a sentinel node, each node is
+  # [ prev, next, key, data ]
+  my $head = [];
+  @$head = ( $head, $head );
+
+  return bless
+    {
+     max_bytes => $max_bytes,
+     max_entries => $max_entries,
+     dir => $opts{dir},
+     head => $head,
+     nodes => {},
+     bytes => 0,
+     hits => 0,
+     misses => 0,
+     disk_hits => 0,
+     evictions => 0,
+    }, $class;
+}
+
+sub _digest {
+  require Digest::MD5;
+
+  return Digest::MD5::md5_hex(@_);
+}
+
+=item key()
+
+  my $key = $cache->key(@parts);
+
+Returns the key used for the given list of parts.  Each part is a
+plain scalar, or an array or hash reference, which is flattened, hash
+keys sorted, so the same parameters always produce the same key.
+
+=cut
+
+sub key {
+  my ($self, @parts) = @_;
+
+  return _digest(_flatten(\@parts));
+}
+
+sub _flatten {
+  my ($item) = @_;
+
+  if (ref $item eq "ARRAY") {
+    return "[" . join(",", map _flatten($_), @$item) . "]";
+  }
+  elsif (ref $item eq "HASH") {
+    return "{" . join(",", map { _flatten($_) . "=" . _flatten($item->{$_}) }
+		      sort keys %$item) . "}";
+  }
+  elsif (defined $item) {
+    (my $escaped = $item) =~ s/([\\,=\[\]{}])/\\$1/g;
+    return $escaped;
+  }
+  else {
+    return "\\u";
+  }
+}
+
+=item fetch()
+
+  my $data = $cache->fetch($key, $code);
+  my $data = $cache->fetch(\@parts, $code);
+
+Returns the data cached under C<$key>, or under the key for C<@parts>
+as produced by key().  If nothing is cached, calls C<$code>, which
+should return the encoded data, caches it and returns it.
+
+If C<$code> returns nothing, nothing is cached and fetch() returns
+nothing.
+
+=cut
+
+sub fetch {
+  my ($self, $key, $code) = @_;
+
+  ref $key
+    and $key = $self->key(@$key);
+
+  my $data = $self->get($key);
+  defined $data
+    and return $data;
+
+  $data = $code->();
+  defined $data
+    or return;
+  $self->set($key, $data);
+
+  return $data;
+}
+
+=item get()
+
+  my $data = $cache->get($key);
+
+Returns the data cached under C<$key>, from memory or the spill
+directory, or nothing if the key isn't cached.  Data read from the
+spill directory is kept in memory too, and the file is left for any
+other processes sharing the directory.
+
+=cut
+
+sub get {
+  my ($self, $key) = @_;
+
+  my $node = $self->{nodes}{$key};
+  if ($node) {
+    ++$self->{hits};
+    _unlink_node($node);
+    _link_node($self->{head}, $node);
+    return $node->[3];
+  }
+
+  if ($self->{dir}) {
+    my $file = $self->_file($key);
+    if (open my $fh, "<", $file) {
+      binmode $fh;
+      my $data = do { local $/; <$fh> };
+      close $fh;
+      if (defined $data) {
+	++$self->{disk_hits};
+	length $data > $self->{max_bytes}
+	  or $self->_store($key, $data);
+	return $data;
+      }
+    }
+  }
+
+  ++$self->{misses};
+
+  return;
+}
+
+=item set()
+
+  $cache->set($key, $data);
+
+Store C<$data> under C<$key>, evicting the least recently used
+entries as needed to stay within the limits.  Data larger than
+C<max_bytes> is spilled straight to the directory, if any.
+
+=cut
+
+sub set {
+  my ($self, $key, $data) = @_;
+
+  $self->remove($key);
+
+  if (length $data > $self->{max_bytes}) {
+    $self->_spill($key, $data);
+    return 1;
+  }
+
+  return $self->_store($key, $data);
+}
+
+# add to memory, evicting as needed, without touching the spill
+# directory
+sub _store {
+  my ($self, $key, $data) = @_;
+
+  my $node = [ undef, undef, $key, $data ];
+  _link_node($self->{head}, $node);
+  $self->{nodes}{$key} = $node;
+  $self->{bytes} += length $data;
+
+  my $head = $self->{head};
+  while ($self->{bytes} > $self->{max_bytes}
+	 || (defined $self->{max_entries}
+	     && keys %{$self->{nodes}} > $self->{max_entries})) {
+    my $oldest = $head->[0];
+    $oldest == $head
+      and last;
+    _unlink_node($oldest);
+    delete $self->{nodes}{$oldest->[2]};
+    $self->{bytes} -= length $oldest->[3];
+    ++$self->{evictions};
+    $self->_spill($oldest->[2], $oldest->[3]);
+  }
+
+  return 1;
+}
+
+=item remove()
+
+  $cache->remove($key);
+
+Remove any entry for C<$key> from memory and the spill directory.
+
+=cut
+
+sub remove {
+  my ($self, $key) = @_;
+
+  if (my $node = delete $self->{nodes}{$key}) {
+    _unlink_node($node);
+    $self->{bytes} -= length $node->[3];
+  }
+  $self->{dir}
+    and unlink $self->_file($key);
+
+  return 1;
+}
+
+=item clear()
+
+  $cache->clear;
+
+Remove all entries from memory.  Files in the spill directory are
+left alone.
+
+=cut
+
+sub clear {
+  my ($self) = @_;
+
+  my $head = $self->{head};
+  # break the cycles
+  for my $node (values %{$self->{nodes}}) {
+    @$node = ();
+  }
+  @$head = ( $head, $head );
+  $self->{nodes} = {};
+  $self->{bytes} = 0;
+
+  return 1;
+}
+
+=item stats()
+
+  my %stats = $cache->stats;
+
+Returns statistics for the cache as key/value pairs:
+
+=over
+
+=item *
+
+C<entries>, C<bytes> - the number of entries and bytes of data held
+in memory.
+
+=item *
+
+C<hits> - requests served from memory.
+
+=item *
+
+C<disk_hits> - requests served from the spill directory.
+
+=item *
+
+C<misses> - requests that weren't cached.
+
+=item *
+
+C<evictions> - entries removed from memory to stay within the
+limits.
+
+=back
+
+=cut
+
+sub stats {
+  my ($self) = @_;
+
+  return
+    (
+     entries => scalar(keys %{$self->{nodes}}),
+     map { $_ => $self->{$_} } qw(bytes hits disk_hits misses evictions),
+    );
+}
+
+=item square_thumbnail()
+
+  my $data = $cache->square_thumbnail(in => \%in, size => $size,
+                                      type => $type, %write_opts);
+
+Returns a C<size> by C<size> thumbnail of the centered square of the
+source image, encoded as C<type>, as produced by
+L<Imager::Files/square_thumbnail()>, from the cache if possible.
+
+C<in> supplies the source as for read(), with C<file>, C<data>, C<fh>
+or C<io> and optionally C<type>.  Unless you supply an C<id> the
+source is read in full to compute its digest, which is much cheaper
+than decoding it.  Sources supplied as C<fh> or C<io> must be read
+this way, C<callback> sources aren't supported.
+
+C<type> is the output file type, by default the type of the source.
+Any other options, such as C<jpegquality>, are passed to the writer
+and are part of the key.
+
+Returns nothing on failure, check C<< $cache->errstr >>.
+
+=cut
+
+sub square_thumbnail {
+  my ($self, %opts) = @_;
+
+  my $size = delete $opts{size};
+  unless (defined $size && $size =~ /^[1-9][0-9]*$/) {
+    $self->_set_error("square_thumbnail: size must be a positive integer");
+    return;
+  }
+
+  return $self->_cached
+    ("square_thumbnail", { size => $size }, \%opts,
+     sub {
+       my ($in, $type, $write_opts) = @_;
+       my $data;
+       Imager->square_thumbnail(in => $in, size => $size,
+				out => { data => \$data, type => $type },
+				%$write_opts)
+	 or return $self->_set_error(Imager->errstr);
+       return $data;
+     });
+}
+
+=item scale()
+
+  my $data = $cache->scale(in => \%in, xpixels => $width,
+                           ypixels => $height, type => $type,
+                           %write_opts);
+
+Returns the source image, optionally cropped, scaled and encoded as
+C<type>, from the cache if possible.
+
+C<in>, C<id> and C<type> are as for square_thumbnail().  The crop()
+parameters C<left>, C<top>, C<width> and C<height> select a region of
+the source, the scale() parameters C<xpixels>, C<ypixels>,
+C<scalefactor>, C<type> (as C<scale_type>) and C<qtype> set the size,
+with C<qtype> defaulting to C<mixing>.  Other options are passed to
+the writer.
+
+Returns nothing on failure, check C<< $cache->errstr >>.
+
+=cut
+
+my @crop_opts = qw(left top width height);
+my @scale_opts = qw(xpixels ypixels scalefactor scale_type qtype);
+
+sub scale {
+  my ($self, %opts) = @_;
+
+  my %crop;
+  for my $name (@crop_opts) {
+    exists $opts{$name}
+      and $crop{$name} = delete $opts{$name};
+  }
+  my %scale = ( qtype => "mixing" );
+  for my $name (@scale_opts) {
+    exists $opts{$name}
+      and $scale{$name} = delete $opts{$name};
+  }
+  exists $scale{scale_type}
+    and $scale{type} = delete $scale{scale_type};
+
+  return $self->_cached
+    ("scale", { crop => \%crop, scale => \%scale }, \%opts,
+     sub {
+       my ($in, $type, $write_opts) = @_;
+       my $im = Imager->new(%$in)
+	 or return $self->_set_error(Imager->errstr);
+       if (keys %crop) {
+	 $im = $im->crop(%crop)
+	   or return $self->_set_error(Imager->errstr);
+       }
+       $im = $im->scale(%scale)
+	 or return $self->_set_error(Imager->errstr);
+       my $data;
+       $im->write(data => \$data, type => $type, %$write_opts)
+	 or return $self->_set_error($im->errstr);
+       return $data;
+     });
+}
+
+# common code for the source based operations, reads the source to
+# compute its digest, unless there's an id, and calls $make with the
+# source, output type and writer options on a miss
+sub _cached {
+  my ($self, $op, $params, $opts, $make) = @_;
+
+  my %opts = %$opts;
+  my $in = delete $opts{in};
+  unless (ref $in eq "HASH") {
+    $self->_set_error("$op: in must be a hash ref");
+    return;
+  }
+  my %in = %$in;
+  my $id = delete $opts{id};
+  my $type = delete $opts{type};
+
+  my $source_key;
+  if (defined $id) {
+    $source_key = [ id => $id ];
+  }
+  else {
+    my $bytes = $self->_source_bytes(\%in, $op)
+      or return;
+    # decode from memory, so the source is only read once
+    $in{type} ||= $in{file} && $Imager::FORMATGUESS->($in{file})
+      || Imager::i_test_format_probe(Imager::io_new_buffer(substr($$bytes, 0, 4096)), -1);
+    %in = ( data => $$bytes, ($in{type} ? ( type => $in{type} ) : ()) );
+    $source_key = [ md5 => _digest($$bytes) ];
+  }
+
+  $type ||= $in{type} || $in{file} && $Imager::FORMATGUESS->($in{file});
+  unless ($type) {
+    $self->_set_error("$op: type parameter missing and it couldn't be determined from the source");
+    return;
+  }
+
+  my $key = $self->key($op, $source_key, $params, $type, \%opts);
+  my $data = $self->get($key);
+  defined $data
+    and return $data;
+
+  $data = $make->(\%in, $type, \%opts);
+  defined $data
+    or return;
+  $self->set($key, $data);
+
+  return $data;
+}
+
+sub _source_bytes {
+  my ($self, $in, $op) = @_;
+
+  if (defined $in->{data}) {
+    my $data = ref $in->{data} ? ${$in->{data}} : $in->{data};
+    return \$data;
+  }
+  elsif (defined $in->{file}) {
+    open my $fh, "<", $in->{file}
+      or return $self->_set_error("$op: cannot open $in->{file}: $!");
+    binmode $fh;
+    my $data = do { local $/; <$fh> };
+    close $fh;
+    return \$data;
+  }
+  elsif ($in->{fh} || $in->{fd} || $in->{io}) {
+    my $io = $in->{io} || Imager::io_new_fd($in->{fd} || fileno($in->{fh}));
+    my $data = "";
+    while (defined(my $chunk = $io->read2(65536))) {
+      length $chunk
+	or last;
+      $data .= $chunk;
+    }
+    return \$data;
+  }
+  else {
+    $self->_set_error("$op: in needs one of file, data, fh, fd or io, or supply an id");
+    return;
+  }
+}
+
+sub _spill {
+  my ($self, $key, $data) = @_;
+
+  my $dir = $self->{dir}
+    or return;
+  my $file = $self->_file($key);
+  my $work = "$file.$$.tmp";
+  if (open my $fh, ">", $work) {
+    binmode $fh;
+    if (print $fh $data and close $fh) {
+      rename $work, $file
+	and return;
+    }
+  }
+  unlink $work;
+}
+
+# keys can be any string, so always name the file by a digest of the
+# key, to keep it inside the directory
+sub _file {
+  my ($self, $key) = @_;
+
+  return File::Spec->catfile($self->{dir}, _digest($key));
+}
+
+sub _link_node {
+  my ($head, $node) = @_;
+
+  # newest next to the head
+  $node->[0] = $head;
+  $node->[1] = $head->[1];
+  $head->[1][0] = $node;
+  $head->[1] = $node;
+}
+
+sub _unlink_node {
+  my ($node) = @_;
+
+  $node->[0][1] = $node->[1];
+  $node->[1][0] = $node->[0];
+}
+
+=item errstr()
+
+  my $message = $cache->errstr;
+
+Returns the error message from the last failed operation.
+
+=cut
+
+sub errstr {
+  my ($self) = @_;
+
+  return $self->{errstr};
+}
+
+sub _set_error {
+  my ($self, $msg) = @_;
+
+  $self->{errstr} = $msg;
+
+  return;
+}
+
+sub DESTROY {
+  my ($self) = @_;
+
+  $self->clear;
+  @{$self->{head}} = ();
+}
+
+1;
+
+__END__
+
+=back
+
+=head1 AUTHOR
+
+Tony Cook <tonyc@cpan.org>
+
+=head1 SEE ALSO
+
+L<Imager>, L<Imager::Files/square_thumbnail()>
+
+=cut
@@ -37,3 +37,25 @@ void
 i_mutex_unlock(i_mutex_t m) {
   (void)m;
 }
+
+/* no worker threads, i_int_run_bands() runs every band in the
+   calling thread */
+
+i_int_pool_t
+i_int_pool_new(int threads) {
+  (void)threads;
+  return NULL;
+}
+
+void
+i_int_pool_destroy(i_int_pool_t pool) {
+  (void)pool;
+}
+
+void
+i_int_pool_run(i_int_pool_t pool, i_img_dim count, i_img_dim band_size,
+	       i_int_band_f f, void *p) {
+  (void)pool;
+  (void)band_size;
+  f(p, 0, count);
+}
@@ -5,6 +5,7 @@
 #include "imageri.h"
 
 #include <pthread.h>
+#include <signal.h>
 #include <errno.h>
 
 /* documented in mutexwin.c */
@@ -42,3 +43,169 @@ void
 i_mutex_unlock(i_mutex_t m) {
   pthread_mutex_unlock(&m->mutex);
 }
+
+/*
+  worker thread pool, see i_int_run_bands() in context.c
+
+  The calling thread takes bands along with the workers, bands are
+  handed out in order from a shared counter.
+*/
+
+struct i_int_pool_tag {
+  pthread_mutex_t mutex;
+  /* signalled when a new job is available or on shutdown */
+  pthread_cond_t work_cond;
+  /* signalled when the last running band of a job finishes */
+  pthread_cond_t done_cond;
+
+  int thread_count;
+  pthread_t *threads;
+  int quit;
+
+  /* the current job */
+  i_int_band_f f;
+  void *p;
+  i_img_dim count;
+  i_img_dim band_size;
+  i_img_dim next;
+  int running;
+};
+
+/* take the next band, called with the mutex held */
+static int
+pool_take(i_int_pool_t pool, i_img_dim *start, i_img_dim *end) {
+  if (pool->next >= pool->count)
+    return 0;
+
+  *start = pool->next;
+  *end = pool->next + pool->band_size;
+  if (*end > pool->count)
+    *end = pool->count;
+  pool->next = *end;
+  ++pool->running;
+
+  return 1;
+}
+
+/* finish a band, called with the mutex held */
+static void
+pool_done(i_int_pool_t pool) {
+  if (--pool->running == 0 && pool->next >= pool->count)
+    pthread_cond_broadcast(&pool->done_cond);
+}
+
+static void *
+pool_worker(void *p) {
+  i_int_pool_t pool = p;
+  i_img_dim start, end;
+
+  pthread_mutex_lock(&pool->mutex);
+  for (;;) {
+    while (!pool->quit && !pool_take(pool, &start, &end))
+      pthread_cond_wait(&pool->work_cond, &pool->mutex);
+    if (pool->quit)
+      break;
+    pthread_mutex_unlock(&pool->mutex);
+
+    pool->f(pool->p, start, end);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool_done(pool);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  return NULL;
+}
+
+i_int_pool_t
+i_int_pool_new(int threads) {
+  i_int_pool_t pool;
+  sigset_t all, old_mask;
+  int i;
+
+  if (threads < 2)
+    return NULL;
+
+  pool = malloc(sizeof(*pool));
+  if (!pool)
+    return NULL;
+  pool->threads = malloc(sizeof(pthread_t) * (threads - 1));
+  if (!pool->threads) {
+    free(pool);
+    return NULL;
+  }
+  if (pthread_mutex_init(&pool->mutex, NULL) != 0)
+    i_fatal(3, "Error initializing mutex %d", errno);
+  if (pthread_cond_init(&pool->work_cond, NULL) != 0
+      || pthread_cond_init(&pool->done_cond, NULL) != 0)
+    i_fatal(3, "Error initializing condition %d", errno);
+  pool->quit = 0;
+  pool->f = NULL;
+  pool->p = NULL;
+  pool->count = pool->next = pool->band_size = 0;
+  pool->running = 0;
+
+  /* the calling thread is one of the threads, signals are left to
+     it by starting the workers with them blocked */
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old_mask);
+  pool->thread_count = 0;
+  for (i = 0; i < threads - 1; ++i) {
+    if (pthread_create(pool->threads + i, NULL, pool_worker, pool) != 0)
+      break;
+    ++pool->thread_count;
+  }
+  pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+  if (pool->thread_count == 0) {
+    i_int_pool_destroy(pool);
+    return NULL;
+  }
+
+  return pool;
+}
+
+void
+i_int_pool_destroy(i_int_pool_t pool) {
+  int i;
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->quit = 1;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (i = 0; i < pool->thread_count; ++i)
+    pthread_join(pool->threads[i], NULL);
+
+  pthread_cond_destroy(&pool->work_cond);
+  pthread_cond_destroy(&pool->done_cond);
+  pthread_mutex_destroy(&pool->mutex);
+  free(pool->threads);
+  free(pool);
+}
+
+void
+i_int_pool_run(i_int_pool_t pool, i_img_dim count, i_img_dim band_size,
+	       i_int_band_f f, void *p) {
+  i_img_dim start, end;
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->f = f;
+  pool->p = p;
+  pool->count = count;
+  pool->band_size = band_size;
+  pool->next = 0;
+  pool->running = 0;
+  pthread_cond_broadcast(&pool->work_cond);
+
+  while (pool_take(pool, &start, &end)) {
+    pthread_mutex_unlock(&pool->mutex);
+    f(p, start, end);
+    pthread_mutex_lock(&pool->mutex);
+    pool_done(pool);
+  }
+  while (pool->running)
+    pthread_cond_wait(&pool->done_cond, &pool->mutex);
+
+  pool->count = pool->next = 0;
+  pthread_mutex_unlock(&pool->mutex);
+}
@@ -146,7 +146,7 @@ im_img_pal_new(pIMCTX, i_img_dim x, i_img_dim y, int channels, int maxpal) {
   im->ext_data = palext;
   i_tags_new(&im->tags);
   im->bytes = bytes;
-  im->idata = mymalloc(im->bytes);
+  im->idata = i_int_img_data_alloc(aIMCTX, im->bytes);
   im->channels = channels;
   memset(im->idata, 0, im->bytes);
   im->xsize = x;
@@ -206,7 +206,7 @@ i_img_to_rgb_inplace(i_img *im) {
 
   /* nasty hack */
   (im->i_f_destroy)(im);
-  myfree(im->idata);
+  i_int_img_data_free(aIMCTX, im->idata);
   *im = temp;
 
   return 1;
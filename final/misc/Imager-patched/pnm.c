@@ -421,59 +421,52 @@ read_pgm_ppm_ascii_16(io_glue *ig, i_img *im, int width, int height,
 }
 
 /*
-=item i_readpnm_wiol(ig, allow_incomplete)
-
-Retrieve an image and stores in the iolayer object. Returns NULL on fatal error.
+=item read_pnm_header(ig, &type, &width, &height, &maxval)
 
-   ig     - io_glue object
-   allow_incomplete - allows a partial file to be read successfully
+Reads the PNM header, leaving the stream positioned at the start of
+the image data.  Returns non-zero on success. (internal)
 
 =cut
 */
 
-i_img *
-i_readpnm_wiol( io_glue *ig, int allow_incomplete) {
-  i_img* im;
-  int type;
-  int width, height, maxval, channels;
+static int
+read_pnm_header(io_glue *ig, int *type, int *width, int *height,
+		int *maxval) {
   int c;
 
-  i_clear_error();
-  mm_log((1,"i_readpnm(ig %p, allow_incomplete %d)\n", ig, allow_incomplete));
-
   c = i_io_getc(ig);
 
   if (c != 'P') {
     i_push_error(0, "bad header magic, not a PNM file");
     mm_log((1, "i_readpnm: Could not read header of file\n"));
-    return NULL;
+    return 0;
   }
 
   if ((c = i_io_getc(ig)) == EOF ) {
     mm_log((1, "i_readpnm: Could not read header of file\n"));
-    return NULL;
+    return 0;
   }
   
-  type = c - '0';
+  *type = c - '0';
 
-  if (type < 1 || type > 6) {
+  if (*type < 1 || *type > 6) {
     i_push_error(0, "unknown PNM file type, not a PNM file");
     mm_log((1, "i_readpnm: Not a pnm file\n"));
-    return NULL;
+    return 0;
   }
 
   if ( (c = i_io_getc(ig)) == EOF ) {
     mm_log((1, "i_readpnm: Could not read header of file\n"));
-    return NULL;
+    return 0;
   }
   
   if ( !misspace(c) ) {
     i_push_error(0, "unexpected character, not a PNM file");
     mm_log((1, "i_readpnm: Not a pnm file\n"));
-    return NULL;
+    return 0;
   }
   
-  mm_log((1, "i_readpnm: image is a %s\n", typenames[type-1] ));
+  mm_log((1, "i_readpnm: image is a %s\n", typenames[*type-1] ));
 
   
   /* Read sizes and such */
@@ -481,59 +474,85 @@ i_readpnm_wiol( io_glue *ig, int allow_incomplete) {
   if (!skip_comment(ig)) {
     i_push_error(0, "while skipping to width");
     mm_log((1, "i_readpnm: error reading before width\n"));
-    return NULL;
+    return 0;
   }
   
-  if (!gnum(ig, &width)) {
+  if (!gnum(ig, width)) {
     i_push_error(0, "could not read image width");
     mm_log((1, "i_readpnm: error reading width\n"));
-    return NULL;
+    return 0;
   }
 
   if (!skip_comment(ig)) {
     i_push_error(0, "while skipping to height");
     mm_log((1, "i_readpnm: error reading before height\n"));
-    return NULL;
+    return 0;
   }
 
-  if (!gnum(ig, &height)) {
+  if (!gnum(ig, height)) {
     i_push_error(0, "could not read image height");
     mm_log((1, "i_readpnm: error reading height\n"));
-    return NULL;
+    return 0;
   }
   
-  if (!(type == 1 || type == 4)) {
+  if (!(*type == 1 || *type == 4)) {
     if (!skip_comment(ig)) {
       i_push_error(0, "while skipping to maxval");
       mm_log((1, "i_readpnm: error reading before maxval\n"));
-      return NULL;
+      return 0;
     }
 
-    if (!gnum(ig, &maxval)) {
+    if (!gnum(ig, maxval)) {
       i_push_error(0, "could not read maxval");
       mm_log((1, "i_readpnm: error reading maxval\n"));
-      return NULL;
+      return 0;
     }
 
-    if (maxval == 0) {
+    if (*maxval == 0) {
       i_push_error(0, "maxval is zero - invalid pnm file");
       mm_log((1, "i_readpnm: maxval is zero, invalid pnm file\n"));
-      return NULL;
+      return 0;
     }
-    else if (maxval > 65535) {
+    else if (*maxval > 65535) {
       i_push_errorf(0, "maxval of %d is over 65535 - invalid pnm file", 
-		    maxval);
-      mm_log((1, "i_readpnm: maxval of %d is over 65535 - invalid pnm file\n", maxval));
-      return NULL;
+		    *maxval);
+      mm_log((1, "i_readpnm: maxval of %d is over 65535 - invalid pnm file\n", *maxval));
+      return 0;
     }
-  } else maxval=1;
+  } else *maxval = 1;
 
   if ((c = i_io_getc(ig)) == EOF || !misspace(c)) {
     i_push_error(0, "garbage in header, invalid PNM file");
     mm_log((1, "i_readpnm: garbage in header\n"));
-    return NULL;
+    return 0;
   }
 
+  return 1;
+}
+
+/*
+=item i_readpnm_wiol(ig, allow_incomplete)
+
+Retrieve an image and stores in the iolayer object. Returns NULL on fatal error.
+
+   ig     - io_glue object
+   allow_incomplete - allows a partial file to be read successfully
+
+=cut
+*/
+
+i_img *
+i_readpnm_wiol( io_glue *ig, int allow_incomplete) {
+  i_img* im;
+  int type;
+  int width, height, maxval, channels;
+
+  i_clear_error();
+  mm_log((1,"i_readpnm(ig %p, allow_incomplete %d)\n", ig, allow_incomplete));
+
+  if (!read_pnm_header(ig, &type, &width, &height, &maxval))
+    return NULL;
+
   channels = (type == 3 || type == 6) ? 3:1;
 
   if (!i_int_check_image_file_limits(width, height, channels, sizeof(i_sample_t))) {
@@ -598,6 +617,42 @@ i_readpnm_wiol( io_glue *ig, int allow_incomplete) {
   return im;
 }
 
+/*
+=item i_probepnm_wiol(ig, info)
+
+Reads the header of a PNM file into C<info> without reading the image
+data.  Returns non-zero on success.
+
+=cut
+*/
+
+int
+i_probepnm_wiol(io_glue *ig, i_image_info *info) {
+  int type, width, height, maxval;
+
+  i_clear_error();
+  mm_log((1, "i_probepnm_wiol(ig %p, info %p)\n", ig, info));
+
+  if (!read_pnm_header(ig, &type, &width, &height, &maxval))
+    return 0;
+
+  memset(info, 0, sizeof(*info));
+  info->format = "pnm";
+  info->width = width;
+  info->height = height;
+  if (type == 1 || type == 4) {
+    info->channels = 1;
+    info->bits = 1;
+    info->paletted = 1;
+  }
+  else {
+    info->channels = (type == 3 || type == 6) ? 3 : 1;
+    info->bits = maxval > 255 ? 16 : 8;
+  }
+
+  return 1;
+}
+
 static void free_images(i_img **imgs, int count) {
   int i;
 
@@ -8,10 +8,12 @@
 static void makemap_webmap(i_quantize *);
 static void makemap_addi(i_quantize *, i_img **imgs, int count);
 static void makemap_mediancut(i_quantize *, i_img **imgs, int count);
+static void makemap_wu(i_quantize *, i_img **imgs, int count);
 static void makemap_mono(i_quantize *);
 static void makemap_gray(i_quantize *, int step);
 
 static int makemap_palette(i_quantize *, i_img **imgs, int count);
+static const i_sample_t *quant_row(i_img *img, i_img_dim y, i_sample_t *line);
 
 static
 void
@@ -69,6 +71,10 @@ i_quant_makemap(i_quantize *quant, i_img **imgs, int count) {
     makemap_mediancut(quant, imgs, count);
     break;
 
+  case mc_wu:
+    makemap_wu(quant, imgs, count);
+    break;
+
   case mc_mono:
     makemap_mono(quant);
     break;
@@ -726,6 +732,379 @@ makemap_mediancut(i_quantize *quant, i_img **imgs, int count) {
   mm_log((1, "makemap_mediancut() - %d colors\n", quant->mc_count));
 }
 
+/* Wu's color quantizer, from Xiaolin Wu, "Efficient Statistical
+   Computations for Optimal Color Quantization", Graphics Gems II.
+
+   The pixels are counted into a histogram of 5 bits per channel,
+   along with their color sums and sums of squares, which are then
+   made cumulative so the statistics of any box of the color space
+   can be found from its 8 corners.  Boxes are then repeatedly split
+   where that most reduces the variance within them, and each box's
+   mean color becomes a palette entry. */
+
+/* histogram entries per side, there's an extra row of zeros at 0 to
+   simplify the moment calculations */
+#define WU_SIDE 33
+#define WU_INDEX(r, g, b) (((r) * WU_SIDE + (g)) * WU_SIDE + (b))
+#define WU_SIZE (WU_SIDE * WU_SIDE * WU_SIDE)
+
+typedef struct {
+  /* moments, the counts, color sums and sum of squares */
+  double *wt, *mr, *mg, *mb, *m2;
+} wu_moments;
+
+typedef struct {
+  int r0, r1, g0, g1, b0, b1; /* min exclusive, max inclusive */
+  int vol;
+} wu_box;
+
+enum { wu_red, wu_green, wu_blue };
+
+/* sum of the moment over the box */
+static double
+wu_vol(const wu_box *box, const double *m) {
+  return m[WU_INDEX(box->r1, box->g1, box->b1)]
+    - m[WU_INDEX(box->r1, box->g1, box->b0)]
+    - m[WU_INDEX(box->r1, box->g0, box->b1)]
+    + m[WU_INDEX(box->r1, box->g0, box->b0)]
+    - m[WU_INDEX(box->r0, box->g1, box->b1)]
+    + m[WU_INDEX(box->r0, box->g1, box->b0)]
+    + m[WU_INDEX(box->r0, box->g0, box->b1)]
+    - m[WU_INDEX(box->r0, box->g0, box->b0)];
+}
+
+/* the part of wu_vol() that doesn't depend on the split position in
+   dir */
+static double
+wu_bottom(const wu_box *box, int dir, const double *m) {
+  switch (dir) {
+  case wu_red:
+    return - m[WU_INDEX(box->r0, box->g1, box->b1)]
+      + m[WU_INDEX(box->r0, box->g1, box->b0)]
+      + m[WU_INDEX(box->r0, box->g0, box->b1)]
+      - m[WU_INDEX(box->r0, box->g0, box->b0)];
+
+  case wu_green:
+    return - m[WU_INDEX(box->r1, box->g0, box->b1)]
+      + m[WU_INDEX(box->r1, box->g0, box->b0)]
+      + m[WU_INDEX(box->r0, box->g0, box->b1)]
+      - m[WU_INDEX(box->r0, box->g0, box->b0)];
+
+  case wu_blue:
+  default:
+    return - m[WU_INDEX(box->r1, box->g1, box->b0)]
+      + m[WU_INDEX(box->r1, box->g0, box->b0)]
+      + m[WU_INDEX(box->r0, box->g1, box->b0)]
+      - m[WU_INDEX(box->r0, box->g0, box->b0)];
+  }
+}
+
+/* the rest of wu_vol() for the box cut at pos in dir */
+static double
+wu_top(const wu_box *box, int dir, int pos, const double *m) {
+  switch (dir) {
+  case wu_red:
+    return m[WU_INDEX(pos, box->g1, box->b1)]
+      - m[WU_INDEX(pos, box->g1, box->b0)]
+      - m[WU_INDEX(pos, box->g0, box->b1)]
+      + m[WU_INDEX(pos, box->g0, box->b0)];
+
+  case wu_green:
+    return m[WU_INDEX(box->r1, pos, box->b1)]
+      - m[WU_INDEX(box->r1, pos, box->b0)]
+      - m[WU_INDEX(box->r0, pos, box->b1)]
+      + m[WU_INDEX(box->r0, pos, box->b0)];
+
+  case wu_blue:
+  default:
+    return m[WU_INDEX(box->r1, box->g1, pos)]
+      - m[WU_INDEX(box->r1, box->g0, pos)]
+      - m[WU_INDEX(box->r0, box->g1, pos)]
+      + m[WU_INDEX(box->r0, box->g0, pos)];
+  }
+}
+
+/* the variance of the colors in the box, times the count */
+static double
+wu_var(const wu_box *box, const wu_moments *mom) {
+  double dr = wu_vol(box, mom->mr);
+  double dg = wu_vol(box, mom->mg);
+  double db = wu_vol(box, mom->mb);
+
+  return wu_vol(box, mom->m2) 
+    - (dr * dr + dg * dg + db * db) / wu_vol(box, mom->wt);
+}
+
+/* find the cut in dir that leaves the least variance in the two
+   halves, or rather maximizes the sum of squared means, which is
+   equivalent.  *cut is set to -1 if the box can't be cut in dir */
+static double
+wu_maximize(const wu_box *box, int dir, int first, int last, int *cut,
+	    double whole_r, double whole_g, double whole_b, double whole_w,
+	    const wu_moments *mom) {
+  double base_r = wu_bottom(box, dir, mom->mr);
+  double base_g = wu_bottom(box, dir, mom->mg);
+  double base_b = wu_bottom(box, dir, mom->mb);
+  double base_w = wu_bottom(box, dir, mom->wt);
+  double max = 0;
+  int i;
+
+  *cut = -1;
+  for (i = first; i < last; ++i) {
+    double half_r = base_r + wu_top(box, dir, i, mom->mr);
+    double half_g = base_g + wu_top(box, dir, i, mom->mg);
+    double half_b = base_b + wu_top(box, dir, i, mom->mb);
+    double half_w = base_w + wu_top(box, dir, i, mom->wt);
+    double temp;
+
+    /* both halves need some pixels */
+    if (half_w == 0)
+      continue;
+    temp = (half_r * half_r + half_g * half_g + half_b * half_b) / half_w;
+
+    half_r = whole_r - half_r;
+    half_g = whole_g - half_g;
+    half_b = whole_b - half_b;
+    half_w = whole_w - half_w;
+    if (half_w == 0)
+      continue;
+    temp += (half_r * half_r + half_g * half_g + half_b * half_b) / half_w;
+
+    if (temp > max) {
+      max = temp;
+      *cut = i;
+    }
+  }
+
+  return max;
+}
+
+/* split box1 into itself and box2, returns zero if it can't be
+   split */
+static int
+wu_cut(wu_box *box1, wu_box *box2, const wu_moments *mom) {
+  double whole_r = wu_vol(box1, mom->mr);
+  double whole_g = wu_vol(box1, mom->mg);
+  double whole_b = wu_vol(box1, mom->mb);
+  double whole_w = wu_vol(box1, mom->wt);
+  double max_r, max_g, max_b;
+  int cut_r, cut_g, cut_b;
+  int dir;
+
+  max_r = wu_maximize(box1, wu_red, box1->r0 + 1, box1->r1, &cut_r,
+		      whole_r, whole_g, whole_b, whole_w, mom);
+  max_g = wu_maximize(box1, wu_green, box1->g0 + 1, box1->g1, &cut_g,
+		      whole_r, whole_g, whole_b, whole_w, mom);
+  max_b = wu_maximize(box1, wu_blue, box1->b0 + 1, box1->b1, &cut_b,
+		      whole_r, whole_g, whole_b, whole_w, mom);
+
+  if (max_r >= max_g && max_r >= max_b) {
+    if (cut_r < 0)
+      return 0; /* can't split */
+    dir = wu_red;
+  }
+  else if (max_g >= max_r && max_g >= max_b)
+    dir = wu_green;
+  else
+    dir = wu_blue;
+
+  *box2 = *box1;
+  switch (dir) {
+  case wu_red:
+    box2->r0 = box1->r1 = cut_r;
+    break;
+
+  case wu_green:
+    box2->g0 = box1->g1 = cut_g;
+    break;
+
+  case wu_blue:
+    box2->b0 = box1->b1 = cut_b;
+    break;
+  }
+  box1->vol = (box1->r1 - box1->r0) * (box1->g1 - box1->g0)
+    * (box1->b1 - box1->b0);
+  box2->vol = (box2->r1 - box2->r0) * (box2->g1 - box2->g0)
+    * (box2->b1 - box2->b0);
+
+  return 1;
+}
+
+/* a histogram entry while counting, kept together so each pixel
+   only touches one place in memory */
+typedef struct {
+  double wt, mr, mg, mb, m2;
+} wu_cell;
+
+/* count the pixels into the histogram, every step-th pixel on every
+   step-th row */
+static void
+wu_hist(wu_moments *mom, i_img **imgs, int count, int step) {
+  i_img_dim max_width, x, y;
+  i_sample_t *line;
+  wu_cell *hist;
+  int imgn, i;
+
+  max_width = 0;
+  for (imgn = 0; imgn < count; ++imgn) {
+    if (imgs[imgn]->xsize > max_width)
+      max_width = imgs[imgn]->xsize;
+  }
+  line = mymalloc(max_width * MAXCHANNELS);
+  hist = mymalloc(sizeof(wu_cell) * WU_SIZE);
+  memset(hist, 0, sizeof(wu_cell) * WU_SIZE);
+
+  for (imgn = 0; imgn < count; ++imgn) {
+    i_img *im = imgs[imgn];
+    int chans = im->channels;
+    /* gray images use the first channel for all three */
+    int g_off = chans >= 3 ? 1 : 0;
+    int b_off = chans >= 3 ? 2 : 0;
+
+    for (y = 0; y < im->ysize; y += step) {
+      const i_sample_t *row = quant_row(im, y, line);
+      for (x = 0; x < im->xsize; x += step) {
+	const i_sample_t *p = row + x * chans;
+	int r = p[0], g = p[g_off], b = p[b_off];
+	wu_cell *cell =
+	  hist + WU_INDEX((r >> 3) + 1, (g >> 3) + 1, (b >> 3) + 1);
+
+	cell->wt += 1;
+	cell->mr += r;
+	cell->mg += g;
+	cell->mb += b;
+	cell->m2 += r * r + g * g + b * b;
+      }
+    }
+  }
+
+  for (i = 0; i < WU_SIZE; ++i) {
+    mom->wt[i] = hist[i].wt;
+    mom->mr[i] = hist[i].mr;
+    mom->mg[i] = hist[i].mg;
+    mom->mb[i] = hist[i].mb;
+    mom->m2[i] = hist[i].m2;
+  }
+
+  myfree(hist);
+  myfree(line);
+}
+
+/* make the moments cumulative */
+static void
+wu_moments_sum(wu_moments *mom) {
+  double area[WU_SIDE], area_r[WU_SIDE], area_g[WU_SIDE], area_b[WU_SIDE];
+  double area2[WU_SIDE];
+  int r, g, b;
+
+  for (r = 1; r < WU_SIDE; ++r) {
+    for (b = 0; b < WU_SIDE; ++b)
+      area[b] = area_r[b] = area_g[b] = area_b[b] = area2[b] = 0;
+    for (g = 1; g < WU_SIDE; ++g) {
+      double line = 0, line_r = 0, line_g = 0, line_b = 0, line2 = 0;
+      for (b = 1; b < WU_SIDE; ++b) {
+	int ind1 = WU_INDEX(r, g, b);
+	int ind2 = WU_INDEX(r - 1, g, b);
+
+	line += mom->wt[ind1];
+	line_r += mom->mr[ind1];
+	line_g += mom->mg[ind1];
+	line_b += mom->mb[ind1];
+	line2 += mom->m2[ind1];
+	area[b] += line;
+	area_r[b] += line_r;
+	area_g[b] += line_g;
+	area_b[b] += line_b;
+	area2[b] += line2;
+	mom->wt[ind1] = mom->wt[ind2] + area[b];
+	mom->mr[ind1] = mom->mr[ind2] + area_r[b];
+	mom->mg[ind1] = mom->mg[ind2] + area_g[b];
+	mom->mb[ind1] = mom->mb[ind2] + area_b[b];
+	mom->m2[ind1] = mom->m2[ind2] + area2[b];
+      }
+    }
+  }
+}
+
+static void
+makemap_wu(i_quantize *quant, i_img **imgs, int count) {
+  i_mempool mp;
+  wu_moments mom;
+  wu_box *boxes;
+  double *vv;
+  int step, next, k, color_count;
+
+  mm_log((1, "makemap_wu(quant %p { mc_count=%d, mc_colors=%p }, imgs %p, count %d)\n", 
+          quant, quant->mc_count, quant->mc_colors, imgs, count));
+
+  if (makemap_palette(quant, imgs, count))
+    return;
+
+  step = quant->version >= 2 && quant->mc_step > 1 ? quant->mc_step : 1;
+
+  i_mempool_init(&mp);
+
+  mom.wt = i_mempool_alloc(&mp, sizeof(double) * WU_SIZE);
+  mom.mr = i_mempool_alloc(&mp, sizeof(double) * WU_SIZE);
+  mom.mg = i_mempool_alloc(&mp, sizeof(double) * WU_SIZE);
+  mom.mb = i_mempool_alloc(&mp, sizeof(double) * WU_SIZE);
+  mom.m2 = i_mempool_alloc(&mp, sizeof(double) * WU_SIZE);
+  wu_hist(&mom, imgs, count, step);
+  wu_moments_sum(&mom);
+
+  boxes = i_mempool_alloc(&mp, sizeof(wu_box) * quant->mc_size);
+  vv = i_mempool_alloc(&mp, sizeof(double) * quant->mc_size);
+  boxes[0].r0 = boxes[0].g0 = boxes[0].b0 = 0;
+  boxes[0].r1 = boxes[0].g1 = boxes[0].b1 = WU_SIDE - 1;
+  boxes[0].vol = (WU_SIDE - 1) * (WU_SIDE - 1) * (WU_SIDE - 1);
+  vv[0] = 0;
+  color_count = 1;
+
+  /* split the box with the most variance until we have enough */
+  next = 0;
+  while (color_count < quant->mc_size) {
+    double max;
+
+    if (wu_cut(boxes + next, boxes + color_count, &mom)) {
+      vv[next] = boxes[next].vol > 1 ? wu_var(boxes + next, &mom) : 0;
+      vv[color_count] = boxes[color_count].vol > 1
+	? wu_var(boxes + color_count, &mom) : 0;
+      ++color_count;
+    }
+    else {
+      vv[next] = 0;
+    }
+
+    next = 0;
+    max = vv[0];
+    for (k = 1; k < color_count; ++k) {
+      if (vv[k] > max) {
+	max = vv[k];
+	next = k;
+      }
+    }
+    if (max <= 0)
+      break;
+  }
+
+  /* each box's mean is a color, a box is only empty if the image is */
+  quant->mc_count = 0;
+  for (k = 0; k < color_count; ++k) {
+    double weight = wu_vol(boxes + k, mom.wt);
+    if (weight) {
+      setcol(quant->mc_colors + quant->mc_count++,
+	     wu_vol(boxes + k, mom.mr) / weight + 0.5,
+	     wu_vol(boxes + k, mom.mg) / weight + 0.5,
+	     wu_vol(boxes + k, mom.mb) / weight + 0.5,
+	     255);
+    }
+  }
+
+  i_mempool_destroy(&mp);
+
+  mm_log((1, "makemap_wu() - %d colors\n", quant->mc_count));
+}
+
 static void
 makemap_mono(i_quantize *quant) {
   quant->mc_colors[0].rgba.r = 0;
@@ -921,9 +1300,47 @@ is_gray_map(const i_quantize *quant) {
    the hashbox */
 #define HB_SORT
 
+/* Each hashbox is split into 8x8x8 cells of 4x4x4 colors, and each
+   cell keeps only the hashbox entries that might be the closest for
+   some color in the cell, in hashbox order, so searching the cell
+   finds the same entry as searching the whole hashbox.  Most cells
+   end up with a single entry and need no search at all.
+   A hashbox's cells are only allocated once a color falls in it, and
+   cells are filled as they're first used, since an image usually only
+   touches a small part of the color space, and a small image
+   shouldn't pay for setting up all of it. */
+#define HB_CELL_SIZE 4
+#define HB_CELLS 512
+
+typedef struct {
+  /* start of the cell's entries in pool */
+  int start;
+  /* number of entries, 0 until the cell is filled */
+  int count;
+} hbcell;
+
+typedef struct {
+  hashbox *hb;
+
+  /* the cells of each hashbox, NULL until the hashbox is used */
+  hbcell *cells[512];
+
+  i_palidx *pool;
+  size_t pool_used, pool_alloc;
+} hbcells;
+
+/* the cell within the hashbox, from the 3 bits of each channel below
+   those pixbox() uses */
+#define HB_CELL_NUM(c) \
+  ((((c)->channel[0] & 0x1C) << 4) \
+   | (((c)->channel[1] & 0x1C) << 1) \
+   | (((c)->channel[2] & 0x1C) >> 2))
+
 /* assume i is available */
-#define CF_VARS hashbox *hb = mymalloc(sizeof(hashbox) * 512); \
+#define CF_VARS hbcells hc; \
                int currhb;  \
+               hbcell *cell; \
+               const i_palidx *cand; \
                long ld, cd
 
 #ifdef HB_SORT
@@ -1012,17 +1429,122 @@ static void hbsetup(i_quantize *quant, hashbox *hb) {
 #endif
   myfree(dists) ;
 }
-#define CF_SETUP hbsetup(quant, hb)
+
+static void
+hbcells_setup(i_quantize *quant, hbcells *hc) {
+  int i;
+
+  hc->hb = mymalloc(sizeof(hashbox) * 512);
+  hbsetup(quant, hc->hb);
+  for (i = 0; i < 512; ++i)
+    hc->cells[i] = NULL;
+  hc->pool_alloc = 4096;
+  hc->pool = mymalloc(hc->pool_alloc);
+  hc->pool_used = 0;
+}
+
+/* squared distance range from a channel value to the range lo..hi */
+static void
+cell_chan_dist(int c, int lo, int hi, long *mind, long *maxd) {
+  if (c < lo)
+    *mind += PWR2(lo - c);
+  else if (c > hi)
+    *mind += PWR2(c - hi);
+  *maxd += c - lo > hi - c ? PWR2(c - lo) : PWR2(hi - c);
+}
+
+/* allocate the empty cells for a hashbox */
+static hbcell *
+hbcells_box(hbcells *hc, int hbnum) {
+  hbcell *cells = mymalloc(sizeof(hbcell) * HB_CELLS);
+
+  memset(cells, 0, sizeof(hbcell) * HB_CELLS);
+  hc->cells[hbnum] = cells;
+
+  return cells;
+}
+
+/* fill the cell containing val with the entries from its hashbox that
+   could be the closest for some color in the cell.  Any entry whose
+   closest point in the cell is further than the furthest point of
+   another entry is further from every color in the cell than that
+   other entry. */
+static void
+hbcells_fill(i_quantize *quant, hbcells *hc, hbcell *cell,
+	     const i_color *val) {
+  int r0 = val->channel[0] & ~(HB_CELL_SIZE - 1);
+  int g0 = val->channel[1] & ~(HB_CELL_SIZE - 1);
+  int b0 = val->channel[2] & ~(HB_CELL_SIZE - 1);
+  int r1 = r0 + HB_CELL_SIZE - 1;
+  int g1 = g0 + HB_CELL_SIZE - 1;
+  int b1 = b0 + HB_CELL_SIZE - 1;
+  hashbox *hb = hc->hb + pixbox((i_color *)val);
+  long mind[256], minmax;
+  int i, cnt;
+
+  minmax = 196608;
+  for (i = 0; i < hb->cnt; ++i) {
+    i_color *c = quant->mc_colors + hb->vec[i];
+    long maxd = 0;
+
+    mind[i] = 0;
+    cell_chan_dist(c->channel[0], r0, r1, mind+i, &maxd);
+    cell_chan_dist(c->channel[1], g0, g1, mind+i, &maxd);
+    cell_chan_dist(c->channel[2], b0, b1, mind+i, &maxd);
+    if (maxd < minmax)
+      minmax = maxd;
+  }
+
+  if (hc->pool_used + hb->cnt > hc->pool_alloc) {
+    while (hc->pool_used + hb->cnt > hc->pool_alloc)
+      hc->pool_alloc *= 2;
+    hc->pool = myrealloc(hc->pool, hc->pool_alloc);
+  }
+  cnt = 0;
+  for (i = 0; i < hb->cnt; ++i) {
+    if (mind[i] <= minmax)
+      hc->pool[hc->pool_used + cnt++] = hb->vec[i];
+  }
+  cell->start = hc->pool_used;
+  cell->count = cnt;
+  hc->pool_used += cnt;
+}
+
+static void
+hbcells_cleanup(hbcells *hc) {
+  int i;
+
+  for (i = 0; i < 512; ++i) {
+    if (hc->cells[i])
+      myfree(hc->cells[i]);
+  }
+  myfree(hc->hb);
+  myfree(hc->pool);
+}
+
+#define CF_SETUP hbcells_setup(quant, &hc)
 
 #define CF_FIND \
   currhb = pixbox(&val); \
-  ld = 196608; \
-  for (i = 0; i < hb[currhb].cnt; ++i) { \
-    cd = ceucl_d(quant->mc_colors+hb[currhb].vec[i], &val); \
-    if (cd < ld) { ld = cd; bst_idx = hb[currhb].vec[i]; } \
+  cell = hc.cells[currhb]; \
+  if (!cell) \
+    cell = hbcells_box(&hc, currhb); \
+  cell += HB_CELL_NUM(&val); \
+  if (!cell->count) \
+    hbcells_fill(quant, &hc, cell, &val); \
+  cand = hc.pool + cell->start; \
+  if (cell->count == 1) { \
+    bst_idx = *cand; \
+  } \
+  else { \
+    ld = 196608; \
+    for (i = 0; i < cell->count; ++i) { \
+      cd = ceucl_d(quant->mc_colors+cand[i], &val); \
+      if (cd < ld) { ld = cd; bst_idx = cand[i]; } \
+    } \
   }
 
-#define CF_CLEANUP myfree(hb)
+#define CF_CLEANUP hbcells_cleanup(&hc)
   
 #endif
 
@@ -1265,11 +1787,37 @@ static int rand2dist_find(i_color val, i_quantize *quant, i_dists *dists, int in
 
 #endif
 
+/* fetch the 8-bit samples for a row, directly from the image where
+   possible, otherwise into line, which must have room for
+   img->xsize * img->channels samples */
+static const i_sample_t *
+quant_row(i_img *img, i_img_dim y, i_sample_t *line) {
+  const i_sample_t *row = i_img_8_row(img, y, NULL);
+
+  if (!row) {
+    i_gsamp(img, 0, img->xsize, y, line, NULL, img->channels);
+    row = line;
+  }
+
+  return row;
+}
+
+/* fetch a pixel from a row returned by quant_row() */
+static void
+quant_gpix(i_img *img, const i_sample_t *row, i_img_dim x, i_color *val) {
+  int ch;
+
+  row += x * img->channels;
+  for (ch = 0; ch < img->channels; ++ch)
+    val->channel[ch] = row[ch];
+}
+
 static void translate_addi(i_quantize *quant, i_img *img, i_palidx *out) {
   i_img_dim x, y, k;
   int i, bst_idx = 0;
   i_color val;
   int pixdev = quant->perturb;
+  i_sample_t *line = mymalloc(img->xsize * img->channels);
   CF_VARS;
 
   CF_SETUP;
@@ -1277,44 +1825,57 @@ static void translate_addi(i_quantize *quant, i_img *img, i_palidx *out) {
   if (img->channels >= 3) {
     if (pixdev) {
       k=0;
-      for(y=0;y<img->ysize;y++) for(x=0;x<img->xsize;x++) {
-        i_gpix(img,x,y,&val);
-        val.channel[0]=g_sat(val.channel[0]+(int)(pixdev*frandn()));
-        val.channel[1]=g_sat(val.channel[1]+(int)(pixdev*frandn()));
-        val.channel[2]=g_sat(val.channel[2]+(int)(pixdev*frandn()));
-        CF_FIND;
-        out[k++]=bst_idx;
+      for(y=0;y<img->ysize;y++) {
+        const i_sample_t *row = quant_row(img, y, line);
+        for(x=0;x<img->xsize;x++) {
+          quant_gpix(img,row,x,&val);
+          val.channel[0]=g_sat(val.channel[0]+(int)(pixdev*frandn()));
+          val.channel[1]=g_sat(val.channel[1]+(int)(pixdev*frandn()));
+          val.channel[2]=g_sat(val.channel[2]+(int)(pixdev*frandn()));
+          CF_FIND;
+          out[k++]=bst_idx;
+        }
       }
     } else {
       k=0;
-      for(y=0;y<img->ysize;y++) for(x=0;x<img->xsize;x++) {
-        i_gpix(img,x,y,&val);
-        CF_FIND;
-        out[k++]=bst_idx;
+      for(y=0;y<img->ysize;y++) {
+        const i_sample_t *row = quant_row(img, y, line);
+        for(x=0;x<img->xsize;x++) {
+          quant_gpix(img,row,x,&val);
+          CF_FIND;
+          out[k++]=bst_idx;
+        }
       }
     }
   }
   else {
     if (pixdev) {
       k=0;
-      for(y=0;y<img->ysize;y++) for(x=0;x<img->xsize;x++) {
-        i_gpix(img,x,y,&val);
-        val.channel[1] = val.channel[2] =
-          val.channel[0]=g_sat(val.channel[0]+(int)(pixdev*frandn()));
-        CF_FIND;
-        out[k++]=bst_idx;
+      for(y=0;y<img->ysize;y++) {
+        const i_sample_t *row = quant_row(img, y, line);
+        for(x=0;x<img->xsize;x++) {
+          quant_gpix(img,row,x,&val);
+          val.channel[1] = val.channel[2] =
+            val.channel[0]=g_sat(val.channel[0]+(int)(pixdev*frandn()));
+          CF_FIND;
+          out[k++]=bst_idx;
+        }
       }
     } else {
       k=0;
-      for(y=0;y<img->ysize;y++) for(x=0;x<img->xsize;x++) {
-        i_gpix(img,x,y,&val);
-        val.channel[1] = val.channel[2] = val.channel[0];
-        CF_FIND;
-        out[k++]=bst_idx;
+      for(y=0;y<img->ysize;y++) {
+        const i_sample_t *row = quant_row(img, y, line);
+        for(x=0;x<img->xsize;x++) {
+          quant_gpix(img,row,x,&val);
+          val.channel[1] = val.channel[2] = val.channel[0];
+          CF_FIND;
+          out[k++]=bst_idx;
+        }
       }
     }
   }
   CF_CLEANUP;
+  myfree(line);
 }
 
 static int floyd_map[] =
@@ -1353,6 +1914,24 @@ typedef struct errdiff_tag {
   int r, g, b;
 } errdiff_t;
 
+/* the built-in maps total at most 48, so the accumulated error for a
+   pixel is within 255 * 48, which fits in 16 bits */
+typedef struct {
+  short r, g, b;
+} errdiff16_t;
+
+/* a non-zero entry in an error diffusion map, relative to the
+   current pixel */
+typedef struct {
+  int dx, dy, weight;
+} errdiff_tap;
+
+/* the largest number of rows in a built-in map */
+#define ERRDIFF_MAX_ROWS 3
+
+static void
+translate_errdiff_builtin(i_quantize *quant, i_img *img, i_palidx *out);
+
 /* perform an error diffusion dither */
 static
 void
@@ -1365,23 +1944,21 @@ translate_errdiff(i_quantize *quant, i_img *img, i_palidx *out) {
   int difftotal;
   i_img_dim x, y, dx, dy;
   int bst_idx = 0;
-  int is_gray = is_gray_map(quant);
+  int is_gray;
+  i_sample_t *line;
   CF_VARS;
 
-  if ((quant->errdiff & ed_mask) == ed_custom) {
-    map = quant->ed_map;
-    mapw = quant->ed_width;
-    maph = quant->ed_height;
-    mapo = quant->ed_orig;
-  }
-  else {
-    int index = quant->errdiff & ed_mask;
-    if (index >= ed_custom) index = ed_floyd;
-    map = maps[index].map;
-    mapw = maps[index].width;
-    maph = maps[index].height;
-    mapo = maps[index].orig;
+  if ((quant->errdiff & ed_mask) != ed_custom || !quant->ed_map) {
+    translate_errdiff_builtin(quant, img, out);
+    return;
   }
+
+  /* custom maps can have any weights, so use the general code */
+  map = quant->ed_map;
+  mapw = quant->ed_width;
+  maph = quant->ed_height;
+  mapo = quant->ed_orig;
+  is_gray = is_gray_map(quant);
   
   errw = img->xsize+mapw;
   err = mymalloc(sizeof(*err) * maph * errw);
@@ -1399,13 +1976,16 @@ translate_errdiff(i_quantize *quant, i_img *img, i_palidx *out) {
    putchar('\n');
    }*/
 
+  line = mymalloc(img->xsize * img->channels);
+
   CF_SETUP;
 
   for (y = 0; y < img->ysize; ++y) {
+    const i_sample_t *row = quant_row(img, y, line);
     for (x = 0; x < img->xsize; ++x) {
       i_color val;
       errdiff_t perr;
-      i_gpix(img, x, y, &val);
+      quant_gpix(img, row, x, &val);
       if (img->channels < 3) {
         val.channel[1] = val.channel[2] = val.channel[0];
       }
@@ -1443,8 +2023,130 @@ translate_errdiff(i_quantize *quant, i_img *img, i_palidx *out) {
     memset(err+(maph-1)*errw, 0, sizeof(*err)*errw);
   }
   CF_CLEANUP;
+  myfree(line);
   myfree(err);
 }
+
+/* error diffusion with one of the built-in maps.
+
+   This produces the same result as the general code above, but only
+   visits the non-zero map entries, keeps the errors for the rows the
+   map covers in a ring of 16-bit rows rather than shifting them up
+   after each row, and optionally scans alternate rows right to left
+   with the map mirrored (ed_bidir). */
+static void
+translate_errdiff_builtin(i_quantize *quant, i_img *img, i_palidx *out) {
+  int index = quant->errdiff & ed_mask;
+  int bidir = (quant->errdiff & ed_bidir) != 0;
+  const struct errdiff_map *emap;
+  errdiff_tap taps[15];
+  int tap_count, difftotal, pad, dx, dy, t;
+  errdiff16_t *ring[ERRDIFF_MAX_ROWS];
+  errdiff16_t *ring_mem;
+  size_t row_size;
+  i_img_dim x, y;
+  int i, bst_idx = 0;
+  int is_gray = is_gray_map(quant);
+  int chans = img->channels;
+  i_sample_t *line;
+  CF_VARS;
+
+  if (index >= ed_custom)
+    index = ed_floyd;
+  emap = maps + index;
+
+  /* collect the non-zero entries after the current pixel */
+  tap_count = 0;
+  difftotal = 0;
+  pad = 0;
+  for (dy = 0; dy < emap->height; ++dy) {
+    for (dx = 0; dx < emap->width; ++dx) {
+      int weight = emap->map[dx + emap->width * dy];
+      difftotal += weight;
+      if (weight) {
+	taps[tap_count].dx = dx - emap->orig;
+	taps[tap_count].dy = dy;
+	taps[tap_count].weight = weight;
+	++tap_count;
+	if (abs(dx - emap->orig) > pad)
+	  pad = abs(dx - emap->orig);
+      }
+    }
+  }
+
+  /* padding on each side takes the error spread past the edges */
+  row_size = img->xsize + 2 * pad;
+  ring_mem = mymalloc(sizeof(errdiff16_t) * row_size * emap->height);
+  memset(ring_mem, 0, sizeof(errdiff16_t) * row_size * emap->height);
+  for (dy = 0; dy < emap->height; ++dy)
+    ring[dy] = ring_mem + dy * row_size + pad;
+
+  line = mymalloc(img->xsize * chans);
+
+  CF_SETUP;
+
+  for (y = 0; y < img->ysize; ++y) {
+    const i_sample_t *row = quant_row(img, y, line);
+    errdiff16_t *rows[ERRDIFF_MAX_ROWS];
+    errdiff16_t *cur;
+    int dir = bidir && (y & 1) ? -1 : 1;
+    i_img_dim end = dir > 0 ? img->xsize : -1;
+
+    /* entries past the map height are never used, but filling them
+       all makes it clear every entry used is set */
+    for (dy = 0; dy < ERRDIFF_MAX_ROWS; ++dy)
+      rows[dy] = ring[(y + dy) % emap->height];
+    cur = rows[0];
+
+    for (x = dir > 0 ? 0 : img->xsize - 1; x != end; x += dir) {
+      const i_sample_t *p = row + x * chans;
+      i_color val;
+      int er, eg, eb;
+
+      if (chans < 3) {
+	val.channel[0] = val.channel[1] = val.channel[2] = p[0];
+      }
+      else if (is_gray) {
+	int gray;
+	val.channel[0] = p[0];
+	val.channel[1] = p[1];
+	val.channel[2] = p[2];
+	gray = 0.5 + color_to_grey(&val);
+	val.channel[0] = val.channel[1] = val.channel[2] = gray;
+      }
+      else {
+	val.channel[0] = p[0];
+	val.channel[1] = p[1];
+	val.channel[2] = p[2];
+      }
+      er = cur[x].r < 0 ? -((-cur[x].r)/difftotal) : cur[x].r/difftotal;
+      eg = cur[x].g < 0 ? -((-cur[x].g)/difftotal) : cur[x].g/difftotal;
+      eb = cur[x].b < 0 ? -((-cur[x].b)/difftotal) : cur[x].b/difftotal;
+      val.channel[0] = g_sat(val.channel[0] - er);
+      val.channel[1] = g_sat(val.channel[1] - eg);
+      val.channel[2] = g_sat(val.channel[2] - eb);
+      CF_FIND;
+      er = quant->mc_colors[bst_idx].channel[0] - val.channel[0];
+      eg = quant->mc_colors[bst_idx].channel[1] - val.channel[1];
+      eb = quant->mc_colors[bst_idx].channel[2] - val.channel[2];
+      for (t = 0; t < tap_count; ++t) {
+	errdiff16_t *e = rows[taps[t].dy] + x + dir * taps[t].dx;
+	e->r += er * taps[t].weight;
+	e->g += eg * taps[t].weight;
+	e->b += eb * taps[t].weight;
+      }
+      out[x] = bst_idx;
+    }
+    out += img->xsize;
+
+    /* this row's errors are used up, it becomes the last row */
+    memset(cur - pad, 0, sizeof(errdiff16_t) * row_size);
+  }
+
+  CF_CLEANUP;
+  myfree(line);
+  myfree(ring_mem);
+}
 /* Prescan finds the boxes in the image that have the highest number of colors 
    and that result is used as the initial value for the vectores */
 
@@ -0,0 +1,154 @@
+#include "imageri.h"
+#include "imsimd.h"
+
+/*
+=head1 NAME
+
+rotatesimd.c - vectorized bilinear interpolation for affine transforms
+
+=head1 SYNOPSIS
+
+  i_int_bilinear_row_f bilinear = i_int_bilinear_simd_row();
+  if (bilinear)
+    bilinear(out, taps, weights, count);
+
+=head1 DESCRIPTION
+
+Interpolates 8-bit pixels for the affine path of
+i_matrix_transform_bg(), producing exactly the same results as the
+plain C implementation in rotate.im.
+
+Each output pixel has 4 taps in C<taps>, top-left, top-right,
+bottom-left and bottom-right, and 2 weights in C<weights>, the
+horizontal and the vertical fractions, scaled by
+C<< 1 << I_BILINEAR_BITS >>.  Each row of taps is interpolated
+keeping C<I_BILINEAR_ROW_BITS> bits of fraction, then the two results
+are interpolated and rounded, so results are within 1 of the separate
+horizontal and vertical interpolations done for other images.
+
+All four channels are interpolated, so images with an alpha channel,
+which weight the color channels by alpha, can't use this.
+
+=over
+
+=cut
+*/
+
+#ifdef IM_SIMD_HAVE_SSE2
+
+#include <emmintrin.h>
+
+/* interpolate the two rows of taps of one pixel, giving the 4
+   channels of each row as 32-bit values */
+static void
+bilinear_rows_sse2(const i_color *taps, int wx, __m128i *top,
+		   __m128i *bottom) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round =
+    _mm_set1_epi32(1 << (I_BILINEAR_BITS - I_BILINEAR_ROW_BITS - 1));
+  __m128i v = _mm_loadu_si128((const __m128i *)taps);
+  __m128i weights = _mm_set1_epi32((wx << 16) | (I_BILINEAR_ONE - wx));
+  /* pair each channel of the left tap with the same channel of the
+     right tap */
+  __m128i t = _mm_unpacklo_epi8(v, _mm_srli_si128(v, 4));
+  __m128i b = _mm_unpacklo_epi8(_mm_srli_si128(v, 8), _mm_srli_si128(v, 12));
+
+  t = _mm_madd_epi16(_mm_unpacklo_epi8(t, zero), weights);
+  b = _mm_madd_epi16(_mm_unpacklo_epi8(b, zero), weights);
+  *top = _mm_srli_epi32(_mm_add_epi32(t, round),
+			I_BILINEAR_BITS - I_BILINEAR_ROW_BITS);
+  *bottom = _mm_srli_epi32(_mm_add_epi32(b, round),
+			   I_BILINEAR_BITS - I_BILINEAR_ROW_BITS);
+}
+
+/* interpolate two pixels vertically, giving 8 16-bit channels */
+static __m128i
+bilinear_cols_sse2(__m128i top0, __m128i bottom0, int wy0,
+		   __m128i top1, __m128i bottom1, int wy1) {
+  const __m128i round =
+    _mm_set1_epi32(1 << (I_BILINEAR_BITS + I_BILINEAR_ROW_BITS - 1));
+  __m128i t = _mm_packs_epi32(top0, top1);
+  __m128i b = _mm_packs_epi32(bottom0, bottom1);
+  __m128i v0 = _mm_madd_epi16
+    (_mm_unpacklo_epi16(t, b),
+     _mm_set1_epi32((wy0 << 16) | (I_BILINEAR_ONE - wy0)));
+  __m128i v1 = _mm_madd_epi16
+    (_mm_unpackhi_epi16(t, b),
+     _mm_set1_epi32((wy1 << 16) | (I_BILINEAR_ONE - wy1)));
+
+  v0 = _mm_srli_epi32(_mm_add_epi32(v0, round),
+		      I_BILINEAR_BITS + I_BILINEAR_ROW_BITS);
+  v1 = _mm_srli_epi32(_mm_add_epi32(v1, round),
+		      I_BILINEAR_BITS + I_BILINEAR_ROW_BITS);
+
+  return _mm_packs_epi32(v0, v1);
+}
+
+static void
+bilinear_row_sse2(i_color *out, const i_color *taps, const int *weights,
+		  i_img_dim count) {
+  i_img_dim x = 0;
+
+  for (; x + 4 <= count; x += 4) {
+    __m128i top[4], bottom[4];
+    __m128i lo, hi;
+    int i;
+
+    for (i = 0; i < 4; ++i)
+      bilinear_rows_sse2(taps + 4 * i, weights[2 * i], top + i, bottom + i);
+    lo = bilinear_cols_sse2(top[0], bottom[0], weights[1],
+			    top[1], bottom[1], weights[3]);
+    hi = bilinear_cols_sse2(top[2], bottom[2], weights[5],
+			    top[3], bottom[3], weights[7]);
+    _mm_storeu_si128((__m128i *)(out + x), _mm_packus_epi16(lo, hi));
+    taps += 16;
+    weights += 8;
+  }
+  for (; x < count; ++x) {
+    __m128i top, bottom;
+
+    bilinear_rows_sse2(taps, weights[0], &top, &bottom);
+    out[x].ui = _mm_cvtsi128_si32
+      (_mm_packus_epi16(bilinear_cols_sse2(top, bottom, weights[1],
+					   top, bottom, weights[1]),
+			_mm_setzero_si128()));
+    taps += 4;
+    weights += 2;
+  }
+}
+
+/*
+=item i_int_bilinear_simd_row()
+
+Returns the vectorized bilinear interpolator for the best instruction
+set the CPU supports, or NULL if there is none.
+
+=cut
+*/
+
+i_int_bilinear_row_f
+i_int_bilinear_simd_row(void) {
+  if (!(i_simd_features() & IM_SIMD_SSE2))
+    return NULL;
+
+  return bilinear_row_sse2;
+}
+
+#else
+
+i_int_bilinear_row_f
+i_int_bilinear_simd_row(void) {
+  return NULL;
+}
+
+#endif
+
+/*
+=back
+
+=head1 SEE ALSO
+
+rotate.im, simd.c
+
+=cut
+*/
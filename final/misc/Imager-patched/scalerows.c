@@ -0,0 +1,788 @@
+#include "imageri.h"
+
+/*
+=head1 NAME
+
+scalerows.c - scale 8-bit image data a row at a time
+
+=head1 SYNOPSIS
+
+  static int
+  put_row(void *p, i_img_dim y, const i_color *row) {
+    ... write the scaled row somewhere ...
+    return 1;
+  }
+
+  i_scale_rows *rows = i_scale_rows_new(in_width, in_height,
+                                        out_width, out_height,
+                                        channels, put_row, p);
+  for (y = 0; y < in_height; ++y) {
+    ... fill in_row ...
+    if (!i_scale_rows_feed(rows, in_row))
+      ... error ...
+  }
+  i_scale_rows_destroy(rows);
+
+=head1 DESCRIPTION
+
+Implements the same coverage scaling as i_scale_mixing(), but the
+caller pushes source rows in one at a time and each output row is
+passed to a callback as soon as it's complete, so neither the source
+nor the scaled image need to be held in memory.
+
+Where the CPU supports it the vectorized kernels from scalesimd.c are
+used, otherwise this produces the same results as the 8-bit
+i_scale_mixing() implementation in scale.im.
+
+=over
+
+=cut
+*/
+
+/* bytes read from the source at a time by i_scale_stream() */
+#define I_SCALE_STREAM_BUFFER 65536
+
+struct i_scale_rows_tag {
+  i_img_dim in_width, in_height;
+  i_img_dim out_width, out_height;
+  int channels;
+  i_scale_rows_put_f put;
+  void *put_data;
+
+  /* rows fed in and rows passed to put so far */
+  i_img_dim rows_in, rows_out;
+
+  /* output rows before skip_to are counted but not accumulated or
+     put, and no rows from stop_at on are produced */
+  i_img_dim skip_to, stop_at;
+
+  double y_scale;
+  double rowsleft, fracrowtofill;
+
+  /* vectorized accumulator, NULL to use the double implementation */
+  i_int_mix_accum_row_f simd_accum;
+  float *faccum;
+  i_fcolor *accum;
+
+  i_color *out_row;
+};
+
+static void
+zero_accum(i_scale_rows *rows);
+static void
+load_row(i_scale_rows *rows, const i_color *in);
+static void
+accum_output_row(i_fcolor *accum, double fraction, const i_color *in,
+		 i_img_dim width, int channels);
+static void
+convert_row(i_color *out, const i_fcolor *in, i_img_dim width, int channels);
+static void
+horizontal_scale(i_color *out, i_img_dim out_width, const i_fcolor *in,
+		 i_img_dim in_width, int channels);
+
+/*
+=item i_scale_rows_new(in_width, in_height, out_width, out_height, channels, put, put_data)
+=category Image
+=synopsis i_scale_rows *rows = i_scale_rows_new(in_w, in_h, out_w, out_h, channels, put_row, p);
+
+Create a row scaler that scales C<in_width> by C<in_height> 8-bit
+image data with C<channels> channels to C<out_width> by
+C<out_height>, using the same algorithm as i_scale_mixing().
+
+Source rows are supplied with i_scale_rows_feed().  Each output row
+is passed to C<put> as:
+
+  put(put_data, y, row)
+
+which should return non-zero on success.
+
+Returns NULL on failure.
+
+=cut
+*/
+
+i_scale_rows *
+i_scale_rows_new(i_img_dim in_width, i_img_dim in_height,
+		 i_img_dim out_width, i_img_dim out_height,
+		 int channels, i_scale_rows_put_f put, void *put_data) {
+  i_scale_rows *rows;
+  size_t accum_bytes, out_bytes;
+  i_int_mix_accum_row_f simd_accum;
+
+  mm_log((1, "i_scale_rows_new(in(" i_DFp "), out(" i_DFp "), channels %d)\n",
+	  i_DFcp(in_width, in_height), i_DFcp(out_width, out_height),
+	  channels));
+
+  if (in_width <= 0 || in_height <= 0) {
+    i_push_errorf(0, "source size (" i_DFp ") invalid",
+		  i_DFcp(in_width, in_height));
+    return NULL;
+  }
+  if (out_width <= 0 || out_height <= 0) {
+    i_push_errorf(0, "output size (" i_DFp ") invalid",
+		  i_DFcp(out_width, out_height));
+    return NULL;
+  }
+  if (channels < 1 || channels > MAXCHANNELS) {
+    i_push_errorf(0, "channels %d invalid", channels);
+    return NULL;
+  }
+
+  simd_accum = i_int_mix_simd_accum_row();
+  if (simd_accum) {
+    accum_bytes = sizeof(float) * 4 * in_width;
+    if (accum_bytes / (sizeof(float) * 4) != in_width) {
+      i_push_error(0, "integer overflow allocating accumulator row buffer");
+      return NULL;
+    }
+  }
+  else {
+    accum_bytes = sizeof(i_fcolor) * in_width;
+    if (accum_bytes / sizeof(i_fcolor) != in_width) {
+      i_push_error(0, "integer overflow allocating accumulator row buffer");
+      return NULL;
+    }
+  }
+  out_bytes = sizeof(i_color) * out_width;
+  if (out_bytes / sizeof(i_color) != out_width) {
+    i_push_error(0, "integer overflow allocating output row buffer");
+    return NULL;
+  }
+
+  rows = mymalloc(sizeof(i_scale_rows));
+  rows->in_width = in_width;
+  rows->in_height = in_height;
+  rows->out_width = out_width;
+  rows->out_height = out_height;
+  rows->channels = channels;
+  rows->put = put;
+  rows->put_data = put_data;
+  rows->rows_in = 0;
+  rows->rows_out = 0;
+  rows->skip_to = 0;
+  rows->stop_at = out_height;
+  rows->y_scale = out_height / (double)in_height;
+  rows->rowsleft = 0.0;
+  rows->fracrowtofill = 1.0;
+  rows->simd_accum = simd_accum;
+  rows->faccum = simd_accum ? mymalloc(accum_bytes) : NULL;
+  rows->accum = simd_accum ? NULL : mymalloc(accum_bytes);
+  rows->out_row = mymalloc(out_bytes);
+
+  zero_accum(rows);
+
+  return rows;
+}
+
+static int
+put_row(i_scale_rows *rows) {
+  if (rows->simd_accum) {
+    i_int_mix_simd_hscale(rows->out_row, rows->out_width, rows->faccum,
+			  rows->in_width, rows->channels);
+  }
+  else if (rows->out_width == rows->in_width) {
+    convert_row(rows->out_row, rows->accum, rows->out_width, rows->channels);
+  }
+  else {
+    horizontal_scale(rows->out_row, rows->out_width, rows->accum,
+		     rows->in_width, rows->channels);
+  }
+
+  if (!rows->put(rows->put_data, rows->rows_out, rows->out_row))
+    return 0;
+
+  ++rows->rows_out;
+  zero_accum(rows);
+  rows->fracrowtofill = 1.0;
+
+  return 1;
+}
+
+/* accumulate the current source row until it's used up or we run out
+   of output rows */
+static int
+accum_rows(i_scale_rows *rows, const i_color *in) {
+  while (rows->rowsleft > 0 && rows->rows_out < rows->stop_at) {
+    double fraction;
+
+    if (rows->rowsleft < rows->fracrowtofill) {
+      fraction = rows->rowsleft;
+      rows->fracrowtofill -= rows->rowsleft;
+      rows->rowsleft = 0;
+    }
+    else {
+      fraction = rows->fracrowtofill;
+      rows->rowsleft -= rows->fracrowtofill;
+      rows->fracrowtofill = 0;
+    }
+
+    if (rows->rows_out >= rows->skip_to) {
+      if (rows->simd_accum)
+	rows->simd_accum(rows->faccum, in, rows->in_width, rows->channels,
+			 fraction);
+      else
+	accum_output_row(rows->accum, fraction, in, rows->in_width,
+			 rows->channels);
+    }
+
+    if (rows->fracrowtofill == 0) {
+      if (rows->rows_out < rows->skip_to) {
+	++rows->rows_out;
+	rows->fracrowtofill = 1.0;
+      }
+      else if (!put_row(rows))
+	return 0;
+    }
+  }
+
+  return 1;
+}
+
+/*
+=item i_scale_rows_feed(rows, row)
+=category Image
+=synopsis if (!i_scale_rows_feed(rows, in_row)) { ... error ... }
+
+Supply the next source row, C<in_width> pixels, to the row scaler.
+
+Any output rows completed by this row are passed to the C<put>
+callback before this returns.  Feeding the last source row produces
+all remaining output rows.
+
+Returns non-zero on success, or zero if too many rows are supplied or
+the C<put> callback fails.
+
+=cut
+*/
+
+int
+i_scale_rows_feed(i_scale_rows *rows, const i_color *row) {
+  if (rows->rows_in >= rows->in_height) {
+    i_push_error(0, "i_scale_rows_feed: too many source rows");
+    return 0;
+  }
+  ++rows->rows_in;
+
+  if (rows->rows_out >= rows->stop_at)
+    return 1;
+
+  if (!rows->simd_accum && rows->out_height == rows->in_height) {
+    /* no vertical scaling, just load it */
+    load_row(rows, row);
+    return put_row(rows);
+  }
+
+  rows->rowsleft = rows->y_scale;
+  if (!accum_rows(rows, row))
+    return 0;
+
+  if (rows->rows_in == rows->in_height) {
+    /* out of source rows, reuse the last one for any remaining
+       output rows */
+    while (rows->rows_out < rows->stop_at) {
+      rows->rowsleft = rows->y_scale;
+      if (!accum_rows(rows, row))
+	return 0;
+    }
+  }
+
+  return 1;
+}
+
+/*
+=item i_scale_rows_done(rows)
+=category Image
+
+Returns true once every output row has been passed to the C<put>
+callback.  Callers can stop supplying source rows at that point.
+
+=cut
+*/
+
+int
+i_scale_rows_done(i_scale_rows *rows) {
+  return rows->rows_out >= rows->stop_at;
+}
+
+/*
+=item i_scale_rows_destroy(rows)
+=category Image
+
+Release a row scaler created by i_scale_rows_new().
+
+=cut
+*/
+
+void
+i_scale_rows_destroy(i_scale_rows *rows) {
+  if (rows->faccum)
+    myfree(rows->faccum);
+  if (rows->accum)
+    myfree(rows->accum);
+  myfree(rows->out_row);
+  myfree(rows);
+}
+
+static int
+put_image_row(void *p, i_img_dim y, const i_color *row) {
+  i_img *im = p;
+
+  i_plin(im, 0, im->xsize, y, row);
+
+  return 1;
+}
+
+/*
+  Skip the source rows that only contribute to output rows before
+  first, returning the index of the next source row to feed.  The
+  parts of that row belonging to earlier output rows are dropped when
+  it's fed.
+*/
+static i_img_dim
+skip_to_row(i_scale_rows *rows, i_img_dim first) {
+  rows->skip_to = first;
+  while (rows->rows_in < rows->in_height - 1) {
+    double rowsleft = rows->y_scale;
+    double fracrowtofill = rows->fracrowtofill;
+    i_img_dim rows_out = rows->rows_out;
+
+    /* the same steps as accum_rows() */
+    while (rowsleft > 0 && rows_out < first) {
+      if (rowsleft < fracrowtofill) {
+	fracrowtofill -= rowsleft;
+	rowsleft = 0;
+      }
+      else {
+	rowsleft -= fracrowtofill;
+	fracrowtofill = 0;
+      }
+      if (fracrowtofill == 0) {
+	++rows_out;
+	fracrowtofill = 1.0;
+      }
+    }
+    if (rowsleft > 0)
+      break;
+
+    ++rows->rows_in;
+    rows->rows_out = rows_out;
+    rows->fracrowtofill = fracrowtofill;
+  }
+
+  return rows->rows_in;
+}
+
+/* rows per band when scaling with several threads */
+#define SCALE_BAND 4
+
+struct scale_band {
+  i_img *src;
+  i_img *result;
+  const i_scale_rows *proto;
+};
+
+static void
+scale_band_rows(void *p, i_img_dim start, i_img_dim end) {
+  const struct scale_band *band = p;
+  i_img *src = band->src;
+  i_scale_rows rows = *band->proto;
+  i_color *in_row;
+  i_img_dim y;
+
+  rows.stop_at = end;
+  rows.faccum = i_int_band_malloc(sizeof(float) * 4 * rows.in_width);
+  rows.out_row = i_int_band_malloc(sizeof(i_color) * rows.out_width);
+  zero_accum(&rows);
+
+  in_row = i_int_band_malloc(sizeof(i_color) * src->xsize);
+  y = skip_to_row(&rows, start);
+  for (; y < src->ysize && !i_scale_rows_done(&rows); ++y) {
+    i_glin(src, 0, src->xsize, y, in_row);
+    i_scale_rows_feed(&rows, in_row);
+  }
+  i_int_band_free(in_row);
+  i_int_band_free(rows.faccum);
+  i_int_band_free(rows.out_row);
+}
+
+/*
+=item i_int_scale_mixing_simd(src, result)
+
+Scale the 8-bit image C<src> into C<result> with the vectorized row
+scaler.
+
+Returns false without touching C<result> if no suitable instruction
+set is available.
+
+=cut
+*/
+
+int
+i_int_scale_mixing_simd(i_img *src, i_img *result) {
+  i_scale_rows *rows;
+  struct scale_band band;
+
+  if (!i_int_mix_simd_accum_row())
+    return 0;
+
+  /* this checks the sizes, each band scales with its own copy */
+  rows = i_scale_rows_new(src->xsize, src->ysize, result->xsize,
+			  result->ysize, src->channels, put_image_row, result);
+  if (!rows)
+    return 0; /* let the fallback report the error */
+
+  band.src = src;
+  band.result = result;
+  band.proto = rows;
+  i_int_run_bands(src, result, result->ysize, SCALE_BAND, scale_band_rows,
+		  &band);
+  i_scale_rows_destroy(rows);
+
+  return 1;
+}
+
+static void
+zero_accum(i_scale_rows *rows) {
+  i_img_dim x;
+  int ch;
+
+  if (rows->simd_accum) {
+    for (x = 0; x < rows->in_width * 4; ++x)
+      rows->faccum[x] = 0;
+  }
+  else {
+    for (x = 0; x < rows->in_width; ++x) {
+      for (ch = 0; ch < rows->channels; ++ch)
+	rows->accum[x].channel[ch] = 0.0;
+    }
+  }
+}
+
+/* the remaining functions are the 8-bit versions of the helpers in
+   scale.im */
+
+static void
+load_row(i_scale_rows *rows, const i_color *in) {
+  i_fcolor *accum = rows->accum;
+  int channels = rows->channels;
+  i_img_dim x;
+  int ch;
+
+  for (x = 0; x < rows->in_width; ++x) {
+    for (ch = 0; ch < channels; ++ch) {
+      accum[x].channel[ch] = in[x].channel[ch];
+    }
+  }
+  /* alpha adjust if needed */
+  if (channels == 2 || channels == 4) {
+    for (x = 0; x < rows->in_width; ++x) {
+      for (ch = 0; ch < channels-1; ++ch) {
+	accum[x].channel[ch] *= accum[x].channel[channels-1] / 255;
+      }
+    }
+  }
+}
+
+static void
+accum_output_row(i_fcolor *accum, double fraction, const i_color *in,
+		 i_img_dim width, int channels) {
+  i_img_dim x;
+  int ch;
+
+  if (channels == 2 || channels == 4) {
+    for (x = 0; x < width; ++x) {
+      for (ch = 0; ch < channels-1; ++ch) {
+	accum[x].channel[ch] += in[x].channel[ch] * fraction * in[x].channel[channels-1] / 255;
+      }
+      accum[x].channel[channels-1] += in[x].channel[channels-1] * fraction;
+    }
+  }
+  else {
+    for (x = 0; x < width; ++x) {
+      for (ch = 0; ch < channels; ++ch) {
+	accum[x].channel[ch] += in[x].channel[ch] * fraction;
+      }
+    }
+  }
+}
+
+static void
+convert_row(i_color *out, const i_fcolor *in, i_img_dim width, int channels) {
+  i_img_dim x;
+  int ch;
+
+  if (channels == 2 || channels == 4) {
+    int alpha_chan = channels - 1;
+    for (x = 0; x < width; ++x) {
+      double alpha = in[x].channel[alpha_chan] / 255;
+      if (alpha) {
+	for (ch = 0; ch < alpha_chan; ++ch) {
+	  int val = in[x].channel[ch] / alpha + 0.5;
+	  out[x].channel[ch] = I_LIMIT_8(val);
+	}
+      }
+      else {
+	/* See RT #32324 */
+	for (ch = 0; ch < alpha_chan; ++ch) {
+	  out[x].channel[ch] = 0;
+	}
+      }
+      out[x].channel[alpha_chan] = I_LIMIT_8(in[x].channel[alpha_chan]+0.5);
+    }
+  }
+  else {
+    for (x = 0; x < width; ++x) {
+      for (ch = 0; ch < channels; ++ch)
+	out[x].channel[ch] = I_LIMIT_8(in[x].channel[ch]+0.5);
+    }
+  }
+}
+
+static void
+store_pixel(i_color *out, const double *accum, int channels) {
+  int ch;
+
+  if (channels == 2 || channels == 4) {
+    int alpha_chan = channels - 1;
+    double alpha = accum[alpha_chan] / 255;
+    if (alpha) {
+      for (ch = 0; ch < alpha_chan; ++ch) {
+	int val = (int)(accum[ch] / alpha + 0.5);
+	out->channel[ch] = I_LIMIT_8(val);
+      }
+    }
+    else {
+      /* See RT #32324 */
+      for (ch = 0; ch < alpha_chan; ++ch)
+	out->channel[ch] = 0;
+    }
+    out->channel[alpha_chan] = I_LIMIT_8((int)(accum[alpha_chan] + 0.5));
+  }
+  else {
+    for (ch = 0; ch < channels; ++ch) {
+      int val = (int)(accum[ch] + 0.5);
+      out->channel[ch] = I_LIMIT_8(val);
+    }
+  }
+}
+
+static void
+horizontal_scale(i_color *out, i_img_dim out_width, const i_fcolor *in,
+		 i_img_dim in_width, int channels) {
+  double frac_col_to_fill, frac_col_left;
+  i_img_dim in_x;
+  i_img_dim out_x;
+  double x_scale = (double)out_width / in_width;
+  int ch;
+  double accum[MAXCHANNELS] = { 0 };
+
+  frac_col_to_fill = 1.0;
+  out_x = 0;
+  for (in_x = 0; in_x < in_width; ++in_x) {
+    frac_col_left = x_scale;
+    while (frac_col_left >= frac_col_to_fill) {
+      for (ch = 0; ch < channels; ++ch)
+	accum[ch] += frac_col_to_fill * in[in_x].channel[ch];
+
+      store_pixel(out + out_x, accum, channels);
+      for (ch = 0; ch < channels; ++ch)
+	accum[ch] = 0;
+      frac_col_left -= frac_col_to_fill;
+      frac_col_to_fill = 1.0;
+      ++out_x;
+    }
+
+    if (frac_col_left > 0) {
+      for (ch = 0; ch < channels; ++ch) {
+	accum[ch] += frac_col_left * in[in_x].channel[ch];
+      }
+      frac_col_to_fill -= frac_col_left;
+    }
+  }
+
+  if (out_x < out_width-1 || out_x > out_width) {
+    i_fatal(3, "Internal error: out_x %d out of range (width %d)", out_x, out_width);
+  }
+
+  if (out_x < out_width) {
+    for (ch = 0; ch < channels; ++ch) {
+      accum[ch] += frac_col_to_fill * in[in_width-1].channel[ch];
+    }
+    store_pixel(out + out_x, accum, channels);
+  }
+}
+
+/* state for i_scale_stream() */
+typedef struct {
+  i_encoder *enc;
+  i_scale_rows *rows;
+  i_img_dim out_width, out_height;
+  i_scale_fit_t fit;
+} stream_state;
+
+static int
+stream_put_row(void *p, i_img_dim y, const i_color *row) {
+  stream_state *st = p;
+
+  (void)y;
+
+  return i_encoder_row(st->enc, row);
+}
+
+static int
+stream_header(void *p, const i_image_info *info) {
+  stream_state *st = p;
+  double scale = 0;
+
+  /* a zero dimension keeps the aspect ratio */
+  if (!st->out_width) {
+    scale = (double)st->out_height / info->height;
+  }
+  else if (!st->out_height) {
+    scale = (double)st->out_width / info->width;
+  }
+  else if (st->fit != i_scale_fit_nonprop) {
+    double x_scale = (double)st->out_width / info->width;
+    double y_scale = (double)st->out_height / info->height;
+
+    if (st->fit == i_scale_fit_min)
+      scale = x_scale < y_scale ? x_scale : y_scale;
+    else
+      scale = x_scale > y_scale ? x_scale : y_scale;
+  }
+  if (scale) {
+    /* as scale_calculate() rounds */
+    st->out_width = (i_img_dim)(info->width * scale + 0.5);
+    st->out_height = (i_img_dim)(info->height * scale + 0.5);
+    if (st->out_width < 1)
+      st->out_width = 1;
+    if (st->out_height < 1)
+      st->out_height = 1;
+  }
+
+  st->rows = i_scale_rows_new(info->width, info->height, st->out_width,
+			      st->out_height, info->channels, stream_put_row,
+			      st);
+  if (!st->rows)
+    return 0;
+
+  return i_encoder_start(st->enc, st->out_width, st->out_height,
+			 info->channels);
+}
+
+static int
+stream_row(void *p, i_img_dim y, const i_color *row) {
+  stream_state *st = p;
+
+  (void)y;
+
+  return i_scale_rows_feed(st->rows, row);
+}
+
+/*
+=item i_scale_stream(in, dec, enc, out_width, out_height, fit)
+=category Image
+=synopsis if (!i_scale_stream(in, dec, enc, 800, 0, i_scale_fit_min)) { ... error ... }
+
+Read an image file from C<in>, decoding it with the incremental
+decoder C<dec>, scale it as with i_scale_mixing(), and write the
+result with the incremental encoder C<enc>.
+
+If either of C<out_width> or C<out_height> is zero it's calculated
+from the other to keep the aspect ratio.  Otherwise C<fit> controls
+the size:
+
+=over
+
+=item *
+
+C<i_scale_fit_nonprop> - scale to exactly C<out_width> by
+C<out_height>.
+
+=item *
+
+C<i_scale_fit_min> - keep the aspect ratio, the largest size that
+fits within C<out_width> by C<out_height>.
+
+=item *
+
+C<i_scale_fit_max> - keep the aspect ratio, the smallest size that
+covers C<out_width> by C<out_height>.
+
+=back
+
+Rows pass from the decoder through i_scale_rows_new() to the encoder
+as they're decoded, so only a few rows are held in memory however
+large the source, and the image file limits only apply to the width
+of the source, except where the decoder itself must hold the whole
+image, such as for progressive JPEG or interlaced PNG files.
+
+C<dec> and C<enc> are used up, but still need to be destroyed.
+
+Returns non-zero on success.
+
+=cut
+*/
+
+int
+i_scale_stream(io_glue *in, i_decoder *dec, i_encoder *enc,
+	       i_img_dim out_width, i_img_dim out_height,
+	       i_scale_fit_t fit) {
+  stream_state st;
+  unsigned char *buffer;
+  ssize_t size;
+  int result = 0;
+
+  mm_log((1, "i_scale_stream(in %p, dec %p, enc %p, out(" i_DFp "), fit %d)\n",
+	  in, dec, enc, i_DFcp(out_width, out_height), (int)fit));
+
+  i_clear_error();
+
+  if (out_width < 0 || out_height < 0 || (!out_width && !out_height)) {
+    i_push_errorf(0, "output size (" i_DFp ") invalid",
+		  i_DFcp(out_width, out_height));
+    return 0;
+  }
+
+  st.enc = enc;
+  st.rows = NULL;
+  st.out_width = out_width;
+  st.out_height = out_height;
+  st.fit = fit;
+
+  dec->rows_only = 1;
+  i_decoder_set_callbacks(dec, stream_header, stream_row, &st);
+
+  buffer = mymalloc(I_SCALE_STREAM_BUFFER);
+  while ((size = i_io_read(in, buffer, I_SCALE_STREAM_BUFFER)) > 0) {
+    if (!i_decoder_feed(dec, buffer, size))
+      goto done;
+  }
+  if (size < 0) {
+    i_push_error(0, "error reading image data");
+    goto done;
+  }
+  if (!i_decoder_finish(dec))
+    goto done;
+  if (!i_encoder_finish(enc))
+    goto done;
+
+  result = 1;
+
+ done:
+  myfree(buffer);
+  if (st.rows)
+    i_scale_rows_destroy(st.rows);
+
+  return result;
+}
+
+/*
+=back
+
+=head1 SEE ALSO
+
+scale.im, scalesimd.c, decoder.c, encoder.c
+
+=cut
+*/
@@ -0,0 +1,107 @@
+#include "imageri.h"
+#include "imsimd.h"
+
+/*
+=head1 NAME
+
+simd.c - runtime selection of vectorized code paths
+
+=head1 SYNOPSIS
+
+  #include "imsimd.h"
+
+  unsigned features = i_simd_features();
+  if (features & IM_SIMD_AVX2) {
+    ... use the AVX2 implementation
+  }
+  else if (features & IM_SIMD_SSE2) {
+    ... use the SSE2 implementation
+  }
+  else {
+    ... plain C
+  }
+
+=head1 DESCRIPTION
+
+Some inner loops have vectorized implementations.  Which instruction
+sets can be used is only known at runtime, so code that has such an
+implementation calls i_simd_features() to decide which to use.
+
+=over
+
+=cut
+*/
+
+/* the features the CPU supports, -1 until detected */
+static int cpu_features = -1;
+
+/* the features we allow to be used */
+static unsigned feature_mask = ~0U;
+
+static unsigned
+detect_features(void) {
+  unsigned features = 0;
+
+#ifdef IM_SIMD_HAVE_SSE2
+  /* the compiler is already generating SSE2 code */
+  features |= IM_SIMD_SSE2;
+#endif
+#ifdef IM_SIMD_HAVE_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    features |= IM_SIMD_AVX2;
+#endif
+
+  return features;
+}
+
+/*
+=item i_simd_features()
+
+Returns a mask of the C<IM_SIMD_*> instruction sets that the CPU
+supports, limited to those that were compiled in and are allowed by
+i_simd_set_mask().
+
+=cut
+*/
+
+unsigned
+i_simd_features(void) {
+  /* detection always produces the same result, so it doesn't matter
+     if two threads race to set it */
+  if (cpu_features < 0)
+    cpu_features = detect_features();
+
+  return cpu_features & feature_mask;
+}
+
+/*
+=item i_simd_set_mask(mask)
+
+Limit the instruction sets i_simd_features() reports to those in
+C<mask>.  Returns the previous mask.
+
+This is intended for testing the plain C implementations against the
+vectorized implementations.
+
+=cut
+*/
+
+unsigned
+i_simd_set_mask(unsigned mask) {
+  unsigned old_mask = feature_mask;
+
+  feature_mask = mask;
+
+  return old_mask;
+}
+
+/*
+=back
+
+=head1 SEE ALSO
+
+Imager(3)
+
+=cut
+*/
@@ -1,10 +1,11 @@
 #!perl -w
 # some of this is tested in t01introvert.t too
 use strict;
-use Test::More tests => 226;
+use Test::More tests => 253;
 BEGIN { use_ok("Imager", ':handy'); }
 
-use Imager::Test qw(image_bounds_checks test_image is_color3 isnt_image is_color4 is_fcolor3);
+use Imager::Test qw(image_bounds_checks test_image is_color3 isnt_image is_color4 is_fcolor3
+                   is_image is_image_similar);
 
 Imager->open_log(log => "testout/t023palette.log");
 
@@ -356,6 +357,93 @@ cmp_ok(Imager->errstr, '=~', qr/Channels must be positive and <= 4/,
   isnt_image($palim, $blank, "make sure paletted isn't all black");
 }
 
+{ # images without 8-bit rows are translated a row at a time too
+  my $im = test_image();
+  my @colors = Imager->make_palette({ make_colors => "mediancut" }, $im);
+  ok(@colors, "make a palette");
+  for my $translate (qw(closest errdiff)) {
+    my $exp = $im->to_paletted(colors => \@colors, make_colors => "none",
+			       translate => $translate);
+    for my $src ([ "16-bit", $im->to_rgb16 ],
+		 [ "double", $im->to_rgb_double ]) {
+      my ($name, $src_im) = @$src;
+      my $palim = $src_im->to_paletted(colors => \@colors,
+				       make_colors => "none",
+				       translate => $translate);
+      is_image($palim, $exp, "$translate: $name translates as 8-bit");
+    }
+  }
+}
+
+{ # the built-in error diffusion maps have their own implementation
+  my $im = test_image();
+  my @colors = Imager->make_palette({ make_colors => "mediancut" }, $im);
+  my %maps =
+    (
+     floyd => [ 3, 2, 1, [ 0, 0, 7, 3, 5, 1 ] ],
+     jarvis => [ 5, 3, 2, [ 0, 0, 0, 7, 5, 3, 5, 7, 5, 3, 1, 3, 5, 3, 1 ] ],
+     stucki => [ 5, 3, 2, [ 0, 0, 0, 8, 4, 2, 4, 8, 4, 2, 1, 2, 4, 2, 1 ] ],
+    );
+  for my $name (sort keys %maps) {
+    my ($width, $height, $orig, $map) = @{$maps{$name}};
+    my $builtin = $im->to_paletted(colors => \@colors, make_colors => "none",
+				   translate => "errdiff", errdiff => $name);
+    my $custom = $im->to_paletted(colors => \@colors, make_colors => "none",
+				  translate => "errdiff", errdiff => "custom",
+				  errdiff_width => $width,
+				  errdiff_height => $height,
+				  errdiff_orig => $orig,
+				  errdiff_map => $map);
+    is_image($builtin, $custom, "$name: same as a custom map");
+    my $serp = $im->to_paletted(colors => \@colors, make_colors => "none",
+				translate => "errdiff", errdiff => $name,
+				errdiff_serpentine => 1);
+    ok($serp, "$name: serpentine");
+    isnt_image($serp, $builtin, "$name: serpentine differs");
+    is_image_similar($serp->to_rgb8, $im, 1_000_000,
+		     "$name: serpentine is still close");
+  }
+}
+
+{ # Wu's quantizer
+  my $im = test_image();
+  my @colors = Imager->make_palette({ make_colors => "wu" }, $im);
+  ok(@colors && @colors <= 256, "wu: made a palette");
+  my $wu = $im->to_paletted(make_colors => "wu");
+  ok($wu, "wu: made paletted image");
+  my $mc = $im->to_paletted(make_colors => "mediancut");
+  cmp_ok(Imager::i_img_diff($wu->to_rgb8->{IMG}, $im->{IMG}), "<",
+	 Imager::i_img_diff($mc->to_rgb8->{IMG}, $im->{IMG}),
+	 "wu: closer than mediancut");
+
+  @colors = Imager->make_palette({ make_colors => "wu", max_colors => 16 },
+				 $im);
+  is(@colors, 16, "wu: limited to max_colors");
+
+  my @sampled = Imager->make_palette({ make_colors => "wu",
+				       make_colors_step => 3 }, $im);
+  ok(@sampled && @sampled <= 256, "wu: made a palette from a sample");
+
+  # a palette for several images, as for an animated GIF
+  my $red = Imager->new(xsize => 10, ysize => 10);
+  $red->box(filled => 1, color => "#FF0000");
+  my $blue = Imager->new(xsize => 10, ysize => 10);
+  $blue->box(filled => 1, color => "#0000FF");
+  @colors = Imager->make_palette({ make_colors => "wu" }, $red, $blue);
+  is(@colors, 2, "wu: two colors from two images");
+  @colors = sort { ($b->rgba)[0] <=> ($a->rgba)[0] } @colors;
+  is_color3($colors[0], 255, 0, 0, "wu: red");
+  is_color3($colors[1], 0, 0, 255, "wu: blue");
+
+  my $gray = Imager->new(xsize => 256, ysize => 1, channels => 1);
+  $gray->setscanline(y => 0,
+		     pixels => [ map Imager::Color->new($_, $_, $_), 0 .. 255 ]);
+  @colors = Imager->make_palette({ make_colors => "wu" }, $gray);
+  ok(@colors > 1, "wu: palette from a gray image");
+  ok(!grep($_->[0] != $_->[1] || $_->[0] != $_->[2], map [ $_->rgba ], @colors),
+     "wu: gray image gives gray colors");
+}
+
 { # check validation of palette entries
   my $im = Imager->new(xsize => 10, ysize => 10, type => 'paletted');
   $im->addcolors(colors => [ $black, $red ]);
@@ -1,6 +1,6 @@
 #!perl -w
 use strict;
-use Test::More tests => 274;
+use Test::More tests => 310;
 use Imager::Test qw(is_image);
 # for SEEK_SET etc, Fcntl doesn't provide these in 5.005_03
 use IO::Seekable;
@@ -31,7 +31,7 @@ Imager::i_writeppm_wiol($im, $IO2);
 close(FH);
 undef($im);
 
-open(FH, "<testimg/penguin-base.ppm");
+open(FH, "<testimg/filltest.ppm");
 binmode(FH);
 $data = <FH>;
 close(FH);
@@ -42,7 +42,7 @@ $im = Imager::i_readpnm_wiol($IO3, -1);
 ok($im, "read from buffer, for compare");
 undef $IO3;
 
-open(FH, "<testimg/penguin-base.ppm") or die $!;
+open(FH, "<testimg/filltest.ppm") or die $!;
 binmode(FH);
 $fd = fileno(FH);
 my $IO4 = Imager::IO->new_fd( $fd );
@@ -888,6 +888,96 @@ SKIP:
   is(tied(*FOO)->[0], "temore", "tied: check it got to the output properly");
 }
 
+{ # buffered reads from a memory buffer return the source data
+  my $data = "abcdefghij" x 1000;
+  my $io = Imager::IO->new_buffer($data);
+  is($io->peekn(10000), substr($data, 0, 8192),
+     "peekn limited to the buffer size");
+  is($io->read2(3), "abc", "read after peekn");
+  is($io->seek(-2, SEEK_CUR), 1, "SEEK_CUR accounts for buffered data");
+  is($io->read2(4), "bcde", "read after seek");
+}
+
+{ # bytes read ahead while unbuffered are followed by the rest of
+  # the buffer
+  my $io = Imager::IO->new_buffer("abcdefghij");
+  $io->set_buffered(0);
+  is($io->peekc, ord "a", "unbuffered peekc");
+  is($io->peekn(4), "abcd", "peekn after unbuffered peekc");
+  is($io->read2(10), "abcdefghij", "read2 gets the whole buffer");
+}
+
+{ # set_buffer_size
+  my $data = "0123456789" x 10;
+  my $io = Imager::IO->new_bufchain;
+  ok(!$io->set_buffer_size(0), "can't set a zero buffer size");
+  is(Imager->_error_as_msg(), "buffer size must be positive", "check message");
+  ok($io->set_buffer_size(16), "set a small buffer size");
+  is($io->write($data), 100, "write through a small buffer");
+  is($io->seek(0, SEEK_SET), 0, "seek back to the start");
+  is($io->peekn(50), substr($data, 0, 16), "peekn limited to the buffer size");
+  ok(!$io->set_buffer_size(64), "can't resize with buffered input");
+  like(Imager->_error_as_msg(), qr/^cannot change the buffer size with data buffered/,
+     "check message");
+  is($io->read2(16), substr($data, 0, 16), "consume the buffered data");
+  ok($io->set_buffer_size(64), "now we can resize");
+  is($io->peekn(100), substr($data, 16, 64), "peekn limited to the new size");
+  my $rest;
+  is($io->read($rest, 100), 84, "read the rest");
+  is($rest, substr($data, 16), "check the data");
+}
+
+SKIP:
+{ # memory mapped input
+  $^O eq "MSWin32"
+    and skip "no mmap() on Win32", 16;
+
+  my $data = join("", map chr($_ % 251), 0 .. 40000);
+  my $name = "testout/t07mmap.dat";
+  open my $fh, ">", $name or die "Cannot create $name: $!";
+  binmode $fh;
+  print $fh $data;
+  close $fh;
+
+  open my $in, "<", $name or die "Cannot open $name: $!";
+  binmode $in;
+  my $io = Imager::IO->new_mmap(fileno($in));
+  ok($io, "make an mmap I/O object")
+    or skip "couldn't map the file", 15;
+  is($io->getc, 0, "getc");
+  is($io->peekn(20000), substr($data, 1, 8192), "peekn limited to the buffer size");
+  my $buf;
+  is($io->read($buf, 30000), 30000, "read a block");
+  is($buf, substr($data, 1, 30000), "check the data");
+  is($io->seek(10, SEEK_SET), 10, "seek");
+  is($io->read2(5), substr($data, 10, 5), "read after seek");
+  is($io->seek(-5, SEEK_END), 39996, "seek from the end");
+  is($io->read($buf, 100), 5, "short read at the end");
+  is($io->read($buf, 100), 0, "then end of file");
+  ok($io->eof, "eof set");
+  undef $io;
+
+  sysseek($in, 1000, SEEK_SET);
+  $io = Imager::IO->new_mmap(fileno($in));
+  is($io->read2(10), substr($data, 1000, 10),
+     "mapping starts from the fd position");
+  undef $io;
+  close $in;
+
+  pipe(my $r, my $w) or skip "no pipe", 4;
+  ok(!Imager::IO->new_mmap(fileno($r)), "can't map a pipe");
+  like(Imager->_error_as_msg(), qr/^only regular files can be mapped/,
+       "check message");
+  close $r;
+  close $w;
+
+  my $im = Imager->new(file => "testimg/filltest.ppm");
+  my $im2 = Imager->new(file => "testimg/filltest.ppm", mmap => 1);
+  ok($im2, "read through a mapping");
+  is_image($im2, $im, "same as a normal read");
+  unlink $name;
+}
+
 Imager->close_log;
 
 unless ($ENV{IMAGER_KEEP_FILES}) {
@@ -4,7 +4,7 @@
 # the file format
 
 use strict;
-use Test::More tests => 89;
+use Test::More tests => 183;
 use Imager;
 
 -d "testout" or mkdir "testout";
@@ -334,6 +334,171 @@ JPEG2K
   }
 }
 
+{ # square_thumbnail() for a format without a single pass implementation
+  my $im = Imager->new(xsize => 60, ysize => 40);
+  $im->box(filled => 1, color => "#F00", xmin => 10, xmax => 49);
+  $im->box(filled => 1, color => "#00F", xmin => 20, xmax => 39);
+  my $data;
+  ok($im->write(data => \$data, type => "pnm"), "write source image");
+  my $thumb;
+  ok(Imager->square_thumbnail(in => { data => $data },
+			      out => { data => \$thumb },
+			      size => 10),
+     "make thumbnail")
+    or print "# ", Imager->errstr, "\n";
+  my $tim = Imager->new(data => $thumb, type => "pnm");
+  ok($tim, "read it back");
+  is($tim->getwidth, 10, "check width");
+  is($tim->getheight, 10, "check height");
+  my $expect = $im->crop(left => 10, width => 40)
+    ->scale(xpixels => 10, ypixels => 10, qtype => "mixing");
+  is(Imager::i_img_diff($tim->{IMG}, $expect->{IMG}), 0,
+     "same as crop then scale");
+
+  ok(!Imager->square_thumbnail(in => { data => $data },
+			       out => { data => \$thumb }, size => 0),
+     "fail with zero size");
+  like(Imager->errstr, qr/size must be a positive integer/,
+       "check message");
+}
+
+{ # square_thumbnails()
+  my $im = Imager->new(xsize => 120, ysize => 80);
+  $im->box(filled => 1, color => "#F00", xmin => 20, xmax => 99);
+  $im->box(filled => 1, color => "#00F", xmin => 40, xmax => 79);
+  my $data;
+  ok($im->write(data => \$data, type => "pnm"), "write source image");
+  my ($small, $large);
+  ok(Imager->square_thumbnails(in => { data => $data }, sizes => [ 10, 40 ],
+			       out => [ { data => \$small },
+					{ data => \$large, type => "bmp" } ]),
+     "make thumbnails")
+    or print "# ", Imager->errstr, "\n";
+  my $sim = Imager->new(data => $small, type => "pnm");
+  ok($sim, "read small back");
+  is($sim->getwidth, 10, "check small width");
+  my $lim = Imager->new(data => $large, type => "bmp");
+  ok($lim, "read large, in the type requested, back");
+  my $expect = $im->crop(left => 20, width => 80)
+    ->scale(xpixels => 40, ypixels => 40, qtype => "mixing");
+  is(Imager::i_img_diff($lim->{IMG}, $expect->{IMG}), 0,
+     "same as crop then scale");
+
+  ok(!Imager->square_thumbnails(in => { data => $data }, sizes => [ 10, 20 ],
+				out => [ { data => \$small } ]),
+     "fail with too few outputs");
+  is(Imager->errstr,
+     "square_thumbnails: out must have a hash ref for each size",
+     "check message");
+}
+
+{ # probe() for the formats Imager reads itself
+  my @tests =
+    (
+     [ "pnm", { xsize => 13, ysize => 7, channels => 3 }, {},
+       { channels => 3, bits => 8, paletted => 0 } ],
+     [ "pnm", { xsize => 5, ysize => 9, channels => 1, bits => 16 }, {},
+       { channels => 1, bits => 16, paletted => 0 } ],
+     [ "pnm", { xsize => 8, ysize => 3, type => "paletted" }, { mono => 1 },
+       { channels => 1, bits => 1, paletted => 1 } ],
+     [ "bmp", { xsize => 11, ysize => 6, channels => 3 }, {},
+       { channels => 3, bits => 8, paletted => 0 } ],
+     [ "bmp", { xsize => 11, ysize => 6, type => "paletted" }, {},
+       { channels => 3, bits => 4, paletted => 1 } ],
+     [ "tga", { xsize => 12, ysize => 4, channels => 4 }, {},
+       { channels => 4, bits => 8, paletted => 0 } ],
+     [ "tga", { xsize => 12, ysize => 4, channels => 1 }, {},
+       { channels => 1, bits => 8, paletted => 0 } ],
+    );
+  for my $test (@tests) {
+    my ($type, $new, $make, $expect) = @$test;
+    my $im = Imager->new(%$new);
+    if ($make->{mono}) {
+      $im->addcolors(colors => [ "#000", "#FFF" ]);
+    }
+    elsif ($new->{type}) {
+      $im->addcolors(colors => [ "#000", "#F00", "#0F0" ]);
+    }
+    my $desc = "$type " . join(" ", map "$_=$new->{$_}", sort keys %$new);
+    my $data;
+    ok($im->write(data => \$data, type => $type, pnm_write_wide_data => 1),
+       "$desc: write")
+      or diag $im->errstr;
+    my $info = Imager->probe(data => $data);
+    ok($info, "$desc: probe")
+      or diag(Imager->errstr);
+    is($info->{type}, $type, "$desc: type");
+    is($info->{width}, $im->getwidth, "$desc: width");
+    is($info->{height}, $im->getheight, "$desc: height");
+    is_deeply({ map { $_ => $info->{$_} } keys %$expect }, $expect,
+	      "$desc: channels, bits and paletted");
+    my $read = Imager->new(data => $data, type => $type);
+    is($info->{channels}, $read->getchannels, "$desc: channels match read");
+  }
+
+  ok(!Imager->probe(data => "P6\n10 x\n"), "fail on bad header");
+  is(Imager->errstr, "could not read image height", "check message");
+
+  ok(!Imager->probe(data => "not an image file"), "fail on unknown format");
+  is(Imager->errstr, "probe: format not recognized", "check message");
+
+  ok(!Imager->probe(data => "FORM    ILBM" . ("\0" x 20)),
+     "fail on a format without a probe");
+  is(Imager->errstr, "cannot probe ilbm files", "check message");
+
+  # a negative BMP height is a top-down image
+  my $bmp_head = sub {
+    pack("A2VvvVVVVvvVVVVVV", "BM", 0, 0, 0, 54, 40, 10, $_[0] & 0xFFFFFFFF,
+	 1, 24, 0, 0, 0, 0, 0, 0);
+  };
+  my $info = Imager->probe(data => $bmp_head->(-20));
+  ok($info, "probe top-down bmp")
+    or diag(Imager->errstr);
+  is($info->{height}, 20, "check height");
+  ok(!Imager->probe(data => $bmp_head->(-2**31)), "fail on -2**31 height");
+  is(Imager->errstr, "invalid image size in BMP header", "check message");
+}
+
+{ # incremental decoders, see the JPEG and PNG modules for the rest
+  ok(!Imager->new_decoder(), "no type");
+  is(Imager->errstr, "new_decoder: type parameter missing", "check message");
+  ok(!Imager->new_decoder(type => "pnm"), "format without a decoder");
+  is(Imager->errstr, "new_decoder: format 'pnm' has no incremental decoder",
+     "check message");
+  ok(!Imager->new_decoder(type => "pnm", row => 1), "bad row callback");
+  is(Imager->errstr, "new_decoder: row must be a code ref", "check message");
+  ok(!eval { Imager->register_decoder(type => "foo"); 1 },
+     "register_decoder needs new");
+  is($@, "register_decoder called with no new parameter\n", "check message");
+}
+
+{ # streaming scaling, see the JPEG and PNG modules for the rest
+  my $data;
+  ok(!Imager->scale_stream(in => "foo", out => {}), "in must be a hash ref");
+  is(Imager->errstr, "scale_stream: in and out must be hash refs",
+     "check message");
+  ok(!Imager->scale_stream(in => {}, out => { data => \$data }),
+     "need a size");
+  is(Imager->errstr, "scale_stream: xpixels or ypixels must be supplied",
+     "check message");
+  ok(!Imager->scale_stream(in => {}, out => { data => \$data },
+			   xpixels => 10, type => "scalefactor"),
+     "bad type");
+  is(Imager->errstr, "scale_stream: invalid value for type parameter",
+     "check message");
+  my $pnm;
+  ok(Imager->new(xsize => 10, ysize => 10)->write(data => \$pnm, type => "pnm"),
+     "make a pnm");
+  ok(!Imager->scale_stream(in => { data => $pnm }, out => { data => \$data },
+			   xpixels => 5),
+     "format without a decoder");
+  is(Imager->errstr, "scale_stream: format 'pnm' has no incremental decoder",
+     "check message");
+  ok(!eval { Imager->register_encoder(type => "foo"); 1 },
+     "register_encoder needs new");
+  is($@, "register_encoder called with no new parameter\n", "check message");
+}
+
 Imager->close_log;
 
 unless ($ENV{IMAGER_KEEP_FILES}) {
@@ -1,9 +1,9 @@
 #!perl -w
 use strict;
-use Test::More tests => 232;
+use Test::More tests => 282;
 
 BEGIN { use_ok(Imager=>':all') }
-use Imager::Test qw(is_image is_color4 is_image_similar);
+use Imager::Test qw(is_image is_color4 is_image_similar test_image test_image_16);
 
 -d "testout" or mkdir "testout";
 
@@ -217,6 +217,60 @@ SKIP:
 	    "check we set alpha=0 pixels to zero on scaling");
 }
 
+{ # the x and y axis paths of i_scaleaxis() should produce the same
+  # result for transposed input
+  my $rgb = test_image();
+  my $rgba = $rgb->convert(preset => "addalpha");
+  $rgba->box(filled => 1, xmin => 10, ymin => 20, xmax => 90, ymax => 60,
+	     color => [ 0, 0, 255, 96 ]);
+  my $gray16 = test_image_16()->convert(preset => "gray");
+  for my $test ([ rgb => $rgb ], [ rgba => $rgba ], [ gray16 => $gray16 ]) {
+    my ($name, $src) = @$test;
+    my $trans = $src->rotate(right => 90)->flip(dir => "h");
+    for my $factor (0.1, 0.6, 2.5) {
+      my $xsc = $src->scaleX(scalefactor => $factor);
+      my $ysc = $trans->scaleY(scalefactor => $factor)
+	->rotate(right => 90)->flip(dir => "h");
+      is_image($ysc, $xsc, "$name: scaleY matches scaleX at $factor");
+    }
+    my $tall = $trans->scaleY(scalefactor => 0.01);
+    is($tall->getheight, 2, "$name: tiny scaleY height");
+  }
+}
+
+{ # vectorized mixing for 8-bit images should be within 1 of the
+  # plain C implementation
+  my $rgb = test_image()->scale(xpixels => 331, ypixels => 257,
+				type => "nonprop");
+  my $rgba = $rgb->convert(preset => "addalpha");
+  for my $y (0 .. $rgba->getheight-1) {
+    my @alpha = map { ($_ * 7 + $y * 3) % 256 } 0 .. $rgba->getwidth-1;
+    $rgba->setsamples(y => $y, channels => [ 3 ], data => pack("C*", @alpha));
+  }
+  my %ims =
+    (
+     rgb => $rgb,
+     rgba => $rgba,
+     gray => $rgb->convert(preset => "gray"),
+     graya => $rgba->convert(preset => "gray"),
+    );
+  my $features = Imager::i_simd_features();
+  for my $name (sort keys %ims) {
+    for my $size ([ 32, 32 ], [ 100, 257 ], [ 331, 90 ], [ 500, 400 ]) {
+      my $old = Imager::i_simd_set_mask(0);
+      my $plain = $ims{$name}->scale(xpixels => $size->[0],
+				     ypixels => $size->[1],
+				     type => "nonprop", qtype => "mixing");
+      Imager::i_simd_set_mask($old);
+      my $fast = $ims{$name}->scale(xpixels => $size->[0],
+				    ypixels => $size->[1],
+				    type => "nonprop", qtype => "mixing");
+      cmp_ok(max_sample_diff($plain, $fast), '<=', 1,
+	     "$name: mixing to @$size within 1 (simd $features)");
+    }
+  }
+}
+
 { # scale_calculate
   my $im = Imager->new(xsize => 100, ysize => 120);
   is_deeply([ $im->scale_calculate(scalefactor => 0.5) ],
@@ -230,6 +284,77 @@ SKIP:
 	    "class method scale_factor");
 }
 
+{ # i_scale_halve() matches mixing to half the size
+  my $src = test_image()->scale(xpixels => 150, ypixels => 100,
+				type => "nonprop");
+  $src->box(filled => 1, color => [ 255, 0, 0, 128 ], xmax => 40, ymax => 30);
+  for my $im ($src, $src->convert(preset => "addalpha"),
+	      $src->convert(preset => "grey"), $src->to_rgb16,
+	      $src->to_rgb_double) {
+    my $alpha = $im->convert(preset => "addalpha");
+    $alpha->box(filled => 1, color => [ 0, 255, 0, 100 ],
+		xmin => 20, xmax => 60, ymax => 50);
+    $alpha->box(filled => 1, color => [ 0, 0, 0, 0 ],
+		xmin => 30, xmax => 50, ymax => 20);
+    for my $test ($im, $alpha) {
+      my $desc = $test->getchannels . " channels, " . $test->bits . " bits";
+      my $half = Imager->new;
+      $half->{IMG} = Imager::i_scale_halve($test->{IMG});
+      my $mixed = $test->scale(xpixels => 75, ypixels => 50,
+			       qtype => "mixing");
+      if ($test->bits eq "double") {
+	# rounding differs in the last bit
+	is_image_similar($half, $mixed, 100, "halve $desc");
+      }
+      else {
+	is_image($half, $mixed, "halve $desc");
+      }
+    }
+  }
+
+  my $odd = $src->crop(width => 149, height => 99);
+  my $half = Imager->new;
+  $half->{IMG} = Imager::i_scale_halve($odd->{IMG});
+  is_image($half, $odd->scale(xpixels => 74, ypixels => 49, type => "nonprop",
+			      qtype => "mixing"),
+	   "halve odd sized image");
+}
+
+{ # scale_pyramid
+  my $src = test_image()->scale(xpixels => 400, ypixels => 300,
+				type => "nonprop");
+  my @thumbs = $src->scale_pyramid(sizes => [ 100, [ 200, 150 ], [ 30, 30 ] ]);
+  is(@thumbs, 3, "scale_pyramid returns 3 images")
+    or diag $src->errstr;
+  is_deeply([ map [ $_->getwidth, $_->getheight ], @thumbs ],
+	    [ [ 100, 75 ], [ 200, 150 ], [ 30, 30 ] ], "check sizes");
+  is_image($thumbs[1], $src->scale(scalefactor => 0.5, qtype => "mixing"),
+	   "exact halving is the same as mixing");
+  my $direct = $src->scale(xpixels => 30, ypixels => 30, type => "nonprop",
+			   qtype => "mixing");
+  cmp_ok(max_sample_diff($thumbs[2], $direct), '<=', 40,
+	 "other sizes are close to mixing");
+
+  my @seen;
+  ok($src->scale_pyramid(sizes => [ 64, 32 ],
+			 callback => sub {
+			   my ($im, $index) = @_;
+			   push @seen, [ $index, $im->getwidth ];
+			   1;
+			 }),
+     "scale_pyramid with callback");
+  is_deeply(\@seen, [ [ 0, 64 ], [ 1, 32 ] ], "called for each size in order");
+  ok(!$src->scale_pyramid(sizes => [ 64, 32 ], callback => sub { 0 }),
+     "callback returning false stops");
+
+  ok(!$src->scale_pyramid(sizes => []), "empty sizes");
+  is($src->errstr, "scale_pyramid: sizes must be a non-empty array ref",
+     "check message");
+  ok(!$src->scale_pyramid(sizes => [ 10, [ 0, 10 ] ]), "bad size");
+  is($src->errstr, "scale_pyramid: invalid size at index 1",
+     "check message");
+}
+
 { # passing a reference for scaling parameters should fail
   # RT #35172
   my $im = Imager->new(xsize => 100, ysize => 100);
@@ -238,6 +363,22 @@ SKIP:
 	 "check error message");
 }
 
+sub max_sample_diff {
+  my ($im1, $im2) = @_;
+
+  my $max = 0;
+  for my $y (0 .. $im1->getheight-1) {
+    my @s1 = unpack "C*", $im1->getsamples(y => $y);
+    my @s2 = unpack "C*", $im2->getsamples(y => $y);
+    for my $i (0 .. $#s1) {
+      my $diff = abs($s1[$i] - $s2[$i]);
+      $max = $diff if $diff > $max;
+    }
+  }
+
+  return $max;
+}
+
 sub scale_test {
   my ($in, $method, $exp_width, $exp_height, $note, @parms) = @_;
 
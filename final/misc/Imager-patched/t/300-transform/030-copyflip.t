@@ -1,6 +1,6 @@
 #!perl -w
 use strict;
-use Test::More tests => 95;
+use Test::More tests => 113;
 use Imager;
 use Imager::Test qw(is_color3 is_image is_imaged test_image_double test_image isnt_image is_image_similar);
 
@@ -277,9 +277,62 @@ sub rot_test {
   # $diff->write(file => "testout/t64rotdiff.png");
 }
 
+{ # 8-bit images without perspective take a fixed point path,
+  # compare it to the general path, used for masked images
+  my $rgb = test_image();
+  my $rgba = $rgb->convert(preset => "addalpha");
+  for my $y (0 .. $rgba->getheight-1) {
+    my @alpha = map { ($_ * 7 + $y * 3) % 256 } 0 .. $rgba->getwidth-1;
+    $rgba->setsamples(y => $y, channels => [ 3 ], data => pack("C*", @alpha));
+  }
+  my %ims =
+    (
+     rgb => $rgb,
+     rgba => $rgba,
+     gray => $rgb->convert(preset => "gray"),
+    );
+  my $features = Imager::i_simd_features();
+  for my $name (sort keys %ims) {
+    my $im = $ims{$name};
+    for my $degrees (10, -33) {
+      my $fast = $im->rotate(degrees => $degrees, back => "#804020");
+      my $general = $im->masked->rotate(degrees => $degrees, back => "#804020");
+      cmp_ok(max_sample_diff($fast, $general), '<=', 1,
+	     "$name: rotate $degrees within 1 of general path");
+      my $old = Imager::i_simd_set_mask(0);
+      my $plain = $im->rotate(degrees => $degrees, back => "#804020");
+      Imager::i_simd_set_mask($old);
+      is_image($fast, $plain, "$name: rotate $degrees same without simd ($features)");
+    }
+    my @shear = ( matrix => [ 0.7, 0.2, -3.5, -0.1, 1.3, 2.25, 0, 0, 1 ],
+		  xsize => 200, ysize => 200 );
+    my $fast = $im->matrix_transform(@shear);
+    my $general = $im->masked->matrix_transform(@shear);
+    cmp_ok(max_sample_diff($fast, $general), '<=', 1,
+	   "$name: matrix_transform within 1 of general path");
+    is($fast->getwidth, 200, "$name: matrix_transform width");
+  }
+}
+
 {
   my $empty = Imager->new;
   ok(!$empty->rotate(degrees => 90), "can't rotate an empty image");
   is($empty->errstr, "rotate: empty input image",
      "check error message");
 }
+
+sub max_sample_diff {
+  my ($im1, $im2) = @_;
+
+  my $max = 0;
+  for my $y (0 .. $im1->getheight-1) {
+    my @s1 = unpack "C*", $im1->getsamples(y => $y);
+    my @s2 = unpack "C*", $im2->getsamples(y => $y);
+    for my $i (0 .. $#s1) {
+      my $diff = abs($s1[$i] - $s2[$i]);
+      $max = $diff if $diff > $max;
+    }
+  }
+
+  return $max;
+}
@@ -1,7 +1,7 @@
 #!perl -w
 use strict;
 use Imager qw(:handy);
-use Test::More tests => 122;
+use Test::More tests => 184;
 
 -d "testout" or mkdir "testout";
 
@@ -44,6 +44,21 @@ test($imbase, {type=>'conv', coef=>[ 0.3, 1, 0.3, ], },
   is($work8->errstr, "sum of coefficients is zero", "check message");
 }
 
+{
+  # the vertical pass is done on a transposed copy, make sure that
+  # round trips for images that aren't square or a multiple of the
+  # tile size
+  my $src = $imbase->crop(left => 3, top => 7, width => 75, height => 50);
+  for my $conv (qw(to_rgb8 to_rgb16 to_rgb_double)) {
+    my $im = $src->$conv;
+    my $bits = $im->bits;
+    my $work = $im->copy;
+    ok($work->filter(type => "conv", coef => [ 0, 1, 0 ]),
+       "identity conv $bits bits");
+    is_image($work, $im, "identity conv $bits bits leaves image unchanged");
+  }
+}
+
 {
   my $work8 = $imbase->copy;
   my $work16 = $imbase->to_rgb16;
@@ -65,6 +80,37 @@ test($imbase, {type=>'conv', coef=>[ 0.3, 1, 0.3, ], },
   is_image_similar($gauss, $gauss16, 250000, "8 and 16 gaussian match");
 }
 
+{
+  # 16-bit images use a wider kernel for the exact method, so compare
+  # to that
+  my $exact = $imbase->to_rgb16;
+  ok($exact->filter(type => "gaussian", stddev => 5), "exact gaussian");
+  my $iir = test($imbase, { type => "gaussian", stddev => 5, method => "iir" },
+		 'testout/t61_gaussian_iir.ppm');
+  is_image_similar($iir, $exact, 250000, "iir gaussian close to exact");
+
+  my $iir16 = test($imbase->to_rgb16,
+		   { type => "gaussian", stddev => 5, method => "iir" },
+		   'testout/t61_gaussian_iir16.ppm');
+  is_image_similar($iir, $iir16, 10000, "8 and 16 iir gaussian match");
+
+  my $flat = Imager->new(xsize => 40, ysize => 30, channels => 4);
+  $flat->box(filled => 1, color => [ 100, 150, 200, 128 ]);
+  my $flat_blur = $flat->copy;
+  ok($flat_blur->filter(type => "gaussian", stddev => 20, method => "iir"),
+     "iir blur a solid image");
+  is_image($flat_blur, $flat, "solid image unchanged by iir blur");
+
+  my $work = $imbase->copy;
+  ok(!$work->filter(type => "gaussian", stddev => 5, method => "unknown"),
+     "unknown gaussian method fails");
+  is($work->errstr, "gaussian: method must be exact or iir",
+     "check message");
+  ok(!$work->filter(type => "gaussian", stddev => 0, method => "iir"),
+     "iir gaussian with zero stddev fails");
+  is($work->errstr, "stddev must be positive", "check message");
+}
+
 
 test($imbase, { type=>'gradgen', dist=>1,
                    xo=>[ 10,  10, 120 ],
@@ -400,6 +446,68 @@ is($name, "test gradient", "check the name matches");
   my $cmp2 = Imager->new(xsize => 3, ysize => 2, channels => 4);
   $cmp2->setpixel(x => 2, 'y' => 0, color => '#FF02FF');
   is_image($diff2, $cmp2, "difference() - check image with mindist 1");
+
+  is($im1->difference_pixels(other => $im2), 2,
+     "difference_pixels() - mindist 0");
+  is($im1->difference_pixels(other => $im2, mindist => 1), 1,
+     "difference_pixels() - mindist 1");
+  is($im1->difference_pixels(other => $im1->copy), 0,
+     "difference_pixels() - no differences");
+  cmp_ok($im1->difference_pixels(other => $im2, limit => 0), '>', 0,
+         "difference_pixels() - stop at the first difference");
+  my $gray = Imager->new(xsize => 3, ysize => 2, channels => 1);
+  ok(!defined $im1->difference_pixels(other => $gray),
+     "difference_pixels() - fail on different channel counts");
+  is($im1->errstr, "different number of channels", "check message");
+}
+
+{ # difference_pixels() over wider images, vectorized, plain, paletted
+  # and masked
+  my $limit = 13;
+  for my $channels (1 .. 4) {
+    my $im1 = Imager->new(xsize => 67, ysize => 5, channels => $channels);
+    $im1->filter(type => "noise", amount => 100, subtype => 1);
+    my $im2 = $im1->copy;
+    # differences of 1 to 3 in a single channel
+    my $expect = 0;
+    my $expect1 = 0;
+    for my $y (0 .. 4) {
+      for my $x (0 .. 66) {
+        ($x * 7 + $y) % 5 == 0 or next;
+        my $ch = ($x + $y) % $channels;
+        my $inc = 1 + $x % 3;
+        my @samples = $im2->getsamples(y => $y, x => $x, width => 1);
+        $samples[$ch] = $samples[$ch] >= 128
+          ? $samples[$ch] - $inc : $samples[$ch] + $inc;
+        $im2->setsamples(y => $y, x => $x, data => pack("C*", @samples));
+        ++$expect;
+        ++$expect1 if $inc > 1;
+      }
+    }
+    is($im1->difference_pixels(other => $im2), $expect,
+       "$channels channels: count differences");
+    is($im1->difference_pixels(other => $im2, mindist => 1), $expect1,
+       "$channels channels: count differences over 1");
+    cmp_ok($im1->difference_pixels(other => $im2, limit => $limit), '>',
+           $limit, "$channels channels: limit");
+    my $old = Imager::i_simd_set_mask(0);
+    is($im1->difference_pixels(other => $im2), $expect,
+       "$channels channels: count differences without SIMD");
+    is($im1->difference_pixels(other => $im2, mindist => 1), $expect1,
+       "$channels channels: count differences over 1 without SIMD");
+    Imager::i_simd_set_mask($old);
+    is($im1->masked->difference_pixels(other => $im2->masked),
+       $expect, "$channels channels: count differences with masked images");
+    is($im1->to_rgb16->difference_pixels(other => $im2->to_rgb16), $expect,
+       "$channels channels: count differences of 16-bit images");
+  }
+
+  my $pal1 = test_image()->to_paletted;
+  my $pal2 = $pal1->copy;
+  $pal2->setpixel(x => 10, y => 20, color => "#FFFFFF");
+  $pal2->setpixel(x => 140, y => 3, color => "#FFFFFF");
+  is($pal1->difference_pixels(other => $pal2), 2,
+     "count differences of paletted images");
 }
 
 {
@@ -438,6 +546,20 @@ is($name, "test gradient", "check the name matches");
      "check error message");
 }
 
+{ # 8-bit images are filtered in place, others through i_glin()/i_plin()
+  for my $filter ([ contrast => intensity => 1.3 ],
+		  [ "hardinvert" ],
+		  [ postlevels => levels => 5 ],
+		  [ autolevels => lsat => 0.1, usat => 0.1 ]) {
+    my ($type, @params) = @$filter;
+    my $direct = $imbase->copy;
+    ok($direct->filter(type => $type, @params), "$type: direct");
+    my $work = $imbase->copy;
+    $work->masked->filter(type => $type, @params);
+    is_image($work, $direct, "$type: same through a masked image");
+  }
+}
+
 sub test {
   my ($in, $params, $out) = @_;
 
@@ -0,0 +1,103 @@
+#!perl -w
+use strict;
+use Test::More tests => 38;
+use Imager;
+use Imager::Color::Float;
+use Imager::Test qw(test_image);
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/t020compare.log");
+
+my $base = test_image();
+
+{ # identical images
+  my $result = $base->compare(other => $base->copy);
+  ok($result, "compare identical images");
+  is($result->{width}, 150, "check width");
+  is($result->{height}, 150, "check height");
+  is($result->{channels}, 3, "check channels");
+  is($result->{mse}, 0, "no error");
+  is($result->{max_error}, 0, "no max error");
+  cmp_ok($result->{psnr}, '>', 1e300, "infinite PSNR");
+  is($result->{ssim}, 1, "SSIM 1");
+  is($result->{histograms}[1][0], 150 * 150, "all errors are 0");
+  ok(!$result->{heatmap}, "no heatmap by default");
+}
+
+{ # a known difference in one channel
+  my $im1 = Imager->new(xsize => 21, ysize => 13);
+  $im1->box(filled => 1, color => [ 100, 50, 200 ]);
+  my $im2 = Imager->new(xsize => 23, ysize => 13);
+  $im2->box(filled => 1, color => [ 110, 50, 200 ]);
+  my $result = $im1->compare(other => $im2);
+  ok($result, "compare images differing in red");
+  is($result->{width}, 21, "common width");
+  is_deeply($result->{channel_mse}, [ 100, 0, 0 ], "channel mse");
+  is_deeply($result->{channel_max_error}, [ 10, 0, 0 ], "channel max error");
+  is_deeply($result->{channel_mean_error}, [ 10, 0, 0 ],
+	    "channel mean error");
+  is($result->{max_error}, 10, "max error");
+  is(sprintf("%.4f", $result->{mean_error}), "3.3333", "mean error");
+  is(sprintf("%.4f", $result->{channel_psnr}[0]),
+     sprintf("%.4f", 10 * log(65025 / 100) / log(10)), "red PSNR");
+  is($result->{histograms}[0][10], 21 * 13, "red errors are all 10");
+  is($result->{histograms}[0][0], 0, "no red errors are 0");
+  cmp_ok($result->{channel_ssim}[0], '<', 1, "red SSIM less than 1");
+  is($result->{channel_ssim}[1], 1, "green SSIM 1");
+}
+
+{ # 8-bit and double images, and threads, produce the same results
+  my $other = $base->copy;
+  $other->filter(type => "noise", amount => 20);
+  $other->box(filled => 1, xmin => 40, ymin => 20, xmax => 70, ymax => 35,
+	      color => "#FFFFFF");
+  my $result = $base->compare(other => $other, heatmap => 1);
+  ok($result, "compare noisy image");
+  cmp_ok($result->{ssim}, '<', 1, "SSIM less than 1");
+  cmp_ok($result->{ssim}, '>', 0, "SSIM more than 0");
+  my $heatmap = $result->{heatmap};
+  ok($heatmap, "got a heatmap");
+  is($heatmap->getwidth, 10, "heatmap width");
+  is($heatmap->getheight, 10, "heatmap height");
+  is($heatmap->bits, "double", "heatmap is double");
+  cmp_ok(($heatmap->getpixel(x => 3, y => 1, type => "float")->rgba)[0], '>',
+	 ($heatmap->getpixel(x => 8, y => 8, type => "float")->rgba)[0],
+	 "more error where the box was drawn");
+
+  my $dresult = $base->to_rgb_double->compare(other => $other->to_rgb_double);
+  ok(abs($dresult->{psnr} - $result->{psnr}) < 1e-6,
+     "double images give the same PSNR");
+  ok(abs($dresult->{ssim} - $result->{ssim}) < 1e-6,
+     "double images give the same SSIM");
+
+  delete $result->{heatmap};
+  Imager->set_threads(4);
+  my $tresult = $base->compare(other => $other);
+  Imager->set_threads(1);
+  is_deeply($tresult, $result, "same result with 4 threads");
+}
+
+{ # double samples outside 0 to 1 go in the last histogram bin
+  my $bright = Imager->new(xsize => 10, ysize => 10, bits => "double");
+  $bright->box(filled => 1,
+	       color => Imager::Color::Float->new(40, 40, 40));
+  my $black = Imager->new(xsize => 10, ysize => 10, bits => "double");
+  my $result = $bright->compare(other => $black);
+  ok($result, "compare out of range samples");
+  is($result->{histograms}[0][255], 100, "errors in the last bin");
+}
+
+{ # failures
+  my $gray = Imager->new(xsize => 10, ysize => 10, channels => 1);
+  ok(!$base->compare(other => $gray), "fail with different channels");
+  is($base->errstr, "different number of channels", "check message");
+  ok(!$base->compare(other => $base, heatmap => 1, tile => 0),
+     "fail with bad tile");
+}
+
+Imager->close_log;
+
+unless ($ENV{IMAGER_KEEP_FILES}) {
+  unlink "testout/t020compare.log";
+}
@@ -2,7 +2,7 @@
 use strict;
 use Imager;
 use Imager::Test qw(test_image test_image_16 test_image_mono test_image_gray test_image_gray_16 test_image_double test_image_named);
-use Test::More tests => 60;
+use Test::More tests => 71;
 
 # test Imager::Test
 
@@ -63,3 +63,37 @@ for my $named (0, 1) {
     $im->write(file => "testout/t03mono.pbm");
   }
 }
+
+{ # the comparison functions behind is_image() and friends
+  my $im1 = test_image();
+  my $im2 = $im1->copy;
+  my ($r, $g, $b) = $im1->getpixel(x => 100, y => 120)->rgba;
+  $r = $r >= 128 ? $r - 3 : $r + 3;
+  $g = $g >= 128 ? $g - 4 : $g + 4;
+  $im2->setpixel(x => 100, y => 120, color => [ $r, $g, $b ]);
+  is(Imager::i_img_diff($im1->{IMG}, $im2->{IMG}), 25, "i_img_diff");
+  is(sprintf("%.6g", Imager::i_img_diffd($im1->{IMG}, $im2->{IMG})),
+     sprintf("%.6g", 25 / 65025), "i_img_diffd");
+  ok(!Imager::i_img_samef($im1->{IMG}, $im2->{IMG}, 0), "samef: different");
+  ok(!Imager::i_img_samef($im1->{IMG}, $im2->{IMG}, 3.5 / 255),
+     "samef: different by more than 3.5");
+  ok(Imager::i_img_samef($im1->{IMG}, $im2->{IMG}, 4.5 / 255),
+     "samef: same within 4.5");
+  ok(!Imager::i_img_samef($im1->{IMG}, $im2->to_rgb16->{IMG}, 3.5 / 255),
+     "samef: different 8-bit and 16-bit");
+  is(Imager::i_img_diff($im1->masked->{IMG}, $im2->to_paletted->{IMG}),
+     Imager::i_img_diff($im1->{IMG}, $im2->to_paletted->{IMG}),
+     "i_img_diff: masked and paletted");
+
+  # only the common channels and area are compared
+  my $gray = $im1->convert(preset => "gray");
+  my $red = $im1->convert(matrix => [ [ 1, 0, 0 ] ]);
+  is(Imager::i_img_diff($red->{IMG}, $im2->{IMG}), 9,
+     "i_img_diff: only the common channels");
+  ok(!Imager::i_img_samef($im2->{IMG}, $red->{IMG}, 0),
+     "samef: only the common channels");
+  ok(Imager::i_img_samef($im2->{IMG}, $red->{IMG}, 3.5 / 255),
+     "samef: only the common channels, within epsilon");
+  is(Imager::i_img_diff($im1->crop(right => 100)->{IMG}, $im2->{IMG}), 0,
+     "i_img_diff: only the common area");
+}
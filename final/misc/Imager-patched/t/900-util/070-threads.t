@@ -0,0 +1,127 @@
+#!perl -w
+use strict;
+use Test::More tests => 76;
+use Imager;
+use Imager::Test qw(is_image test_image test_image_16 test_image_double);
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/t070threads.log");
+
+# worker threads for filters and transformations
+
+is(Imager->get_threads, 1, "default to a single thread");
+ok(!Imager->set_threads(0), "can't set 0 threads");
+is(Imager->errstr, "threads must be from 1 to 256", "check message");
+ok(!Imager->set_threads(257), "can't set 257 threads");
+ok(!Imager->set_threads(-1), "can't set -1 threads");
+is(Imager->errstr, "set_threads: threads must be a positive integer",
+   "check message");
+ok(!Imager->set_threads("x"), "can't set x threads");
+is(Imager->get_threads, 1, "still a single thread");
+
+my @ops =
+  (
+   [ gaussian => sub {
+       $_[0]->filter(type => "gaussian", stddev => 2) or die;
+       $_[0];
+     } ],
+   [ conv => sub {
+       $_[0]->filter(type => "conv", coef => [ 0.3, 1, 0.3 ]) or die;
+       $_[0];
+     } ],
+   [ unsharpmask => sub {
+       $_[0]->filter(type => "unsharpmask", stddev => 1.5, scale => 0.7)
+	 or die;
+       $_[0];
+     } ],
+   [ "scale down" => sub {
+       $_[0]->scale(xpixels => 47, ypixels => 31, type => "nonprop",
+		    qtype => "mixing");
+     } ],
+   [ "scale up" => sub {
+       $_[0]->scale(xpixels => 211, ypixels => 307, type => "nonprop",
+		    qtype => "mixing");
+     } ],
+   [ rotate => sub {
+       $_[0]->rotate(degrees => 17, back => "#102030");
+     } ],
+   [ convert => sub {
+       $_[0]->convert(matrix => [ [ 0.5, 0.3, 0.2, 0.1 ], [ 0.1, 0.1, 0.8 ],
+				  [ 0.4, 0.4, 0.4, 0.5 ] ]);
+     } ],
+  );
+
+my @images =
+  (
+   [ "8-bit" => test_image() ],
+   [ "16-bit" => test_image_16() ],
+   [ "double" => test_image_double() ],
+   [ "alpha" => test_image()->convert(preset => "addalpha") ],
+  );
+
+# a masked image is filtered on the calling thread
+sub masked_gaussian {
+  my $im = test_image();
+  $im->masked(left => 20, top => 30, right => 120, bottom => 140)
+    ->filter(type => "gaussian", stddev => 2);
+  $im;
+}
+
+my %single;
+for my $image (@images) {
+  my ($name, $im) = @$image;
+  for my $op (@ops) {
+    my ($op_name, $code) = @$op;
+    $single{$name}{$op_name} = $code->($im->copy);
+  }
+}
+my $masked_single = masked_gaussian();
+
+ok(Imager->set_threads(4), "set 4 threads");
+is(Imager->get_threads, 4, "check it was set");
+
+for my $image (@images) {
+  my ($name, $im) = @$image;
+  for my $op (@ops) {
+    my ($op_name, $code) = @$op;
+    my $result = $code->($im->copy);
+    ok($result, "$name $op_name with 4 threads");
+    is_image($result, $single{$name}{$op_name},
+	     "$name $op_name: same as single thread");
+  }
+}
+
+is_image(masked_gaussian(), $masked_single, "masked image filtered the same");
+
+{ # image comparisons
+  my $im1 = test_image();
+  my $im2 = $im1->copy;
+  $im2->filter(type => "noise", amount => 10);
+  my $im3 = $im1->copy;
+  $im3->setpixel(x => 140, y => 147, color => "#FFFFFF");
+  ok(Imager->set_threads(1), "compare with a single thread");
+  my @single = map Imager::i_img_diff($_->[0]{IMG}, $_->[1]{IMG}),
+    [ $im1, $im2 ], [ $im1, $im3 ];
+  my $singled = Imager::i_img_diffd($im1->{IMG}, $im2->{IMG});
+  ok(Imager->set_threads(4), "compare with 4 threads");
+  is(Imager::i_img_diff($im1->{IMG}, $im2->{IMG}), $single[0],
+     "i_img_diff same with 4 threads");
+  is(Imager::i_img_diff($im1->{IMG}, $im3->{IMG}), $single[1],
+     "i_img_diff same with 4 threads (one difference)");
+  is(Imager::i_img_diffd($im1->{IMG}, $im2->{IMG}), $singled,
+     "i_img_diffd same with 4 threads");
+  ok(!Imager::i_img_samef($im1->{IMG}, $im3->{IMG}, 0.5),
+     "samef finds a difference near the end with 4 threads");
+  ok(Imager::i_img_samef($im1->{IMG}, $im1->copy->{IMG}, 0),
+     "samef with 4 threads, identical");
+}
+
+ok(Imager->set_threads(1), "back to a single thread");
+is(Imager->get_threads, 1, "check it was set");
+
+Imager->close_log;
+
+unless ($ENV{IMAGER_KEEP_FILES}) {
+  unlink "testout/t070threads.log";
+}
@@ -0,0 +1,129 @@
+#!perl -w
+use strict;
+use Test::More tests => 33;
+use Imager;
+use Imager::Test qw(is_color3 is_fcolor3);
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/t080imgpool.log");
+
+# reuse of image memory
+
+{
+  my %stats = Imager->image_pool_stats;
+  is($stats{max_bytes}, 0, "pool disabled by default");
+  is($stats{hits}, 0, "no hits");
+  {
+    my $im = Imager->new(xsize => 200, ysize => 200);
+  }
+  %stats = Imager->image_pool_stats;
+  is($stats{bytes}, 0, "nothing kept when disabled");
+
+  ok(!Imager->set_image_pool(-1), "can't set a negative limit");
+  is(Imager->errstr, "set_image_pool: bytes must be a non-negative integer",
+     "check message");
+  ok(!Imager->set_image_pool("x"), "can't set a non-numeric limit");
+}
+
+{
+  ok(Imager->set_image_pool(10_000_000), "enable the pool");
+  my %stats = Imager->image_pool_stats;
+  is($stats{max_bytes}, 10_000_000, "limit set");
+
+  {
+    my $im = Imager->new(xsize => 200, ysize => 200);
+    $im->box(filled => 1, color => "#FF0000");
+  }
+  %stats = Imager->image_pool_stats;
+  is($stats{misses}, 1, "first image misses");
+  is($stats{buffers}, 1, "its buffer is kept");
+  is($stats{bytes}, 131072, "in its size class");
+
+  my $im = Imager->new(xsize => 190, ysize => 205);
+  %stats = Imager->image_pool_stats;
+  is($stats{hits}, 1, "similar sized image reuses it");
+  is($stats{image_hits}, 1, "and the image structure");
+  is($stats{buffers}, 0, "nothing kept now");
+  is_color3($im->getpixel(x => 189, y => 204), 0, 0, 0,
+	    "reused memory is cleared");
+  undef $im;
+
+  # other sample types
+  {
+    my $im16 = Imager->new(xsize => 100, ysize => 100, bits => 16);
+    $im16->box(filled => 1, color => "#00FF00");
+  }
+  {
+    my $im16 = Imager->new(xsize => 100, ysize => 100, bits => 16);
+    is_color3($im16->getpixel(x => 50, y => 50), 0, 0, 0,
+	      "16-bit image is cleared");
+  }
+  {
+    my $imd = Imager->new(xsize => 100, ysize => 100, bits => "double");
+    $imd->box(filled => 1, color => "#0000FF");
+  }
+  {
+    my $imd = Imager->new(xsize => 100, ysize => 100, bits => "double");
+    is_fcolor3($imd->getpixel(x => 50, y => 50, type => "float"), 0, 0, 0,
+	       "double image is cleared");
+  }
+  {
+    my $impal = Imager->new(xsize => 300, ysize => 300, type => "paletted");
+    ok($impal, "paletted image");
+  }
+  %stats = Imager->image_pool_stats;
+  my $hits = $stats{hits};
+  {
+    my $impal = Imager->new(xsize => 300, ysize => 300, type => "paletted");
+    ok($impal, "paletted image again");
+  }
+  %stats = Imager->image_pool_stats;
+  is($stats{hits}, $hits + 1, "paletted image reused memory");
+
+  {
+    my $small = Imager->new(xsize => 10, ysize => 10);
+  }
+  my %small = Imager->image_pool_stats;
+  is($small{hits} + $small{misses}, $stats{hits} + $stats{misses},
+     "small images aren't pooled");
+}
+
+{
+  # limit on what's kept
+  ok(Imager->set_image_pool(100_000), "small limit");
+  my %stats = Imager->image_pool_stats;
+  cmp_ok($stats{bytes}, '<=', 100_000, "pool trimmed to the new limit");
+  {
+    # 40000 bytes, a 40960 byte class
+    my @ims = map Imager->new(xsize => 100, ysize => 100, channels => 4),
+      1 .. 4;
+  }
+  %stats = Imager->image_pool_stats;
+  cmp_ok($stats{bytes}, '<=', 100_000, "within the limit");
+  cmp_ok($stats{buffers}, '>=', 1, "some kept");
+
+  ok(Imager->set_image_pool(0), "disable");
+  %stats = Imager->image_pool_stats;
+  is($stats{bytes}, 0, "nothing kept");
+  is($stats{buffers}, 0, "no buffers");
+  {
+    my $im = Imager->new(xsize => 200, ysize => 200);
+  }
+  my %after = Imager->image_pool_stats;
+  is($after{misses}, $stats{misses}, "not counted when disabled");
+  is($after{bytes}, 0, "still nothing kept");
+}
+
+{
+  # memory allocated with the pool enabled and released after it's
+  # disabled
+  ok(Imager->set_image_pool(10_000_000), "enable again");
+  my $im = Imager->new(xsize => 200, ysize => 200);
+  ok(Imager->set_image_pool(0), "disable");
+  undef $im;
+  my %stats = Imager->image_pool_stats;
+  is($stats{bytes}, 0, "released, not kept");
+}
+
+Imager->close_log;
@@ -0,0 +1,173 @@
+#!perl -w
+use strict;
+use Test::More;
+use Imager;
+use Imager::Test qw(test_image);
+use File::Path qw(rmtree);
+
+eval { require Digest::MD5; 1 }
+  or plan skip_all => "Digest::MD5 not available";
+
+plan tests => 56;
+
+use_ok("Imager::ThumbCache");
+
+-d "testout" or mkdir "testout";
+
+Imager->open_log(log => "testout/t090thumbcache.log");
+
+my $src = test_image()->scale(xpixels => 150, ypixels => 100,
+			      type => "nonprop");
+my $src_data;
+ok($src->write(data => \$src_data, type => "pnm"), "make source data");
+my $src_file = "testout/t090src.ppm";
+ok($src->write(file => $src_file), "make source file");
+
+{
+  ok(!Imager::ThumbCache->new(max_bytes => -1), "bad max_bytes");
+  is(Imager->errstr,
+     "Imager::ThumbCache: max_bytes must be a non-negative integer",
+     "check message");
+  ok(!Imager::ThumbCache->new(dir => "testout/t090-not-there"),
+     "missing directory");
+}
+
+{ # basic cache operations
+  my $cache = Imager::ThumbCache->new(max_bytes => 100);
+  ok($cache, "make a cache");
+  is($cache->get("a"), undef, "nothing there");
+  ok($cache->set(a => "x" x 40), "set a");
+  ok($cache->set(b => "y" x 40), "set b");
+  is($cache->get("a"), "x" x 40, "get a, now most recent");
+  ok($cache->set(c => "z" x 40), "set c, evicts b");
+  is($cache->get("b"), undef, "b evicted");
+  is($cache->get("a"), "x" x 40, "a still there");
+  is($cache->get("c"), "z" x 40, "c there");
+  my %stats = $cache->stats;
+  is($stats{entries}, 2, "2 entries");
+  is($stats{bytes}, 80, "80 bytes");
+  is($stats{hits}, 3, "3 hits");
+  is($stats{misses}, 2, "2 misses");
+  is($stats{evictions}, 1, "1 eviction");
+
+  ok($cache->remove("a"), "remove a");
+  is($cache->get("a"), undef, "a gone");
+
+  my $calls = 0;
+  my $make = sub { ++$calls; "made" };
+  is($cache->fetch([ "op", { size => 10, type => "png" } ], $make), "made",
+     "fetch makes the data");
+  is($cache->fetch([ "op", { type => "png", size => 10 } ], $make), "made",
+     "fetch again, key independent of hash order");
+  is($calls, 1, "only made once");
+  isnt($cache->key("a,b"), $cache->key("a", "b"), "parts are separated");
+  is($cache->fetch("nothing", sub { return }), undef,
+     "nothing returned, nothing cached");
+
+  my $limited = Imager::ThumbCache->new(max_entries => 2);
+  $limited->set($_ => $_) for qw(a b c);
+  is(join(",", map { defined $limited->get($_) ? $_ : "-" } qw(a b c)),
+     "-,b,c", "max_entries limits the entries");
+}
+
+{ # thumbnails
+  my $cache = Imager::ThumbCache->new;
+  my $expected;
+  ok(Imager->square_thumbnail(in => { data => $src_data }, size => 32,
+			      out => { data => \$expected, type => "pnm" }),
+     "make expected thumbnail");
+
+  my $thumb = $cache->square_thumbnail(in => { data => $src_data },
+				       size => 32);
+  ok($thumb, "make a thumbnail")
+    or diag $cache->errstr;
+  is($thumb, $expected, "same as square_thumbnail() produces");
+  my $again = $cache->square_thumbnail(in => { file => $src_file },
+				       size => 32);
+  is($again, $expected, "same again from the file");
+  my %stats = $cache->stats;
+  is($stats{hits}, 1, "served from the cache by content");
+  is($stats{misses}, 1, "made once");
+
+  my $bmp = $cache->square_thumbnail(in => { file => $src_file },
+				     size => 32, type => "bmp");
+  like($bmp, qr/^BM/, "different type is a different entry");
+  my $bigger = $cache->square_thumbnail(in => { file => $src_file },
+					size => 40);
+  my $im = Imager->new(data => $bigger);
+  is($im->getwidth, 40, "different size is a different entry");
+
+  my $by_id = $cache->square_thumbnail(id => "src", in => { file => $src_file },
+				       size => 32);
+  is($by_id, $expected, "by id");
+  my $by_id_again = $cache->square_thumbnail(id => "src",
+					     in => { file => "not-there.ppm" },
+					     size => 32);
+  is($by_id_again, $expected, "by id, source not read");
+
+  ok(!$cache->square_thumbnail(in => { file => $src_file }, size => 0),
+     "bad size");
+  is($cache->errstr, "square_thumbnail: size must be a positive integer",
+     "check message");
+  ok(!$cache->square_thumbnail(in => { file => "testout/t090-missing.ppm" },
+			       size => 10),
+     "missing source");
+  like($cache->errstr, qr/^square_thumbnail: cannot open/, "check message");
+}
+
+{ # scale
+  my $cache = Imager::ThumbCache->new;
+  my $data = $cache->scale(in => { file => $src_file },
+			   left => 10, top => 10, width => 100, height => 50,
+			   xpixels => 50, type => "pnm");
+  ok($data, "scale with crop")
+    or diag $cache->errstr;
+  my $im = Imager->new(data => $data);
+  is($im->getwidth, 50, "check width");
+  is($im->getheight, 25, "check height");
+  is($cache->scale(in => { file => $src_file },
+		   left => 10, top => 10, width => 100, height => 50,
+		   xpixels => 50, type => "pnm"), $data, "same again");
+  my %stats = $cache->stats;
+  is($stats{hits}, 1, "served from the cache");
+}
+
+{ # spill directory
+  my $dir = "testout/t090spill";
+  rmtree($dir);
+  mkdir $dir;
+  my $cache = Imager::ThumbCache->new(max_bytes => 100, dir => $dir);
+  $cache->set(a => "a" x 60);
+  $cache->set(b => "b" x 60);
+  my @files = glob("$dir/*");
+  is(@files, 1, "a spilled to disk");
+  is($cache->get("a"), "a" x 60, "read back from disk");
+  my %stats = $cache->stats;
+  is($stats{disk_hits}, 1, "counted as a disk hit");
+  is($cache->get("b"), "b" x 60, "b read back from disk too");
+
+  # other processes sharing the directory still see entries read back
+  my $other = Imager::ThumbCache->new(max_bytes => 100, dir => $dir);
+  is($other->get("a"), "a" x 60, "disk hit leaves the file for others");
+
+  # keys can't name files outside the directory
+  my $victim = "testout/t090victim";
+  open my $fh, ">", $victim or die "Cannot create $victim: $!";
+  print $fh "keep me";
+  close $fh;
+  $cache->set("../t090victim" => "x" x 200);
+  $cache->remove("../t090victim");
+  ok(-s $victim == 7, "key with .. doesn't write or remove outside dir");
+  $cache->set("../t090escape" => "x" x 200);
+  ok(!-e "testout/t090escape", "spilled inside dir");
+  is($cache->get("../t090escape"), "x" x 200, "and read back");
+  ok(!grep(!m(/[0-9a-f]{32}\z), glob("$dir/*")), "files named by digests");
+  unlink $victim;
+  rmtree($dir);
+}
+
+Imager->close_log;
+
+unless ($ENV{IMAGER_KEEP_FILES}) {
+  unlink $src_file, "testout/t090thumbcache.log";
+}
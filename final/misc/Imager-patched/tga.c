@@ -811,6 +811,74 @@ i_readtga_wiol(io_glue *ig, int length) {
 
 
 
+/*
+=item i_probetga_wiol(ig, info)
+
+Reads the header of a targa file into C<info> without reading the
+image data.  Returns non-zero on success.
+
+=cut
+*/
+
+int
+i_probetga_wiol(io_glue *ig, i_image_info *info) {
+  tga_header header;
+  unsigned char headbuf[18];
+  unsigned int bpp;
+
+  i_clear_error();
+
+  mm_log((1,"i_probetga_wiol(ig %p, info %p)\n", ig, info));
+  
+  if (i_io_read(ig, &headbuf, 18) != 18) {
+    i_push_error(errno, "could not read targa header");
+    return 0;
+  }
+
+  if (!tga_header_verify(headbuf)) {
+    i_push_error(0, "Unknown targa format");
+    return 0;
+  }
+
+  tga_header_unpack(&header, headbuf);
+
+  memset(info, 0, sizeof(*info));
+  info->format = "tga";
+  switch (header.datatypecode) {
+  case 0: /* No data in image */
+    i_push_error(0, "Targa image contains no image data");
+    return 0;
+
+  case 1:  /* Uncompressed, color-mapped images */
+  case 9:  /* Compressed,   color-mapped images */
+    info->paletted = 1;
+    bpp = header.colourmapdepth;
+    break;
+
+  case 3:  /* Uncompressed, grayscale images    */
+  case 11: /* Compressed,   grayscale images    */
+    bpp = 8;
+    break;
+
+  default:
+    bpp = header.bitsperpixel;
+    break;
+  }
+
+  if (!(info->channels = bpp_to_channels(bpp, header.imagedescriptor & 0xF))) {
+    i_push_error(0, "Targa Image has none of 15/16/24/32 pixel layout");
+    return 0;
+  }
+
+  info->width = header.width;
+  info->height = header.height;
+  info->bits = info->paletted ? 8 : bpp == 15 || bpp == 16 ? 5 : 8;
+
+  return 1;
+}
+
+
+
 /*
 =item i_writetga_wiol(img, ig)
 